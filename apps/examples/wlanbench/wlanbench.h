@@ -0,0 +1,156 @@
+/****************************************************************************
+ * examples/wlanbench/wlanbench.h
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_EXAMPLES_WLANBENCH_WLANBENCH_H
+#define __APPS_EXAMPLES_WLANBENCH_WLANBENCH_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_PORT
+#  define CONFIG_EXAMPLES_WLANBENCH_PORT 5201
+#endif
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_IFNAME
+#  define CONFIG_EXAMPLES_WLANBENCH_IFNAME "wlan0"
+#endif
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_DURATION
+#  define CONFIG_EXAMPLES_WLANBENCH_DURATION 10
+#endif
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_BUFSIZE
+#  define CONFIG_EXAMPLES_WLANBENCH_BUFSIZE 1460
+#endif
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_SMALLSIZE
+#  define CONFIG_EXAMPLES_WLANBENCH_SMALLSIZE 64
+#endif
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_NSAMPLES
+#  define CONFIG_EXAMPLES_WLANBENCH_NSAMPLES 1000
+#endif
+
+#ifndef CONFIG_EXAMPLES_WLANBENCH_CPUMHZ
+#  define CONFIG_EXAMPLES_WLANBENCH_CPUMHZ 0
+#endif
+
+/* The first message on every TCP connection selects what the server does
+ * with the rest of the connection.
+ */
+
+#define WB_TCP_SINK       0     /* Read and discard until the peer closes */
+#define WB_TCP_ECHO       1     /* Return every request of wh_size bytes */
+
+/* The first byte of every UDP datagram is its type.  The server answers
+ * WB_UDP_FIN with a struct wb_report_s.
+ */
+
+#define WB_UDP_START      0     /* Restart the receive counters */
+#define WB_UDP_DATA       1     /* Counted and discarded */
+#define WB_UDP_FIN        2     /* End of the run, request the counters */
+
+/* Largest request the echo server accepts */
+
+#define WB_MAXREQ         CONFIG_EXAMPLES_WLANBENCH_BUFSIZE
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* First message of a TCP connection (network byte order) */
+
+struct wb_hello_s
+{
+  uint32_t wh_mode;             /* WB_TCP_SINK or WB_TCP_ECHO */
+  uint32_t wh_size;             /* Request size of WB_TCP_ECHO */
+};
+
+/* Reply to WB_UDP_FIN (network byte order) */
+
+struct wb_report_s
+{
+  uint32_t wr_packets;          /* WB_UDP_DATA datagrams received */
+  uint32_t wr_bytes;            /* Payload bytes received */
+};
+
+/* Outcome of one client workload */
+
+struct wb_result_s
+{
+  uint64_t wr_bytes;            /* Payload bytes sent */
+  uint32_t wr_usec;             /* Length of the run */
+  uint32_t wr_packets;          /* Writes, datagrams or exchanges */
+  int32_t  wr_rxpackets;        /* Datagrams seen by the server, or -1 */
+  int32_t  wr_rxbytes;          /* Bytes seen by the server, or -1 */
+  FAR uint32_t *wr_lat;         /* Latency samples (usec), or NULL */
+  unsigned int wr_nlat;         /* Number of latency samples */
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/* wlanbench_main.c */
+
+uint64_t wb_now(void);
+
+/* wlanbench_client.c */
+
+int wb_tcp_stream(FAR const struct sockaddr_in *server, unsigned int seconds,
+                  size_t size, FAR struct wb_result_s *result);
+int wb_tcp_rr(FAR const struct sockaddr_in *server, unsigned int count,
+              size_t size, FAR struct wb_result_s *result);
+int wb_udp_stream(FAR const struct sockaddr_in *server, unsigned int seconds,
+                  size_t size, FAR struct wb_result_s *result);
+
+/* wlanbench_server.c */
+
+int wb_server(void);
+
+#endif /* __APPS_EXAMPLES_WLANBENCH_WLANBENCH_H */
@@ -0,0 +1,375 @@
+/****************************************************************************
+ * examples/wlanbench/wlanbench_client.c
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "wlanbench.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wb_connect
+ *
+ * Description:
+ *   Open a TCP connection to the server and send the hello message that
+ *   selects the server behaviour.  Returns the socket or -1.
+ *
+ ****************************************************************************/
+
+static int wb_connect(FAR const struct sockaddr_in *server, uint32_t mode,
+                      uint32_t size)
+{
+  struct wb_hello_s hello;
+  int sd;
+
+  sd = socket(PF_INET, SOCK_STREAM, 0);
+  if (sd < 0)
+    {
+      fprintf(stderr, "wlanbench: socket failed: %d\n", errno);
+      return -1;
+    }
+
+  if (connect(sd, (FAR const struct sockaddr *)server,
+              sizeof(struct sockaddr_in)) < 0)
+    {
+      fprintf(stderr, "wlanbench: connect failed: %d\n", errno);
+      close(sd);
+      return -1;
+    }
+
+  hello.wh_mode = htonl(mode);
+  hello.wh_size = htonl(size);
+
+  if (send(sd, &hello, sizeof(hello), 0) != sizeof(hello))
+    {
+      fprintf(stderr, "wlanbench: send failed: %d\n", errno);
+      close(sd);
+      return -1;
+    }
+
+  return sd;
+}
+
+/****************************************************************************
+ * Name: wb_udp_ctrl
+ *
+ * Description:
+ *   Send a one byte control datagram.  For WB_UDP_FIN, wait up to a second
+ *   for the server report, retrying a few times since either datagram may
+ *   be lost on the air.
+ *
+ ****************************************************************************/
+
+static int wb_udp_ctrl(int sd, FAR const struct sockaddr_in *server,
+                       uint8_t type, FAR struct wb_report_s *report)
+{
+  int retries;
+  int nbytes;
+
+  for (retries = 0; retries < 3; retries++)
+    {
+      nbytes = sendto(sd, &type, 1, 0, (FAR const struct sockaddr *)server,
+                      sizeof(struct sockaddr_in));
+      if (nbytes < 0)
+        {
+          return -1;
+        }
+
+      if (report == NULL)
+        {
+          return 0;
+        }
+
+      nbytes = recv(sd, report, sizeof(struct wb_report_s), 0);
+      if (nbytes == sizeof(struct wb_report_s))
+        {
+          report->wr_packets = ntohl(report->wr_packets);
+          report->wr_bytes   = ntohl(report->wr_bytes);
+          return 0;
+        }
+    }
+
+  return -1;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wb_tcp_stream
+ *
+ * Description:
+ *   Write 'size' byte blocks to a sink connection for 'seconds'.
+ *
+ ****************************************************************************/
+
+int wb_tcp_stream(FAR const struct sockaddr_in *server, unsigned int seconds,
+                  size_t size, FAR struct wb_result_s *result)
+{
+  FAR uint8_t *buffer;
+  uint64_t start;
+  uint64_t end;
+  uint64_t now;
+  ssize_t nbytes;
+  int sd;
+
+  buffer = (FAR uint8_t *)malloc(size);
+  if (buffer == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memset(buffer, 0x5a, size);
+
+  sd = wb_connect(server, WB_TCP_SINK, 0);
+  if (sd < 0)
+    {
+      free(buffer);
+      return -ECONNREFUSED;
+    }
+
+  start = wb_now();
+  end   = start + (uint64_t)seconds * 1000000;
+
+  do
+    {
+      nbytes = send(sd, buffer, size, 0);
+      if (nbytes <= 0)
+        {
+          fprintf(stderr, "wlanbench: send failed: %d\n", errno);
+          break;
+        }
+
+      result->wr_bytes += nbytes;
+      result->wr_packets++;
+      now = wb_now();
+    }
+  while (now < end);
+
+  /* The run ends when the stack has taken the last block; data still in
+   * the send buffer is not counted.
+   */
+
+  result->wr_usec = (uint32_t)(wb_now() - start);
+
+  close(sd);
+  free(buffer);
+  return nbytes > 0 ? OK : -EIO;
+}
+
+/****************************************************************************
+ * Name: wb_tcp_rr
+ *
+ * Description:
+ *   Exchange 'count' request/response pairs of 'size' bytes with an echo
+ *   connection and record the round trip time of each one.
+ *
+ ****************************************************************************/
+
+int wb_tcp_rr(FAR const struct sockaddr_in *server, unsigned int count,
+              size_t size, FAR struct wb_result_s *result)
+{
+  FAR uint8_t *buffer;
+  uint64_t start;
+  uint64_t sent;
+  ssize_t nbytes;
+  size_t nrecvd;
+  int ret = OK;
+  int sd;
+
+  if (size > WB_MAXREQ)
+    {
+      size = WB_MAXREQ;
+    }
+
+  buffer = (FAR uint8_t *)malloc(size);
+  result->wr_lat = (FAR uint32_t *)malloc(count * sizeof(uint32_t));
+  if (buffer == NULL || result->wr_lat == NULL)
+    {
+      free(buffer);
+      return -ENOMEM;
+    }
+
+  sd = wb_connect(server, WB_TCP_ECHO, size);
+  if (sd < 0)
+    {
+      free(buffer);
+      return -ECONNREFUSED;
+    }
+
+  memset(buffer, 0xa5, size);
+  start = wb_now();
+
+  while (result->wr_nlat < count)
+    {
+      sent   = wb_now();
+      nbytes = send(sd, buffer, size, 0);
+      if (nbytes != size)
+        {
+          fprintf(stderr, "wlanbench: send failed: %d\n", errno);
+          ret = -EIO;
+          break;
+        }
+
+      for (nrecvd = 0; nrecvd < size; nrecvd += nbytes)
+        {
+          nbytes = recv(sd, &buffer[nrecvd], size - nrecvd, 0);
+          if (nbytes <= 0)
+            {
+              fprintf(stderr, "wlanbench: recv failed: %d\n", errno);
+              ret = -EIO;
+              goto done;
+            }
+        }
+
+      result->wr_lat[result->wr_nlat++] = (uint32_t)(wb_now() - sent);
+      result->wr_bytes += size;
+      result->wr_packets++;
+    }
+
+done:
+  result->wr_usec = (uint32_t)(wb_now() - start);
+  close(sd);
+  free(buffer);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: wb_udp_stream
+ *
+ * Description:
+ *   Send 'size' byte datagrams as fast as the stack accepts them for
+ *   'seconds', then ask the server how many arrived.
+ *
+ ****************************************************************************/
+
+int wb_udp_stream(FAR const struct sockaddr_in *server, unsigned int seconds,
+                  size_t size, FAR struct wb_result_s *result)
+{
+#ifdef CONFIG_NET_SOCKOPTS
+  struct wb_report_s report;
+  struct timeval tv;
+#endif
+  FAR uint8_t *buffer;
+  uint64_t start;
+  uint64_t end;
+  uint64_t now;
+  ssize_t nbytes;
+  int sd;
+
+  if (size < 1)
+    {
+      size = 1;
+    }
+
+  buffer = (FAR uint8_t *)malloc(size);
+  if (buffer == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memset(buffer, 0x3c, size);
+  buffer[0] = WB_UDP_DATA;
+
+  sd = socket(PF_INET, SOCK_DGRAM, 0);
+  if (sd < 0)
+    {
+      fprintf(stderr, "wlanbench: socket failed: %d\n", errno);
+      free(buffer);
+      return -EIO;
+    }
+
+#ifdef CONFIG_NET_SOCKOPTS
+  tv.tv_sec  = 1;
+  tv.tv_usec = 0;
+  setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(struct timeval));
+#endif
+
+  wb_udp_ctrl(sd, server, WB_UDP_START, NULL);
+
+  start = wb_now();
+  end   = start + (uint64_t)seconds * 1000000;
+
+  do
+    {
+      nbytes = sendto(sd, buffer, size, 0,
+                      (FAR const struct sockaddr *)server,
+                      sizeof(struct sockaddr_in));
+      if (nbytes > 0)
+        {
+          result->wr_bytes += nbytes;
+          result->wr_packets++;
+        }
+
+      now = wb_now();
+    }
+  while (now < end);
+
+  result->wr_usec = (uint32_t)(now - start);
+
+  /* Without a receive timeout a lost report would hang the client */
+
+#ifdef CONFIG_NET_SOCKOPTS
+  if (wb_udp_ctrl(sd, server, WB_UDP_FIN, &report) == 0)
+    {
+      result->wr_rxpackets = report.wr_packets;
+      result->wr_rxbytes   = report.wr_bytes;
+    }
+#else
+  wb_udp_ctrl(sd, server, WB_UDP_FIN, NULL);
+#endif
+
+  close(sd);
+  free(buffer);
+  return OK;
+}
@@ -0,0 +1,385 @@
+/****************************************************************************
+ * examples/wlanbench/wlanbench_main.c
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/net/iob.h>
+#ifdef CONFIG_NET_IEEE80211
+#  include <nuttx/net/ieee80211.h>
+#endif
+
+#include "wlanbench.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Counters sampled before each workload */
+
+struct wb_snapshot_s
+{
+#ifdef CONFIG_NET_IEEE80211
+  struct ieee80211_txstats_s ws_tx;
+  bool ws_havetx;
+#endif
+  int ws_unused;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static FAR const char *g_ifname = CONFIG_EXAMPLES_WLANBENCH_IFNAME;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wb_rate
+ *
+ * Description:
+ *   Scale a count over 'usec' microseconds to a count per second.
+ *
+ ****************************************************************************/
+
+static unsigned long wb_rate(uint64_t count, uint32_t usec)
+{
+  return usec > 0 ? (unsigned long)(count * 1000000 / usec) : 0;
+}
+
+/****************************************************************************
+ * Name: wb_compare
+ *
+ * Description:
+ *   qsort() comparison of two latency samples.
+ *
+ ****************************************************************************/
+
+static int wb_compare(FAR const void *a, FAR const void *b)
+{
+  uint32_t la = *(FAR const uint32_t *)a;
+  uint32_t lb = *(FAR const uint32_t *)b;
+
+  return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+/****************************************************************************
+ * Name: wb_begin
+ *
+ * Description:
+ *   Restart the I/O buffer high-water mark and sample the 802.11 transmit
+ *   counters before a workload.
+ *
+ ****************************************************************************/
+
+static void wb_begin(FAR struct wb_snapshot_s *snap,
+                     FAR struct wb_result_s *result)
+{
+#ifdef CONFIG_IOB_STATS
+  struct iob_stats_s iob;
+
+  iob_getstats(&iob, true);
+#endif
+
+  memset(result, 0, sizeof(struct wb_result_s));
+  result->wr_rxpackets = -1;
+  result->wr_rxbytes   = -1;
+
+#ifdef CONFIG_NET_IEEE80211
+  snap->ws_havetx = (ieee80211_txstats(g_ifname, &snap->ws_tx) == OK);
+#endif
+}
+
+/****************************************************************************
+ * Name: wb_report
+ *
+ * Description:
+ *   Print the result of one workload as a single line of key=value pairs.
+ *   Fields that are not available in this configuration are omitted.
+ *
+ ****************************************************************************/
+
+static void wb_report(FAR const char *name, size_t size,
+                      FAR const struct wb_snapshot_s *snap,
+                      FAR struct wb_result_s *result, int ret)
+{
+#ifdef CONFIG_IOB_STATS
+  struct iob_stats_s iob;
+#endif
+#ifdef CONFIG_NET_IEEE80211
+  struct ieee80211_txstats_s tx;
+#endif
+#ifdef CONFIG_SCHED_CPULOAD
+  struct cpuload_s load;
+  unsigned long busy;
+  unsigned long nsec;
+#endif
+  FAR uint32_t *lat;
+  unsigned int n;
+
+  printf("wlanbench test=%s ifname=%s size=%lu status=%d usec=%lu "
+         "bytes=%lu pkts=%lu kbps=%lu pps=%lu",
+         name, g_ifname, (unsigned long)size, ret,
+         (unsigned long)result->wr_usec, (unsigned long)result->wr_bytes,
+         (unsigned long)result->wr_packets,
+         wb_rate(result->wr_bytes * 8, result->wr_usec) / 1000,
+         wb_rate(result->wr_packets, result->wr_usec));
+
+  if (result->wr_rxpackets >= 0)
+    {
+      printf(" rx_pkts=%ld rx_kbps=%lu loss_pm=%lu",
+             (long)result->wr_rxpackets,
+             wb_rate((uint64_t)result->wr_rxbytes * 8, result->wr_usec) /
+             1000,
+             result->wr_packets > 0 &&
+             result->wr_packets > (uint32_t)result->wr_rxpackets ?
+             (unsigned long)(((uint64_t)result->wr_packets -
+                              result->wr_rxpackets) * 1000 /
+                             result->wr_packets) : 0ul);
+    }
+
+  if (result->wr_lat != NULL && result->wr_nlat > 0)
+    {
+      lat = result->wr_lat;
+      n   = result->wr_nlat;
+      qsort(lat, n, sizeof(uint32_t), wb_compare);
+
+      printf(" lat_min=%lu lat_p50=%lu lat_p99=%lu lat_max=%lu",
+             (unsigned long)lat[0], (unsigned long)lat[(n - 1) * 50 / 100],
+             (unsigned long)lat[(n - 1) * 99 / 100],
+             (unsigned long)lat[n - 1]);
+    }
+
+#ifdef CONFIG_SCHED_CPULOAD
+  /* The load of the IDLE task (PID 0) is a decaying average over the CPU
+   * load time constant, so the figure only describes the workload if the
+   * run lasted at least that long.
+   */
+
+  if (clock_cpuload(0, &load) == OK && load.total > 0 &&
+      result->wr_packets > 0)
+    {
+      busy = 1000 - (unsigned long)((uint64_t)load.active * 1000 /
+                                    load.total);
+      nsec = (unsigned long)((uint64_t)result->wr_usec * busy /
+                             result->wr_packets);
+
+      printf(" cpu_pm=%lu cpu_ns_pkt=%lu", busy, nsec);
+#if CONFIG_EXAMPLES_WLANBENCH_CPUMHZ > 0
+      printf(" cycles_pkt=%lu",
+             nsec * CONFIG_EXAMPLES_WLANBENCH_CPUMHZ / 1000);
+#endif
+    }
+#endif
+
+#ifdef CONFIG_IOB_STATS
+  iob_getstats(&iob, false);
+  printf(" iob_hiwat=%u iob_nbuf=%u", iob.is_hiwat, iob.is_nbuffers);
+#endif
+
+#ifdef CONFIG_NET_IEEE80211
+  if (snap->ws_havetx && ieee80211_txstats(g_ifname, &tx) == OK)
+    {
+      printf(" classify_fps=%lu encrypt_fps=%lu enqueue_fps=%lu "
+             "dequeue_fps=%lu txq_drops=%lu txq_hiwat=%u",
+             wb_rate(tx.ts_classified - snap->ws_tx.ts_classified,
+                     result->wr_usec),
+             wb_rate(tx.ts_encrypted - snap->ws_tx.ts_encrypted,
+                     result->wr_usec),
+             wb_rate(tx.ts_enqueued - snap->ws_tx.ts_enqueued,
+                     result->wr_usec),
+             wb_rate(tx.ts_dequeued - snap->ws_tx.ts_dequeued,
+                     result->wr_usec),
+             (unsigned long)(tx.ts_drops - snap->ws_tx.ts_drops),
+             tx.ts_hiwat);
+    }
+#endif
+
+  printf("\n");
+
+  free(result->wr_lat);
+  result->wr_lat = NULL;
+}
+
+/****************************************************************************
+ * Name: wb_usage
+ ****************************************************************************/
+
+static void wb_usage(FAR const char *progname)
+{
+  fprintf(stderr, "USAGE: %s -s\n", progname);
+  fprintf(stderr, "       %s [-i <ifname>] [-t <seconds>] [-l <size>] "
+          "[-n <samples>] [-w tcp|udp|rr|small|all] <server-ip>\n",
+          progname);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wb_now
+ *
+ * Description:
+ *   Return the current time in microseconds.  The resolution is that of
+ *   the system timer.
+ *
+ ****************************************************************************/
+
+uint64_t wb_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/****************************************************************************
+ * Name: wlanbench_main
+ ****************************************************************************/
+
+int wlanbench_main(int argc, char *argv[])
+{
+  struct sockaddr_in server;
+  struct wb_snapshot_s snap;
+  struct wb_result_s result;
+  FAR const char *workload = "all";
+  unsigned int seconds = CONFIG_EXAMPLES_WLANBENCH_DURATION;
+  unsigned int nsamples = CONFIG_EXAMPLES_WLANBENCH_NSAMPLES;
+  size_t size = CONFIG_EXAMPLES_WLANBENCH_BUFSIZE;
+  bool all;
+  int ret;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "si:t:l:n:w:")) != ERROR)
+    {
+      switch (ch)
+        {
+          case 's':
+            ret = wb_server();
+            return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+
+          case 'i':
+            g_ifname = optarg;
+            break;
+
+          case 't':
+            seconds = atoi(optarg);
+            break;
+
+          case 'l':
+            size = atoi(optarg);
+            break;
+
+          case 'n':
+            nsamples = atoi(optarg);
+            break;
+
+          case 'w':
+            workload = optarg;
+            break;
+
+          default:
+            wb_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+  if (optind != argc - 1 || size < 1 || nsamples < 1)
+    {
+      wb_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  memset(&server, 0, sizeof(struct sockaddr_in));
+  server.sin_family      = AF_INET;
+  server.sin_port        = htons(CONFIG_EXAMPLES_WLANBENCH_PORT);
+  server.sin_addr.s_addr = inet_addr(argv[optind]);
+
+  all = (strcmp(workload, "all") == 0);
+
+  if (all || strcmp(workload, "tcp") == 0)
+    {
+      wb_begin(&snap, &result);
+      ret = wb_tcp_stream(&server, seconds, size, &result);
+      wb_report("tcp", size, &snap, &result, ret);
+    }
+
+  if (all || strcmp(workload, "udp") == 0)
+    {
+      wb_begin(&snap, &result);
+      ret = wb_udp_stream(&server, seconds, size, &result);
+      wb_report("udp", size, &snap, &result, ret);
+    }
+
+  if (all || strcmp(workload, "rr") == 0)
+    {
+      wb_begin(&snap, &result);
+      ret = wb_tcp_rr(&server, nsamples, CONFIG_EXAMPLES_WLANBENCH_SMALLSIZE,
+                      &result);
+      wb_report("rr", CONFIG_EXAMPLES_WLANBENCH_SMALLSIZE, &snap, &result,
+                ret);
+    }
+
+  if (all || strcmp(workload, "small") == 0)
+    {
+      wb_begin(&snap, &result);
+      ret = wb_udp_stream(&server, seconds,
+                          CONFIG_EXAMPLES_WLANBENCH_SMALLSIZE, &result);
+      wb_report("small", CONFIG_EXAMPLES_WLANBENCH_SMALLSIZE, &snap,
+                &result, ret);
+    }
+
+  return EXIT_SUCCESS;
+}
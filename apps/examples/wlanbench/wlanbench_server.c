@@ -0,0 +1,287 @@
+/****************************************************************************
+ * examples/wlanbench/wlanbench_server.c
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "wlanbench.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wb_bind
+ *
+ * Description:
+ *   Create a socket of 'type' bound to the benchmark port.
+ *
+ ****************************************************************************/
+
+static int wb_bind(int type)
+{
+  struct sockaddr_in addr;
+  int optval;
+  int sd;
+
+  sd = socket(PF_INET, type, 0);
+  if (sd < 0)
+    {
+      fprintf(stderr, "wlanbench: socket failed: %d\n", errno);
+      return -1;
+    }
+
+  optval = 1;
+  setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int));
+
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(CONFIG_EXAMPLES_WLANBENCH_PORT);
+  addr.sin_addr.s_addr = INADDR_ANY;
+
+  if (bind(sd, (FAR struct sockaddr *)&addr, sizeof(struct sockaddr_in)) < 0)
+    {
+      fprintf(stderr, "wlanbench: bind failed: %d\n", errno);
+      close(sd);
+      return -1;
+    }
+
+  return sd;
+}
+
+/****************************************************************************
+ * Name: wb_udp_server
+ *
+ * Description:
+ *   Count WB_UDP_DATA datagrams and report the counts on WB_UDP_FIN.
+ *
+ ****************************************************************************/
+
+static FAR void *wb_udp_server(FAR void *arg)
+{
+  struct sockaddr_in from;
+  struct wb_report_s report;
+  FAR uint8_t *buffer;
+  socklen_t addrlen;
+  uint32_t npackets = 0;
+  uint32_t nbytes = 0;
+  ssize_t ret;
+  int sd = (int)((intptr_t)arg);
+
+  buffer = (FAR uint8_t *)malloc(CONFIG_EXAMPLES_WLANBENCH_BUFSIZE);
+  if (buffer == NULL)
+    {
+      close(sd);
+      return NULL;
+    }
+
+  for (; ; )
+    {
+      addrlen = sizeof(struct sockaddr_in);
+      ret = recvfrom(sd, buffer, CONFIG_EXAMPLES_WLANBENCH_BUFSIZE, 0,
+                     (FAR struct sockaddr *)&from, &addrlen);
+      if (ret <= 0)
+        {
+          continue;
+        }
+
+      switch (buffer[0])
+        {
+          case WB_UDP_START:
+            npackets = 0;
+            nbytes   = 0;
+            break;
+
+          case WB_UDP_DATA:
+            npackets++;
+            nbytes += ret;
+            break;
+
+          case WB_UDP_FIN:
+            report.wr_packets = htonl(npackets);
+            report.wr_bytes   = htonl(nbytes);
+            sendto(sd, &report, sizeof(report), 0,
+                   (FAR struct sockaddr *)&from, addrlen);
+            break;
+
+          default:
+            break;
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: wb_tcp_session
+ *
+ * Description:
+ *   Serve one TCP connection as selected by its hello message.
+ *
+ ****************************************************************************/
+
+static void wb_tcp_session(int sd, FAR uint8_t *buffer)
+{
+  struct wb_hello_s hello;
+  size_t size = sizeof(hello);
+  size_t nrecvd;
+  ssize_t nbytes;
+
+  for (nrecvd = 0; nrecvd < size; nrecvd += nbytes)
+    {
+      nbytes = recv(sd, (FAR uint8_t *)&hello + nrecvd, size - nrecvd, 0);
+      if (nbytes <= 0)
+        {
+          return;
+        }
+    }
+
+  if (ntohl(hello.wh_mode) == WB_TCP_SINK)
+    {
+      while (recv(sd, buffer, CONFIG_EXAMPLES_WLANBENCH_BUFSIZE, 0) > 0);
+      return;
+    }
+
+  size = ntohl(hello.wh_size);
+  if (size < 1 || size > WB_MAXREQ)
+    {
+      return;
+    }
+
+  for (; ; )
+    {
+      for (nrecvd = 0; nrecvd < size; nrecvd += nbytes)
+        {
+          nbytes = recv(sd, &buffer[nrecvd], size - nrecvd, 0);
+          if (nbytes <= 0)
+            {
+              return;
+            }
+        }
+
+      if (send(sd, buffer, size, 0) != size)
+        {
+          return;
+        }
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wb_server
+ *
+ * Description:
+ *   Run the server side of the benchmark.  UDP is served by a separate
+ *   thread; TCP connections are served one at a time.  Never returns on
+ *   success.
+ *
+ ****************************************************************************/
+
+int wb_server(void)
+{
+  struct sockaddr_in addr;
+  FAR uint8_t *buffer;
+  pthread_t thread;
+  socklen_t addrlen;
+  int listensd;
+  int udpsd;
+  int sd;
+  int ret;
+
+  buffer = (FAR uint8_t *)malloc(CONFIG_EXAMPLES_WLANBENCH_BUFSIZE);
+  if (buffer == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  udpsd = wb_bind(SOCK_DGRAM);
+  if (udpsd < 0)
+    {
+      ret = -EIO;
+      goto errout_with_buffer;
+    }
+
+  ret = pthread_create(&thread, NULL, wb_udp_server,
+                       (FAR void *)((intptr_t)udpsd));
+  if (ret != 0)
+    {
+      fprintf(stderr, "wlanbench: pthread_create failed: %d\n", ret);
+      close(udpsd);
+      ret = -ret;
+      goto errout_with_buffer;
+    }
+
+  listensd = wb_bind(SOCK_STREAM);
+  if (listensd < 0 || listen(listensd, 1) < 0)
+    {
+      ret = -EIO;
+      goto errout_with_buffer;
+    }
+
+  printf("wlanbench: listening on port %d\n", CONFIG_EXAMPLES_WLANBENCH_PORT);
+
+  for (; ; )
+    {
+      addrlen = sizeof(struct sockaddr_in);
+      sd = accept(listensd, (FAR struct sockaddr *)&addr, &addrlen);
+      if (sd < 0)
+        {
+          fprintf(stderr, "wlanbench: accept failed: %d\n", errno);
+          continue;
+        }
+
+      wb_tcp_session(sd, buffer);
+      close(sd);
+    }
+
+errout_with_buffer:
+  free(buffer);
+  return ret;
+}
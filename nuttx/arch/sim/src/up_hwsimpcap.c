@@ -0,0 +1,151 @@
+/****************************************************************************
+ * arch/sim/src/up_hwsimpcap.c
+ * Host side capture file of the simulated IEEE 802.11 medium
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Private Definitions
+ ****************************************************************************/
+
+#define PCAP_MAGIC            0xa1b2c3d4
+#define PCAP_SNAPLEN          65535
+#define DLT_IEEE802_11_RADIO  127   /* 802.11 plus radiotap header */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct pcap_filehdr
+{
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+struct pcap_pkthdr
+{
+  uint32_t ts_sec;
+  uint32_t ts_usec;
+  uint32_t caplen;
+  uint32_t len;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static FILE *g_pcap;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: hwsim_pcapopen
+ *
+ * Description:
+ *   Create the capture file of the simulated 802.11 medium on the host.
+ *
+ ****************************************************************************/
+
+int hwsim_pcapopen(const char *path)
+{
+  struct pcap_filehdr hdr =
+  {
+    PCAP_MAGIC, 2, 4, 0, 0, PCAP_SNAPLEN, DLT_IEEE802_11_RADIO
+  };
+
+  g_pcap = fopen(path, "wb");
+  if (g_pcap == NULL)
+    {
+      return -1;
+    }
+
+  if (fwrite(&hdr, sizeof(hdr), 1, g_pcap) != 1)
+    {
+      fclose(g_pcap);
+      g_pcap = NULL;
+      return -1;
+    }
+
+  fflush(g_pcap);
+  return 0;
+}
+
+/****************************************************************************
+ * Name: hwsim_pcapwrite
+ *
+ * Description:
+ *   Append one frame (radiotap header first) stamped with the time of the
+ *   medium.  The file is flushed so that it can be followed while the
+ *   simulation runs.
+ *
+ ****************************************************************************/
+
+void hwsim_pcapwrite(const unsigned char *buf, unsigned int len,
+                     unsigned long long usec)
+{
+  struct pcap_pkthdr hdr;
+
+  if (g_pcap == NULL)
+    {
+      return;
+    }
+
+  hdr.ts_sec  = usec / 1000000;
+  hdr.ts_usec = usec % 1000000;
+  hdr.caplen  = len;
+  hdr.len     = len;
+
+  if (fwrite(&hdr, sizeof(hdr), 1, g_pcap) != 1 ||
+      fwrite(buf, len, 1, g_pcap) != 1)
+    {
+      fclose(g_pcap);
+      g_pcap = NULL;
+      return;
+    }
+
+  fflush(g_pcap);
+}
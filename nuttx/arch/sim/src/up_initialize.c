@@ -130,4 +130,8 @@ void up_initialize(void)
 #ifdef CONFIG_NET
   uipdriver_init();         /* Our "real" network driver */
 #endif
+
+#ifdef CONFIG_SIM_WLAN_HWSIM
+  hwsim_initialize();       /* Simulated 802.11 radios */
+#endif
 }
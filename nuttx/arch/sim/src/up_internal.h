@@ -131,6 +131,30 @@
  * Public Types
  **************************************************************************/
 
+#ifndef __ASSEMBLY__
+
+/* Counters of one simulated 802.11 radio (see hwsim_getstats()) */
+
+#ifdef CONFIG_SIM_WLAN_HWSIM
+struct hwsim_stats_s
+{
+  uint32_t hs_txframes;     /* Frames sent (A-MPDU subframes included) */
+  uint32_t hs_txattempts;   /* PPDUs put on the air, retries included */
+  uint32_t hs_txfailed;     /* Unicast frames never acknowledged */
+  uint32_t hs_rxframes;     /* Frames passed to the 802.11 stack */
+  uint32_t hs_rxlost;       /* Frames lost on the link */
+  uint32_t hs_rxdropped;    /* Frames dropped for lack of I/O buffers */
+  uint64_t hs_airtime;      /* Air time of the transmissions (usec) */
+  uint32_t hs_nkeys;        /* Keys installed */
+  uint32_t hs_keytime;      /* Time of the last key installation (ticks) */
+  uint32_t hs_runtime;      /* Time of the last move to RUN (ticks) */
+  uint16_t hs_ampdu_tx;     /* Active Block Ack agreements as originator */
+  uint16_t hs_ampdu_rx;     /* Active Block Ack agreements as recipient */
+};
+#endif
+
+#endif /* __ASSEMBLY__ */
+
 /**************************************************************************
  * Public Variables
  **************************************************************************/
@@ -230,5 +254,21 @@ extern int uipdriver_setmacaddr(unsigned char *macaddr);
 extern void uipdriver_loop(void);
 #endif
 
+/* up_wlanhwsim.c ********************************************************/
+
+#ifdef CONFIG_SIM_WLAN_HWSIM
+extern int hwsim_initialize(void);
+extern int hwsim_setlink(int tx, int rx, int rssi, int loss);
+extern int hwsim_getstats(int index, struct hwsim_stats_s *stats);
+#endif
+
+/* up_hwsimpcap.c *********************************************************/
+
+#ifdef CONFIG_SIM_WLAN_HWSIM_PCAP
+extern int hwsim_pcapopen(const char *path);
+extern void hwsim_pcapwrite(const unsigned char *buf, unsigned int len,
+                            unsigned long long usec);
+#endif
+
 #endif /* __ASSEMBLY__ */
 #endif /* __ARCH_UP_INTERNAL_H */
@@ -0,0 +1,1458 @@
+/****************************************************************************
+ * arch/sim/src/up_wlanhwsim.c
+ * Simulated IEEE 802.11 radios sharing a software medium
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#ifdef CONFIG_SIM_WLAN_HWSIM
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/net/arp.h>
+#include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
+#include <nuttx/net/uip/uip-arch.h>
+
+#include "ieee80211/ieee80211_ifnet.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_radiotap.h"
+#include "ieee80211/ieee80211_ratectl.h"
+
+#include "up_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+#ifndef CONFIG_SIM_WLAN_HWSIM_NRADIOS
+#  define CONFIG_SIM_WLAN_HWSIM_NRADIOS 2
+#endif
+
+#ifndef CONFIG_SIM_WLAN_HWSIM_NAPS
+#  define CONFIG_SIM_WLAN_HWSIM_NAPS 1
+#endif
+
+#ifndef CONFIG_SIM_WLAN_HWSIM_RSSI
+#  define CONFIG_SIM_WLAN_HWSIM_RSSI -50
+#endif
+
+#ifndef CONFIG_SIM_WLAN_HWSIM_PCAPFILE
+#  define CONFIG_SIM_WLAN_HWSIM_PCAPFILE "hwsim.pcap"
+#endif
+
+#if defined(CONFIG_SIM_WLAN_HWSIM_AMRR)
+#  define HWSIM_RATECTL (&ieee80211_ratectl_amrr)
+#elif defined(CONFIG_SIM_WLAN_HWSIM_RSSADAPT)
+#  define HWSIM_RATECTL (&ieee80211_ratectl_rssadapt)
+#else
+#  define HWSIM_RATECTL (&ieee80211_ratectl_minstrel)
+#endif
+
+#define HWSIM_NRADIOS    CONFIG_SIM_WLAN_HWSIM_NRADIOS
+
+/* The radios are 802.11b/g devices on the 2.4 GHz channels 1-13 */
+
+#define HWSIM_MAXCHAN    13
+
+/* Timing of the medium in microseconds (802.11g, short slot) */
+
+#define HWSIM_SIFS       10
+#define HWSIM_DIFS       28
+#define HWSIM_ACKTIME    44     /* ACK or BlockAck at a basic OFDM rate */
+
+#define HWSIM_NOISEFLOOR -95    /* dBm */
+#define HWSIM_MGMT_TRIES 7      /* Attempts at unicast frames without a chain */
+#define HWSIM_SCAN_DWELL MSEC2TICK(100)
+#define HWSIM_POLLTIME   MSEC2TICK(500) /* uIP timer poll, one half second */
+
+/* Largest captured frame:  radiotap header plus a full MPDU */
+
+#define HWSIM_CAPLEN     (sizeof(struct hwsim_radiotap_s) + IEEE80211_MAX_LEN)
+
+#define HWSIM_RADIOTAP_PRESENT \
+  ((1 << IEEE80211_RADIOTAP_TSFT) | \
+   (1 << IEEE80211_RADIOTAP_FLAGS) | \
+   (1 << IEEE80211_RADIOTAP_RATE) | \
+   (1 << IEEE80211_RADIOTAP_CHANNEL) | \
+   (1 << IEEE80211_RADIOTAP_DBM_ANTSIGNAL) | \
+   (1 << IEEE80211_RADIOTAP_DBM_ANTNOISE))
+
+/* DSSS/CCK rates in units of 500 kb/s */
+
+#define HWSIM_IS_DSSS(r) ((r) == 2 || (r) == 4 || (r) == 11 || (r) == 22)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* One direction of the path between two radios */
+
+struct hwsim_link_s
+{
+  int8_t  hl_rssi;              /* Signal at the receiver (dBm) */
+  uint8_t hl_loss;              /* Frame loss on top of the PHY model (%) */
+};
+
+/* The medium shared by all radios */
+
+struct hwsim_medium_s
+{
+  struct hwsim_link_s hm_link[HWSIM_NRADIOS][HWSIM_NRADIOS]; /* [tx][rx] */
+  uint64_t hm_busy[HWSIM_MAXCHAN + 1];  /* End of the last transmission */
+#ifdef CONFIG_SIM_WLAN_HWSIM_PCAP
+  bool hm_capture;                      /* Capture file is open */
+#endif
+};
+
+/* One simulated radio */
+
+struct hwsim_radio_s
+{
+  struct uip_driver_s hr_dev;           /* Interface understood by uIP */
+  FAR struct ieee80211_s *hr_ic;        /* IEEE 802.11 stack state */
+  int (*hr_newstate)(FAR struct ieee80211_s *, enum ieee80211_state, int);
+  struct iob_queue_s hr_rxq;            /* Frames received from the medium */
+  struct work_s hr_txwork;              /* Transmit poll */
+  struct work_s hr_rxwork;              /* Receive processing */
+  struct work_s hr_scanwork;            /* Channel dwell time during scans */
+  struct work_s hr_pollwork;            /* Periodic uIP timer poll */
+#ifdef CONFIG_IEEE80211_AP
+  struct work_s hr_bcnwork;             /* Beacon interval */
+#endif
+  uint8_t hr_index;                     /* Index in g_hwsim_radios[] */
+  uint8_t hr_chan;                      /* Tuned channel, 0: none */
+  bool hr_up;                           /* Interface is up */
+#ifdef CONFIG_IEEE80211_HT
+  FAR struct ieee80211_node *hr_ba_ni;  /* BlockAck to report, NULL: none */
+  uint64_t hr_ba_bitmap;
+  uint16_t hr_ba_ssn;
+  uint8_t hr_ba_tid;
+#endif
+  struct hwsim_stats_s hr_stats;
+#ifdef CONFIG_NET_MULTIBUFFER
+  uint8_t hr_buf[CONFIG_NET_BUFSIZE + CONFIG_NET_GUARDSIZE];
+#endif
+};
+
+/* Radiotap header of the captured frames */
+
+struct hwsim_radiotap_s
+{
+  struct ieee80211_radiotap_header th_hdr;
+  uint64_t th_tsft;
+  uint8_t  th_flags;
+  uint8_t  th_rate;
+  uint16_t th_chan_freq;
+  uint16_t th_chan_flags;
+  int8_t   th_antsignal;
+  int8_t   th_antnoise;
+} packed_struct;
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void hwsim_txwork(FAR void *arg);
+static void hwsim_rxwork(FAR void *arg);
+static void hwsim_pollwork(FAR void *arg);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct hwsim_radio_s g_hwsim_radios[HWSIM_NRADIOS];
+static struct hwsim_medium_s g_hwsim_medium;
+
+/* Minimum signal (dBm) needed by each rate for a low frame error rate */
+
+static const struct
+{
+  uint8_t rate;
+  int8_t  sens;
+} g_hwsim_sens[] =
+{
+  {   2, -94 }, {   4, -91 }, {  11, -87 }, {  22, -85 },
+  {  12, -88 }, {  18, -87 }, {  24, -85 }, {  36, -83 },
+  {  48, -80 }, {  72, -76 }, {  96, -72 }, { 108, -70 }
+};
+
+#ifdef CONFIG_SIM_WLAN_HWSIM_PCAP
+static uint8_t g_hwsim_capbuf[HWSIM_CAPLEN];
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: hwsim_now
+ *
+ * Description:
+ *   Return the time of the medium in microseconds.
+ *
+ ****************************************************************************/
+
+static inline uint64_t hwsim_now(void)
+{
+  return (uint64_t)clock_systimer() * USEC_PER_TICK;
+}
+
+/****************************************************************************
+ * Name: hwsim_radio
+ *
+ * Description:
+ *   Return the radio that owns the IEEE 802.11 stack instance 'ic'.
+ *
+ ****************************************************************************/
+
+static FAR struct hwsim_radio_s *hwsim_radio(FAR struct ieee80211_s *ic)
+{
+  int i;
+
+  for (i = 0; i < HWSIM_NRADIOS; i++)
+    {
+      if (g_hwsim_radios[i].hr_ic == ic)
+        {
+          return &g_hwsim_radios[i];
+        }
+    }
+
+  PANIC();
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: hwsim_txtime
+ *
+ * Description:
+ *   Return the air time (usec) of a PPDU carrying 'len' bytes at 'rate'
+ *   (in units of 500 kb/s).
+ *
+ ****************************************************************************/
+
+static uint32_t hwsim_txtime(unsigned int len, uint8_t rate)
+{
+  unsigned int nbits;
+  unsigned int ndbps;
+
+  if (HWSIM_IS_DSSS(rate))
+    {
+      /* Long preamble and PLCP header */
+
+      return 192 + (len * 16 + rate - 1) / rate;
+    }
+
+  /* OFDM:  preamble and SIGNAL, 4 usec symbols carrying the SERVICE and
+   * tail bits, and the 2.4 GHz signal extension.
+   */
+
+  nbits = 16 + len * 8 + 6;
+  ndbps = rate * 2;
+  return 20 + 4 * ((nbits + ndbps - 1) / ndbps) + 6;
+}
+
+/****************************************************************************
+ * Name: hwsim_received
+ *
+ * Description:
+ *   Decide whether one transmission at 'rate' over the link 'tx' -> 'rx'
+ *   is received.  Below the sensitivity of the rate, the frame error rate
+ *   rises linearly from 0 to 100% over 8 dB.
+ *
+ ****************************************************************************/
+
+static bool hwsim_received(int tx, int rx, uint8_t rate)
+{
+  FAR const struct hwsim_link_s *hl = &g_hwsim_medium.hm_link[tx][rx];
+  int margin;
+  int per;
+  int i;
+
+  margin = hl->hl_rssi - g_hwsim_sens[0].sens;
+  for (i = 0; i < sizeof(g_hwsim_sens) / sizeof(g_hwsim_sens[0]); i++)
+    {
+      if (g_hwsim_sens[i].rate == rate)
+        {
+          margin = hl->hl_rssi - g_hwsim_sens[i].sens;
+          break;
+        }
+    }
+
+  if (margin >= 4)
+    {
+      per = 0;
+    }
+  else if (margin <= -4)
+    {
+      per = 100;
+    }
+  else
+    {
+      per = (4 - margin) * 100 / 8;
+    }
+
+  per += hl->hl_loss - per * hl->hl_loss / 100;
+  return (rand() % 100) >= per;
+}
+
+/****************************************************************************
+ * Name: hwsim_rate
+ *
+ * Description:
+ *   Return the rate (in units of 500 kb/s) of entry 'ridx' of the rate set
+ *   of 'ni', or 1 Mb/s if the node has no rates.
+ *
+ ****************************************************************************/
+
+static uint8_t hwsim_rate(FAR const struct ieee80211_node *ni, uint8_t ridx)
+{
+  if (ni == NULL || ridx >= ni->ni_rates.rs_nrates)
+    {
+      return 2;
+    }
+
+  return ni->ni_rates.rs_rates[ridx] & IEEE80211_RATE_VAL;
+}
+
+/****************************************************************************
+ * Name: hwsim_airtime
+ *
+ * Description:
+ *   Occupy the channel of 'hr' for 'usec' microseconds and return the time
+ *   at which the transmission starts.
+ *
+ ****************************************************************************/
+
+static uint64_t hwsim_airtime(FAR struct hwsim_radio_s *hr, uint32_t usec)
+{
+  FAR uint64_t *busy = &g_hwsim_medium.hm_busy[hr->hr_chan];
+  uint64_t start = hwsim_now();
+
+  if (*busy > start)
+    {
+      start = *busy;
+    }
+
+  *busy = start + usec;
+  hr->hr_stats.hs_airtime += usec;
+  return start;
+}
+
+/****************************************************************************
+ * Name: hwsim_busy
+ *
+ * Description:
+ *   Return the number of ticks the channel of 'hr' remains busy with the
+ *   transmissions already accepted, or zero if it can take more.  Senders
+ *   are paced so that the simulated medium does not run ahead of time.
+ *
+ ****************************************************************************/
+
+static uint32_t hwsim_busy(FAR struct hwsim_radio_s *hr)
+{
+  uint64_t busy = g_hwsim_medium.hm_busy[hr->hr_chan];
+  uint64_t now = hwsim_now();
+
+  if (busy <= now + USEC_PER_TICK)
+    {
+      return 0;
+    }
+
+  return USEC2TICK(busy - now);
+}
+
+/****************************************************************************
+ * Name: hwsim_capture
+ *
+ * Description:
+ *   Write one transmission to the capture file with a radiotap header.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SIM_WLAN_HWSIM_PCAP
+static void hwsim_capture(FAR struct hwsim_radio_s *hr,
+                          FAR struct iob_s *iob, uint8_t rate,
+                          int rssi, uint64_t tsf)
+{
+  FAR struct hwsim_radiotap_s *th;
+  unsigned int len;
+
+  if (!g_hwsim_medium.hm_capture)
+    {
+      return;
+    }
+
+  /* The simulation host is little endian, as is radiotap */
+
+  th = (FAR struct hwsim_radiotap_s *)g_hwsim_capbuf;
+  memset(th, 0, sizeof(*th));
+  th->th_hdr.it_len      = sizeof(*th);
+  th->th_hdr.it_present  = HWSIM_RADIOTAP_PRESENT;
+  th->th_tsft            = tsf;
+  th->th_flags           = IEEE80211_RADIOTAP_F_SHORTPRE;
+  th->th_rate            = rate;
+  th->th_chan_freq       = ieee80211_ieee2mhz(hr->hr_chan,
+                                              IEEE80211_CHAN_2GHZ);
+  th->th_chan_flags      = IEEE80211_CHAN_2GHZ |
+                           (HWSIM_IS_DSSS(rate) ? IEEE80211_CHAN_CCK :
+                                                  IEEE80211_CHAN_OFDM);
+  th->th_antsignal       = rssi;
+  th->th_antnoise        = HWSIM_NOISEFLOOR;
+
+  len = iob_copyout(&g_hwsim_capbuf[sizeof(*th)], iob,
+                    HWSIM_CAPLEN - sizeof(*th), 0);
+  hwsim_pcapwrite(g_hwsim_capbuf, sizeof(*th) + len, tsf);
+}
+#else
+#  define hwsim_capture(hr, iob, rate, rssi, tsf)
+#endif
+
+/****************************************************************************
+ * Name: hwsim_deliver
+ *
+ * Description:
+ *   Queue a copy of the frame in 'iob' for reception by radio 'rx'.
+ *
+ ****************************************************************************/
+
+static void hwsim_deliver(FAR struct hwsim_radio_s *hr,
+                          FAR struct hwsim_radio_s *rx,
+                          FAR struct iob_s *iob, uint64_t tsf)
+{
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct iob_s *copy;
+
+  copy = iob_alloc(false);
+  if (copy == NULL)
+    {
+      rx->hr_stats.hs_rxdropped++;
+      return;
+    }
+
+  if (iob_clone(iob, copy, false) < 0 ||
+      (ph = IEEE80211_PKTHDR_GET(copy)) == NULL)
+    {
+      iob_free_chain(copy);
+      rx->hr_stats.hs_rxdropped++;
+      return;
+    }
+
+  /* The metadata of the transmitter (its node reference in particular)
+   * is meaningless to the receiver.
+   */
+
+  memset(ph, 0, sizeof(*ph));
+  ph->ph_rxi.rxi_rssi   = g_hwsim_medium.hm_link[hr->hr_index][rx->hr_index]
+                            .hl_rssi - HWSIM_NOISEFLOOR;
+  ph->ph_rxi.rxi_tstamp = (uint32_t)tsf;
+
+  if (iob_add_queue(copy, &rx->hr_rxq) < 0)
+    {
+      iob_free_chain(copy);
+      rx->hr_stats.hs_rxdropped++;
+      return;
+    }
+
+  if (work_available(&rx->hr_rxwork))
+    {
+      (void)work_queue(HPWORK, &rx->hr_rxwork, hwsim_rxwork, rx, 0);
+    }
+}
+
+/****************************************************************************
+ * Name: hwsim_find
+ *
+ * Description:
+ *   Return the radio tuned to the channel of 'hr' whose address is 'addr',
+ *   or NULL if there is none.
+ *
+ ****************************************************************************/
+
+static FAR struct hwsim_radio_s *hwsim_find(FAR struct hwsim_radio_s *hr,
+                                            FAR const uint8_t *addr)
+{
+  FAR struct hwsim_radio_s *rx;
+  int i;
+
+  for (i = 0; i < HWSIM_NRADIOS; i++)
+    {
+      rx = &g_hwsim_radios[i];
+      if (rx != hr && rx->hr_up && rx->hr_chan == hr->hr_chan &&
+          IEEE80211_ADDR_EQ(rx->hr_ic->ic_myaddr, addr))
+        {
+          return rx;
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: hwsim_broadcast
+ *
+ * Description:
+ *   Send a group addressed frame once, to every radio tuned to the same
+ *   channel that receives it.
+ *
+ ****************************************************************************/
+
+static void hwsim_broadcast(FAR struct hwsim_radio_s *hr,
+                            FAR struct iob_s *iob, uint8_t rate)
+{
+  FAR struct hwsim_radio_s *rx;
+  unsigned int len = iob->io_pktlen + IEEE80211_CRC_LEN;
+  uint64_t tsf;
+  int rssi = HWSIM_NOISEFLOOR;
+  int i;
+
+  tsf = hwsim_airtime(hr, HWSIM_DIFS + hwsim_txtime(len, rate));
+  hr->hr_stats.hs_txattempts++;
+
+  for (i = 0; i < HWSIM_NRADIOS; i++)
+    {
+      rx = &g_hwsim_radios[i];
+      if (rx == hr || !rx->hr_up || rx->hr_chan != hr->hr_chan)
+        {
+          continue;
+        }
+
+      if (g_hwsim_medium.hm_link[hr->hr_index][i].hl_rssi > rssi)
+        {
+          rssi = g_hwsim_medium.hm_link[hr->hr_index][i].hl_rssi;
+        }
+
+      if (hwsim_received(hr->hr_index, i, rate))
+        {
+          hwsim_deliver(hr, rx, iob, tsf);
+        }
+      else
+        {
+          rx->hr_stats.hs_rxlost++;
+        }
+    }
+
+  hwsim_capture(hr, iob, rate, rssi, tsf);
+}
+
+/****************************************************************************
+ * Name: hwsim_transmit
+ *
+ * Description:
+ *   Send one MPDU over the medium.  The stack has already encapsulated
+ *   and encrypted it.  Unicast frames are retried along the rate chain
+ *   until acknowledged; the outcome is reported to rate control.  The
+ *   frame and its node reference are released.
+ *
+ ****************************************************************************/
+
+static void hwsim_transmit(FAR struct hwsim_radio_s *hr,
+                           FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_s *ic = hr->hr_ic;
+  FAR struct ieee80211_frame *wh;
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct ieee80211_node *ni;
+  FAR struct hwsim_radio_s *rx;
+  struct ieee80211_ratechain chain;
+  struct ieee80211_txstatus txs;
+  unsigned int len;
+  uint64_t tsf;
+  uint8_t rate;
+  uint8_t ackrate;
+  bool ratectl = false;
+  int i;
+  int n;
+
+  wh  = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  ph  = IEEE80211_PKTHDR(iob);
+  ni  = ph != NULL ? ph->ph_ni : NULL;
+  len = iob->io_pktlen + IEEE80211_CRC_LEN;
+
+  hr->hr_stats.hs_txframes++;
+
+  /* Select the rates to try */
+
+  if (IEEE80211_IS_MULTICAST(wh->i_addr1))
+    {
+      hwsim_broadcast(hr, iob, hwsim_rate(ni, 0));
+      goto done;
+    }
+
+  if (ph != NULL && (ph->ph_flags & IEEE80211_PH_TXHINT) != 0)
+    {
+      chain.rc_nrates  = 1;
+      chain.rc_ridx[0] = ph->ph_txrate;
+      chain.rc_tries[0] = ph->ph_txretries != 0 ? ph->ph_txretries :
+                                                  HWSIM_MGMT_TRIES;
+    }
+  else if (ni != NULL &&
+           (wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) ==
+            IEEE80211_FC0_TYPE_DATA)
+    {
+      ieee80211_ratectl_choose(ic, ni, len, &chain);
+      ratectl = true;
+    }
+  else
+    {
+      chain.rc_nrates  = 1;
+      chain.rc_ridx[0] = 0;
+      chain.rc_tries[0] = HWSIM_MGMT_TRIES;
+    }
+
+  /* Try each entry of the chain in turn.  An unacknowledged frame that
+   * did reach the receiver is received again as a retry.
+   */
+
+  rx      = hwsim_find(hr, wh->i_addr1);
+  ackrate = hwsim_rate(ni, 0);
+
+  memset(&txs, 0, sizeof(txs));
+  txs.txs_len = len;
+
+  for (i = 0; i < chain.rc_nrates && !txs.txs_acked; i++)
+    {
+      rate = hwsim_rate(ni, chain.rc_ridx[i]);
+      txs.txs_final = i;
+
+      for (n = 0; n < chain.rc_tries[i]; n++)
+        {
+          if (i > 0 || n > 0)
+            {
+              wh->i_fc[1] |= IEEE80211_FC1_RETRY;
+            }
+
+          hr->hr_stats.hs_txattempts++;
+
+          tsf = hwsim_airtime(hr, HWSIM_DIFS + hwsim_txtime(len, rate) +
+                                  HWSIM_SIFS + HWSIM_ACKTIME);
+          hwsim_capture(hr, iob, rate, rx != NULL ?
+                        g_hwsim_medium.hm_link[hr->hr_index][rx->hr_index]
+                          .hl_rssi : HWSIM_NOISEFLOOR, tsf);
+
+          txs.txs_tries = n + 1;
+          if (rx == NULL)
+            {
+              continue;
+            }
+
+          if (!hwsim_received(hr->hr_index, rx->hr_index, rate))
+            {
+              rx->hr_stats.hs_rxlost++;
+              continue;
+            }
+
+          hwsim_deliver(hr, rx, iob, tsf);
+          if (hwsim_received(rx->hr_index, hr->hr_index, ackrate))
+            {
+              txs.txs_acked = true;
+              break;
+            }
+        }
+    }
+
+  if (!txs.txs_acked)
+    {
+      hr->hr_stats.hs_txfailed++;
+    }
+
+  if (ratectl)
+    {
+      ieee80211_ratectl_tx_complete(ic, ni, &chain, &txs);
+    }
+
+done:
+  ieee80211_txfree(ic, iob);
+}
+
+/****************************************************************************
+ * Name: hwsim_txpoll
+ *
+ * Description:
+ *   ieee80211_ifpoll() callback:  send one frame unless the channel is
+ *   already booked beyond the current clock tick.
+ *
+ ****************************************************************************/
+
+static int hwsim_txpoll(FAR struct ieee80211_s *ic, FAR struct iob_s *iob)
+{
+  FAR struct hwsim_radio_s *hr = hwsim_radio(ic);
+  uint32_t delay;
+
+  delay = hwsim_busy(hr);
+  if (delay > 0)
+    {
+      (void)work_queue(HPWORK, &hr->hr_txwork, hwsim_txwork, hr, delay);
+      return -EBUSY;
+    }
+
+  /* ieee80211_ifpoll() removes the frame from its queue on return */
+
+  hwsim_transmit(hr, iob);
+  return OK;
+}
+
+#ifdef CONFIG_IEEE80211_HT
+/****************************************************************************
+ * Name: hwsim_ampdu_txpoll
+ *
+ * Description:
+ *   ieee80211_ampdu_poll() callback:  send an A-MPDU as one PPDU at the
+ *   current rate of the receiver and work out the BlockAck bitmap of the
+ *   subframes that got through.  The simulated PHY has no HT rates.  The
+ *   poll is stopped so that hwsim_txwork() can report the BlockAck, which
+ *   must not happen while the aggregate is being handed over.
+ *
+ ****************************************************************************/
+
+static int hwsim_ampdu_txpoll(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_ampdu_s *ampdu)
+{
+  FAR struct hwsim_radio_s *hr = hwsim_radio(ic);
+  FAR struct ieee80211_node *ni = ampdu->am_ni;
+  FAR struct ieee80211_frame *wh;
+  FAR struct hwsim_radio_s *rx;
+  uint64_t bitmap = 0;
+  uint64_t tsf;
+  uint32_t delay;
+  uint16_t seq;
+  uint8_t rate;
+  int i;
+
+  delay = hwsim_busy(hr);
+  if (delay > 0)
+    {
+      (void)work_queue(HPWORK, &hr->hr_txwork, hwsim_txwork, hr, delay);
+      return -EBUSY;
+    }
+
+  wh   = (FAR struct ieee80211_frame *)IOB_DATA(ampdu->am_frames[0]);
+  rx   = hwsim_find(hr, wh->i_addr1);
+  rate = hwsim_rate(ni, ni->ni_txrate);
+
+  hr->hr_stats.hs_txframes += ampdu->am_nframes;
+  hr->hr_stats.hs_txattempts++;
+
+  tsf = hwsim_airtime(hr, HWSIM_DIFS + hwsim_txtime(ampdu->am_len, rate) +
+                          HWSIM_SIFS + HWSIM_ACKTIME);
+
+  for (i = 0; i < ampdu->am_nframes; i++)
+    {
+      hwsim_capture(hr, ampdu->am_frames[i], rate, rx != NULL ?
+                    g_hwsim_medium.hm_link[hr->hr_index][rx->hr_index]
+                      .hl_rssi : HWSIM_NOISEFLOOR, tsf);
+
+      if (rx == NULL)
+        {
+          continue;
+        }
+
+      if (!hwsim_received(hr->hr_index, rx->hr_index, rate))
+        {
+          rx->hr_stats.hs_rxlost++;
+          continue;
+        }
+
+      wh  = (FAR struct ieee80211_frame *)IOB_DATA(ampdu->am_frames[i]);
+      seq = (LE_READ_2(wh->i_seq) >> IEEE80211_SEQ_SEQ_SHIFT) -
+            ampdu->am_ssn;
+      seq &= 0xfff;
+      if (seq < 64)
+        {
+          bitmap |= (uint64_t)1 << seq;
+        }
+
+      hwsim_deliver(hr, rx, ampdu->am_frames[i], tsf);
+    }
+
+  /* A lost BlockAck looks like a lost A-MPDU to the sender */
+
+  if (rx != NULL && bitmap != 0 &&
+      !hwsim_received(rx->hr_index, hr->hr_index, hwsim_rate(ni, 0)))
+    {
+      bitmap = 0;
+    }
+
+  hr->hr_ba_ni     = ni;
+  hr->hr_ba_tid    = ampdu->am_tid;
+  hr->hr_ba_ssn    = ampdu->am_ssn;
+  hr->hr_ba_bitmap = bitmap;
+  return 1;
+}
+#endif
+
+/****************************************************************************
+ * Name: hwsim_uiptxpoll
+ *
+ * Description:
+ *   uip_poll() and uip_timer() callback:  hand the packet that uIP has left
+ *   in d_buf to the stack, which encapsulates and encrypts it.
+ *
+ ****************************************************************************/
+
+static int hwsim_uiptxpoll(FAR struct uip_driver_s *dev)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)dev->d_private;
+
+  /* If the polling resulted in data that should be sent out on the
+   * network, the field d_len is set to a value > 0.
+   */
+
+  if (dev->d_len > 0)
+    {
+      arp_out(dev);
+      (void)ieee80211_ifoutput(hr->hr_ic, dev);
+    }
+
+  /* If zero is returned, the polling will continue until all connections
+   * have been examined.
+   */
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: hwsim_txwork
+ *
+ * Description:
+ *   Collect the packets of uIP and the frames queued by the stack.
+ *
+ ****************************************************************************/
+
+static void hwsim_txwork(FAR void *arg)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)arg;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  if (!hr->hr_up || hr->hr_chan == 0)
+    {
+      goto out;
+    }
+
+  if (hr->hr_ic->ic_state == IEEE80211_S_RUN)
+    {
+      (void)uip_poll(&hr->hr_dev, hwsim_uiptxpoll);
+    }
+
+  if (ieee80211_ifpoll(hr->hr_ic, hwsim_txpoll) < 0)
+    {
+      goto out;
+    }
+
+#ifdef CONFIG_IEEE80211_HT
+  while (ieee80211_ampdu_poll(hr->hr_ic, hwsim_ampdu_txpoll) > 0)
+    {
+      (void)ieee80211_ampdu_ack(hr->hr_ic, hr->hr_ba_ni, hr->hr_ba_tid,
+                                hr->hr_ba_ssn, hr->hr_ba_bitmap);
+      hr->hr_ba_ni = NULL;
+    }
+#endif
+
+out:
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: hwsim_rxwork
+ *
+ * Description:
+ *   Pass the frames received from the medium to the stack.
+ *
+ ****************************************************************************/
+
+static void hwsim_rxwork(FAR void *arg)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)arg;
+  FAR struct ieee80211_s *ic = hr->hr_ic;
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct ieee80211_frame *wh;
+  FAR struct ieee80211_node *ni;
+  struct ieee80211_rxinfo rxi;
+  FAR struct iob_s *iob;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  while ((iob = iob_remove_queue(&hr->hr_rxq)) != NULL)
+    {
+      if (!hr->hr_up)
+        {
+          iob_free_chain(iob);
+          continue;
+        }
+
+      ph = IEEE80211_PKTHDR(iob);
+      if (ph == NULL)
+        {
+          hr->hr_stats.hs_rxdropped++;
+          iob_free_chain(iob);
+          continue;
+        }
+
+      rxi = ph->ph_rxi;
+      wh  = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+      ni  = ieee80211_find_rxnode(ic, wh);
+
+      hr->hr_stats.hs_rxframes++;
+      ieee80211_input(ic, iob, ni, &rxi);
+      ieee80211_release_node(ic, ni);
+    }
+
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: hwsim_pollwork
+ *
+ * Description:
+ *   Run the uIP timers (TCP retransmissions, ARP aging) every half second.
+ *
+ ****************************************************************************/
+
+static void hwsim_pollwork(FAR void *arg)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)arg;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  if (!hr->hr_up)
+    {
+      uip_unlock(lock);
+      return;
+    }
+
+  if (hr->hr_ic->ic_state == IEEE80211_S_RUN)
+    {
+      (void)uip_timer(&hr->hr_dev, hwsim_uiptxpoll, 1);
+    }
+
+  (void)work_queue(HPWORK, &hr->hr_pollwork, hwsim_pollwork, hr,
+                   HWSIM_POLLTIME);
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: hwsim_scanwork
+ *
+ * Description:
+ *   Move on to the next channel at the end of the dwell time.
+ *
+ ****************************************************************************/
+
+static void hwsim_scanwork(FAR void *arg)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)arg;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  if (hr->hr_up && hr->hr_ic->ic_state == IEEE80211_S_SCAN)
+    {
+      ieee80211_next_scan(hr->hr_ic);
+    }
+
+  uip_unlock(lock);
+}
+
+#ifdef CONFIG_IEEE80211_AP
+/****************************************************************************
+ * Name: hwsim_bcnwork
+ *
+ * Description:
+ *   Send a beacon at each TBTT of a HOSTAP or IBSS radio.
+ *
+ ****************************************************************************/
+
+static void hwsim_bcnwork(FAR void *arg)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)arg;
+  FAR struct ieee80211_s *ic = hr->hr_ic;
+  FAR const uint8_t *frm;
+  FAR struct iob_s *iob;
+  unsigned int len;
+  uip_lock_t lock;
+  bool dtim;
+
+  lock = uip_lock();
+  if (!hr->hr_up || ic->ic_state != IEEE80211_S_RUN)
+    {
+      uip_unlock(lock);
+      return;
+    }
+
+  frm = ieee80211_beacon_update(ic, hwsim_now(), &len, &dtim);
+  if (frm != NULL && (iob = iob_alloc(false)) != NULL)
+    {
+      if (iob_copyin(iob, frm, len, 0, false) == OK)
+        {
+          hr->hr_stats.hs_txframes++;
+          hwsim_broadcast(hr, iob, hwsim_rate(ic->ic_bss, 0));
+        }
+
+      iob_free_chain(iob);
+      if (dtim)
+        {
+          ieee80211_notify_dtim(ic);
+        }
+    }
+
+  (void)work_queue(HPWORK, &hr->hr_bcnwork, hwsim_bcnwork, hr,
+                   MSEC2TICK(ic->ic_bss->ni_intval * IEEE80211_DUR_TU / 1000)
+                   + 1);
+  uip_unlock(lock);
+}
+#endif
+
+/****************************************************************************
+ * Name: hwsim_newstate
+ *
+ * Description:
+ *   ic_newstate:  follow the channel of the BSS and drive scanning and
+ *   beaconing.
+ *
+ ****************************************************************************/
+
+static int hwsim_newstate(FAR struct ieee80211_s *ic,
+                          enum ieee80211_state nstate, int arg)
+{
+  FAR struct hwsim_radio_s *hr = hwsim_radio(ic);
+  int ret;
+
+  (void)work_cancel(HPWORK, &hr->hr_scanwork);
+#ifdef CONFIG_IEEE80211_AP
+  (void)work_cancel(HPWORK, &hr->hr_bcnwork);
+#endif
+
+  ret = hr->hr_newstate(ic, nstate, arg);
+
+  /* The stack may have picked the channel while handling the transition */
+
+  if (ic->ic_bss->ni_chan != IEEE80211_CHAN_ANYC)
+    {
+      hr->hr_chan = ieee80211_chan2ieee(ic, ic->ic_bss->ni_chan);
+    }
+
+  switch (nstate)
+    {
+    case IEEE80211_S_SCAN:
+      (void)work_queue(HPWORK, &hr->hr_scanwork, hwsim_scanwork, hr,
+                       HWSIM_SCAN_DWELL);
+      break;
+
+    case IEEE80211_S_RUN:
+      hr->hr_stats.hs_runtime = clock_systimer();
+#ifdef CONFIG_IEEE80211_AP
+      if (ic->ic_opmode == IEEE80211_M_HOSTAP ||
+          ic->ic_opmode == IEEE80211_M_IBSS)
+        {
+          (void)work_queue(HPWORK, &hr->hr_bcnwork, hwsim_bcnwork, hr, 0);
+        }
+#endif
+      break;
+
+    default:
+      break;
+    }
+
+  /* Frames queued on the old channel can go out on the new one */
+
+  if (work_available(&hr->hr_txwork))
+    {
+      (void)work_queue(HPWORK, &hr->hr_txwork, hwsim_txwork, hr, 0);
+    }
+
+  return ret;
+}
+
+#ifdef CONFIG_IEEE80211_BGSCAN
+/****************************************************************************
+ * Name: hwsim_set_channel
+ *
+ * Description:
+ *   ic_set_channel:  tune the radio for a background scan.  Frames are sent
+ *   as they are polled, so none is left behind on the old channel.
+ *
+ ****************************************************************************/
+
+static int hwsim_set_channel(FAR struct ieee80211_s *ic,
+                             FAR struct ieee80211_channel *chan)
+{
+  FAR struct hwsim_radio_s *hr = hwsim_radio(ic);
+
+  hr->hr_chan = ieee80211_chan2ieee(ic, chan);
+
+  if (work_available(&hr->hr_txwork))
+    {
+      (void)work_queue(HPWORK, &hr->hr_txwork, hwsim_txwork, hr, 0);
+    }
+
+  return OK;
+}
+#endif
+
+/****************************************************************************
+ * Name: hwsim_set_key
+ *
+ * Description:
+ *   ic_set_key:  the radios have no crypto engine; keep the software
+ *   implementation and record when the key arrived.
+ *
+ ****************************************************************************/
+
+static int hwsim_set_key(FAR struct ieee80211_s *ic,
+                         FAR struct ieee80211_node *ni,
+                         FAR struct ieee80211_key *k)
+{
+  FAR struct hwsim_radio_s *hr = hwsim_radio(ic);
+
+  hr->hr_stats.hs_nkeys++;
+  hr->hr_stats.hs_keytime = clock_systimer();
+  return ieee80211_set_key(ic, ni, k);
+}
+
+#ifdef CONFIG_IEEE80211_HT
+/****************************************************************************
+ * Name: hwsim_ampdu_tx_start, hwsim_ampdu_tx_stop, hwsim_ampdu_rx_start,
+ *       hwsim_ampdu_rx_stop
+ *
+ * Description:
+ *   Block Ack agreements need no set up in the simulated radio; keep count
+ *   of them.
+ *
+ ****************************************************************************/
+
+static int hwsim_ampdu_tx_start(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_node *ni, uint8_t tid)
+{
+  hwsim_radio(ic)->hr_stats.hs_ampdu_tx++;
+  return OK;
+}
+
+static void hwsim_ampdu_tx_stop(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_node *ni, uint8_t tid)
+{
+  hwsim_radio(ic)->hr_stats.hs_ampdu_tx--;
+}
+
+static int hwsim_ampdu_rx_start(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_node *ni, uint8_t tid)
+{
+  hwsim_radio(ic)->hr_stats.hs_ampdu_rx++;
+  return OK;
+}
+
+static void hwsim_ampdu_rx_stop(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_node *ni, uint8_t tid)
+{
+  hwsim_radio(ic)->hr_stats.hs_ampdu_rx--;
+}
+#endif
+
+/****************************************************************************
+ * Name: hwsim_ifup
+ *
+ * Description:
+ *   NuttX callback:  bring the radio up and start looking for (or
+ *   creating) a BSS.
+ *
+ ****************************************************************************/
+
+static int hwsim_ifup(FAR struct uip_driver_s *dev)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)dev->d_private;
+  uip_lock_t lock;
+
+  nvdbg("%s up\n", dev->d_ifname);
+
+  lock = uip_lock();
+  hr->hr_up = true;
+  ieee80211_begin_scan(hr->hr_ic);
+  (void)work_queue(HPWORK, &hr->hr_pollwork, hwsim_pollwork, hr,
+                   HWSIM_POLLTIME);
+  uip_unlock(lock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: hwsim_ifdown
+ *
+ * Description:
+ *   NuttX callback:  leave the BSS and take the radio off the medium.
+ *
+ ****************************************************************************/
+
+static int hwsim_ifdown(FAR struct uip_driver_s *dev)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)dev->d_private;
+  uip_lock_t lock;
+
+  nvdbg("%s down\n", dev->d_ifname);
+
+  lock = uip_lock();
+  ieee80211_new_state(hr->hr_ic, IEEE80211_S_INIT, -1);
+  hr->hr_up = false;
+  hr->hr_chan = 0;
+
+  (void)work_cancel(HPWORK, &hr->hr_txwork);
+  (void)work_cancel(HPWORK, &hr->hr_scanwork);
+  (void)work_cancel(HPWORK, &hr->hr_pollwork);
+  ieee80211_ifflush(hr->hr_ic);
+  iob_free_queue(&hr->hr_rxq);
+  uip_unlock(lock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: hwsim_txavail
+ *
+ * Description:
+ *   NuttX callback:  the stack has queued frames for transmission.
+ *
+ ****************************************************************************/
+
+static int hwsim_txavail(FAR struct uip_driver_s *dev)
+{
+  FAR struct hwsim_radio_s *hr = (FAR struct hwsim_radio_s *)dev->d_private;
+
+  if (hr->hr_up && work_available(&hr->hr_txwork))
+    {
+      (void)work_queue(HPWORK, &hr->hr_txwork, hwsim_txwork, hr, 0);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: hwsim_attach
+ *
+ * Description:
+ *   Describe radio 'index' to a new instance of the IEEE 802.11 stack.
+ *
+ ****************************************************************************/
+
+static int hwsim_attach(FAR struct hwsim_radio_s *hr, int index)
+{
+  FAR struct ieee80211_s *ic;
+  int i;
+
+  hr->hr_index = index;
+
+  /* Locally administered addresses 02:48:57:53:49:<index> */
+
+  hr->hr_dev.d_mac.ether_addr_octet[0] = 0x02;
+  hr->hr_dev.d_mac.ether_addr_octet[1] = 'H';
+  hr->hr_dev.d_mac.ether_addr_octet[2] = 'W';
+  hr->hr_dev.d_mac.ether_addr_octet[3] = 'S';
+  hr->hr_dev.d_mac.ether_addr_octet[4] = 'I';
+  hr->hr_dev.d_mac.ether_addr_octet[5] = index;
+
+#ifdef CONFIG_NET_MULTIBUFFER
+  hr->hr_dev.d_buf     = hr->hr_buf;
+#endif
+  hr->hr_dev.d_ifup    = hwsim_ifup;
+  hr->hr_dev.d_ifdown  = hwsim_ifdown;
+  hr->hr_dev.d_txavail = hwsim_txavail;
+  hr->hr_dev.d_private = hr;
+
+  /* Register first:  the stack finds its driver by interface name */
+
+  if (netdev_register(&hr->hr_dev) < 0)
+    {
+      ndbg("ERROR: Failed to register radio %d\n", index);
+      return -ENODEV;
+    }
+
+  ic = (FAR struct ieee80211_s *)ieee80211_initialize(hr->hr_dev.d_ifname);
+  if (ic == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  hr->hr_ic = ic;
+  memcpy(ic->ic_myaddr, hr->hr_dev.d_mac.ether_addr_octet,
+         IEEE80211_ADDR_LEN);
+
+  for (i = 1; i <= HWSIM_MAXCHAN; i++)
+    {
+      ic->ic_channels[i].ic_freq  = ieee80211_ieee2mhz(i, IEEE80211_CHAN_2GHZ);
+      ic->ic_channels[i].ic_flags = IEEE80211_CHAN_CCK |
+                                    IEEE80211_CHAN_OFDM |
+                                    IEEE80211_CHAN_DYN |
+                                    IEEE80211_CHAN_2GHZ;
+    }
+
+  ic->ic_sup_rates[IEEE80211_MODE_11B] = ieee80211_std_rateset_11b;
+  ic->ic_sup_rates[IEEE80211_MODE_11G] = ieee80211_std_rateset_11g;
+
+  ic->ic_phytype = IEEE80211_T_OFDM;
+  ic->ic_caps    = IEEE80211_C_WEP | IEEE80211_C_RSN | IEEE80211_C_MFP |
+                   IEEE80211_C_PMGT | IEEE80211_C_SHSLOT |
+                   IEEE80211_C_SHPREAMBLE | IEEE80211_C_SCANALL |
+                   IEEE80211_C_QOS;
+  ic->ic_opmode  = IEEE80211_M_STA;
+
+#ifdef CONFIG_IEEE80211_AP
+  ic->ic_caps   |= IEEE80211_C_HOSTAP | IEEE80211_C_IBSS |
+                   IEEE80211_C_APPMGT;
+  if (index < CONFIG_SIM_WLAN_HWSIM_NAPS)
+    {
+      ic->ic_opmode = IEEE80211_M_HOSTAP;
+    }
+#endif
+
+  ieee80211_ifattach(ic);
+
+  /* Intercept the stack handlers that involve the radio */
+
+  hr->hr_newstate  = ic->ic_newstate;
+  ic->ic_newstate  = hwsim_newstate;
+  ic->ic_set_key   = hwsim_set_key;
+#ifdef CONFIG_IEEE80211_BGSCAN
+  ic->ic_set_channel = hwsim_set_channel;
+#endif
+#ifdef CONFIG_IEEE80211_HT
+  ic->ic_ampdu_tx_start = hwsim_ampdu_tx_start;
+  ic->ic_ampdu_tx_stop  = hwsim_ampdu_tx_stop;
+  ic->ic_ampdu_rx_start = hwsim_ampdu_rx_start;
+  ic->ic_ampdu_rx_stop  = hwsim_ampdu_rx_stop;
+#endif
+
+  ieee80211_ratectl_attach(ic, HWSIM_RATECTL);
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: hwsim_initialize
+ *
+ * Description:
+ *   Create the simulated radios.  Every link starts with the configured
+ *   signal strength and no extra loss.
+ *
+ ****************************************************************************/
+
+int hwsim_initialize(void)
+{
+  int ret;
+  int i;
+  int j;
+
+  for (i = 0; i < HWSIM_NRADIOS; i++)
+    {
+      for (j = 0; j < HWSIM_NRADIOS; j++)
+        {
+          g_hwsim_medium.hm_link[i][j].hl_rssi = CONFIG_SIM_WLAN_HWSIM_RSSI;
+          g_hwsim_medium.hm_link[i][j].hl_loss = 0;
+        }
+    }
+
+#ifdef CONFIG_SIM_WLAN_HWSIM_PCAP
+  g_hwsim_medium.hm_capture =
+    (hwsim_pcapopen(CONFIG_SIM_WLAN_HWSIM_PCAPFILE) == 0);
+#endif
+
+  for (i = 0; i < HWSIM_NRADIOS; i++)
+    {
+      ret = hwsim_attach(&g_hwsim_radios[i], i);
+      if (ret < 0)
+        {
+          return ret;
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: hwsim_setlink
+ *
+ * Description:
+ *   Set the signal strength (dBm) and the additional frame loss (percent)
+ *   of the link from radio 'tx' to radio 'rx'.
+ *
+ ****************************************************************************/
+
+int hwsim_setlink(int tx, int rx, int rssi, int loss)
+{
+  if (tx < 0 || tx >= HWSIM_NRADIOS || rx < 0 || rx >= HWSIM_NRADIOS ||
+      rssi < -128 || rssi > 0 || loss < 0 || loss > 100)
+    {
+      return -EINVAL;
+    }
+
+  g_hwsim_medium.hm_link[tx][rx].hl_rssi = rssi;
+  g_hwsim_medium.hm_link[tx][rx].hl_loss = loss;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: hwsim_getstats
+ *
+ * Description:
+ *   Return a snapshot of the counters of radio 'index'.
+ *
+ ****************************************************************************/
+
+int hwsim_getstats(int index, FAR struct hwsim_stats_s *stats)
+{
+  uip_lock_t lock;
+
+  if (index < 0 || index >= HWSIM_NRADIOS)
+    {
+      return -EINVAL;
+    }
+
+  lock = uip_lock();
+  *stats = g_hwsim_radios[index].hr_stats;
+  uip_unlock(lock);
+  return OK;
+}
+
+#endif /* CONFIG_SIM_WLAN_HWSIM */
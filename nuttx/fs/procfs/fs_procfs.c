@@ -81,6 +81,7 @@ extern const struct procfs_operations uptime_operations;
 extern const struct procfs_operations mtd_procfsoperations;
 extern const struct procfs_operations part_procfsoperations;
 extern const struct procfs_operations smartfs_procfsoperations;
+extern const struct procfs_operations ieee80211_procfsoperations;
 
 /****************************************************************************
  * Private Types
@@ -103,6 +104,10 @@ static const struct procfs_entry_s g_procfsentries[] =
   { "fs/smartfs**",     &smartfs_procfsoperations },
 #endif
 
+#if defined(CONFIG_NET_IEEE80211) && !defined(CONFIG_FS_PROCFS_EXCLUDE_NET80211)
+  { "net/**",           &ieee80211_procfsoperations },
+#endif
+
 #if defined(CONFIG_MTD) && !defined(CONFIG_FS_PROCFS_EXCLUDE_MTD)
   { "mtd",              &mtd_procfsoperations },
 #endif
@@ -125,6 +130,7 @@ static const uint8_t g_procfsentrycount = sizeof(g_procfsentries) /
 /* Helpers */
 
 static void    procfs_enum(FAR struct tcb_s *tcb, FAR void *arg);
+static bool    procfs_match(FAR const char *pattern, FAR const char *relpath);
 
 /* File system methods */
 
@@ -265,6 +271,26 @@ static void procfs_enum(FAR struct tcb_s *tcb, FAR void *arg)
 }
 #endif
 
+/****************************************************************************
+ * Name: procfs_match
+ *
+ * Description:
+ *   Test if relpath belongs to the procfs entry with the given pattern.  An
+ *   entry whose pattern is "<dir>/" followed by "**" also owns <dir> itself
+ *   so that its handler, rather than the generic intermediate directory
+ *   logic, lists it.
+ *
+ ****************************************************************************/
+
+static bool procfs_match(FAR const char *pattern, FAR const char *relpath)
+{
+  int len = strlen(relpath);
+
+  return match(pattern, relpath) ||
+         (len > 0 && strncmp(pattern, relpath, len) == 0 &&
+          strcmp(&pattern[len], "/**") == 0);
+}
+
 /****************************************************************************
  * Name: procfs_open
  ****************************************************************************/
@@ -460,7 +486,7 @@ static int procfs_opendir(FAR struct inode *mountpt, FAR const char *relpath,
         {
           /* Test if the path matches this entry's specification */
 
-          if (match(g_procfsentries[x].pathpattern, relpath))
+          if (procfs_match(g_procfsentries[x].pathpattern, relpath))
             {
               /* Match found!  Call the handler's opendir routine.  If successful,
                * this opendir routine will create an entry derived from struct
@@ -875,7 +901,7 @@ static int procfs_stat(struct inode *mountpt, const char *relpath,
         {
           /* Test if the path matches this entry's specification */
 
-          if (match(g_procfsentries[x].pathpattern, relpath))
+          if (procfs_match(g_procfsentries[x].pathpattern, relpath))
             {
               /* Match found!  Stat using this procfs entry */
 
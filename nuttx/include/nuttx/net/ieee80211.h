@@ -0,0 +1,106 @@
+/****************************************************************************
+ * include/nuttx/net/ieee80211.h
+ * Public interfaces of the IEEE 802.11 stack.
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __INCLUDE_NUTTX_NET_IEEE80211_H
+#define __INCLUDE_NUTTX_NET_IEEE80211_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <nuttx/compiler.h>
+
+#include <stdint.h>
+
+#ifdef CONFIG_NET_IEEE80211
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Frame counts at each stage of the transmit path of one interface, as
+ * returned by ieee80211_txstats().  The counters are free running and
+ * wrap; sample them twice and take the difference to get a rate.
+ */
+
+struct ieee80211_txstats_s
+{
+  uint32_t ts_classified;   /* Data frames given an access category */
+  uint32_t ts_encrypted;    /* Frames encrypted in software before queueing;
+                             * stays 0 if the driver encrypts */
+  uint32_t ts_enqueued;     /* Frames accepted into the EDCA queues */
+  uint32_t ts_dequeued;     /* Frames handed to the driver */
+  uint32_t ts_drops;        /* Frames dropped by the EDCA queues */
+  uint16_t ts_queued;       /* Frames waiting in the EDCA queues now */
+  uint16_t ts_hiwat;        /* Largest depth reached by any EDCA queue */
+  uint32_t ts_mgtdrops;     /* Management frames dropped (queue full) */
+  uint32_t ts_psdrops;      /* Power save frames dropped (queues full) */
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+#ifdef __cplusplus
+#define EXTERN extern "C"
+extern "C"
+{
+#else
+#define EXTERN extern
+#endif
+
+/****************************************************************************
+ * Name: ieee80211_txstats
+ *
+ * Description:
+ *   Return the transmit path counters of the 802.11 interface 'ifname'.
+ *
+ * Returned Value:
+ *   OK on success; -ENODEV if there is no such 802.11 interface.
+ *
+ ****************************************************************************/
+
+int ieee80211_txstats(FAR const char *ifname,
+                      FAR struct ieee80211_txstats_s *stats);
+
+#undef EXTERN
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_NET_IEEE80211 */
+#endif /* __INCLUDE_NUTTX_NET_IEEE80211_H */
@@ -93,6 +93,26 @@
 #define IOB_DATA(p)      (&(p)->io_data[(p)->io_offset])
 #define IOB_FREESPACE(p) (CONFIG_IOB_BUFSIZE - (p)->io_len - (p)->io_offset)
 
+#ifdef CONFIG_IOB_PKTHDR
+/* Packet metadata helpers.  Only the I/O buffer at the head of a chain
+ * may carry packet metadata.
+ */
+
+#  ifndef CONFIG_IOB_NPKTHDRS
+#    define CONFIG_IOB_NPKTHDRS CONFIG_IOB_NBUFFERS
+#  endif
+
+#  ifndef CONFIG_IOB_PKTHDR_SIZE
+#    define CONFIG_IOB_PKTHDR_SIZE 32
+#  endif
+
+#  define IOB_PKTHDR_NWORDS \
+     ((CONFIG_IOB_PKTHDR_SIZE + sizeof(uintptr_t) - 1) / sizeof(uintptr_t))
+
+#  define IOB_PKTHDR(p) \
+     ((p)->io_pkthdr != NULL ? (FAR void *)(p)->io_pkthdr->ph_data : NULL)
+#endif
+
 #if CONFIG_IOB_NCHAINS > 0
 /* Queue helpers */
 
@@ -104,9 +124,22 @@
  * Public Types
  ****************************************************************************/
 
+#ifdef CONFIG_IOB_PKTHDR
+/* Per-packet metadata.  The contents are defined by the protocol layer that
+ * attaches it; the I/O buffer logic only moves it along with the head of
+ * the chain and returns it to its pool when the packet is freed.
+ */
+
+struct iob_pkthdr_s
+{
+  FAR struct iob_pkthdr_s *ph_flink;   /* Free list link */
+  uintptr_t ph_data[IOB_PKTHDR_NWORDS];
+};
+#endif
+
 /* Represents one I/O buffer.  A packet is contained by one or more I/O
- * buffers in a chain.  The io_pktlen is only valid for the I/O buffer at
- * the head of the chain.
+ * buffers in a chain.  The io_pktlen and io_pkthdr are only valid for the
+ * I/O buffer at the head of the chain.
  */
 
 struct iob_s
@@ -115,6 +148,12 @@ struct iob_s
 
   FAR struct iob_s *io_flink;
 
+#ifdef CONFIG_IOB_PKTHDR
+  /* Optional packet metadata */
+
+  FAR struct iob_pkthdr_s *io_pkthdr;
+#endif
+
   /* Payload */
 
 #if CONFIG_IOB_BUFSIZE < 256
@@ -156,6 +195,17 @@ struct iob_queue_s
 };
 #endif /* CONFIG_IOB_NCHAINS > 0 */
 
+#ifdef CONFIG_IOB_STATS
+/* A snapshot of I/O buffer pool usage as returned by iob_getstats() */
+
+struct iob_stats_s
+{
+  uint16_t is_nbuffers;   /* Size of the I/O buffer pool */
+  uint16_t is_nfree;      /* Number of I/O buffers currently free */
+  uint16_t is_hiwat;      /* Largest number of I/O buffers in use at once */
+};
+#endif
+
 /****************************************************************************
  * Global Data
  ****************************************************************************/
@@ -184,6 +234,32 @@ void iob_initialize(void);
 
 FAR struct iob_s *iob_alloc(bool throttled);
 
+#ifdef CONFIG_IOB_PKTHDR
+/****************************************************************************
+ * Name: iob_pkthdr_attach
+ *
+ * Description:
+ *   Return the packet metadata of the I/O buffer chain headed by iob,
+ *   taking a zeroed metadata descriptor from the free list if the chain
+ *   does not have one yet.  NULL is returned if no descriptor is available.
+ *   This function never waits and may be called from interrupt handlers.
+ *
+ ****************************************************************************/
+
+FAR void *iob_pkthdr_attach(FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: iob_pkthdr_detach
+ *
+ * Description:
+ *   Release the packet metadata of the I/O buffer chain headed by iob, if
+ *   any.
+ *
+ ****************************************************************************/
+
+void iob_pkthdr_detach(FAR struct iob_s *iob);
+#endif
+
 /****************************************************************************
  * Name: iob_free
  *
@@ -384,6 +460,19 @@ int iob_contig(FAR struct iob_s *iob, unsigned int len);
  *
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: iob_getstats
+ *
+ * Description:
+ *   Return the current I/O buffer pool usage.  If 'reset' is true, the
+ *   high-water mark is restarted from the number of buffers in use now.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_IOB_STATS
+void iob_getstats(FAR struct iob_stats_s *stats, bool reset);
+#endif
+
 #ifdef CONFIG_DEBUG
 void iob_dump(FAR const char *msg, FAR struct iob_s *iob, unsigned int len,
               unsigned int offset);
@@ -54,6 +54,7 @@
 
 #include <nuttx/kmalloc.h>
 #include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
 
 #include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
@@ -71,16 +72,15 @@ int ieee80211_findrate(FAR struct ieee80211_s *, enum ieee80211_phymode, int);
  *
  * Description:
  *   Initialize the IEEE 802.11 stack for operation with the selected device.
+ *   The driver then describes the device (ic_myaddr, ic_caps, ic_channels,
+ *   ic_sup_rates, ...) in the returned structure and completes the set up
+ *   with ieee80211_ifattach().
  *
  ****************************************************************************/
 
 iee80211_handle ieee80211_initialize(FAR const char *ifname)
 {
   FAR struct ieee80211_s *ic;
-  FAR struct ieee80211_channel *chan;
-  int ndx;
-  int bit;
-  int i;
 
   /* Allocate the IEEE 802.11 stack state structure */
 
@@ -102,6 +102,26 @@ iee80211_handle ieee80211_initialize(FAR const char *ifname)
   /* Initialize cypto support */
 
   ieee80211_crypto_attach(ic);
+  return (iee80211_handle) ic;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ifattach
+ *
+ * Description:
+ *   Complete the set up of the IEEE 802.11 stack once the driver has filled
+ *   in the capabilities of the device.  Drivers that intercept ic_newstate
+ *   or ic_set_key save the stack's handlers after this call.
+ *
+ ****************************************************************************/
+
+void ieee80211_ifattach(iee80211_handle handle)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)handle;
+  FAR struct ieee80211_channel *chan;
+  int ndx;
+  int bit;
+  int i;
 
   /* Fill in 802.11 available channel set, mark all available channels as
    * active, and pick a default channel if not already specified. */
@@ -176,11 +196,10 @@ iee80211_handle ieee80211_initialize(FAR const char *ifname)
   ic->ic_bmisstimeout = 7 * ic->ic_lintval;     /* default 7 beacons */
   ic->ic_dtim_period = 1;       /* all TIMs are DTIMs */
 
-  dq_addfirst((FAR dq_entry_t *) ic, &ieee80211_s_head);
+  dq_addfirst(&ic->ic_list, &ieee80211_s_head);
   ieee80211_node_attach(ic);
+  ieee80211_node_lateattach(ic);
   ieee80211_proto_attach(ic);
-
-  return (iee80211_handle) ic;
 }
 
 /****************************************************************************
@@ -194,7 +213,15 @@ iee80211_handle ieee80211_initialize(FAR const char *ifname)
 void ieee80211_uninitialize(iee80211_handle handle)
 {
   FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)handle;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  dq_rem(&ic->ic_list, &ieee80211_s_head);
+  uip_unlock(lock);
 
+#ifdef CONFIG_IEEE80211_BGSCAN
+  ieee80211_bgscan_discard(ic);
+#endif
   ieee80211_proto_detach(ic);
   ieee80211_crypto_detach(ic);
   ieee80211_node_detach(ic);
@@ -206,6 +233,32 @@ void ieee80211_uninitialize(iee80211_handle handle)
   kfree(ic);
 }
 
+/****************************************************************************
+ * Name: ieee80211_find_ifname
+ *
+ * Description:
+ *   Return the 802.11 interface named 'ifname' or NULL.  The network must
+ *   be locked.
+ *
+ ****************************************************************************/
+
+FAR struct ieee80211_s *ieee80211_find_ifname(FAR const char *ifname)
+{
+  FAR struct ieee80211_s *ic;
+
+  for (ic = (FAR struct ieee80211_s *)ieee80211_s_head.head;
+       ic != NULL;
+       ic = (FAR struct ieee80211_s *)ic->ic_list.flink)
+    {
+      if (strncmp(ic->ic_ifname, ifname, IFNAMSIZ) == 0)
+        {
+          return ic;
+        }
+    }
+
+  return NULL;
+}
+
 /* Convert MHz frequency to IEEE channel number */
 
 unsigned int ieee80211_mhz2ieee(unsigned int freq, unsigned int flags)
@@ -868,6 +868,17 @@ typedef FAR void *iee80211_handle;
 
 iee80211_handle ieee80211_initialize(FAR const char *ifname);
 
+/****************************************************************************
+ * Name: ieee80211_ifattach
+ *
+ * Description:
+ *   Complete the set up of the IEEE 802.11 stack once the driver has filled
+ *   in the capabilities of the device.
+ *
+ ****************************************************************************/
+
+void ieee80211_ifattach(iee80211_handle handle);
+
 /****************************************************************************
  * Name: ieee80211_uninitialize
  *
@@ -0,0 +1,824 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_ampdu.c
+ * A-MPDU transmit aggregation driven by the TX Block Ack agreements
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wdog.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_debug.h"
+#include "ieee80211/ieee80211_ifnet.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+
+#ifdef CONFIG_IEEE80211_HT
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+/* Number of TX Block Ack agreements that can aggregate at the same time */
+
+#ifndef CONFIG_IEEE80211_AMPDU_NSESSIONS
+#  define CONFIG_IEEE80211_AMPDU_NSESSIONS 8
+#endif
+
+/* Upper bounds on the PSDU length and air time of one A-MPDU */
+
+#ifndef CONFIG_IEEE80211_AMPDU_MAXLEN
+#  define CONFIG_IEEE80211_AMPDU_MAXLEN 65535
+#endif
+
+#ifndef CONFIG_IEEE80211_AMPDU_MAXUSEC
+#  define CONFIG_IEEE80211_AMPDU_MAXUSEC 4000
+#endif
+
+#ifndef CONFIG_IEEE80211_TXQ_DEPTH
+#  define CONFIG_IEEE80211_TXQ_DEPTH 8
+#endif
+
+#if CONFIG_IEEE80211_AMPDU_MAXFRAMES > 64
+#  error CONFIG_IEEE80211_AMPDU_MAXFRAMES may not exceed the BlockAck bitmap
+#endif
+
+/* The transmit window is limited to the 64 MPDUs covered by a compressed
+ * BlockAck bitmap, so that the per-window state fits in one 64-bit word.
+ */
+
+#define AMPDU_MAXWIN      64
+#define AMPDU_MAXRETRY    8
+
+/* Number of A-MPDUs of one RA/TID that may await their BlockAck */
+
+#define AMPDU_MAXSENT     4
+
+/* Per-subframe overhead:  MPDU delimiter and FCS */
+
+#define AMPDU_DELIM_LEN   4
+#define AMPDU_FCS_LEN     4
+
+/* Count trailing zeros of a non-zero 64-bit word */
+
+#ifdef __GNUC__
+#  define ampdu_ctz(x) __builtin_ctzll(x)
+#else
+#  define ampdu_ctz(x) ieee80211_ctz64(x)
+#endif
+
+#define AMPDU_BIT(off)    ((uint64_t)1 << (off))
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* One A-MPDU handed to the driver and not yet acknowledged.  Bit n of
+ * as_map stands for the MPDU with sequence number as_ssn + n.
+ */
+
+struct ieee80211_ampdu_sent_s
+  {
+    uint64_t as_map;
+    uint16_t as_ssn;
+  };
+
+/* Transmit aggregation state of one Block Ack agreement.  MPDUs inside the
+ * window are held in ag_frame[] (indexed by sequence number modulo the
+ * window) until they are acknowledged; the bitmaps are indexed by the
+ * offset of the sequence number from WinStart.  MPDUs beyond the window
+ * wait in ag_backlog.  ag_sent[] lists the A-MPDUs in flight, oldest
+ * first; BlockAcks come back in the same order.
+ */
+
+struct ieee80211_txagg_s
+  {
+    FAR struct ieee80211_node *ag_ni;     /* Owner; NULL if the entry is free */
+    FAR struct iob_s *ag_frame[AMPDU_MAXWIN];
+    uint8_t ag_retries[AMPDU_MAXWIN];
+    uint64_t ag_held;                     /* MPDUs held, not yet acknowledged */
+    uint64_t ag_pend;                     /* MPDUs to be (re)transmitted */
+    struct ieee80211_ampdu_sent_s ag_sent[AMPDU_MAXSENT];
+    uint8_t ag_nsent;                     /* Number of A-MPDUs in flight */
+    struct iob_queue_s ag_backlog;        /* MPDUs beyond the window */
+    uint16_t ag_nbacklog;                 /* Number of MPDUs in ag_backlog */
+    uint16_t ag_nextsn;                   /* SN following the newest MPDU */
+    uint8_t ag_tid;
+    bool ag_bar;                          /* An MPDU was abandoned */
+  };
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct ieee80211_txagg_s g_txagg[CONFIG_IEEE80211_AMPDU_NSESSIONS];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifndef __GNUC__
+static int ieee80211_ctz64(uint64_t x)
+{
+  int n = 0;
+
+  while ((x & 1) == 0)
+    {
+      x >>= 1;
+      n++;
+    }
+
+  return n;
+}
+#endif
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_seq
+ *
+ * Description:
+ *   Return the sequence number of a QoS data MPDU.
+ *
+ ****************************************************************************/
+
+static inline uint16_t ieee80211_ampdu_seq(FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_frame *wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+
+  return letoh16(*(FAR uint16_t *)wh->i_seq) >> IEEE80211_SEQ_SEQ_SHIFT;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_hold
+ *
+ * Description:
+ *   Place an MPDU that falls inside the window into the window and mark it
+ *   for transmission.
+ *
+ ****************************************************************************/
+
+static void ieee80211_ampdu_hold(FAR struct ieee80211_tx_ba *ba,
+                                 FAR struct ieee80211_txagg_s *ag,
+                                 FAR struct iob_s *iob, uint16_t sn)
+{
+  unsigned int off = (sn - ba->ba_winstart) & 0xfff;
+  unsigned int idx = sn & (AMPDU_MAXWIN - 1);
+
+  ag->ag_frame[idx]   = iob;
+  ag->ag_retries[idx] = 0;
+  ag->ag_held        |= AMPDU_BIT(off);
+  ag->ag_pend        |= AMPDU_BIT(off);
+  ag->ag_nextsn       = (sn + 1) & 0xfff;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_resync
+ *
+ * Description:
+ *   Restart an empty window at 'sn'.  Sequence numbers may have been
+ *   consumed by MPDUs that never reached the aggregation stage.
+ *
+ ****************************************************************************/
+
+static void ieee80211_ampdu_resync(FAR struct ieee80211_tx_ba *ba,
+                                   FAR struct ieee80211_txagg_s *ag,
+                                   uint16_t sn)
+{
+  ba->ba_winstart = sn;
+  ba->ba_winend   = (sn + ba->ba_winsize - 1) & 0xfff;
+  ag->ag_nextsn   = sn;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_refill
+ *
+ * Description:
+ *   Move MPDUs from the backlog into the window as far as it now allows.
+ *
+ ****************************************************************************/
+
+static void ieee80211_ampdu_refill(FAR struct ieee80211_tx_ba *ba,
+                                   FAR struct ieee80211_txagg_s *ag)
+{
+  FAR struct iob_s *iob;
+  uint16_t sn;
+
+  while ((iob = iob_peek_queue(&ag->ag_backlog)) != NULL)
+    {
+      sn = ieee80211_ampdu_seq(iob);
+      if (ag->ag_held == 0)
+        {
+          ieee80211_ampdu_resync(ba, ag, sn);
+        }
+      else if (((sn - ba->ba_winstart) & 0xfff) >= ba->ba_winsize)
+        {
+          break;
+        }
+
+      (void)iob_remove_queue(&ag->ag_backlog);
+      ag->ag_nbacklog--;
+      ieee80211_ampdu_hold(ba, ag, iob, sn);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_maxlen
+ *
+ * Description:
+ *   Return the largest PSDU that respects both the configured length and
+ *   air time limits at the current transmit rate of the node.  The rate is
+ *   taken from the negotiated (legacy) rate set, which underestimates HT
+ *   rates and so errs on the side of shorter aggregates.
+ *
+ ****************************************************************************/
+
+static uint32_t ieee80211_ampdu_maxlen(FAR struct ieee80211_node *ni)
+{
+  uint32_t maxlen = CONFIG_IEEE80211_AMPDU_MAXLEN;
+  uint32_t rate = 0;
+  uint32_t airlen;
+
+  if (ni->ni_rates.rs_nrates > 0)
+    {
+      rate = ni->ni_rates.rs_rates[ni->ni_txrate] & IEEE80211_RATE_VAL;
+    }
+
+  /* Rates are in units of 500 kb/s, i.e. rate / 16 bytes per usec */
+
+  if (rate != 0)
+    {
+      airlen = (uint32_t)CONFIG_IEEE80211_AMPDU_MAXUSEC * rate / 16;
+      if (airlen < maxlen)
+        {
+          maxlen = airlen;
+        }
+    }
+
+  return maxlen;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_build
+ *
+ * Description:
+ *   Gather the MPDUs marked for (re)transmission into an A-MPDU
+ *   descriptor, in sequence number order, without changing the window
+ *   state.  Returns the set of window offsets that were included.
+ *
+ ****************************************************************************/
+
+static uint64_t ieee80211_ampdu_build(FAR struct ieee80211_tx_ba *ba,
+                                      FAR struct ieee80211_txagg_s *ag,
+                                      FAR struct ieee80211_ampdu_s *ampdu)
+{
+  FAR struct ieee80211_frame *wh;
+  FAR struct iob_s *iob;
+  uint64_t pend = ag->ag_pend;
+  uint64_t used = 0;
+  uint32_t maxlen = ieee80211_ampdu_maxlen(ag->ag_ni);
+  uint32_t len = 0;
+  uint32_t sublen;
+  unsigned int off;
+  unsigned int idx;
+
+  ampdu->am_ni      = ag->ag_ni;
+  ampdu->am_tid     = ag->ag_tid;
+  ampdu->am_nframes = 0;
+
+  while (pend != 0 && ampdu->am_nframes < CONFIG_IEEE80211_AMPDU_MAXFRAMES)
+    {
+      off = ampdu_ctz(pend);
+      idx = (ba->ba_winstart + off) & (AMPDU_MAXWIN - 1);
+      iob = ag->ag_frame[idx];
+
+      /* Every subframe but the last is padded to a multiple of 4 bytes.
+       * The first subframe is always taken, whatever its length.
+       */
+
+      sublen = AMPDU_DELIM_LEN + iob->io_pktlen + AMPDU_FCS_LEN;
+      if (ampdu->am_nframes > 0 && ((len + 3) & ~3) + sublen > maxlen)
+        {
+          break;
+        }
+
+      if (ampdu->am_nframes == 0)
+        {
+          ampdu->am_ssn = (ba->ba_winstart + off) & 0xfff;
+        }
+
+      if (ag->ag_retries[idx] > 0)
+        {
+          wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+          wh->i_fc[1] |= IEEE80211_FC1_RETRY;
+        }
+
+      len = (ampdu->am_nframes > 0 ? ((len + 3) & ~3) : 0) + sublen;
+      ampdu->am_frames[ampdu->am_nframes++] = iob;
+      used |= AMPDU_BIT(off);
+      pend &= pend - 1;
+    }
+
+  ampdu->am_len = len;
+  return used;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_bar
+ *
+ * Description:
+ *   Send a compressed BlockAckReq moving the recipient's window to 'ssn'.
+ *   This is needed when an MPDU is abandoned, otherwise the recipient would
+ *   hold back everything that follows it until its reordering timer fires.
+ *
+ ****************************************************************************/
+
+static void ieee80211_ampdu_bar(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_node *ni,
+                                uint8_t tid, uint16_t ssn)
+{
+  FAR struct ieee80211_frame_min *wh;
+  FAR struct iob_s *iob;
+  FAR uint8_t *frm;
+
+  iob = iob_alloc(false);
+  if (iob == NULL)
+    {
+      ndbg("ERROR: Failed to allocate BlockAckReq\n");
+      return;
+    }
+
+  wh = (FAR struct ieee80211_frame_min *)IOB_DATA(iob);
+  wh->i_fc[0] = IEEE80211_FC0_VERSION_0 | IEEE80211_FC0_TYPE_CTL |
+                IEEE80211_FC0_SUBTYPE_BAR;
+  wh->i_fc[1] = 0;
+  *(FAR uint16_t *)wh->i_dur = 0;
+  IEEE80211_ADDR_COPY(wh->i_addr1, ni->ni_macaddr);
+  IEEE80211_ADDR_COPY(wh->i_addr2, ic->ic_myaddr);
+
+  frm = (FAR uint8_t *)&wh[1];
+  LE_WRITE_2(frm, tid << IEEE80211_BA_TID_INFO_SHIFT |
+                  IEEE80211_BA_COMPRESSED);
+  frm += 2;
+  LE_WRITE_2(frm, ssn << IEEE80211_SEQ_SEQ_SHIFT);
+  frm += 2;
+
+  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
+  if (ieee80211_ifsend(ic, iob, IFSEND_MGMT) == OK)
+    {
+      ic->ic_ampdu_stats.am_bars++;
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_start
+ *
+ * Description:
+ *   Set up transmit aggregation for a Block Ack agreement that has just
+ *   been established.  The window is clamped to what a compressed BlockAck
+ *   can acknowledge.
+ *
+ * Returned Value:
+ *   OK on success; -ENOMEM if all aggregation sessions are in use.
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_start(FAR struct ieee80211_s *ic,
+                          FAR struct ieee80211_node *ni, uint8_t tid)
+{
+  FAR struct ieee80211_tx_ba *ba = &ni->ni_ba->nb_tx[tid];
+  FAR struct ieee80211_txagg_s *ag;
+  int i;
+
+  DEBUGASSERT(ba->ba_agg == NULL);
+
+  for (i = 0; i < CONFIG_IEEE80211_AMPDU_NSESSIONS; i++)
+    {
+      ag = &g_txagg[i];
+      if (ag->ag_ni == NULL)
+        {
+          memset(ag, 0, sizeof(struct ieee80211_txagg_s));
+          IOB_QINIT(&ag->ag_backlog);
+          ag->ag_ni  = ni;
+          ag->ag_tid = tid;
+
+          if (ba->ba_winsize > AMPDU_MAXWIN)
+            {
+              ba->ba_winsize = AMPDU_MAXWIN;
+            }
+
+          ieee80211_ampdu_resync(ba, ag, ba->ba_winstart);
+          ba->ba_agg = ag;
+          return OK;
+        }
+    }
+
+  ndbg("ERROR: No A-MPDU session for %s TID %d\n",
+       ieee80211_addr2str(ni->ni_macaddr), tid);
+  return -ENOMEM;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_stop
+ *
+ * Description:
+ *   Tear down transmit aggregation for a Block Ack agreement, freeing every
+ *   MPDU still held.  The driver must already have been told to abandon
+ *   any A-MPDU in flight for this RA/TID (ic_ampdu_tx_stop).
+ *
+ ****************************************************************************/
+
+void ieee80211_ampdu_stop(FAR struct ieee80211_s *ic,
+                          FAR struct ieee80211_node *ni, uint8_t tid)
+{
+  FAR struct ieee80211_tx_ba *ba;
+  FAR struct ieee80211_txagg_s *ag;
+  FAR struct iob_s *iob;
+  uint64_t held;
+  unsigned int off;
+
+  if (ni->ni_ba == NULL)
+    {
+      return;
+    }
+
+  ba = &ni->ni_ba->nb_tx[tid];
+  ag = ba->ba_agg;
+  if (ag == NULL)
+    {
+      return;
+    }
+
+  for (held = ag->ag_held; held != 0; held &= held - 1)
+    {
+      off = ampdu_ctz(held);
+      ieee80211_txfree(ic, ag->ag_frame[(ba->ba_winstart + off) &
+                                        (AMPDU_MAXWIN - 1)]);
+    }
+
+  while ((iob = iob_remove_queue(&ag->ag_backlog)) != NULL)
+    {
+      ieee80211_txfree(ic, iob);
+    }
+
+  ic->ic_ampdu_stats.am_drops += ag->ag_nbacklog;
+
+  ag->ag_ni  = NULL;
+  ba->ba_agg = NULL;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_enqueue
+ *
+ * Description:
+ *   Offer an encapsulated (and, if required, encrypted) QoS data MPDU to
+ *   the aggregation stage.  MPDUs of one RA/TID must be offered in sequence
+ *   number order.
+ *
+ * Returned Value:
+ *   OK if the MPDU was taken; -ENOENT if there is no Block Ack agreement
+ *   for its RA/TID (the caller still owns the MPDU); -ENOBUFS if the MPDU
+ *   was taken but dropped because the backlog is full.
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_enqueue(FAR struct ieee80211_s *ic,
+                            FAR struct ieee80211_node *ni,
+                            FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_frame *wh;
+  FAR struct ieee80211_tx_ba *ba;
+  FAR struct ieee80211_txagg_s *ag;
+  uip_lock_t lock;
+  uint16_t sn;
+  uint8_t tid;
+  int ret = OK;
+
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  if ((wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) != IEEE80211_FC0_TYPE_DATA ||
+      !ieee80211_has_qos(wh) || IEEE80211_IS_MULTICAST(wh->i_addr1))
+    {
+      return -ENOENT;
+    }
+
+  if (ni->ni_ba == NULL)
+    {
+      return -ENOENT;
+    }
+
+  tid = ieee80211_get_qos(wh) & IEEE80211_QOS_TID;
+  ba  = &ni->ni_ba->nb_tx[tid];
+  sn  = ieee80211_ampdu_seq(iob);
+
+  lock = uip_lock();
+
+  ag = ba->ba_agg;
+  if (ba->ba_state != IEEE80211_BA_AGREED || ag == NULL)
+    {
+      ret = -ENOENT;
+      goto out;
+    }
+
+  if (ag->ag_nbacklog == 0)
+    {
+      if (ag->ag_held == 0)
+        {
+          ieee80211_ampdu_resync(ba, ag, sn);
+        }
+
+      if (((sn - ba->ba_winstart) & 0xfff) < ba->ba_winsize)
+        {
+          ieee80211_ampdu_hold(ba, ag, iob, sn);
+          goto out;
+        }
+    }
+
+  if (ag->ag_nbacklog >= CONFIG_IEEE80211_TXQ_DEPTH ||
+      iob_add_queue(iob, &ag->ag_backlog) < 0)
+    {
+      nvdbg("A-MPDU backlog full, dropping frame\n");
+      ic->ic_ampdu_stats.am_drops++;
+      ieee80211_txfree(ic, iob);
+      ret = -ENOBUFS;
+      goto out;
+    }
+
+  ag->ag_nbacklog++;
+
+out:
+  uip_unlock(lock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_poll
+ *
+ * Description:
+ *   Called by the driver to collect A-MPDUs.  Each aggregate holds the
+ *   MPDUs of one RA/TID that are waiting for (re)transmission, in sequence
+ *   number order, up to the Block Ack window, CONFIG_IEEE80211_AMPDU_MAXLEN
+ *   bytes and CONFIG_IEEE80211_AMPDU_MAXUSEC of air time.
+ *
+ *   The callback returns zero to accept the aggregate and continue, a
+ *   positive value to accept it and stop, or a negated errno value to
+ *   refuse it (the MPDUs are then offered again on the next poll).  At
+ *   most AMPDU_MAXSENT aggregates of one RA/TID are handed out before the
+ *   oldest is acknowledged.
+ *
+ * Returned Value:
+ *   Zero if nothing is left to send; non-zero if the driver stopped the
+ *   poll.
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_poll(FAR struct ieee80211_s *ic,
+                         ieee80211_ampdu_txpoll_t callback)
+{
+  struct ieee80211_ampdu_s ampdu;
+  FAR struct ieee80211_ampdu_sent_s *sent;
+  FAR struct ieee80211_txagg_s *ag;
+  FAR struct ieee80211_tx_ba *ba;
+  uip_lock_t lock;
+  uint64_t used;
+  int ret = OK;
+  int i;
+
+  DEBUGASSERT(ic != NULL && callback != NULL);
+
+  lock = uip_lock();
+
+#ifdef CONFIG_IEEE80211_BGSCAN
+  /* Off channel: the recipients cannot hear us */
+
+  if (ic->ic_bgscan.bs_chan != NULL)
+    {
+      uip_unlock(lock);
+      return OK;
+    }
+#endif
+
+  for (i = 0; i < CONFIG_IEEE80211_AMPDU_NSESSIONS; i++)
+    {
+      ag = &g_txagg[i];
+      if (ag->ag_ni == NULL || ag->ag_ni->ni_ic != ic)
+        {
+          continue;
+        }
+
+      ba = &ag->ag_ni->ni_ba->nb_tx[ag->ag_tid];
+      while (ag->ag_pend != 0 && ag->ag_nsent < AMPDU_MAXSENT)
+        {
+          used = ieee80211_ampdu_build(ba, ag, &ampdu);
+
+          ret = callback(ic, &ampdu);
+          if (ret < 0)
+            {
+              goto out;
+            }
+
+          /* Remember which MPDUs went out in this aggregate, by sequence
+           * number since WinStart may move before its BlockAck arrives.
+           */
+
+          sent = &ag->ag_sent[ag->ag_nsent++];
+          sent->as_ssn = ampdu.am_ssn;
+          sent->as_map = used >> ampdu_ctz(used);
+
+          ag->ag_pend &= ~used;
+          ic->ic_ampdu_stats.am_aggregates++;
+          ic->ic_ampdu_stats.am_subframes += ampdu.am_nframes;
+
+          if (ret > 0)
+            {
+              goto out;
+            }
+        }
+    }
+
+out:
+  uip_unlock(lock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_ack
+ *
+ * Description:
+ *   Process the BlockAck for RA/TID whose starting sequence number is 'ssn'
+ *   and whose bit n acknowledges MPDU ssn + n.  Drivers that receive no
+ *   BlockAck for an A-MPDU report a zero bitmap.  The BlockAck answers the
+ *   oldest A-MPDU of RA/TID still in flight, and only the MPDUs of that
+ *   aggregate are judged by it.
+ *
+ *   Acknowledged MPDUs are freed.  MPDUs that were transmitted but not
+ *   acknowledged are marked for retransmission, unless their retry limit
+ *   is reached, in which case they are dropped and a BlockAckReq later
+ *   moves the recipient past them.  WinStart then advances to the oldest
+ *   MPDU still held and the backlog is moved into the window.
+ *
+ * Returned Value:
+ *   OK on success; -ENOENT if there is no aggregation state for RA/TID or
+ *   no A-MPDU in flight.
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_ack(FAR struct ieee80211_s *ic,
+                        FAR struct ieee80211_node *ni, uint8_t tid,
+                        uint16_t ssn, uint64_t bitmap)
+{
+  struct ieee80211_ampdu_sent_s sent;
+  FAR struct ieee80211_tx_ba *ba;
+  FAR struct ieee80211_txagg_s *ag;
+  uip_lock_t lock;
+  uint64_t map;
+  uint16_t sn;
+  unsigned int off;
+  unsigned int idx;
+  unsigned int rel;
+  unsigned int n;
+
+  if (ni->ni_ba == NULL)
+    {
+      return -ENOENT;
+    }
+
+  ba = &ni->ni_ba->nb_tx[tid & IEEE80211_QOS_TID];
+  lock = uip_lock();
+
+  ag = ba->ba_agg;
+  if (ag == NULL || ag->ag_nsent == 0)
+    {
+      uip_unlock(lock);
+      return -ENOENT;
+    }
+
+  sent = ag->ag_sent[0];
+  ag->ag_nsent--;
+  memmove(&ag->ag_sent[0], &ag->ag_sent[1],
+          ag->ag_nsent * sizeof(struct ieee80211_ampdu_sent_s));
+
+  /* Restart the Block Ack inactivity timer */
+
+  if (ba->ba_timeout_val != 0)
+    {
+      wd_start(ba->ba_to, USEC2TICK(ba->ba_timeout_val),
+               ieee80211_tx_ba_timeout, 1, ba);
+    }
+
+  for (map = sent.as_map; map != 0; map &= map - 1)
+    {
+      sn  = (sent.as_ssn + ampdu_ctz(map)) & 0xfff;
+      off = (sn - ba->ba_winstart) & 0xfff;
+      idx = sn & (AMPDU_MAXWIN - 1);
+      rel = (sn - ssn) & 0xfff;
+
+      DEBUGASSERT(off < AMPDU_MAXWIN && (ag->ag_held & AMPDU_BIT(off)) != 0);
+
+      if (rel < 64 && (bitmap & AMPDU_BIT(rel)) != 0)
+        {
+          ic->ic_ampdu_stats.am_acked++;
+        }
+      else if (rel >= 2048)
+        {
+          /* The recipient has already moved past this MPDU */
+
+          ic->ic_ampdu_stats.am_drops++;
+        }
+      else if (++ag->ag_retries[idx] <= AMPDU_MAXRETRY)
+        {
+          ag->ag_pend |= AMPDU_BIT(off);
+          ic->ic_ampdu_stats.am_retries++;
+          continue;
+        }
+      else
+        {
+          ic->ic_ampdu_stats.am_drops++;
+          ag->ag_bar = true;
+        }
+
+      ieee80211_txfree(ic, ag->ag_frame[idx]);
+      ag->ag_frame[idx] = NULL;
+      ag->ag_held &= ~AMPDU_BIT(off);
+    }
+
+  /* Move WinStart to the oldest MPDU still held */
+
+  if (ag->ag_held == 0)
+    {
+      n = (ag->ag_nextsn - ba->ba_winstart) & 0xfff;
+      ag->ag_pend = 0;
+    }
+  else
+    {
+      n = ampdu_ctz(ag->ag_held);
+      ag->ag_held >>= n;
+      ag->ag_pend >>= n;
+    }
+
+  if (n > 0)
+    {
+      ba->ba_winstart = (ba->ba_winstart + n) & 0xfff;
+      ba->ba_winend   = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
+
+      if (ag->ag_bar)
+        {
+          ag->ag_bar = false;
+          ieee80211_ampdu_bar(ic, ni, tid, ba->ba_winstart);
+        }
+
+      ieee80211_ampdu_refill(ba, ag);
+    }
+
+  uip_unlock(lock);
+  return OK;
+}
+
+#endif /* CONFIG_IEEE80211_HT */
@@ -22,22 +22,25 @@
  * Included Files
  ****************************************************************************/
 
-#include <nuttx/config.h>
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
 
-#include <sys/param.h>
-#include <sys/socket.h>
+#  include <sys/param.h>
+#  include <sys/socket.h>
 
-#include <net/if.h>
+#  include <net/if.h>
 
-#ifdef CONFIG_NET_ETHERNET
-#  include <netinet/in.h>
-#  include <nuttx/net/uip/uip.h>
-#endif
+#  ifdef CONFIG_NET_ETHERNET
+#    include <netinet/in.h>
+#    include <nuttx/net/uip/uip.h>
+#  endif
+
+#  include <debug.h>
 
-#include <debug.h>
+#  include "ieee80211/ieee80211_var.h"
+#  include "ieee80211/ieee80211_priv.h"
+#endif
 
-#include "ieee80211/ieee80211_var.h"
-#include "ieee80211/ieee80211_priv.h"
 #include "ieee80211/ieee80211_amrr.h"
 
 /****************************************************************************
@@ -0,0 +1,523 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_amsdu.c
+ * A-MSDU transmit aggregation for small frames
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <debug.h>
+
+#include <arpa/inet.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/net/arp.h>
+#include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_ifnet.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+/* How long a lone MSDU may wait for company */
+
+#ifndef CONFIG_IEEE80211_AMSDU_HOLDUSEC
+#  define CONFIG_IEEE80211_AMSDU_HOLDUSEC 2000
+#endif
+
+/* Byte budget of one A-MSDU (3839 is the smallest maximum a peer can
+ * advertise).
+ */
+
+#ifndef CONFIG_IEEE80211_AMSDU_MAXLEN
+#  define CONFIG_IEEE80211_AMSDU_MAXLEN 3839
+#endif
+
+/* Larger MSDUs are never aggregated */
+
+#ifndef CONFIG_IEEE80211_AMSDU_MAXMSDU
+#  define CONFIG_IEEE80211_AMSDU_MAXMSDU 256
+#endif
+
+/* An A-MSDU subframe header (DA, SA, Length) is followed by the RFC 1042
+ * LLC/SNAP header that replaces the Ethernet type field.
+ */
+
+#define AMSDU_ETHHDR_LEN  sizeof(struct uip_eth_hdr)
+#define AMSDU_SUBHDR_LEN  (2 * IEEE80211_ADDR_LEN + 2)
+#define AMSDU_LLC_LEN     8
+#define AMSDU_OVERHEAD    (AMSDU_SUBHDR_LEN + AMSDU_LLC_LEN - AMSDU_ETHHDR_LEN)
+
+#define AMSDU_LLC_SNAP    0xaa   /* DSAP/SSAP of an LLC/SNAP header */
+#define AMSDU_LLC_UI      0x03   /* Unnumbered information */
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_tail
+ *
+ * Description:
+ *   Return the last I/O buffer of a chain.
+ *
+ ****************************************************************************/
+
+static FAR struct iob_s *ieee80211_amsdu_tail(FAR struct iob_s *iob)
+{
+  while (iob->io_flink != NULL)
+    {
+      iob = iob->io_flink;
+    }
+
+  return iob;
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_subframe
+ *
+ * Description:
+ *   Turn an Ethernet frame into an A-MSDU subframe in place:  the Ethernet
+ *   header becomes the subframe header followed by an LLC/SNAP header.
+ *   Only the head I/O buffer is touched.  Returns the new head of the
+ *   chain or NULL (the chain having been freed) on failure.
+ *
+ ****************************************************************************/
+
+static FAR struct iob_s *ieee80211_amsdu_subframe(FAR struct iob_s *iob)
+{
+  struct uip_eth_hdr ethhdr;
+  FAR uint8_t *frm;
+  uint16_t len;
+
+  memcpy(&ethhdr, IOB_DATA(iob), AMSDU_ETHHDR_LEN);
+  len = iob->io_pktlen - AMSDU_ETHHDR_LEN + AMSDU_LLC_LEN;
+
+  iob = iob_trimhead(iob, AMSDU_ETHHDR_LEN);
+  iob = ieee80211_iob_prepend(iob, AMSDU_SUBHDR_LEN + AMSDU_LLC_LEN);
+  if (iob == NULL)
+    {
+      return NULL;
+    }
+
+  frm = IOB_DATA(iob);
+  IEEE80211_ADDR_COPY(frm, ethhdr.dest);
+  frm += IEEE80211_ADDR_LEN;
+  IEEE80211_ADDR_COPY(frm, ethhdr.src);
+  frm += IEEE80211_ADDR_LEN;
+  *frm++ = len >> 8;
+  *frm++ = len & 0xff;
+
+  *frm++ = AMSDU_LLC_SNAP;
+  *frm++ = AMSDU_LLC_SNAP;
+  *frm++ = AMSDU_LLC_UI;
+  *frm++ = 0;
+  *frm++ = 0;
+  *frm++ = 0;
+  memcpy(frm, &ethhdr.type, 2);
+  return iob;
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_join
+ *
+ * Description:
+ *   Append an Ethernet frame as a new subframe of the A-MSDU, padding the
+ *   previous subframe to a multiple of four bytes.  Nothing is copied but
+ *   the headers; the payload I/O buffers are linked as they are.
+ *
+ ****************************************************************************/
+
+static int ieee80211_amsdu_join(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_amsdu_s *as,
+                                FAR struct iob_s *iob)
+{
+  FAR struct iob_s *tail;
+  unsigned int npad = -as->as_lastlen & 3;
+
+  iob = ieee80211_amsdu_subframe(iob);
+  if (iob == NULL)
+    {
+      ic->ic_amsdu_stats.as_nobufs++;
+      return -ENOMEM;
+    }
+
+  if (npad > 0)
+    {
+      tail = as->as_tail;
+      if (IOB_FREESPACE(tail) < npad)
+        {
+          tail = iob_alloc(false);
+          if (tail == NULL)
+            {
+              ic->ic_amsdu_stats.as_nobufs++;
+              iob_free_chain(iob);
+              return -ENOMEM;
+            }
+
+          as->as_tail->io_flink = tail;
+          as->as_tail = tail;
+        }
+
+      memset(IOB_DATA(tail) + tail->io_len, 0, npad);
+      tail->io_len += npad;
+      as->as_head->io_pktlen += npad;
+    }
+
+  as->as_tail->io_flink  = iob;
+  as->as_tail            = ieee80211_amsdu_tail(iob);
+  as->as_head->io_pktlen += iob->io_pktlen;
+  as->as_len            += npad + iob->io_pktlen;
+  as->as_lastlen         = iob->io_pktlen;
+  as->as_nmsdus++;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_flush
+ *
+ * Description:
+ *   Queue the A-MSDU under construction for access category 'ac'.  A lone
+ *   MSDU is queued as the Ethernet frame it still is.  Otherwise a pseudo
+ *   Ethernet header carries the DA and SA to ieee80211_encap(), and the
+ *   packet header marks the frame as an A-MSDU for TID as_tid.
+ *
+ ****************************************************************************/
+
+static void ieee80211_amsdu_flush(FAR struct ieee80211_s *ic, uint8_t ac)
+{
+  FAR struct ieee80211_amsdu_s *as = &ic->ic_amsdu[ac];
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct uip_eth_hdr *ethhdr;
+  FAR struct iob_s *iob = as->as_head;
+
+  if (iob == NULL)
+    {
+      return;
+    }
+
+  as->as_head = NULL;
+  as->as_tail = NULL;
+
+  if (as->as_nmsdus == 1)
+    {
+      ic->ic_amsdu_stats.as_single++;
+    }
+  else
+    {
+      iob = ieee80211_iob_prepend(iob, AMSDU_ETHHDR_LEN);
+      if (iob == NULL)
+        {
+          ic->ic_amsdu_stats.as_nobufs += as->as_nmsdus;
+          return;
+        }
+
+      ph = IEEE80211_PKTHDR_GET(iob);
+      if (ph == NULL)
+        {
+          ic->ic_amsdu_stats.as_nobufs += as->as_nmsdus;
+          iob_free_chain(iob);
+          return;
+        }
+
+      ph->ph_flags |= IEEE80211_PH_AMSDU;
+      ph->ph_tid    = as->as_tid;
+
+      ethhdr = (FAR struct uip_eth_hdr *)IOB_DATA(iob);
+      IEEE80211_ADDR_COPY(ethhdr->dest, as->as_da);
+      IEEE80211_ADDR_COPY(ethhdr->src, ic->ic_myaddr);
+      ethhdr->type = 0;
+
+      ic->ic_amsdu_stats.as_amsdus++;
+      ic->ic_amsdu_stats.as_msdus += as->as_nmsdus;
+    }
+
+  (void)ieee80211_txdata(ic, ac, iob);
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_timeout
+ *
+ * Description:
+ *   The hold time has expired:  send whatever has been collected.
+ *
+ ****************************************************************************/
+
+static void ieee80211_amsdu_timeout(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  uip_lock_t lock;
+  int ac;
+
+  lock = uip_lock();
+  for (ac = 0; ac < EDCA_NUM_AC; ac++)
+    {
+      if (ic->ic_amsdu[ac].as_head != NULL)
+        {
+          ic->ic_amsdu_stats.as_timeouts++;
+          ieee80211_amsdu_flush(ic, ac);
+        }
+    }
+
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_eligible
+ *
+ * Description:
+ *   Return the TID of an Ethernet frame that may be sent inside an A-MSDU,
+ *   or a negative value if it may not.  A-MSDUs go to HT QoS peers only,
+ *   and not on TIDs with a Block Ack agreement:  A-MSDU in A-MPDU is not
+ *   negotiated.
+ *
+ ****************************************************************************/
+
+static int ieee80211_amsdu_eligible(FAR struct ieee80211_s *ic,
+                                    FAR struct iob_s *iob)
+{
+  FAR struct uip_eth_hdr *ethhdr;
+  FAR struct ieee80211_node *ni;
+  int tid;
+
+  if ((ic->ic_flags & IEEE80211_F_QOS) == 0 ||
+      iob->io_pktlen > CONFIG_IEEE80211_AMSDU_MAXMSDU ||
+      iob->io_len < AMSDU_ETHHDR_LEN)
+    {
+      return -1;
+    }
+
+  ethhdr = (FAR struct uip_eth_hdr *)IOB_DATA(iob);
+  if (IEEE80211_IS_MULTICAST(ethhdr->dest) ||
+      ethhdr->type == htons(UIP_ETHTYPE_PAE))
+    {
+      return -1;
+    }
+
+  if (ic->ic_opmode == IEEE80211_M_STA)
+    {
+      ni = ic->ic_bss;
+    }
+  else
+    {
+      ni = ieee80211_find_node(ic, ethhdr->dest);
+    }
+
+  if (ni == NULL ||
+      (ni->ni_flags & (IEEE80211_NODE_HT | IEEE80211_NODE_QOS)) !=
+      (IEEE80211_NODE_HT | IEEE80211_NODE_QOS) ||
+      ((ic->ic_flags & IEEE80211_F_RSNON) && !ni->ni_port_valid))
+    {
+      return -1;
+    }
+
+  tid = ieee80211_classify(ic, iob);
+  if (ni->ni_ba != NULL &&
+      ni->ni_ba->nb_tx[tid].ba_state == IEEE80211_BA_AGREED)
+    {
+      return -1;
+    }
+
+  return tid;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_initialize
+ *
+ * Description:
+ *   Reset the A-MSDU transmit aggregation state of the interface.
+ *
+ ****************************************************************************/
+
+void ieee80211_amsdu_initialize(FAR struct ieee80211_s *ic)
+{
+  memset(ic->ic_amsdu, 0, sizeof(ic->ic_amsdu));
+  memset(&ic->ic_amsdu_stats, 0, sizeof(ic->ic_amsdu_stats));
+  memset(&ic->ic_amsdu_work, 0, sizeof(ic->ic_amsdu_work));
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_add
+ *
+ * Description:
+ *   Offer an Ethernet frame, classified to access category 'ac', to the
+ *   A-MSDU builder.  Frames with the same DA and TID are collected until
+ *   the byte budget is reached or the hold time expires.  A frame that
+ *   cannot be aggregated first pushes out whatever is held for its access
+ *   category, so that the order of frames within an access category is
+ *   preserved.
+ *
+ * Returned Value:
+ *   OK if the frame was taken (it may have been dropped for lack of I/O
+ *   buffers);  -ENOENT if it must be queued normally.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_amsdu_add(FAR struct ieee80211_s *ic, uint8_t ac,
+                        FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_amsdu_s *as = &ic->ic_amsdu[ac];
+  FAR struct uip_eth_hdr *ethhdr;
+  int tid;
+
+  tid = ieee80211_amsdu_eligible(ic, iob);
+  if (tid < 0)
+    {
+      ieee80211_amsdu_flush(ic, ac);
+      return -ENOENT;
+    }
+
+  ethhdr = (FAR struct uip_eth_hdr *)IOB_DATA(iob);
+
+  /* Does the frame belong to the A-MSDU being built? */
+
+  if (as->as_head != NULL &&
+      (as->as_tid != tid || !IEEE80211_ADDR_EQ(as->as_da, ethhdr->dest) ||
+       as->as_len + (-as->as_lastlen & 3) + iob->io_pktlen + AMSDU_OVERHEAD >
+       CONFIG_IEEE80211_AMSDU_MAXLEN))
+    {
+      ieee80211_amsdu_flush(ic, ac);
+    }
+
+  if (as->as_head == NULL)
+    {
+      /* Start a new A-MSDU.  The frame is kept as it is for now. */
+
+      as->as_head    = iob;
+      as->as_tail    = ieee80211_amsdu_tail(iob);
+      as->as_len     = iob->io_pktlen + AMSDU_OVERHEAD;
+      as->as_lastlen = as->as_len;
+      as->as_nmsdus  = 1;
+      as->as_tid     = tid;
+      IEEE80211_ADDR_COPY(as->as_da, ethhdr->dest);
+
+      if (work_available(&ic->ic_amsdu_work))
+        {
+          (void)work_queue(HPWORK, &ic->ic_amsdu_work,
+                           ieee80211_amsdu_timeout, ic,
+                           USEC2TICK(CONFIG_IEEE80211_AMSDU_HOLDUSEC) + 1);
+        }
+
+      return OK;
+    }
+
+  if (as->as_nmsdus == 1)
+    {
+      /* A second MSDU has arrived:  convert the first one */
+
+      as->as_head = ieee80211_amsdu_subframe(as->as_head);
+      if (as->as_head == NULL)
+        {
+          ic->ic_amsdu_stats.as_nobufs++;
+          as->as_tail = NULL;
+          as->as_head = iob;
+          ieee80211_amsdu_flush(ic, ac);
+          return OK;
+        }
+
+      as->as_tail = ieee80211_amsdu_tail(as->as_head);
+    }
+
+  if (ieee80211_amsdu_join(ic, as, iob) < 0)
+    {
+      /* The frame has been freed; send what we have */
+
+      ieee80211_amsdu_flush(ic, ac);
+    }
+  else if (as->as_len + 4 + AMSDU_OVERHEAD + AMSDU_ETHHDR_LEN >
+           CONFIG_IEEE80211_AMSDU_MAXLEN)
+    {
+      /* Even the smallest further frame would not fit */
+
+      ieee80211_amsdu_flush(ic, ac);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_discard
+ *
+ * Description:
+ *   Free all frames held by the A-MSDU builder.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_amsdu_discard(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_amsdu_s *as;
+  int ac;
+
+  (void)work_cancel(HPWORK, &ic->ic_amsdu_work);
+
+  for (ac = 0; ac < EDCA_NUM_AC; ac++)
+    {
+      as = &ic->ic_amsdu[ac];
+      if (as->as_head != NULL)
+        {
+          iob_free_chain(as->as_head);
+          as->as_head = NULL;
+          as->as_tail = NULL;
+        }
+    }
+}
+
+#endif /* CONFIG_IEEE80211_AMSDU_TX */
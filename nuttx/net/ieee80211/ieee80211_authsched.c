@@ -0,0 +1,670 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_authsched.c
+ * Authenticator 4-way handshake scheduler
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <queue.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_debug.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_crypto.h"
+#include "ieee80211/ieee80211_priv.h"
+
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Verifying message 2 costs a PTK derivation and a MIC, several HMAC-SHA1
+ * runs; do it on the low priority work queue.  The retry timer only sends
+ * frames and runs on the high priority queue like the watchdogs it
+ * replaces.
+ */
+
+#define HS_WORK  LPWORK
+#define HS_TIMER HPWORK
+
+/* Get the job of an as_timers entry */
+
+#define HS_TJOB(e) \
+  ((FAR struct ieee80211_hsjob *) \
+   ((FAR uint8_t *)(e) - offsetof(struct ieee80211_hsjob, hs_tlink)))
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void ieee80211_authsched_timeout(FAR void *arg);
+static void ieee80211_authsched_worker(FAR void *arg);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_authsched_arm
+ *
+ * Description:
+ *   (Re)start the shared retry timer for the soonest EAPOL timeout.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_authsched_arm(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR dq_entry_t *e;
+  int32_t delay;
+
+  (void)work_cancel(HS_TIMER, &as->as_timer);
+
+  e = dq_peek(&as->as_timers);
+  if (e == NULL)
+    {
+      return;
+    }
+
+  delay = (int32_t)(HS_TJOB(e)->hs_expire - clock_systimer());
+  if (delay < 0)
+    {
+      delay = 0;
+    }
+
+  (void)work_queue(HS_TIMER, &as->as_timer, ieee80211_authsched_timeout,
+                   ic, delay);
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_timeout
+ *
+ * Description:
+ *   Run the EAPOL timeouts that are due.
+ *
+ ****************************************************************************/
+
+static void ieee80211_authsched_timeout(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_hsjob *job;
+  FAR dq_entry_t *e;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+
+  while ((e = dq_peek(&as->as_timers)) != NULL)
+    {
+      job = HS_TJOB(e);
+      if ((int32_t)(job->hs_expire - clock_systimer()) > 0)
+        {
+          break;
+        }
+
+      dq_rem(e, &as->as_timers);
+      job->hs_flags &= ~IEEE80211_HS_TIMER;
+
+      /* May restart the timer or make the node leave */
+
+      ieee80211_eapol_timeout(job->hs_ni);
+    }
+
+  ieee80211_authsched_arm(ic);
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_activate
+ *
+ * Description:
+ *   Give a handshake slot to a node and send message 1.
+ *
+ * Assumptions:
+ *   The network is locked and a slot is free.
+ *
+ ****************************************************************************/
+
+static int ieee80211_authsched_activate(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_hsjob *job = &ni->ni_rsn->rn_hs;
+
+  job->hs_flags |= IEEE80211_HS_ACTIVE;
+  job->hs_start  = clock_systimer();
+
+  as->as_active++;
+  as->as_stats.hs_started++;
+  if (as->as_active > as->as_stats.hs_peak)
+    {
+      as->as_stats.hs_peak = as->as_active;
+    }
+
+  return ieee80211_send_4way_msg1(ic, ni);
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_release
+ *
+ * Description:
+ *   Return the slot of a node and start the handshakes waiting for one.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_authsched_release(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_hsjob *job)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR dq_entry_t *e;
+
+  job->hs_flags &= ~IEEE80211_HS_ACTIVE;
+  if (as->as_active > 0)
+    {
+      as->as_active--;
+    }
+
+  /* Message 1 may make a node leave and release its slot again, so check
+   * the count on every pass.
+   */
+
+  while (as->as_active < CONFIG_IEEE80211_AUTHSCHED_MAXACTIVE &&
+         (e = dq_remfirst(&as->as_waiting)) != NULL)
+    {
+      job = (FAR struct ieee80211_hsjob *)e;
+      job->hs_flags &= ~IEEE80211_HS_WAITING;
+      (void)ieee80211_authsched_activate(ic, job->hs_ni);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_worker
+ *
+ * Description:
+ *   Derive the PTK and check the MIC of queued messages 2 with the network
+ *   unlocked, then continue the handshakes whose MIC is correct.  At most
+ *   CONFIG_IEEE80211_AUTHSCHED_BATCH messages are handled per run so that
+ *   other low priority work is not held off.
+ *
+ ****************************************************************************/
+
+static void ieee80211_authsched_worker(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_eapol_key *key;
+  FAR struct ieee80211_node_rsn *rn;
+  FAR struct ieee80211_hsjob *job;
+  FAR struct ieee80211_node *ni;
+  FAR dq_entry_t *e;
+  struct ieee80211_ptk tptk;
+  uint8_t msg2[IEEE80211_HS_MSG2LEN];
+  uint8_t pmk[IEEE80211_PMK_LEN];
+  uint8_t anonce[EAPOL_KEY_NONCE_LEN];
+  uint8_t aa[IEEE80211_ADDR_LEN];
+  uint8_t spa[IEEE80211_ADDR_LEN];
+  enum ieee80211_akm akm;
+  uip_lock_t lock;
+  uint16_t rsnoff;
+  uint16_t seq;
+  bool micok;
+  int n;
+
+  lock = uip_lock();
+
+  for (n = 0; n < CONFIG_IEEE80211_AUTHSCHED_BATCH &&
+              (e = dq_remfirst(&as->as_ready)) != NULL; n++)
+    {
+      /* Take a snapshot of everything the derivation needs */
+
+      job = (FAR struct ieee80211_hsjob *)e;
+      job->hs_flags = (job->hs_flags & ~IEEE80211_HS_QUEUED) |
+                      IEEE80211_HS_BUSY;
+
+      ni     = job->hs_ni;
+      rn     = ni->ni_rsn;
+      seq    = job->hs_seq;
+      rsnoff = job->hs_rsnoff;
+      akm    = ni->ni_rsnakms;
+
+      memcpy(msg2, job->hs_msg2, job->hs_len);
+      memcpy(pmk, rn->rn_pmk, IEEE80211_PMK_LEN);
+      memcpy(anonce, rn->rn_nonce, EAPOL_KEY_NONCE_LEN);
+      memcpy(aa, ic->ic_myaddr, IEEE80211_ADDR_LEN);
+      memcpy(spa, ni->ni_macaddr, IEEE80211_ADDR_LEN);
+      uip_unlock(lock);
+
+      /* PTK = CalcPTK(ANonce, SNonce), then check the MIC using the KCK */
+
+      key = (FAR struct ieee80211_eapol_key *)msg2;
+      ieee80211_derive_ptk(akm, pmk, aa, spa, anonce, key->nonce, &tptk);
+      micok = (ieee80211_eapol_key_check_mic(key, tptk.kck) == 0);
+
+      lock = uip_lock();
+
+      /* The node may have left, or even joined again, meanwhile */
+
+      if (ni->ni_rsn != rn || (job->hs_flags & IEEE80211_HS_BUSY) == 0 ||
+          job->hs_seq != seq)
+        {
+          continue;
+        }
+
+      job->hs_flags &= ~IEEE80211_HS_BUSY;
+
+      if (!micok)
+        {
+          ndbg("ERROR: key MIC failed\n");
+          as->as_stats.hs_micfail++;
+          continue;             /* will timeout.. */
+        }
+
+      if (rn->rn_state == RSNA_PTKSTART ||
+          rn->rn_state == RSNA_PTKCALCNEGOTIATING)
+        {
+          ieee80211_4way_msg2_verified(ic, ni, &tptk, &msg2[rsnoff]);
+        }
+    }
+
+  as->as_queued = false;
+  if (!dq_empty(&as->as_ready))
+    {
+      as->as_queued = (work_queue(HS_WORK, &as->as_work,
+                                  ieee80211_authsched_worker, ic, 0) == OK);
+    }
+
+  uip_unlock(lock);
+
+  memset(&tptk, 0, sizeof(tptk));
+  memset(pmk, 0, sizeof(pmk));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_authsched_initialize
+ *
+ * Description:
+ *   Initialize the handshake scheduler of an interface.
+ *
+ ****************************************************************************/
+
+void ieee80211_authsched_initialize(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+
+  memset(as, 0, sizeof(*as));
+  dq_init(&as->as_waiting);
+  dq_init(&as->as_ready);
+  dq_init(&as->as_timers);
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_uninitialize
+ *
+ * Description:
+ *   Stop the handshake scheduler.  Nodes still on its lists are taken off
+ *   so that they can be discarded later.
+ *
+ ****************************************************************************/
+
+void ieee80211_authsched_uninitialize(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR dq_entry_t *e;
+
+  (void)work_cancel(HS_WORK, &as->as_work);
+  (void)work_cancel(HS_TIMER, &as->as_timer);
+
+  while ((e = dq_remfirst(&as->as_waiting)) != NULL)
+    {
+      ((FAR struct ieee80211_hsjob *)e)->hs_flags = 0;
+    }
+
+  while ((e = dq_remfirst(&as->as_ready)) != NULL)
+    {
+      ((FAR struct ieee80211_hsjob *)e)->hs_flags = 0;
+    }
+
+  while ((e = dq_remfirst(&as->as_timers)) != NULL)
+    {
+      HS_TJOB(e)->hs_flags = 0;
+    }
+
+  as->as_active = 0;
+  as->as_queued = false;
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_start
+ *
+ * Description:
+ *   Start the 4-Way Handshake with a node.  At most
+ *   CONFIG_IEEE80211_AUTHSCHED_MAXACTIVE handshakes are in progress at a
+ *   time; further nodes wait in arrival order for a slot to become free.
+ *
+ * Returned Value:
+ *   The result of sending message 1, or OK if the node has to wait.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_authsched_start(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_hsjob *job = &ni->ni_rsn->rn_hs;
+
+  job->hs_ni = ni;
+
+  if (job->hs_flags & IEEE80211_HS_ACTIVE)
+    {
+      return ieee80211_send_4way_msg1(ic, ni);
+    }
+
+  if (job->hs_flags & IEEE80211_HS_WAITING)
+    {
+      return OK;
+    }
+
+  if (as->as_active >= CONFIG_IEEE80211_AUTHSCHED_MAXACTIVE)
+    {
+      nvdbg("%s: deferring 4-way handshake with %s (%d in progress)\n",
+            ic->ic_ifname, ieee80211_addr2str(ni->ni_macaddr),
+            as->as_active);
+
+      job->hs_flags |= IEEE80211_HS_WAITING;
+      dq_addlast(&job->hs_link, &as->as_waiting);
+      as->as_stats.hs_deferred++;
+      return OK;
+    }
+
+  return ieee80211_authsched_activate(ic, ni);
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_done
+ *
+ * Description:
+ *   The 4-Way Handshake with a node completed.  Account for its latency and
+ *   pass its slot on.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_authsched_done(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_hs_stats *st = &ic->ic_authsched.as_stats;
+  FAR struct ieee80211_hsjob *job = &ni->ni_rsn->rn_hs;
+  uint32_t ms;
+
+  if ((job->hs_flags & IEEE80211_HS_ACTIVE) == 0)
+    {
+      return;
+    }
+
+  ms = TICK2MSEC(clock_systimer() - job->hs_start);
+  st->hs_completed++;
+  st->hs_lastms   = ms;
+  st->hs_totalms += ms;
+  if (ms > st->hs_maxms)
+    {
+      st->hs_maxms = ms;
+    }
+
+  ieee80211_authsched_release(ic, job);
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_discard
+ *
+ * Description:
+ *   Forget the handshake state of a node that leaves or is freed: stop its
+ *   timer, drop any queued message 2 and release its slot.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_authsched_discard(FAR struct ieee80211_s *ic,
+                                 FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_hsjob *job;
+  uint8_t flags;
+
+  if (ni->ni_rsn == NULL)
+    {
+      return;
+    }
+
+  job = &ni->ni_rsn->rn_hs;
+  ieee80211_eapol_timer_stop(ic, ni);
+
+  flags = job->hs_flags;
+  if (flags & IEEE80211_HS_WAITING)
+    {
+      dq_rem(&job->hs_link, &as->as_waiting);
+    }
+  else if (flags & IEEE80211_HS_QUEUED)
+    {
+      dq_rem(&job->hs_link, &as->as_ready);
+    }
+
+  /* A worker still verifying message 2 sees that BUSY was cleared */
+
+  job->hs_flags = 0;
+  job->hs_len   = 0;
+
+  if (flags & IEEE80211_HS_ACTIVE)
+    {
+      as->as_stats.hs_failed++;
+      ieee80211_authsched_release(ic, job);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_authsched_msg2
+ *
+ * Description:
+ *   Queue message 2 of the 4-Way Handshake for verification by the worker.
+ *   Retransmissions of a message that is already queued are dropped.
+ *
+ * Returned Value:
+ *   OK if the message was taken; otherwise the caller verifies it inline.
+ *
+ * Assumptions:
+ *   The network is locked and the replay counter has been verified.
+ *
+ ****************************************************************************/
+
+int ieee80211_authsched_msg2(FAR struct ieee80211_s *ic,
+                             FAR struct ieee80211_node *ni,
+                             FAR const struct ieee80211_eapol_key *key,
+                             FAR const uint8_t *rsnie)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_node_rsn *rn = ni->ni_rsn;
+  FAR struct ieee80211_hsjob *job = &rn->rn_hs;
+  FAR const uint8_t *frm = (FAR const uint8_t *)key;
+  size_t len;
+
+  if (job->hs_flags & (IEEE80211_HS_QUEUED | IEEE80211_HS_BUSY))
+    {
+      return OK;
+    }
+
+  len = 4 + BE_READ_2(key->len);
+  if (len > sizeof(job->hs_msg2) || rsnie < frm ||
+      rsnie + 2 + rsnie[1] > frm + len)
+    {
+      return -E2BIG;
+    }
+
+  rn->rn_state = RSNA_PTKCALCNEGOTIATING;
+
+  memcpy(job->hs_msg2, key, len);
+  job->hs_len    = len;
+  job->hs_rsnoff = rsnie - frm;
+  job->hs_seq    = ++as->as_seq;
+  job->hs_ni     = ni;
+  job->hs_flags |= IEEE80211_HS_QUEUED;
+  dq_addlast(&job->hs_link, &as->as_ready);
+
+  if (!as->as_queued)
+    {
+      if (work_queue(HS_WORK, &as->as_work, ieee80211_authsched_worker,
+                     ic, 0) != OK)
+        {
+          dq_rem(&job->hs_link, &as->as_ready);
+          job->hs_flags &= ~IEEE80211_HS_QUEUED;
+          return -EAGAIN;
+        }
+
+      as->as_queued = true;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_eapol_timer_start
+ *
+ * Description:
+ *   (Re)start the EAPOL-Key retry timer of a node.  All nodes share one
+ *   timer on the work queue; the pending timeouts are kept sorted by
+ *   expiry.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_eapol_timer_start(FAR struct ieee80211_s *ic,
+                                 FAR struct ieee80211_node *ni,
+                                 uint32_t ticks)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_hsjob *job = &ni->ni_rsn->rn_hs;
+  FAR dq_entry_t *e;
+
+  if (job->hs_flags & IEEE80211_HS_TIMER)
+    {
+      dq_rem(&job->hs_tlink, &as->as_timers);
+    }
+
+  job->hs_ni     = ni;
+  job->hs_expire = clock_systimer() + ticks;
+  job->hs_flags |= IEEE80211_HS_TIMER;
+
+  /* Timeouts are mostly started in expiry order: search from the tail */
+
+  e = as->as_timers.tail;
+  while (e != NULL && (int32_t)(HS_TJOB(e)->hs_expire - job->hs_expire) > 0)
+    {
+      e = dq_prev(e);
+    }
+
+  if (e == NULL)
+    {
+      dq_addfirst(&job->hs_tlink, &as->as_timers);
+      ieee80211_authsched_arm(ic);
+    }
+  else
+    {
+      dq_addafter(e, &job->hs_tlink, &as->as_timers);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_eapol_timer_stop
+ *
+ * Description:
+ *   Stop the EAPOL-Key retry timer of a node.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_eapol_timer_stop(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_authsched_s *as = &ic->ic_authsched;
+  FAR struct ieee80211_hsjob *job = &ni->ni_rsn->rn_hs;
+  bool head;
+
+  if ((job->hs_flags & IEEE80211_HS_TIMER) == 0)
+    {
+      return;
+    }
+
+  head = (dq_peek(&as->as_timers) == &job->hs_tlink);
+  dq_rem(&job->hs_tlink, &as->as_timers);
+  job->hs_flags &= ~IEEE80211_HS_TIMER;
+
+  if (head)
+    {
+      ieee80211_authsched_arm(ic);
+    }
+}
+
+#endif /* CONFIG_IEEE80211_AUTHSCHED */
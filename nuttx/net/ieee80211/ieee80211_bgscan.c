@@ -0,0 +1,536 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_bgscan.c
+ * Background scanning and roaming for associated stations
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_debug.h"
+#include "ieee80211/ieee80211_ifnet.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+
+#ifdef CONFIG_IEEE80211_BGSCAN
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+/* Time spent on each visited channel (msec) */
+
+#ifndef CONFIG_IEEE80211_BGSCAN_DWELL
+#  define CONFIG_IEEE80211_BGSCAN_DWELL 20
+#endif
+
+/* Time spent on the home channel between two visits (msec) */
+
+#ifndef CONFIG_IEEE80211_BGSCAN_HOME
+#  define CONFIG_IEEE80211_BGSCAN_HOME 100
+#endif
+
+/* Period of the background scans (seconds, 0: on request only) */
+
+#ifndef CONFIG_IEEE80211_BGSCAN_INTERVAL
+#  define CONFIG_IEEE80211_BGSCAN_INTERVAL 60
+#endif
+
+/* Scan every CONFIG_IEEE80211_BGSCAN_WEAK_INTERVAL seconds while the
+ * average RSSI of the AP is below this (0: disabled).
+ */
+
+#ifndef CONFIG_IEEE80211_BGSCAN_RSSI
+#  define CONFIG_IEEE80211_BGSCAN_RSSI 0
+#endif
+
+#ifndef CONFIG_IEEE80211_BGSCAN_WEAK_INTERVAL
+#  define CONFIG_IEEE80211_BGSCAN_WEAK_INTERVAL 10
+#endif
+
+/* RSSI advantage a candidate AP needs before we roam to it */
+
+#ifndef CONFIG_IEEE80211_ROAM_MARGIN
+#  define CONFIG_IEEE80211_ROAM_MARGIN 10
+#endif
+
+/* A visit is postponed at most this many times while data is waiting to be
+ * sent, and the radio leaves at most this many ticks after the power save
+ * Null frame was queued, whether or not the driver took it.
+ */
+
+#define BGSCAN_MAXDEFER  4
+#define BGSCAN_MAXLEAVE  4
+
+/* How often an idle station checks whether a scan is due */
+
+#define BGSCAN_POLL      SEC2TICK(1)
+
+/* Background scan states (bs_state) */
+
+#define BGSCAN_IDLE      0  /* No scan in progress */
+#define BGSCAN_HOME      1  /* On the home channel between two visits */
+#define BGSCAN_LEAVING   2  /* Power save announced, about to retune */
+#define BGSCAN_AWAY      3  /* Tuned to bs_chan */
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void ieee80211_bgscan_work(FAR void *arg);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_schedule
+ *
+ * Description:
+ *   Run the background scan state machine again after 'delay' ticks.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_schedule(FAR struct ieee80211_s *ic,
+                                      uint32_t delay)
+{
+  (void)work_queue(HPWORK, &ic->ic_bgscan.bs_work, ieee80211_bgscan_work,
+                   ic, delay);
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_due
+ *
+ * Description:
+ *   Return true if the periodic or the weak signal interval has elapsed
+ *   since the end of the previous background scan.
+ *
+ ****************************************************************************/
+
+static bool ieee80211_bgscan_due(FAR struct ieee80211_s *ic)
+{
+  uint32_t elapsed = clock_systimer() - ic->ic_bgscan.bs_last;
+
+#if CONFIG_IEEE80211_BGSCAN_INTERVAL > 0
+  if (elapsed >= SEC2TICK(CONFIG_IEEE80211_BGSCAN_INTERVAL))
+    {
+      return true;
+    }
+#endif
+
+#if CONFIG_IEEE80211_BGSCAN_RSSI > 0
+  if (elapsed >= SEC2TICK(CONFIG_IEEE80211_BGSCAN_WEAK_INTERVAL) &&
+      ic->ic_bss->ni_stats.ns_rssiavg != 0 &&
+      (ic->ic_bss->ni_stats.ns_rssiavg >> 4) < CONFIG_IEEE80211_BGSCAN_RSSI)
+    {
+      return true;
+    }
+#endif
+
+  UNUSED(elapsed);
+  return false;
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_begin
+ *
+ * Description:
+ *   Start a background scan from the first channel of the scan list.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_begin(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_bgscan_s *bs = &ic->ic_bgscan;
+
+  nvdbg("%s: begin background scan\n", ic->ic_ifname);
+
+  bs->bs_start = clock_systimer();
+  bs->bs_next  = 0;
+  bs->bs_defer = 0;
+  bs->bs_state = BGSCAN_HOME;
+
+  ieee80211_bgscan_schedule(ic, 0);
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_end
+ *
+ * Description:
+ *   All channels have been visited.  Move to the best AP of our network
+ *   if it is clearly better than the current one, otherwise wait for the
+ *   next scan.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_end(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_bgscan_s *bs = &ic->ic_bgscan;
+  FAR struct ieee80211_node *ni;
+  FAR struct ieee80211_node *curbs;
+  FAR struct ieee80211_node *selbs = NULL;
+  int currssi;
+
+  bs->bs_state = BGSCAN_IDLE;
+  bs->bs_last  = clock_systimer();
+  ic->ic_scan_stats.ss_bgscans++;
+
+  nvdbg("%s: end background scan\n", ic->ic_ifname);
+
+  /* Only the results of this scan count:  an AP heard of long ago may
+   * have gone since.
+   */
+
+  RB_FOREACH(ni, ieee80211_tree, &ic->ic_tree)
+    {
+      if (ni->ni_fails != 0 ||
+          IEEE80211_ADDR_EQ(ni->ni_bssid, ic->ic_bss->ni_bssid) ||
+          (int32_t)(ni->ni_lastseen - bs->bs_start) < 0 ||
+          ieee80211_match_bss(ic, ni) != 0)
+        {
+          continue;
+        }
+
+      if (selbs == NULL || ni->ni_rssi > selbs->ni_rssi)
+        {
+          selbs = ni;
+        }
+    }
+
+  /* Compare with what the beacons of the current AP told us, if they were
+   * heard during the scan.
+   */
+
+  curbs   = ieee80211_find_node(ic, ic->ic_bss->ni_macaddr);
+  currssi = curbs != NULL ? curbs->ni_rssi : ic->ic_bss->ni_rssi;
+
+  if (selbs != NULL &&
+      selbs->ni_rssi >= currssi + CONFIG_IEEE80211_ROAM_MARGIN)
+    {
+      ic->ic_scan_stats.ss_roams++;
+      ieee80211_roam(ic, selbs);
+      return;
+    }
+
+  ieee80211_bgscan_schedule(ic, BGSCAN_POLL);
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_leave
+ *
+ * Description:
+ *   On the home channel:  pick the next channel to visit and tell the AP
+ *   we are going to sleep.  Visits are postponed for a while if data is
+ *   waiting to be sent.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_leave(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_bgscan_s *bs = &ic->ic_bgscan;
+  FAR struct ieee80211_channel *chan = NULL;
+  int ac;
+
+  for (ac = 0; ac < EDCA_NUM_AC && bs->bs_defer < BGSCAN_MAXDEFER; ac++)
+    {
+      if (ic->ic_txq[ac].txq_len != 0)
+        {
+          bs->bs_defer++;
+          ieee80211_bgscan_schedule(ic,
+                                    MSEC2TICK(CONFIG_IEEE80211_BGSCAN_HOME));
+          return;
+        }
+    }
+
+  bs->bs_defer = 0;
+
+  while (bs->bs_next < ic->ic_scan_nchans)
+    {
+      chan = &ic->ic_channels[ic->ic_scan_chans[bs->bs_next++]];
+      if (chan != ic->ic_bss->ni_chan)
+        {
+          break;
+        }
+
+      chan = NULL;
+    }
+
+  if (chan == NULL)
+    {
+      ieee80211_bgscan_end(ic);
+      return;
+    }
+
+  (void)ieee80211_send_nulldata(ic, ic->ic_bss, true);
+
+  bs->bs_state = BGSCAN_LEAVING;
+  ieee80211_bgscan_schedule(ic, 1);
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_away
+ *
+ * Description:
+ *   Retune to the channel picked by ieee80211_bgscan_leave() once the power
+ *   save Null frame has gone out, and probe it if allowed.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_away(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_bgscan_s *bs = &ic->ic_bgscan;
+  FAR struct ieee80211_channel *chan;
+
+  if (!IOB_QEMPTY(&ic->ic_mgtq.txq_queue) && ++bs->bs_defer < BGSCAN_MAXLEAVE)
+    {
+      ieee80211_bgscan_schedule(ic, 1);
+      return;
+    }
+
+  bs->bs_defer = 0;
+  chan = &ic->ic_channels[ic->ic_scan_chans[bs->bs_next - 1]];
+
+  if (ic->ic_set_channel(ic, chan) < 0)
+    {
+      /* Skip the channel; we never left home */
+
+      (void)ieee80211_send_nulldata(ic, ic->ic_bss, false);
+      bs->bs_state = BGSCAN_HOME;
+      ieee80211_bgscan_schedule(ic, 0);
+      return;
+    }
+
+  bs->bs_chan  = chan;
+  bs->bs_state = BGSCAN_AWAY;
+  ic->ic_scan_stats.ss_slices++;
+
+  if ((chan->ic_flags & IEEE80211_CHAN_PASSIVE) == 0)
+    {
+      (void)ieee80211_send_bcast_probe(ic);
+    }
+
+  ieee80211_bgscan_schedule(ic, MSEC2TICK(CONFIG_IEEE80211_BGSCAN_DWELL));
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_home
+ *
+ * Description:
+ *   Return to the channel of the AP, wake up and let the frames held back
+ *   while away go out.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_home(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_bgscan_s *bs = &ic->ic_bgscan;
+
+  (void)ic->ic_set_channel(ic, ic->ic_bss->ni_chan);
+  bs->bs_chan  = NULL;
+  bs->bs_state = BGSCAN_HOME;
+
+  (void)ieee80211_send_nulldata(ic, ic->ic_bss, false);
+  ieee80211_iftxavail(ic);
+
+  ieee80211_bgscan_schedule(ic, MSEC2TICK(CONFIG_IEEE80211_BGSCAN_HOME));
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_work
+ *
+ * Description:
+ *   Background scan state machine, run on the high priority work queue.
+ *
+ ****************************************************************************/
+
+static void ieee80211_bgscan_work(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+
+  if (ic->ic_opmode != IEEE80211_M_STA || ic->ic_state != IEEE80211_S_RUN)
+    {
+      goto out;
+    }
+
+  switch (ic->ic_bgscan.bs_state)
+    {
+    case BGSCAN_IDLE:
+      if (ieee80211_bgscan_due(ic))
+        {
+          ieee80211_bgscan_begin(ic);
+        }
+      else
+        {
+          ieee80211_bgscan_schedule(ic, BGSCAN_POLL);
+        }
+      break;
+
+    case BGSCAN_HOME:
+      ieee80211_bgscan_leave(ic);
+      break;
+
+    case BGSCAN_LEAVING:
+      ieee80211_bgscan_away(ic);
+      break;
+
+    case BGSCAN_AWAY:
+      ieee80211_bgscan_home(ic);
+      break;
+    }
+
+out:
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_start
+ *
+ * Description:
+ *   Start a background scan now (user request).
+ *
+ * Returned Value:
+ *   OK if the scan was started; -ENOSYS if the driver cannot retune on its
+ *   own, -ENOTCONN if the station is not associated or -EBUSY if a
+ *   background scan is already in progress.
+ *
+ ****************************************************************************/
+
+int ieee80211_bgscan_start(FAR struct ieee80211_s *ic)
+{
+  uip_lock_t lock;
+  int ret = OK;
+
+  if (ic->ic_set_channel == NULL)
+    {
+      return -ENOSYS;
+    }
+
+  lock = uip_lock();
+  if (ic->ic_opmode != IEEE80211_M_STA || ic->ic_state != IEEE80211_S_RUN)
+    {
+      ret = -ENOTCONN;
+    }
+  else if (ic->ic_bgscan.bs_state != BGSCAN_IDLE)
+    {
+      ret = -EBUSY;
+    }
+  else
+    {
+      (void)work_cancel(HPWORK, &ic->ic_bgscan.bs_work);
+      ieee80211_bgscan_begin(ic);
+    }
+
+  uip_unlock(lock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_newstate
+ *
+ * Description:
+ *   Called by the state machine after each transition.  A scan in progress
+ *   is abandoned; periodic scans are armed when the station associates.
+ *   The driver retunes to the channel of ic_bss on its own as part of the
+ *   transition.
+ *
+ ****************************************************************************/
+
+void ieee80211_bgscan_newstate(FAR struct ieee80211_s *ic,
+                               enum ieee80211_state ostate)
+{
+  FAR struct ieee80211_bgscan_s *bs = &ic->ic_bgscan;
+  bool away = bs->bs_chan != NULL;
+
+  if (ic->ic_state == ostate || ic->ic_set_channel == NULL)
+    {
+      return;
+    }
+
+  (void)work_cancel(HPWORK, &bs->bs_work);
+  bs->bs_chan  = NULL;
+  bs->bs_state = BGSCAN_IDLE;
+  bs->bs_defer = 0;
+
+  if (away)
+    {
+      ieee80211_iftxavail(ic);
+    }
+
+  if (ic->ic_opmode == IEEE80211_M_STA && ic->ic_state == IEEE80211_S_RUN &&
+      (CONFIG_IEEE80211_BGSCAN_INTERVAL > 0 ||
+       CONFIG_IEEE80211_BGSCAN_RSSI > 0))
+    {
+      bs->bs_last = clock_systimer();
+      ieee80211_bgscan_schedule(ic, BGSCAN_POLL);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_bgscan_discard
+ *
+ * Description:
+ *   Stop background scanning before the interface goes away.
+ *
+ ****************************************************************************/
+
+void ieee80211_bgscan_discard(FAR struct ieee80211_s *ic)
+{
+  (void)work_cancel(HPWORK, &ic->ic_bgscan.bs_work);
+  ic->ic_bgscan.bs_chan  = NULL;
+  ic->ic_bgscan.bs_state = BGSCAN_IDLE;
+}
+
+#endif /* CONFIG_IEEE80211_BGSCAN */
@@ -0,0 +1,478 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_ccmp_bench.c
+ * Host benchmark for the AES/CCMP data path.  This is not part of the
+ * NuttX build.  Build and run it on the development host with:
+ *
+ *   cc -O2 -DIEEE80211_HOSTBENCH -o ccmp_bench \
+ *      ieee80211_ccmp_bench.c ieee80211_rijndael.c
+ *   ./ccmp_bench
+ *
+ * It first checks rijndael_encrypt() against the FIPS-197 AES-128 vector,
+ * and rijndael_encrypt_ctr() and both CCM loops against the CCMP test
+ * vector of IEEE Std 802.11-2012 Annex M.6.4 (CCM as in RFC 3610, M = 8,
+ * L = 2).  It then compares the original per-byte CCM loop (one
+ * rijndael_encrypt() call for the CBC-MAC and one for the key stream
+ * interleaved per block) with the block CBC-MAC plus batched CTR pass used
+ * by ieee80211_crypto_ccmp.c, and checks that both produce the same cipher
+ * text and MIC at every length.
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ieee80211_rijndael.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CCMP_CTR_NBLOCKS  4
+#define CCMP_MICLEN       8
+#define BENCH_BYTES       (16 * 1024 * 1024)   /* Bytes processed per case */
+
+#ifndef MIN
+#  define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const unsigned int g_mpdulen[] = { 64, 512, 1500 };
+
+/* FIPS-197 Appendix C.1 (AES-128) */
+
+static const uint8_t g_aes_key[16] =
+{
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+static const uint8_t g_aes_pt[16] =
+{
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+  0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+
+static const uint8_t g_aes_ct[16] =
+{
+  0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+  0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+};
+
+/* IEEE Std 802.11-2012 Annex M.6.4:  PN = 0xb5039776e70c, A1 =
+ * 0f:d2:e1:28:a5:7c, A2 = 50:30:f1:84:44:08, A3 = ab:ae:a5:b8:fc:ba.  The
+ * nonce and AAD are as ieee80211_ccmp_phase1() builds them from the
+ * header.
+ */
+
+static const uint8_t g_ccmp_key[16] =
+{
+  0xc9, 0x7c, 0x1f, 0x67, 0xce, 0x37, 0x11, 0x85,
+  0x51, 0x4a, 0x8a, 0x19, 0xf2, 0xbd, 0xd5, 0x2f
+};
+
+static const uint8_t g_ccmp_nonce[13] =
+{
+  0x00, 0x50, 0x30, 0xf1, 0x84, 0x44, 0x08, 0xb5,
+  0x03, 0x97, 0x76, 0xe7, 0x0c
+};
+
+static const uint8_t g_ccmp_aad[22] =
+{
+  0x08, 0x40, 0x0f, 0xd2, 0xe1, 0x28, 0xa5, 0x7c,
+  0x50, 0x30, 0xf1, 0x84, 0x44, 0x08, 0xab, 0xae,
+  0xa5, 0xb8, 0xfc, 0xba, 0x00, 0x00
+};
+
+static const uint8_t g_ccmp_pt[20] =
+{
+  0xf8, 0xba, 0x1a, 0x55, 0xd0, 0x2f, 0x85, 0xae,
+  0x96, 0x7b, 0xb6, 0x2f, 0xb6, 0xcd, 0xa8, 0xeb,
+  0x7e, 0x78, 0xa0, 0x50
+};
+
+static const uint8_t g_ccmp_ct[20] =
+{
+  0xf3, 0xd0, 0xa2, 0xfe, 0x9a, 0x3d, 0xbf, 0x23,
+  0x42, 0xa6, 0x43, 0xe4, 0x32, 0x46, 0xe8, 0x0c,
+  0x3c, 0x04, 0xd0, 0x19
+};
+
+static const uint8_t g_ccmp_mic[CCMP_MICLEN] =
+{
+  0x78, 0x45, 0xce, 0x0b, 0x16, 0xf9, 0x76, 0x23
+};
+
+/* Key stream blocks E(K, A_1) and E(K, A_2) of the vector above */
+
+static const uint8_t g_ccmp_ks[32] =
+{
+  0x0b, 0x6a, 0xb8, 0xab, 0x4a, 0x12, 0x3a, 0x8d,
+  0xd4, 0xdd, 0xf5, 0xcb, 0x84, 0x8b, 0x40, 0xe7,
+  0x42, 0x7c, 0x70, 0x49, 0xbf, 0x6b, 0x20, 0x7e,
+  0x86, 0x7b, 0xf7, 0x6e, 0xb3, 0x39, 0xc7, 0x28
+};
+
+static uint8_t g_frame[2][1500 + CCMP_MICLEN];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* The original interleaved per-byte loop */
+
+static void ccm_bytewise(const rijndael_ctx *ctx, uint8_t *buf,
+                         unsigned int len, const uint8_t *b0,
+                         const uint8_t *a0, uint8_t *mic)
+{
+  uint8_t a[16];
+  uint8_t b[16];
+  uint8_t s[16];
+  uint16_t ctr = 1;
+  unsigned int i;
+  int j = 0;
+
+  memcpy(a, a0, 16);
+  memcpy(b, b0, 16);
+  a[14] = 0;
+  a[15] = 1;
+  rijndael_encrypt(ctx, a, s);
+
+  for (i = 0; i < len; i++)
+    {
+      b[j] ^= buf[i];
+      buf[i] ^= s[j];
+      if (++j < 16)
+        {
+          continue;
+        }
+
+      rijndael_encrypt(ctx, b, b);
+      ctr++;
+      a[14] = ctr >> 8;
+      a[15] = ctr & 0xff;
+      rijndael_encrypt(ctx, a, s);
+      j = 0;
+    }
+
+  if (j != 0)
+    {
+      rijndael_encrypt(ctx, b, b);
+    }
+
+  memcpy(mic, b, CCMP_MICLEN);
+}
+
+/* Block CBC-MAC followed by a batched CTR pass */
+
+static void ccm_blocks(const rijndael_ctx *ctx, uint8_t *buf,
+                       unsigned int len, const uint8_t *b0,
+                       const uint8_t *a0, uint8_t *mic)
+{
+  uint8_t ks[CCMP_CTR_NBLOCKS * 16];
+  uint8_t a[16];
+  uint8_t b[16];
+  unsigned int nblocks;
+  unsigned int off;
+  unsigned int n;
+  unsigned int i;
+
+  memcpy(a, a0, 16);
+  memcpy(b, b0, 16);
+
+  for (off = 0; off < len; off += 16)
+    {
+      n = MIN(16, len - off);
+      for (i = 0; i < n; i++)
+        {
+          b[i] ^= buf[off + i];
+        }
+
+      rijndael_encrypt(ctx, b, b);
+    }
+
+  a[14] = 0;
+  a[15] = 1;
+
+  for (off = 0; off < len; off += n)
+    {
+      nblocks = MIN(CCMP_CTR_NBLOCKS, (len - off + 15) / 16);
+      rijndael_encrypt_ctr(ctx, a, ks, nblocks);
+
+      n = MIN(nblocks * 16, len - off);
+      for (i = 0; i < n; i++)
+        {
+          buf[off + i] ^= ks[i];
+        }
+    }
+
+  memcpy(mic, b, CCMP_MICLEN);
+}
+
+typedef void (*ccm_func_t)(const rijndael_ctx *, uint8_t *, unsigned int,
+                           const uint8_t *, const uint8_t *, uint8_t *);
+
+/* The CBC-MAC over B_0 and the two AAD blocks, A_0 and S_0, as
+ * ieee80211_ccmp_phase1() computes them once the nonce and AAD are built.
+ */
+
+static void ccm_phase1(const rijndael_ctx *ctx, const uint8_t *nonce,
+                       const uint8_t *aad, unsigned int la, unsigned int lm,
+                       uint8_t *b, uint8_t *a, uint8_t *s0)
+{
+  uint8_t auth[32];
+  unsigned int i;
+
+  memset(auth, 0, sizeof(auth));
+  auth[0] = la >> 8;
+  auth[1] = la & 0xff;
+  memcpy(&auth[2], aad, la);
+
+  b[0] = 89;
+  memcpy(&b[1], nonce, 13);
+  b[14] = lm >> 8;
+  b[15] = lm & 0xff;
+  rijndael_encrypt(ctx, b, b);
+
+  for (i = 0; i < 16; i++)
+    {
+      b[i] ^= auth[i];
+    }
+
+  rijndael_encrypt(ctx, b, b);
+  for (i = 0; i < 16; i++)
+    {
+      b[i] ^= auth[16 + i];
+    }
+
+  rijndael_encrypt(ctx, b, b);
+
+  a[0] = 1;
+  memcpy(&a[1], nonce, 13);
+  a[14] = a[15] = 0;
+  rijndael_encrypt(ctx, a, s0);
+}
+
+/* Known-answer tests.  Each returns 0 on success */
+
+static int kat_aes(void)
+{
+  rijndael_ctx ctx;
+  uint8_t buf[16];
+
+  rijndael_set_key_enc_only(&ctx, g_aes_key, 128);
+  rijndael_encrypt(&ctx, g_aes_pt, buf);
+  if (memcmp(buf, g_aes_ct, sizeof(buf)) != 0)
+    {
+      fprintf(stderr, "ERROR: AES-128 known answer mismatch\n");
+      return -1;
+    }
+
+  return 0;
+}
+
+static int kat_ctr(void)
+{
+  rijndael_ctx ctx;
+  uint8_t ks[sizeof(g_ccmp_ks)];
+  uint8_t a[16];
+  unsigned int i;
+
+  rijndael_set_key_enc_only(&ctx, g_ccmp_key, 128);
+
+  a[0] = 1;
+  memcpy(&a[1], g_ccmp_nonce, 13);
+  a[14] = 0;
+  a[15] = 1;
+  rijndael_encrypt_ctr(&ctx, a, ks, 2);
+
+  if (memcmp(ks, g_ccmp_ks, sizeof(ks)) != 0 || a[14] != 0 || a[15] != 3)
+    {
+      fprintf(stderr, "ERROR: CTR key stream known answer mismatch\n");
+      return -1;
+    }
+
+  /* The key stream applied to the plain text must give the cipher text */
+
+  for (i = 0; i < sizeof(g_ccmp_pt); i++)
+    {
+      if ((g_ccmp_pt[i] ^ ks[i]) != g_ccmp_ct[i])
+        {
+          fprintf(stderr, "ERROR: CTR cipher text mismatch at %u\n", i);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+static int kat_ccmp(ccm_func_t func, const char *name)
+{
+  rijndael_ctx ctx;
+  uint8_t buf[sizeof(g_ccmp_pt)];
+  uint8_t mic[CCMP_MICLEN];
+  uint8_t b[16];
+  uint8_t a[16];
+  uint8_t s0[16];
+  unsigned int i;
+
+  rijndael_set_key_enc_only(&ctx, g_ccmp_key, 128);
+  ccm_phase1(&ctx, g_ccmp_nonce, g_ccmp_aad, sizeof(g_ccmp_aad),
+             sizeof(g_ccmp_pt), b, a, s0);
+
+  memcpy(buf, g_ccmp_pt, sizeof(buf));
+  func(&ctx, buf, sizeof(buf), b, a, mic);
+  for (i = 0; i < CCMP_MICLEN; i++)
+    {
+      mic[i] ^= s0[i];
+    }
+
+  if (memcmp(buf, g_ccmp_ct, sizeof(buf)) != 0 ||
+      memcmp(mic, g_ccmp_mic, CCMP_MICLEN) != 0)
+    {
+      fprintf(stderr, "ERROR: %s CCMP known answer mismatch\n", name);
+      return -1;
+    }
+
+  return 0;
+}
+
+static double bench(ccm_func_t func, const rijndael_ctx *ctx,
+                    unsigned int len)
+{
+  uint8_t b0[16];
+  uint8_t a0[16];
+  uint8_t mic[CCMP_MICLEN];
+  unsigned int iter = BENCH_BYTES / len;
+  unsigned int i;
+  double start;
+  double elapsed;
+
+  memset(b0, 0x59, sizeof(b0));
+  memset(a0, 0x01, sizeof(a0));
+
+  start = now();
+  for (i = 0; i < iter; i++)
+    {
+      func(ctx, g_frame[0], len, b0, a0, mic);
+    }
+
+  elapsed = now() - start;
+  return ((double)iter * len) / elapsed / 1e6;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(void)
+{
+  static const uint8_t key[16] =
+  {
+    0xc9, 0x7c, 0x1f, 0x67, 0xce, 0x37, 0x11, 0x85,
+    0x51, 0x4a, 0x8a, 0x19, 0xf2, 0xbd, 0xd5, 0x2f
+  };
+
+  rijndael_ctx ctx;
+  uint8_t b0[16];
+  uint8_t a0[16];
+  uint8_t mic[2][CCMP_MICLEN];
+  unsigned int n;
+  unsigned int i;
+
+  /* Known answers:  the block cipher and the key stream on their own, then
+   * the complete CCMP encapsulation through both paths.
+   */
+
+  if (kat_aes() < 0 || kat_ctr() < 0 ||
+      kat_ccmp(ccm_bytewise, "bytewise") < 0 ||
+      kat_ccmp(ccm_blocks, "blocks") < 0)
+    {
+      return EXIT_FAILURE;
+    }
+
+  rijndael_set_key_enc_only(&ctx, key, 128);
+
+  /* Sanity check:  Both paths must agree at every length */
+
+  for (i = 0; i < 16; i++)
+    {
+      b0[i] = (uint8_t)(0x59 + i);
+      a0[i] = (uint8_t)(0x01 + i);
+    }
+
+  for (n = 0; n <= 1500; n++)
+    {
+      for (i = 0; i < n; i++)
+        {
+          g_frame[0][i] = g_frame[1][i] = (uint8_t)(i * 7 + n);
+        }
+
+      ccm_bytewise(&ctx, g_frame[0], n, b0, a0, mic[0]);
+      ccm_blocks(&ctx, g_frame[1], n, b0, a0, mic[1]);
+
+      if (memcmp(g_frame[0], g_frame[1], n) != 0 ||
+          memcmp(mic[0], mic[1], CCMP_MICLEN) != 0)
+        {
+          fprintf(stderr, "ERROR: mismatch at length %u\n", n);
+          return EXIT_FAILURE;
+        }
+    }
+
+  printf("%-8s %14s %14s\n", "MPDU", "bytewise MB/s", "blocks MB/s");
+  for (i = 0; i < sizeof(g_mpdulen) / sizeof(g_mpdulen[0]); i++)
+    {
+      n = g_mpdulen[i];
+      printf("%-8u %14.1f %14.1f\n", n,
+             bench(ccm_bytewise, &ctx, n), bench(ccm_blocks, &ctx, n));
+    }
+
+  return EXIT_SUCCESS;
+}
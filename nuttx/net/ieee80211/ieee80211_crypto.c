@@ -30,6 +30,7 @@
 #include <string.h>
 #include <queue.h>
 #include <errno.h>
+#include <assert.h>
 
 #include <net/if.h>
 
@@ -38,11 +39,12 @@
 #  include <nuttx/net/uip/uip.h>
 #endif
 
-#include <nuttx/kmalloc.h>
 #include <nuttx/net/iob.h>
 
+#include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
 #include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_sha1.h"
 
 /****************************************************************************
  * Private Function Prototypes
@@ -52,8 +54,6 @@ void ieee80211_prf(const uint8_t *, size_t, const uint8_t *, size_t,
                    const uint8_t *, size_t, uint8_t *, size_t);
 void ieee80211_kdf(const uint8_t *, size_t, const uint8_t *, size_t,
                    const uint8_t *, size_t, uint8_t *, size_t);
-void ieee80211_derive_pmkid(enum ieee80211_akm, const uint8_t *,
-                            const uint8_t *, const uint8_t *, uint8_t *);
 
 /****************************************************************************
  * Private Functions
@@ -61,7 +61,7 @@ void ieee80211_derive_pmkid(enum ieee80211_akm, const uint8_t *,
 
 void ieee80211_crypto_attach(struct ieee80211_s *ic)
 {
-  sq_init(&ic->ic_pmksa);
+  ieee80211_pmksa_initialize(ic);
   if (ic->ic_caps & IEEE80211_C_RSN)
     {
       ic->ic_rsnprotos = IEEE80211_PROTO_WPA | IEEE80211_PROTO_RSN;
@@ -73,21 +73,22 @@ void ieee80211_crypto_attach(struct ieee80211_s *ic)
 
   ic->ic_set_key = ieee80211_set_key;
   ic->ic_delete_key = ieee80211_delete_key;
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+  ieee80211_cryptoq_initialize(ic);
+#endif
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  ieee80211_authsched_initialize(ic);
+#endif
 }
 
 void ieee80211_crypto_detach(struct ieee80211_s *ic)
 {
-  FAR struct ieee80211_pmk *pmk;
   int i;
 
   /* Purge the PMKSA cache */
 
-  while ((pmk = (FAR struct ieee80211_pmk *)sq_peek(&ic->ic_pmksa)) != NULL)
-    {
-      sq_remfirst(&ic->ic_pmksa);
-      memset(pmk, 0, sizeof(struct ieee80211_pmk));
-      kfree(pmk);
-    }
+  ieee80211_pmksa_flush(ic);
 
   /* Clear all group keys from memory */
 
@@ -102,9 +103,19 @@ void ieee80211_crypto_detach(struct ieee80211_s *ic)
       memset(k, 0, sizeof(*k));
     }
 
-  /* Clear pre-shared key from memory */
+  /* Clear pre-shared key and passphrase from memory */
 
+#ifdef CONFIG_IEEE80211_PBKDF2
+  ieee80211_psk_discard(ic);
+#endif
   memset(ic->ic_psk, 0, IEEE80211_PMK_LEN);
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+  ieee80211_cryptoq_uninitialize(ic);
+#endif
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  ieee80211_authsched_uninitialize(ic);
+#endif
 }
 
 /*
@@ -160,6 +171,12 @@ int ieee80211_set_key(struct ieee80211_s *ic, struct ieee80211_node *ni,
 void ieee80211_delete_key(struct ieee80211_s *ic, struct ieee80211_node *ni,
                           struct ieee80211_key *k)
 {
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+  /* Fail queued requests and wait for the worker to let go of the key */
+
+  ieee80211_cryptoq_flushkey(ic, k);
+#endif
+
   switch (k->k_cipher)
     {
     case IEEE80211_CIPHER_WEP40:
@@ -192,7 +209,7 @@ struct ieee80211_key *ieee80211_get_txkey(struct ieee80211_s *ic,
   if ((ic->ic_flags & IEEE80211_F_RSNON) &&
       !IEEE80211_IS_MULTICAST(wh->i_addr1) &&
       ni->ni_rsncipher != IEEE80211_CIPHER_USEGROUP)
-    return &ni->ni_pairwise_key;
+    return (ni->ni_rsn != NULL) ? &ni->ni_rsn->rn_pairwise_key : NULL;
 
   if (!IEEE80211_IS_MULTICAST(wh->i_addr1) ||
       (wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) != IEEE80211_FC0_TYPE_MGT)
@@ -202,9 +219,128 @@ struct ieee80211_key *ieee80211_get_txkey(struct ieee80211_s *ic,
   return &ic->ic_nw_keys[kid];
 }
 
-struct iob_s *ieee80211_encrypt(struct ieee80211_s *ic, struct iob_s *iob0,
-                                struct ieee80211_key *k)
+/* Insert 'len' bytes of cipher header between the 802.11 header and the
+ * frame body, in place.  The 802.11 header must be contiguous in the head
+ * I/O buffer.  The header is slid down into the headroom of the head I/O
+ * buffer if there is enough; otherwise the body bytes of the head I/O
+ * buffer are slid up into its tailroom.  Only if neither is possible is
+ * the 802.11 header copied into a new I/O buffer linked in front of the
+ * body.  On failure the chain is freed and NULL is returned.
+ */
+
+FAR struct iob_s *ieee80211_crypto_hdrgap(FAR struct ieee80211_s *ic,
+                                          FAR struct iob_s *iob,
+                                          unsigned int hdrlen,
+                                          unsigned int len)
+{
+  FAR struct iob_s *head;
+  FAR uint8_t *wh = IOB_DATA(iob);
+
+  DEBUGASSERT(iob->io_len >= hdrlen);
+
+  if (iob->io_offset >= len)
+    {
+      memmove(wh - len, wh, hdrlen);
+      iob->io_offset -= len;
+    }
+  else if (IOB_FREESPACE(iob) >= len)
+    {
+      memmove(wh + hdrlen + len, wh + hdrlen, iob->io_len - hdrlen);
+    }
+  else
+    {
+      head = iob_alloc(false);
+      if (head == NULL)
+        {
+          ic->ic_crypto_stats.cs_nobufs++;
+          iob_free_chain(iob);
+          return NULL;
+        }
+
+      ic->ic_crypto_stats.cs_iobs++;
+
+      memcpy(IOB_DATA(head), wh, hdrlen);
+      head->io_len    = hdrlen + len;
+      head->io_pktlen = iob->io_pktlen + len;
+      head->io_flink  = iob_trimhead(iob, hdrlen);
+
+      /* The packet metadata moves to the new head */
+
+      head->io_pkthdr = head->io_flink->io_pkthdr;
+      head->io_flink->io_pkthdr = NULL;
+      return head;
+    }
+
+  iob->io_len    += len;
+  iob->io_pktlen += len;
+  return iob;
+}
+
+/* Reserve 'len' contiguous bytes at the end of the chain for a MIC or ICV.
+ * The tailroom of the last I/O buffer is used when there is enough of it.
+ */
+
+FAR uint8_t *ieee80211_crypto_tailroom(FAR struct ieee80211_s *ic,
+                                       FAR struct iob_s *iob,
+                                       unsigned int len)
+{
+  FAR struct iob_s *last;
+  FAR uint8_t *tail;
+
+  for (last = iob; last->io_flink != NULL; last = last->io_flink);
+
+  tail = ieee80211_iob_append(iob, len);
+  if (tail == NULL)
+    {
+      ic->ic_crypto_stats.cs_nobufs++;
+    }
+  else if (last->io_flink != NULL)
+    {
+      ic->ic_crypto_stats.cs_iobs++;
+    }
+
+  return tail;
+}
+
+/* Remove the 'len' byte cipher header that follows the 802.11 header and
+ * the 'taillen' byte MIC/ICV from a decrypted frame, in place.
+ */
+
+int ieee80211_crypto_strip(FAR struct iob_s *iob, unsigned int hdrlen,
+                           unsigned int len, unsigned int taillen)
 {
+  FAR uint8_t *wh;
+  int error;
+
+  if (iob->io_len < hdrlen + len)
+    {
+      error = iob_contig(iob, hdrlen + len);
+      if (error < 0)
+        {
+          return error;
+        }
+    }
+
+  wh = IOB_DATA(iob);
+  memmove(wh + len, wh, hdrlen);
+  iob->io_offset += len;
+  iob->io_len    -= len;
+  iob->io_pktlen -= len;
+
+  (void)iob_trimtail(iob, taillen);
+  return OK;
+}
+
+/* Run the software cipher of key 'k' over the frame.  The caller must hold
+ * the crypto lock.
+ */
+
+FAR struct iob_s *ieee80211_cipher_encrypt(FAR struct ieee80211_s *ic,
+                                           FAR struct iob_s *iob0,
+                                           FAR struct ieee80211_key *k)
+{
+  uint32_t iobs = ic->ic_crypto_stats.cs_iobs;
+
   switch (k->k_cipher)
     {
     case IEEE80211_CIPHER_WEP40:
@@ -227,12 +363,25 @@ struct iob_s *ieee80211_encrypt(struct ieee80211_s *ic, struct iob_s *iob0,
       iob0 = NULL;
     }
 
+  if (iob0 != NULL)
+    {
+      ic->ic_crypto_stats.cs_encrypted++;
+      if (ic->ic_crypto_stats.cs_iobs == iobs)
+        {
+          ic->ic_crypto_stats.cs_inplace++;
+        }
+    }
+
   return iob0;
 }
 
-struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
-                                FAR struct iob_s *iob0,
-                                struct ieee80211_node *ni)
+/* Find the key needed to decrypt a received frame.  NULL is returned if
+ * the frame does not carry a valid key identifier; the frame is not freed.
+ */
+
+struct ieee80211_key *ieee80211_get_rxkey(FAR struct ieee80211_s *ic,
+                                          FAR struct iob_s *iob0,
+                                          FAR struct ieee80211_node *ni)
 {
   FAR struct ieee80211_frame *wh;
   FAR struct ieee80211_key *k;
@@ -248,8 +397,14 @@ struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
       !IEEE80211_IS_MULTICAST(wh->i_addr1) &&
       ni->ni_rsncipher != IEEE80211_CIPHER_USEGROUP)
     {
-      k = &ni->ni_pairwise_key;
+      /* No pairwise key unless the sender completed association */
+
+      if (ni->ni_rsn == NULL)
+        {
+          return NULL;
+        }
 
+      k = &ni->ni_rsn->rn_pairwise_key;
     }
   else if (!IEEE80211_IS_MULTICAST(wh->i_addr1) ||
            (wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) != IEEE80211_FC0_TYPE_MGT)
@@ -262,7 +417,6 @@ struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
 
       if (iob0->io_len < hdrlen + 4)
         {
-          iob_free_chain(iob0);
           return NULL;
         }
 
@@ -276,7 +430,6 @@ struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
 
       if (iob0->io_len < sizeof(*wh) + IEEE80211_MMIE_LEN)
         {
-          iob_free_chain(iob0);
           return NULL;
         }
 
@@ -288,19 +441,29 @@ struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
 
       if (mmie[0] != IEEE80211_ELEMID_MMIE || mmie[1] != 16)
         {
-          iob_free_chain(iob0);
           return NULL;
         }
 
       kid = LE_READ_2(&mmie[2]);
       if (kid != 4 && kid != 5)
         {
-          iob_free_chain(iob0);
           return NULL;
         }
 
       k = &ic->ic_nw_keys[kid];
     }
+
+  return k;
+}
+
+/* Run the software cipher of key 'k' over a received frame.  The caller
+ * must hold the crypto lock.
+ */
+
+FAR struct iob_s *ieee80211_cipher_decrypt(FAR struct ieee80211_s *ic,
+                                           FAR struct iob_s *iob0,
+                                           FAR struct ieee80211_key *k)
+{
   switch (k->k_cipher)
     {
     case IEEE80211_CIPHER_WEP40:
@@ -322,6 +485,58 @@ struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
       iob_free_chain(iob0);
       iob0 = NULL;
     }
+
+  if (iob0 != NULL)
+    {
+      ic->ic_crypto_stats.cs_decrypted++;
+    }
+
+  return iob0;
+}
+
+struct iob_s *ieee80211_encrypt(struct ieee80211_s *ic, struct iob_s *iob0,
+                                struct ieee80211_key *k)
+{
+  ieee80211_crypto_lock(ic);
+  iob0 = ieee80211_cipher_encrypt(ic, iob0, k);
+  ieee80211_crypto_unlock(ic);
+  return iob0;
+}
+
+struct iob_s *ieee80211_decrypt(FAR struct ieee80211_s *ic,
+                                FAR struct iob_s *iob0,
+                                struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_key *k;
+  uint32_t replays;
+
+  k = ieee80211_get_rxkey(ic, iob0, ni);
+  if (k == NULL)
+    {
+      ni->ni_stats.ns_decrypterrs++;
+      iob_free_chain(iob0);
+      return NULL;
+    }
+
+  ieee80211_crypto_lock(ic);
+  replays = ic->ic_crypto_stats.cs_replays;
+  iob0 = ieee80211_cipher_decrypt(ic, iob0, k);
+
+  /* Replays are told apart from other failures by the cipher counter */
+
+  if (iob0 == NULL)
+    {
+      if (ic->ic_crypto_stats.cs_replays != replays)
+        {
+          ni->ni_stats.ns_replays++;
+        }
+      else
+        {
+          ni->ni_stats.ns_decrypterrs++;
+        }
+    }
+
+  ieee80211_crypto_unlock(ic);
   return iob0;
 }
 
@@ -624,81 +839,3 @@ int ieee80211_eapol_key_decrypt(struct ieee80211_eapol_key *key,
 
   return 1;                     /* unknown Key Descriptor Version */
 }
-
-/* Add a PMK entry to the PMKSA cache */
-
-struct ieee80211_pmk *ieee80211_pmksa_add(struct ieee80211_s *ic,
-                                          enum ieee80211_akm akm,
-                                          const uint8_t * macaddr,
-                                          const uint8_t * key,
-                                          uint32_t lifetime)
-{
-  struct ieee80211_pmk *pmk;
-  sq_entry_t *entry;
-
-  /* Check if an entry already exists for this (STA,AKMP) */
-
-  for (entry = ic->ic_pmksa.head; entry; entry = entry->flink)
-    {
-      pmk = (struct ieee80211_pmk *)entry;
-      if (pmk->pmk_akm == akm && IEEE80211_ADDR_EQ(pmk->pmk_macaddr, macaddr))
-        {
-          break;
-        }
-    }
-
-  if (pmk == NULL)
-    {
-      /* Allocate a new PMKSA entry */
-
-      if ((pmk = kmalloc(sizeof(struct ieee80211_pmk))) == NULL)
-        {
-          return NULL;
-        }
-
-      pmk->pmk_akm = akm;
-      IEEE80211_ADDR_COPY(pmk->pmk_macaddr, macaddr);
-      sq_addlast((sq_entry_t *) pmk, &ic->ic_pmksa);
-    }
-
-  memcpy(pmk->pmk_key, key, IEEE80211_PMK_LEN);
-  pmk->pmk_lifetime = lifetime; /* XXX not used yet */
-#ifdef CONFIG_IEEE80211_AP
-  if (ic->ic_opmode == IEEE80211_M_HOSTAP)
-    {
-      ieee80211_derive_pmkid(pmk->pmk_akm, pmk->pmk_key,
-                             ic->ic_myaddr, macaddr, pmk->pmk_pmkid);
-    }
-  else
-#endif
-    {
-      ieee80211_derive_pmkid(pmk->pmk_akm, pmk->pmk_key,
-                             macaddr, ic->ic_myaddr, pmk->pmk_pmkid);
-    }
-
-  return pmk;
-}
-
-/* Check if we have a cached PMK entry for the specified node and PMKID. */
-
-struct ieee80211_pmk *ieee80211_pmksa_find(struct ieee80211_s *ic,
-                                           struct ieee80211_node *ni,
-                                           const uint8_t * pmkid)
-{
-  struct ieee80211_pmk *pmk;
-  sq_entry_t *entry;
-
-  for (entry = ic->ic_pmksa.head; entry; entry = entry->flink)
-    {
-      pmk = (struct ieee80211_pmk *)entry;
-      if (pmk->pmk_akm == ni->ni_rsnakms &&
-          IEEE80211_ADDR_EQ(pmk->pmk_macaddr, ni->ni_macaddr) &&
-          (pmkid == NULL ||
-           memcmp(pmk->pmk_pmkid, pmkid, IEEE80211_PMKID_LEN) == 0))
-        {
-          break;
-        }
-    }
-
-  return pmk;
-}
@@ -28,9 +28,47 @@
 #include <nuttx/config.h>
 
 #include <queue.h>
+#include <semaphore.h>
 
+#include <nuttx/wqueue.h>
 #include <nuttx/net/iob.h>
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+#  ifndef CONFIG_IEEE80211_CRYPTO_NREQS
+#    define CONFIG_IEEE80211_CRYPTO_NREQS 16
+#  endif
+#  ifndef CONFIG_IEEE80211_CRYPTO_BATCH
+#    define CONFIG_IEEE80211_CRYPTO_BATCH 4
+#  endif
+#endif
+
+#ifndef CONFIG_IEEE80211_PMKSA_NENTRIES
+#  define CONFIG_IEEE80211_PMKSA_NENTRIES 8
+#endif
+
+#define IEEE80211_PMKSA_HASHSIZE 8             /* power of 2 */
+
+#ifdef CONFIG_IEEE80211_PMKCACHE
+#  ifndef CONFIG_IEEE80211_PMKCACHE_PATH
+#    define CONFIG_IEEE80211_PMKCACHE_PATH "/dev/config"
+#  endif
+#  ifndef CONFIG_IEEE80211_PMKCACHE_ID
+#    define CONFIG_IEEE80211_PMKCACHE_ID 0x8011
+#  endif
+#  ifndef CONFIG_IEEE80211_PMKCACHE_NENTRIES
+#    define CONFIG_IEEE80211_PMKCACHE_NENTRIES 4
+#  endif
+#endif
+
+/* WPA passphrases are 8 to 63 printable characters (802.11 Annex M.4) */
+
+#define IEEE80211_PASSPHRASE_MINLEN  8
+#define IEEE80211_PASSPHRASE_MAXLEN  63
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -96,24 +134,128 @@ struct ieee80211_key
     void *k_priv;
   };
 
-/* Entry in the PMKSA cache */
+/* Entry in the PMKSA cache (see ieee80211_pmksa.c), hashed by the address
+ * of the peer.  There is at most one entry per (peer, AKMP).
+ */
 
 struct ieee80211_pmk
   {
-    sq_entry_t pmk_next;
+    dq_entry_t pmk_lru;             /* LRU list, least recently used first */
+    FAR struct ieee80211_pmk *pmk_hnext;    /* Hash chain or free list */
     enum ieee80211_akm pmk_akm;
-    uint32_t pmk_lifetime;
+    uint32_t pmk_lifetime;          /* Seconds */
 #define IEEE80211_PMK_INFINITE    0
 
+    uint32_t pmk_expire;            /* Expiry time (system ticks) */
+    uint8_t pmk_hash;               /* Hash bucket */
     uint8_t pmk_pmkid[IEEE80211_PMKID_LEN];
     uint8_t pmk_macaddr[IEEE80211_ADDR_LEN];
     uint8_t pmk_key[IEEE80211_PMK_LEN];
   };
 
+struct ieee80211_pmksa_stats
+  {
+    uint32_t ps_hits;               /* Lookups that found a PMK */
+    uint32_t ps_misses;             /* Lookups that did not */
+    uint32_t ps_fastassoc;          /* (Re)associations that skipped 802.1X */
+    uint32_t ps_evictions;          /* Entries dropped to make room */
+    uint32_t ps_expired;            /* Entries dropped after their lifetime */
+  };
+
+/* Software crypto statistics.  Comparing cs_iobs with cs_encrypted shows
+ * how many frames could be protected in place, without drawing on the I/O
+ * buffer pool.
+ */
+
+struct ieee80211_crypto_stats
+  {
+    uint32_t cs_encrypted;      /* Frames encrypted */
+    uint32_t cs_decrypted;      /* Frames decrypted and verified */
+    uint32_t cs_inplace;        /* Frames encrypted without new I/O buffers */
+    uint32_t cs_iobs;           /* I/O buffers taken from the pool */
+    uint32_t cs_nobufs;         /* Frames dropped for lack of I/O buffers */
+    uint32_t cs_replays;        /* Frames dropped by replay detection */
+  };
+
 /* forward references */
 
 struct ieee80211_s;
 struct ieee80211_node;
+struct rc4_ctx;
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+/* Asynchronous crypto engine.  A request carries one I/O buffer chain and
+ * the key to apply to it.  Requests are completed in submission order, so
+ * the packet numbers of a key are assigned (TX) and checked (RX) in the
+ * order the frames were submitted.
+ */
+
+#define IEEE80211_CRYPTO_ENCRYPT  0
+#define IEEE80211_CRYPTO_DECRYPT  1
+
+/* Completion callback.  Called with the network locked; 'iob' is the
+ * processed frame or NULL if it was dropped.
+ */
+
+typedef void (*ieee80211_crypto_done_t)(FAR struct ieee80211_s *ic,
+                                        FAR struct iob_s *iob,
+                                        FAR void *arg);
+
+struct ieee80211_crypto_req
+  {
+    sq_entry_t cr_link;             /* Link in cq_free or cq_inflight */
+    FAR struct iob_s *cr_iob;       /* Frame in, result out */
+    FAR struct ieee80211_key *cr_key;
+    ieee80211_crypto_done_t cr_done;
+    FAR void *cr_arg;
+    uint8_t cr_op;                  /* IEEE80211_CRYPTO_ENCRYPT/DECRYPT */
+    uint8_t cr_state;               /* See IEEE80211_CRYPTO_REQ_* */
+  };
+
+#define IEEE80211_CRYPTO_REQ_QUEUED 0  /* Waiting for the software worker */
+#define IEEE80211_CRYPTO_REQ_BUSY   1  /* Owned by the worker or hardware */
+#define IEEE80211_CRYPTO_REQ_DONE   2  /* Result ready to be delivered */
+
+struct ieee80211_cryptoq_s
+  {
+    sq_queue_t cq_free;             /* Unused requests */
+    sq_queue_t cq_inflight;         /* Outstanding requests, in order */
+    struct work_s cq_work;          /* Software worker */
+    sem_t cq_exclsem;               /* Held while software ciphers run */
+    sem_t cq_waitsem;               /* Posted when the hardware completes */
+    uint8_t cq_nwaiters;            /* Threads waiting on cq_waitsem */
+    uint16_t cq_nqueued;            /* Requests waiting for the worker */
+    uint32_t cq_submitted;          /* Requests accepted */
+    uint32_t cq_offloaded;          /* Requests taken by the hardware hook */
+    uint32_t cq_batches;            /* Worker runs */
+    uint32_t cq_busy;               /* Submissions refused (no request) */
+    struct ieee80211_crypto_req cq_reqs[CONFIG_IEEE80211_CRYPTO_NREQS];
+  };
+#endif
+
+#ifdef CONFIG_IEEE80211_PBKDF2
+/* Passphrase to PSK derivation.  4096 iterations of PBKDF2-HMAC-SHA1 take
+ * long enough on a small CPU that they are run on the low priority work
+ * queue.  The completion callback is called with the network locked;
+ * 'result' is OK once ic_psk holds the new PSK.
+ */
+
+typedef void (*ieee80211_psk_done_t)(FAR struct ieee80211_s *ic,
+                                     int result, FAR void *arg);
+
+struct ieee80211_pskreq_s
+  {
+    struct work_s pr_work;          /* Derivation worker */
+    ieee80211_psk_done_t pr_done;   /* Completion callback or NULL */
+    FAR void *pr_arg;
+    uint16_t pr_gen;                /* Bumped whenever the inputs change */
+    bool pr_busy;                   /* Worker queued or running */
+    uint8_t pr_passlen;             /* Zero if no passphrase is set */
+    char pr_pass[IEEE80211_PASSPHRASE_MAXLEN];
+    uint32_t pr_derived;            /* PSKs computed */
+    uint32_t pr_cachehits;          /* PSKs found in the PMK cache */
+  };
+#endif
 
 void ieee80211_crypto_attach(struct ieee80211_s *);
 void ieee80211_crypto_detach(struct ieee80211_s *);
@@ -123,11 +265,43 @@ struct ieee80211_key *ieee80211_get_txkey(struct ieee80211_s *,
                                           struct ieee80211_node *);
 struct ieee80211_key *ieee80211_get_rxkey(struct ieee80211_s *, struct iob_s *,
                                           struct ieee80211_node *);
+FAR struct iob_s *ieee80211_cipher_encrypt(FAR struct ieee80211_s *,
+                                           FAR struct iob_s *,
+                                           FAR struct ieee80211_key *);
+FAR struct iob_s *ieee80211_cipher_decrypt(FAR struct ieee80211_s *,
+                                           FAR struct iob_s *,
+                                           FAR struct ieee80211_key *);
 struct iob_s *ieee80211_encrypt(struct ieee80211_s *, struct iob_s *,
                                 struct ieee80211_key *);
 struct iob_s *ieee80211_decrypt(struct ieee80211_s *, struct iob_s *,
                                 struct ieee80211_node *);
 
+FAR struct iob_s *ieee80211_crypto_hdrgap(FAR struct ieee80211_s *,
+                                          FAR struct iob_s *, unsigned int,
+                                          unsigned int);
+FAR uint8_t *ieee80211_crypto_tailroom(FAR struct ieee80211_s *,
+                                       FAR struct iob_s *, unsigned int);
+int ieee80211_crypto_strip(FAR struct iob_s *, unsigned int, unsigned int,
+                           unsigned int);
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+void ieee80211_cryptoq_initialize(FAR struct ieee80211_s *);
+void ieee80211_cryptoq_uninitialize(FAR struct ieee80211_s *);
+int ieee80211_crypto_submit(FAR struct ieee80211_s *, FAR struct iob_s *,
+                            FAR struct ieee80211_key *, uint8_t,
+                            ieee80211_crypto_done_t, FAR void *);
+void ieee80211_crypto_complete(FAR struct ieee80211_s *,
+                               FAR struct ieee80211_crypto_req *,
+                               FAR struct iob_s *);
+void ieee80211_cryptoq_flushkey(FAR struct ieee80211_s *,
+                                FAR struct ieee80211_key *);
+void ieee80211_crypto_lock(FAR struct ieee80211_s *);
+void ieee80211_crypto_unlock(FAR struct ieee80211_s *);
+#else
+#  define ieee80211_crypto_lock(ic)
+#  define ieee80211_crypto_unlock(ic)
+#endif
+
 int ieee80211_set_key(struct ieee80211_s *, struct ieee80211_node *,
                       struct ieee80211_key *);
 void ieee80211_delete_key(struct ieee80211_s *, struct ieee80211_node *,
@@ -142,23 +316,39 @@ void ieee80211_eapol_key_encrypt(struct ieee80211_s *,
 #endif
 int ieee80211_eapol_key_decrypt(struct ieee80211_eapol_key *, const uint8_t *);
 
+void ieee80211_pmksa_initialize(FAR struct ieee80211_s *);
+void ieee80211_pmksa_flush(FAR struct ieee80211_s *);
 struct ieee80211_pmk *ieee80211_pmksa_add(struct ieee80211_s *,
                                           enum ieee80211_akm, const uint8_t *,
                                           const uint8_t *, uint32_t);
 struct ieee80211_pmk *ieee80211_pmksa_find(struct ieee80211_s *,
                                            struct ieee80211_node *,
                                            const uint8_t *);
+FAR struct ieee80211_pmk *ieee80211_pmksa_match(FAR struct ieee80211_s *,
+                                                FAR struct ieee80211_node *,
+                                                FAR const uint8_t *, int);
+void ieee80211_derive_pmkid(enum ieee80211_akm, const uint8_t *,
+                            const uint8_t *, const uint8_t *, uint8_t *);
 void ieee80211_derive_ptk(enum ieee80211_akm, const uint8_t *, const uint8_t *,
                           const uint8_t *, const uint8_t *, const uint8_t *,
                           struct ieee80211_ptk *);
 int ieee80211_cipher_keylen(enum ieee80211_cipher);
 
+#ifdef CONFIG_IEEE80211_PBKDF2
+int ieee80211_set_passphrase(FAR struct ieee80211_s *, FAR const char *,
+                             size_t, ieee80211_psk_done_t, FAR void *);
+int ieee80211_psk_update(FAR struct ieee80211_s *);
+void ieee80211_psk_discard(FAR struct ieee80211_s *);
+#endif
+
 int ieee80211_wep_set_key(struct ieee80211_s *, struct ieee80211_key *);
 void ieee80211_wep_delete_key(struct ieee80211_s *, struct ieee80211_key *);
 struct iob_s *ieee80211_wep_encrypt(struct ieee80211_s *, struct iob_s *,
                                     struct ieee80211_key *);
 struct iob_s *ieee80211_wep_decrypt(struct ieee80211_s *, struct iob_s *,
                                     struct ieee80211_key *);
+uint32_t ieee80211_wep_crypt(FAR struct rc4_ctx *, FAR struct iob_s *,
+                             unsigned int, unsigned int, uint32_t, bool);
 
 int ieee80211_tkip_set_key(struct ieee80211_s *, struct ieee80211_key *);
 void ieee80211_tkip_delete_key(struct ieee80211_s *, struct ieee80211_key *);
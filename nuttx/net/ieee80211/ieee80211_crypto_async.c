@@ -0,0 +1,471 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_crypto_async.c
+ * Asynchronous 802.11 crypto engine
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <string.h>
+#include <queue.h>
+#include <semaphore.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/wqueue.h>
+#include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_crypto.h"
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* The software ciphers run on the low priority work queue so that they do
+ * not hold off the network driver work on the high priority queue.
+ */
+
+#define CRYPTO_WORK LPWORK
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void ieee80211_crypto_worker(FAR void *arg);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_crypto_deliver
+ *
+ * Description:
+ *   Hand completed requests to their callbacks.  Delivery stops at the
+ *   first request that is still outstanding so that callbacks always run
+ *   in submission order.  Threads waiting in ieee80211_cryptoq_flushkey()
+ *   are woken up to check their key again.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_crypto_deliver(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+  FAR struct ieee80211_crypto_req *req;
+  ieee80211_crypto_done_t done;
+  FAR struct iob_s *iob;
+  FAR void *arg;
+
+  while ((req = (FAR struct ieee80211_crypto_req *)
+                sq_peek(&cq->cq_inflight)) != NULL &&
+         req->cr_state == IEEE80211_CRYPTO_REQ_DONE)
+    {
+      (void)sq_remfirst(&cq->cq_inflight);
+
+      done = req->cr_done;
+      arg  = req->cr_arg;
+      iob  = req->cr_iob;
+
+      /* Recycle the request first; the callback may submit another */
+
+      req->cr_iob = NULL;
+      req->cr_key = NULL;
+      sq_addlast(&req->cr_link, &cq->cq_free);
+
+      done(ic, iob, arg);
+    }
+
+  while (cq->cq_nwaiters > 0)
+    {
+      cq->cq_nwaiters--;
+      sem_post(&cq->cq_waitsem);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_crypto_schedule
+ *
+ * Description:
+ *   Start the software worker if there is queued work and it is idle.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_crypto_schedule(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+  int ret;
+
+  if (cq->cq_nqueued > 0 && work_available(&cq->cq_work))
+    {
+      ret = work_queue(CRYPTO_WORK, &cq->cq_work, ieee80211_crypto_worker,
+                       ic, 0);
+      DEBUGASSERT(ret == OK);
+      UNUSED(ret);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_crypto_worker
+ *
+ * Description:
+ *   Software backend.  Claims up to CONFIG_IEEE80211_CRYPTO_BATCH queued
+ *   requests, runs the ciphers on them with the network unlocked and then
+ *   delivers the results.  Requests are claimed in submission order and
+ *   there is only one worker, so the per-key packet number is advanced in
+ *   that same order.
+ *
+ ****************************************************************************/
+
+static void ieee80211_crypto_worker(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+  FAR struct ieee80211_crypto_req *batch[CONFIG_IEEE80211_CRYPTO_BATCH];
+  FAR struct ieee80211_crypto_req *req;
+  uip_lock_t lock;
+  int nbatch = 0;
+  int i;
+
+  lock = uip_lock();
+
+  for (req = (FAR struct ieee80211_crypto_req *)sq_peek(&cq->cq_inflight);
+       req != NULL && nbatch < CONFIG_IEEE80211_CRYPTO_BATCH;
+       req = (FAR struct ieee80211_crypto_req *)sq_next(&req->cr_link))
+    {
+      if (req->cr_state == IEEE80211_CRYPTO_REQ_QUEUED)
+        {
+          req->cr_state = IEEE80211_CRYPTO_REQ_BUSY;
+          batch[nbatch++] = req;
+        }
+    }
+
+  cq->cq_nqueued -= nbatch;
+  cq->cq_batches++;
+
+  /* Take the crypto lock before letting go of the network so that a key
+   * cannot be deleted under the batch (see ieee80211_cryptoq_flushkey()).
+   */
+
+  ieee80211_crypto_lock(ic);
+  uip_unlock(lock);
+
+  for (i = 0; i < nbatch; i++)
+    {
+      req = batch[i];
+      if (req->cr_op == IEEE80211_CRYPTO_ENCRYPT)
+        {
+          req->cr_iob = ieee80211_cipher_encrypt(ic, req->cr_iob,
+                                                 req->cr_key);
+        }
+      else
+        {
+          req->cr_iob = ieee80211_cipher_decrypt(ic, req->cr_iob,
+                                                 req->cr_key);
+        }
+
+      req->cr_state = IEEE80211_CRYPTO_REQ_DONE;
+    }
+
+  ieee80211_crypto_unlock(ic);
+
+  lock = uip_lock();
+  ieee80211_crypto_deliver(ic);
+  ieee80211_crypto_schedule(ic);
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_cryptoq_initialize
+ *
+ * Description:
+ *   Initialize the asynchronous crypto engine.  Called from
+ *   ieee80211_crypto_attach().
+ *
+ ****************************************************************************/
+
+void ieee80211_cryptoq_initialize(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+  int i;
+
+  memset(cq, 0, sizeof(struct ieee80211_cryptoq_s));
+  sq_init(&cq->cq_free);
+  sq_init(&cq->cq_inflight);
+  sem_init(&cq->cq_exclsem, 0, 1);
+  sem_init(&cq->cq_waitsem, 0, 0);
+
+  for (i = 0; i < CONFIG_IEEE80211_CRYPTO_NREQS; i++)
+    {
+      sq_addlast(&cq->cq_reqs[i].cr_link, &cq->cq_free);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_cryptoq_uninitialize
+ *
+ * Description:
+ *   Stop the software worker and fail all requests that it has not yet
+ *   claimed.  Requests owned by the hardware must have been completed by
+ *   the driver before this is called.
+ *
+ ****************************************************************************/
+
+void ieee80211_cryptoq_uninitialize(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+
+  (void)work_cancel(CRYPTO_WORK, &cq->cq_work);
+  ieee80211_cryptoq_flushkey(ic, NULL);
+
+  DEBUGASSERT(sq_empty(&cq->cq_inflight));
+  sem_destroy(&cq->cq_exclsem);
+  sem_destroy(&cq->cq_waitsem);
+}
+
+/****************************************************************************
+ * Name: ieee80211_crypto_submit
+ *
+ * Description:
+ *   Queue one frame for encryption or decryption with key 'k'.  The frame
+ *   is first offered to the driver's ic_crypto_offload hook, if any; if
+ *   the driver declines it is queued for the software worker.  'done' is
+ *   called with the result once this and all earlier requests are
+ *   complete.
+ *
+ * Returned Value:
+ *   OK if the frame was accepted; ownership of 'iob' passes to the engine.
+ *   -EBUSY if no request is available; the caller still owns 'iob'.  It
+ *   must not process the frame synchronously with the same key, since
+ *   that would overtake the requests still in flight.
+ *
+ ****************************************************************************/
+
+int ieee80211_crypto_submit(FAR struct ieee80211_s *ic,
+                            FAR struct iob_s *iob,
+                            FAR struct ieee80211_key *k, uint8_t op,
+                            ieee80211_crypto_done_t done, FAR void *arg)
+{
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+  FAR struct ieee80211_crypto_req *req;
+  uip_lock_t lock;
+
+  DEBUGASSERT(iob != NULL && k != NULL && done != NULL);
+
+  lock = uip_lock();
+
+  req = (FAR struct ieee80211_crypto_req *)sq_remfirst(&cq->cq_free);
+  if (req == NULL)
+    {
+      cq->cq_busy++;
+      uip_unlock(lock);
+      return -EBUSY;
+    }
+
+  req->cr_iob  = iob;
+  req->cr_key  = k;
+  req->cr_done = done;
+  req->cr_arg  = arg;
+  req->cr_op   = op;
+  sq_addlast(&req->cr_link, &cq->cq_inflight);
+  cq->cq_submitted++;
+
+  /* Offer the request to the hardware.  It is marked busy first because
+   * the driver may complete it before the hook returns.
+   */
+
+  req->cr_state = IEEE80211_CRYPTO_REQ_BUSY;
+  if (ic->ic_crypto_offload != NULL && ic->ic_crypto_offload(ic, req) == OK)
+    {
+      cq->cq_offloaded++;
+    }
+  else
+    {
+      req->cr_state = IEEE80211_CRYPTO_REQ_QUEUED;
+      cq->cq_nqueued++;
+      ieee80211_crypto_schedule(ic);
+    }
+
+  uip_unlock(lock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_crypto_complete
+ *
+ * Description:
+ *   Called by a driver when the hardware has finished a request accepted
+ *   through ic_crypto_offload.  'iob' is the processed frame or NULL if it
+ *   was dropped (for example, on a MIC failure).  Must be called from task
+ *   context.
+ *
+ ****************************************************************************/
+
+void ieee80211_crypto_complete(FAR struct ieee80211_s *ic,
+                               FAR struct ieee80211_crypto_req *req,
+                               FAR struct iob_s *iob)
+{
+  uip_lock_t lock;
+
+  lock = uip_lock();
+
+  DEBUGASSERT(req->cr_state == IEEE80211_CRYPTO_REQ_BUSY);
+  req->cr_iob   = iob;
+  req->cr_state = IEEE80211_CRYPTO_REQ_DONE;
+  ieee80211_crypto_deliver(ic);
+
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: ieee80211_cryptoq_flushkey
+ *
+ * Description:
+ *   Fail every queued request that uses key 'k' (all keys if 'k' is NULL)
+ *   and wait until neither the software worker nor the hardware uses the
+ *   key.  Called before the key's cipher context is released.
+ *
+ * Assumptions:
+ *   Called from task context.  The driver must eventually complete every
+ *   request that it accepted through ic_crypto_offload.
+ *
+ ****************************************************************************/
+
+void ieee80211_cryptoq_flushkey(FAR struct ieee80211_s *ic,
+                                FAR struct ieee80211_key *k)
+{
+  FAR struct ieee80211_cryptoq_s *cq = &ic->ic_cryptoq;
+  FAR struct ieee80211_crypto_req *req;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+
+  for (req = (FAR struct ieee80211_crypto_req *)sq_peek(&cq->cq_inflight);
+       req != NULL;
+       req = (FAR struct ieee80211_crypto_req *)sq_next(&req->cr_link))
+    {
+      if (req->cr_state == IEEE80211_CRYPTO_REQ_QUEUED &&
+          (k == NULL || req->cr_key == k))
+        {
+          iob_free_chain(req->cr_iob);
+          req->cr_iob   = NULL;
+          req->cr_state = IEEE80211_CRYPTO_REQ_DONE;
+          cq->cq_nqueued--;
+        }
+    }
+
+  /* A batch already claimed by the worker holds the crypto lock */
+
+  ieee80211_crypto_lock(ic);
+  ieee80211_crypto_unlock(ic);
+
+  ieee80211_crypto_deliver(ic);
+
+  /* Any request of the key that is still busy is owned by the hardware
+   * (or by a worker batch claimed while this thread was waiting).  Wait
+   * for it to complete; the network lock is released while waiting.
+   */
+
+  req = (FAR struct ieee80211_crypto_req *)sq_peek(&cq->cq_inflight);
+  while (req != NULL)
+    {
+      if (req->cr_state == IEEE80211_CRYPTO_REQ_BUSY &&
+          (k == NULL || req->cr_key == k))
+        {
+          cq->cq_nwaiters++;
+          (void)uip_lockedwait(&cq->cq_waitsem);
+
+          /* The list may have changed, start over */
+
+          req = (FAR struct ieee80211_crypto_req *)sq_peek(&cq->cq_inflight);
+          continue;
+        }
+
+      req = (FAR struct ieee80211_crypto_req *)sq_next(&req->cr_link);
+    }
+
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: ieee80211_crypto_lock
+ *
+ * Description:
+ *   Serialize use of the software cipher contexts and packet numbers
+ *   between the worker and the synchronous ieee80211_encrypt() and
+ *   ieee80211_decrypt() paths.  When both are needed, the network lock is
+ *   always taken first.
+ *
+ ****************************************************************************/
+
+void ieee80211_crypto_lock(FAR struct ieee80211_s *ic)
+{
+  while (sem_wait(&ic->ic_cryptoq.cq_exclsem) != 0)
+    {
+      /* The only case that an error should occur here is if the wait was
+       * awakened by a signal.
+       */
+
+      DEBUGASSERT(get_errno() == EINTR);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_crypto_unlock
+ ****************************************************************************/
+
+void ieee80211_crypto_unlock(FAR struct ieee80211_s *ic)
+{
+  sem_post(&ic->ic_cryptoq.cq_exclsem);
+}
+
+#endif /* CONFIG_IEEE80211_CRYPTO_ASYNC */
@@ -197,6 +197,7 @@ struct iob_s *ieee80211_bip_decap(struct ieee80211_s *ic, struct iob_s *iob0,
     {
       /* Replayed frame, discard */
 
+      ic->ic_crypto_stats.cs_replays++;
       iob_free_chain(iob0);
       return NULL;
     }
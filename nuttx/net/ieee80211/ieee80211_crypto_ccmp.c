@@ -44,6 +44,15 @@
 #include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
 #include "ieee80211/ieee80211_crypto.h"
+#include "ieee80211/ieee80211_rijndael.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Number of CTR key stream blocks generated per call into the cipher */
+
+#define CCMP_CTR_NBLOCKS  4
 
 /* CCMP software crypto context */
 
@@ -85,7 +94,7 @@ void ieee80211_ccmp_delete_key(struct ieee80211_s *ic, struct ieee80211_key *k)
  * CCMP uses the following CCM parameters: M = 8, L = 2
  */
 
-static void ieee80211_ccmp_phase1(rijndael_ctx * ctx,
+static void ieee80211_ccmp_phase1(FAR const rijndael_ctx *ctx,
                                   const struct ieee80211_frame *wh, uint64_t pn,
                                   int lm, uint8_t b[16], uint8_t a[16],
                                   uint8_t s0[16])
@@ -169,219 +178,257 @@ static void ieee80211_ccmp_phase1(rijndael_ctx * ctx,
   rijndael_encrypt(ctx, a, s0);
 }
 
-struct iob_s *ieee80211_ccmp_encrypt(struct ieee80211_s *ic, struct iob_s *iob0,
-                                     struct ieee80211_key *k)
+/* Fold 'len' bytes of the I/O buffer chain starting at 'offset' into the
+ * CBC-MAC 'b'.  Whole blocks that are contiguous in one I/O buffer are
+ * processed 16 bytes at a time; blocks split across buffers are gathered
+ * byte by byte.  A trailing partial block is implicitly zero padded.
+ */
+
+static void ieee80211_ccmp_cbcmac(FAR const rijndael_ctx *ctx, FAR uint8_t *b,
+                                  FAR struct iob_s *iob, unsigned int offset,
+                                  unsigned int len)
 {
-  struct ieee80211_ccmp_ctx *ctx = k->k_priv;
-  const struct ieee80211_frame *wh;
-  const uint8_t *src;
-  uint8_t *ivp, *mic, *dst;
-  uint8_t a[16], b[16], s0[16], s[16];
-  struct iob_s *next0, *iob, *next;
-  int hdrlen, left, moff, noff, len;
-  uint16_t ctr;
-  int i, j;
-
-  next0 = iob_alloc(false);
-  if (next0 == NULL)
-    {
-      goto nospace;
-    }
+  FAR const uint8_t *src;
+  unsigned int avail;
+  unsigned int j = 0;
+  int i;
 
-  if (iob_clone(next0, iob0) < 0)
+  while (offset >= iob->io_len)
     {
-      goto nospace;
+      offset -= iob->io_len;
+      iob     = iob->io_flink;
     }
 
-  next0->io_pktlen += IEEE80211_CCMP_HDRLEN;
-  next0->io_len = CONFIG_IEEE80211_BUFSIZE;
-
-  if (next0->io_len > next0->io_pktlen)
+  while (iob != NULL && len > 0)
     {
-      next0->io_len = next0->io_pktlen;
-    }
+      src    = IOB_DATA(iob) + offset;
+      avail  = MIN(iob->io_len - offset, len);
+      len   -= avail;
 
-  /* Copy 802.11 header */
-
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob0);
-  hdrlen = ieee80211_get_hdrlen(wh);
-  memcpy(IOB_DATA(next0), wh, hdrlen);
+      while (avail > 0)
+        {
+          if (j == 0 && avail >= AES_BLOCK_SIZE)
+            {
+              for (i = 0; i < AES_BLOCK_SIZE; i++)
+                {
+                  b[i] ^= src[i];
+                }
+
+              rijndael_encrypt(ctx, b, b);
+              src   += AES_BLOCK_SIZE;
+              avail -= AES_BLOCK_SIZE;
+              continue;
+            }
 
-  k->k_tsc++;                   /* increment the 48-bit PN */
+          b[j] ^= *src++;
+          avail--;
 
-  /* construct CCMP header */
+          if (++j == AES_BLOCK_SIZE)
+            {
+              rijndael_encrypt(ctx, b, b);
+              j = 0;
+            }
+        }
 
-  ivp = (FAR uint8_t *) IOB_DATA(next0) + hdrlen;
-  ivp[0] = k->k_tsc;            /* PN0 */
-  ivp[1] = k->k_tsc >> 8;       /* PN1 */
-  ivp[2] = 0;                   /* Rsvd */
-  ivp[3] = k->k_id << 6 | IEEE80211_WEP_EXTIV;  /* KeyID | ExtIV */
-  ivp[4] = k->k_tsc >> 16;      /* PN2 */
-  ivp[5] = k->k_tsc >> 24;      /* PN3 */
-  ivp[6] = k->k_tsc >> 32;      /* PN4 */
-  ivp[7] = k->k_tsc >> 40;      /* PN5 */
+      iob    = iob->io_flink;
+      offset = 0;
+    }
 
-  /* construct initial B, A and S_0 blocks */
-  ieee80211_ccmp_phase1(&ctx->rijndael, wh, k->k_tsc,
-                        iob0->io_pktlen - hdrlen, b, a, s0);
-
-  /* construct S_1 */
-  ctr = 1;
-  a[14] = ctr >> 8;
-  a[15] = ctr & 0xff;
-  rijndael_encrypt(&ctx->rijndael, a, s);
-
-  /* encrypt frame body and compute MIC */
-  j = 0;
-  iob = iob0;
-  next = next0;
-  moff = hdrlen;
-  noff = hdrlen + IEEE80211_CCMP_HDRLEN;
-  left = iob0->io_pktlen - moff;
-  while (left > 0)
+  if (j != 0)
     {
-      if (moff == iob->io_len)
-        {
-          /* Nothing left to copy from iob */
+      rijndael_encrypt(ctx, b, b);
+    }
+}
 
-          iob = iob->io_flink;
-          moff = 0;
-        }
+/* XOR 'len' bytes of the I/O buffer chain starting at 'offset' with the
+ * CTR key stream starting at counter block 'a'.  The key stream is
+ * produced CCMP_CTR_NBLOCKS blocks at a time.  Encryption and decryption
+ * are the same operation.
+ */
 
-      if (noff == next->io_len)
-        {
-          struct iob_s *newbuf;
+static void ieee80211_ccmp_ctr(FAR const rijndael_ctx *ctx, FAR uint8_t *a,
+                               FAR struct iob_s *iob, unsigned int offset,
+                               unsigned int len)
+{
+  uint8_t ks[CCMP_CTR_NBLOCKS * AES_BLOCK_SIZE];
+  FAR uint8_t *dst;
+  unsigned int kslen = 0;
+  unsigned int kspos = 0;
+  unsigned int nblocks;
+  unsigned int avail;
+  unsigned int n;
+  unsigned int i;
+
+  while (offset >= iob->io_len)
+    {
+      offset -= iob->io_len;
+      iob     = iob->io_flink;
+    }
 
-          /* next is full and there's more data to copy */
+  while (iob != NULL && len > 0)
+    {
+      dst    = IOB_DATA(iob) + offset;
+      avail  = MIN(iob->io_len - offset, len);
 
-          newbuf = iob_alloc(false);
-          if (newbuf == NULL)
+      while (avail > 0)
+        {
+          if (kspos == kslen)
             {
-              goto nospace;
+              nblocks = (len + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+              if (nblocks > CCMP_CTR_NBLOCKS)
+                {
+                  nblocks = CCMP_CTR_NBLOCKS;
+                }
+
+              rijndael_encrypt_ctr(ctx, a, ks, nblocks);
+              kslen = nblocks * AES_BLOCK_SIZE;
+              kspos = 0;
             }
 
-          next->io_flink = newbuf;
-          next = newbuf;
-          next->io_len = 0;
-
-          if (next->io_len > left)
+          n = MIN(avail, kslen - kspos);
+          for (i = 0; i < n; i++)
             {
-              next->io_len = left;
+              dst[i] ^= ks[kspos + i];
             }
 
-          noff = 0;
+          dst   += n;
+          kspos += n;
+          avail -= n;
+          len   -= n;
         }
 
-      len = MIN(iob->io_len - moff, next->io_len - noff);
+      iob    = iob->io_flink;
+      offset = 0;
+    }
+}
 
-      src = (FAR uint8_t *) IOB_DATA(iob) + moff;
-      dst = (FAR uint8_t *) IOB_DATA(next) + noff;
+/* Encrypt the frame in place.  The CCMP header is inserted behind the
+ * 802.11 header, the body is encrypted where it lies and the MIC is
+ * appended to the tailroom of the chain.
+ */
 
-      for (i = 0; i < len; i++)
-        {
-          /* update MIC with clear text */
-          b[j] ^= src[i];
-
-          /* encrypt message */
-          dst[i] = src[i] ^ s[j];
-          if (++j < 16)
-            continue;
-
-          /* we have a full block, encrypt MIC */
-          rijndael_encrypt(&ctx->rijndael, b, b);
-
-          /* construct a new S_ctr block */
-          ctr++;
-          a[14] = ctr >> 8;
-          a[15] = ctr & 0xff;
-          rijndael_encrypt(&ctx->rijndael, a, s);
-          j = 0;
-        }
+struct iob_s *ieee80211_ccmp_encrypt(struct ieee80211_s *ic, struct iob_s *iob0,
+                                     struct ieee80211_key *k)
+{
+  struct ieee80211_ccmp_ctx *ctx = k->k_priv;
+  FAR const struct ieee80211_frame *wh;
+  FAR uint8_t *ivp;
+  FAR uint8_t *mic;
+  uint8_t a[16];
+  uint8_t b[16];
+  uint8_t s0[16];
+  unsigned int hdrlen;
+  unsigned int datalen;
+  int i;
 
-      moff += len;
-      noff += len;
-      left -= len;
-    }
-  if (j != 0)                   /* partial block, encrypt MIC */
-    rijndael_encrypt(&ctx->rijndael, b, b);
+  wh      = (FAR struct ieee80211_frame *)IOB_DATA(iob0);
+  hdrlen  = ieee80211_get_hdrlen(wh);
+  datalen = iob0->io_pktlen - hdrlen;
 
-  /* Reserve trailing space for MIC */
+  /* Make room for the CCMP header and the MIC */
 
-  if (IOB_FREESPACE(next) < IEEE80211_CCMP_MICLEN)
+  iob0 = ieee80211_crypto_hdrgap(ic, iob0, hdrlen, IEEE80211_CCMP_HDRLEN);
+  if (iob0 == NULL)
     {
-      struct iob_s *newbuf;
-
-      newbuf = iob_alloc(false);
-      if (newbuf == NULL)
-        {
-          goto nospace;
-        }
-
-      next->io_flink = newbuf;
-      next = newbuf;
-      next->io_len = 0;
+      return NULL;
     }
 
-  /* Finalize MIC, U := T XOR first-M-bytes( S_0 ) */
-
-  mic = (FAR uint8_t *) IOB_DATA(next) + next->io_len;
-  for (i = 0; i < IEEE80211_CCMP_MICLEN; i++)
+  mic = ieee80211_crypto_tailroom(ic, iob0, IEEE80211_CCMP_MICLEN);
+  if (mic == NULL)
     {
-      mic[i] = b[i] ^ s0[i];
+      iob_free_chain(iob0);
+      return NULL;
     }
 
-  next->io_len += IEEE80211_CCMP_MICLEN;
-  next0->io_pktlen += IEEE80211_CCMP_MICLEN;
+  wh  = (FAR struct ieee80211_frame *)IOB_DATA(iob0);
+  ivp = IOB_DATA(iob0) + hdrlen;
 
-  iob_free_chain(iob0);
-  return next0;
+  k->k_tsc++;                   /* increment the 48-bit PN */
 
-nospace:
-  iob_free_chain(iob0);
-  if (next0 != NULL)
+  /* Construct CCMP header */
+
+  ivp[0] = k->k_tsc;            /* PN0 */
+  ivp[1] = k->k_tsc >> 8;       /* PN1 */
+  ivp[2] = 0;                   /* Rsvd */
+  ivp[3] = k->k_id << 6 | IEEE80211_WEP_EXTIV;  /* KeyID | ExtIV */
+  ivp[4] = k->k_tsc >> 16;      /* PN2 */
+  ivp[5] = k->k_tsc >> 24;      /* PN3 */
+  ivp[6] = k->k_tsc >> 32;      /* PN4 */
+  ivp[7] = k->k_tsc >> 40;      /* PN5 */
+
+  /* Construct initial B, A and S_0 blocks */
+
+  ieee80211_ccmp_phase1(&ctx->rijndael, wh, k->k_tsc, datalen, b, a, s0);
+
+  /* Compute the MIC over the clear text, then encrypt it in place starting
+   * with counter block S_1.
+   */
+
+  ieee80211_ccmp_cbcmac(&ctx->rijndael, b, iob0,
+                        hdrlen + IEEE80211_CCMP_HDRLEN, datalen);
+
+  a[14] = 0;
+  a[15] = 1;
+  ieee80211_ccmp_ctr(&ctx->rijndael, a, iob0,
+                     hdrlen + IEEE80211_CCMP_HDRLEN, datalen);
+
+  /* Finalize MIC, U := T XOR first-M-bytes( S_0 ) */
+
+  for (i = 0; i < IEEE80211_CCMP_MICLEN; i++)
     {
-      iob_free_chain(next0);
+      mic[i] = b[i] ^ s0[i];
     }
 
-  return NULL;
+  return iob0;
 }
 
+/* Decrypt and verify the frame in place, then strip the CCMP header and
+ * the MIC.
+ */
+
 struct iob_s *ieee80211_ccmp_decrypt(struct ieee80211_s *ic, struct iob_s *iob0,
                                      struct ieee80211_key *k)
 {
   struct ieee80211_ccmp_ctx *ctx = k->k_priv;
-  struct ieee80211_frame *wh;
-  uint64_t pn, *prsc;
-  const uint8_t *ivp;
-  const uint8_t *src;
-  uint8_t *dst;
+  FAR struct ieee80211_frame *wh;
+  FAR const uint8_t *ivp;
+  FAR uint64_t *prsc;
+  uint64_t pn;
   uint8_t mic0[IEEE80211_CCMP_MICLEN];
   uint8_t a[16];
   uint8_t b[16];
   uint8_t s0[16];
-  uint8_t s[16];
-  struct iob_s *next0;
-  struct iob_s *iob;
-  struct iob_s *next;
-  int hdrlen;
-  int left;
-  int moff;
-  int noff;
-  int len;
-  uint16_t ctr;
+  unsigned int hdrlen;
+  unsigned int datalen;
   int i;
-  int j;
+
+  /* The 802.11 header and the CCMP header must be present and contiguous
+   * in the first I/O buffer before they can be read.
+   */
+
+  if (iob0->io_pktlen < sizeof(struct ieee80211_frame) +
+                        IEEE80211_CCMP_HDRLEN + IEEE80211_CCMP_MICLEN ||
+      (iob0->io_len < sizeof(struct ieee80211_frame) &&
+       iob_contig(iob0, sizeof(struct ieee80211_frame)) < 0))
+    {
+      iob_free_chain(iob0);
+      return NULL;
+    }
 
   wh = (FAR struct ieee80211_frame *)IOB_DATA(iob0);
   hdrlen = ieee80211_get_hdrlen(wh);
-  ivp = (uint8_t *) wh + hdrlen;
 
-  if (iob0->io_pktlen < hdrlen + IEEE80211_CCMP_HDRLEN + IEEE80211_CCMP_MICLEN)
+  if (iob0->io_pktlen < hdrlen + IEEE80211_CCMP_HDRLEN + IEEE80211_CCMP_MICLEN ||
+      (iob0->io_len < hdrlen + IEEE80211_CCMP_HDRLEN &&
+       iob_contig(iob0, hdrlen + IEEE80211_CCMP_HDRLEN) < 0))
     {
       iob_free_chain(iob0);
       return NULL;
     }
 
+  wh  = (FAR struct ieee80211_frame *)IOB_DATA(iob0);
+  ivp = (FAR const uint8_t *)wh + hdrlen;
+
   /* Check that ExtIV bit is set */
 
   if (!(ivp[3] & IEEE80211_WEP_EXTIV))
@@ -416,154 +463,58 @@ struct iob_s *ieee80211_ccmp_decrypt(struct ieee80211_s *ic, struct iob_s *iob0,
     {
       /* Replayed frame, discard */
 
+      ic->ic_crypto_stats.cs_replays++;
       iob_free_chain(iob0);
       return NULL;
     }
 
-  next0 = iob_alloc(false);
-  if (next0 == NULL)
-    {
-      goto nospace;
-    }
-
-  if (iob_clone(next0, iob0) < 0)
-    {
-      goto nospace;
-    }
-
-  next0->io_pktlen -= IEEE80211_CCMP_HDRLEN + IEEE80211_CCMP_MICLEN;
-  next0->io_len = CONFIG_IEEE80211_BUFSIZE;
-  if (next0->io_len > next0->io_pktlen)
-    {
-      next0->io_len = next0->io_pktlen;
-    }
+  datalen = iob0->io_pktlen - hdrlen - IEEE80211_CCMP_HDRLEN -
+            IEEE80211_CCMP_MICLEN;
 
   /* Construct initial B, A and S_0 blocks */
 
-  ieee80211_ccmp_phase1(&ctx->rijndael, wh, pn,
-                        next0->io_pktlen - hdrlen, b, a, s0);
-
-  /* Copy 802.11 header and clear protected bit */
-
-  memcpy(IOB_DATA(next0), wh, hdrlen);
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(next0);
-  wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
-
-  /* construct S_1 */
-  ctr = 1;
-  a[14] = ctr >> 8;
-  a[15] = ctr & 0xff;
-  rijndael_encrypt(&ctx->rijndael, a, s);
-
-  /* decrypt frame body and compute MIC */
-  j = 0;
-  iob = iob0;
-  next = next0;
-  moff = hdrlen + IEEE80211_CCMP_HDRLEN;
-  noff = hdrlen;
-  left = next0->io_pktlen - noff;
-  while (left > 0)
-    {
-      if (moff == iob->io_len)
-        {
-          /* Nothing left to copy from iob */
-
-          iob = iob->io_flink;
-          moff = 0;
-        }
-
-      if (noff == next->io_len)
-        {
-          struct iob_s *newbuf;
-
-          /* next is full and there's more data to copy */
-
-          newbuf = iob_alloc(false);
-          if (newbuf == NULL)
-            {
-              goto nospace;
-            }
-
-          next->io_flink = newbuf;
-          next = newbuf;
-          next->io_len = 0;
-
-          if (next->io_len > left)
-            {
-              next->io_len = left;
-            }
-
-          noff = 0;
-        }
-
-      len = MIN(iob->io_len - moff, next->io_len - noff);
-
-      src = (FAR uint8_t *) IOB_DATA(iob) + moff;
-      dst = (FAR uint8_t *) IOB_DATA(next) + noff;
-
-      for (i = 0; i < len; i++)
-        {
-          /* decrypt message */
-
-          dst[i] = src[i] ^ s[j];
-
-          /* update MIC with clear text */
+  ieee80211_ccmp_phase1(&ctx->rijndael, wh, pn, datalen, b, a, s0);
 
-          b[j] ^= dst[i];
-          if (++j < 16)
-            continue;
-          /* we have a full block, encrypt MIC */
+  /* Decrypt the frame body in place starting with counter block S_1, then
+   * compute the MIC over the recovered clear text.
+   */
 
-          rijndael_encrypt(&ctx->rijndael, b, b);
-
-          /* construct a new S_ctr block */
-
-          ctr++;
-          a[14] = ctr >> 8;
-          a[15] = ctr & 0xff;
-          rijndael_encrypt(&ctx->rijndael, a, s);
-          j = 0;
-        }
-
-      moff += len;
-      noff += len;
-      left -= len;
-    }
-
-  if (j != 0)
-    {
-      /* Partial block, encrypt MIC */
-
-      rijndael_encrypt(&ctx->rijndael, b, b);
-    }
+  a[14] = 0;
+  a[15] = 1;
+  ieee80211_ccmp_ctr(&ctx->rijndael, a, iob0,
+                     hdrlen + IEEE80211_CCMP_HDRLEN, datalen);
+  ieee80211_ccmp_cbcmac(&ctx->rijndael, b, iob0,
+                        hdrlen + IEEE80211_CCMP_HDRLEN, datalen);
 
   /* Finalize MIC, U := T XOR first-M-bytes( S_0 ) */
 
   for (i = 0; i < IEEE80211_CCMP_MICLEN; i++)
-    b[i] ^= s0[i];
+    {
+      b[i] ^= s0[i];
+    }
 
   /* Check that it matches the MIC in received frame */
 
-  iob_copyout(mic0, iob, moff, IEEE80211_CCMP_MICLEN);
+  iob_copyout(mic0, iob0, IEEE80211_CCMP_MICLEN,
+              iob0->io_pktlen - IEEE80211_CCMP_MICLEN);
   if (memcmp(mic0, b, IEEE80211_CCMP_MICLEN) != 0)
     {
       iob_free_chain(iob0);
-      iob_free_chain(next0);
       return NULL;
     }
 
-  /* update last seen packet number (MIC is validated) */
-  *prsc = pn;
-
-  iob_free_chain(iob0);
-  return next0;
+  /* Clear protected bit and strip the CCMP header and MIC */
 
-nospace:
-  iob_free_chain(iob0);
-  if (next0 != NULL)
+  wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
+  if (ieee80211_crypto_strip(iob0, hdrlen, IEEE80211_CCMP_HDRLEN,
+                             IEEE80211_CCMP_MICLEN) < 0)
     {
-      iob_free_chain(next0);
+      iob_free_chain(iob0);
+      return NULL;
     }
 
-  return NULL;
+  /* update last seen packet number (MIC is validated) */
+
+  *prsc = pn;
+  return iob0;
 }
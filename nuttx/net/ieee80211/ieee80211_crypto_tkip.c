@@ -133,22 +133,20 @@ struct ieee80211_tkip_frame
     uint8_t i_pad[3];
   } packed_struct;
 
-/* Compute TKIP MIC over an buffer chain starting "off" bytes from the
- * beginning.  This function should be kept independent from the software
- * TKIP crypto code so that drivers doing hardware crypto but not MIC can
- * call it without a software crypto context.
+/* Compute TKIP MIC over "len" bytes of a buffer chain starting "off"
+ * bytes from the beginning.  The 802.11 header is assumed to be contiguous
+ * in the first buffer.
  */
 
-void
-ieee80211_tkip_mic(struct iob_s *m0, int off, const uint8_t * key,
-                   uint8_t mic[IEEE80211_TKIP_MICLEN])
+static void ieee80211_tkip_mic_range(struct iob_s *m0, unsigned int off,
+                                     unsigned int len, const uint8_t * key,
+                                     uint8_t mic[IEEE80211_TKIP_MICLEN])
 {
   const struct ieee80211_frame *wh;
   struct ieee80211_tkip_frame wht;
   MICHAEL_CTX ctx;              /* small enough */
   struct iob_s *iob;
-  void *pos;
-  int len;
+  unsigned int n;
 
   /* Assumes 802.11 header is contiguous */
 
@@ -187,33 +185,46 @@ ieee80211_tkip_mic(struct iob_s *m0, int off, const uint8_t * key,
 
   michael_update(&ctx, (void *)&wht, sizeof(wht));
 
-  iob = m0;
-
-  /* Assumes the first "off" bytes are contiguous */
+  for (iob = m0; iob != NULL && off >= iob->io_len; iob = iob->io_flink)
+    {
+      off -= iob->io_len;
+    }
 
-  pos = (FAR void *)IOB_DATA(iob) + off;
-  len = iob->io_len - off;
-  for (;;)
+  for (; iob != NULL && len > 0; iob = iob->io_flink)
     {
-      michael_update(&ctx, pos, len);
-      if ((iob = iob->io_flink) == NULL)
-        {
-          break;
-        }
-
-      pos = (FAR void *)IOB_DATA(iob);
-      len = iob->io_len;
+      n = MIN(iob->io_len - off, len);
+      michael_update(&ctx, IOB_DATA(iob) + off, n);
+      len -= n;
+      off  = 0;
     }
 
   michael_final(mic, &ctx);
 }
 
+/* Compute TKIP MIC over an buffer chain starting "off" bytes from the
+ * beginning.  This function should be kept independent from the software
+ * TKIP crypto code so that drivers doing hardware crypto but not MIC can
+ * call it without a software crypto context.
+ */
+
+void
+ieee80211_tkip_mic(struct iob_s *m0, int off, const uint8_t * key,
+                   uint8_t mic[IEEE80211_TKIP_MICLEN])
+{
+  ieee80211_tkip_mic_range(m0, off, m0->io_pktlen - off, key, mic);
+}
+
 /* shortcuts */
 #define IEEE80211_TKIP_TAILLEN    \
     (IEEE80211_TKIP_MICLEN + IEEE80211_WEP_CRCLEN)
 #define IEEE80211_TKIP_OVHD    \
     (IEEE80211_TKIP_HDRLEN + IEEE80211_TKIP_TAILLEN)
 
+/* Encrypt the frame in place: the TKIP header is inserted behind the
+ * 802.11 header, the body is encrypted where it lies and the MIC and ICV
+ * are appended to the tailroom of the chain.
+ */
+
 struct iob_s *ieee80211_tkip_encrypt(struct ieee80211_s *ic, struct iob_s *m0,
                                      struct ieee80211_key *k)
 {
@@ -221,39 +232,41 @@ struct iob_s *ieee80211_tkip_encrypt(struct ieee80211_s *ic, struct iob_s *m0,
   uint16_t wepseed[8];          /* needs to be 16-bit aligned for Phase2 */
   const struct ieee80211_frame *wh;
   uint8_t *ivp, *mic, *icvp;
-  struct iob_s *next0, *iob, *next;
   uint32_t crc;
-  int left, moff, noff, len, hdrlen;
+  int datalen, hdrlen;
 
-  next0 = iob_alloc(false);
-  if (next0 == NULL)
-    {
-      goto nospace;
-    }
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
+  hdrlen = ieee80211_get_hdrlen(wh);
+  datalen = m0->io_pktlen - hdrlen;
+
+  /* Make room for the TKIP header, the TKIP MIC and the WEP ICV */
 
-  if (iob_clone(next0, m0) < 0)
+  m0 = ieee80211_crypto_hdrgap(ic, m0, hdrlen, IEEE80211_TKIP_HDRLEN);
+  if (m0 == NULL)
     {
-      goto nospace;
+      return NULL;
     }
 
-  next0->io_pktlen += IEEE80211_TKIP_HDRLEN;
-  next0->io_len = CONFIG_IEEE80211_BUFSIZE;
-  if (next0->io_len > next0->io_pktlen)
+  mic = ieee80211_crypto_tailroom(ic, m0, IEEE80211_TKIP_TAILLEN);
+  if (mic == NULL)
     {
-      next0->io_len = next0->io_pktlen;
+      iob_free_chain(m0);
+      return NULL;
     }
 
-  /* Copy 802.11 header */
+  icvp = mic + IEEE80211_TKIP_MICLEN;
 
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
-  hdrlen = ieee80211_get_hdrlen(wh);
-  memcpy(IOB_DATA(next0), wh, hdrlen);
+  /* Compute TKIP MIC over clear text */
+
+  ieee80211_tkip_mic_range(m0, hdrlen + IEEE80211_TKIP_HDRLEN, datalen,
+                           ctx->txmic, mic);
 
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
   k->k_tsc++;                   /* increment the 48-bit TSC */
 
   /* Construct TKIP header */
 
-  ivp = (FAR uint8_t *) IOB_DATA(next0) + hdrlen;
+  ivp = (FAR uint8_t *) IOB_DATA(m0) + hdrlen;
   ivp[0] = k->k_tsc >> 8;       /* TSC1 */
 
   /* WEP Seed = (TSC1 | 0x20) & 0x7f (see 8.3.2.2) */
@@ -275,109 +288,29 @@ struct iob_s *ieee80211_tkip_encrypt(struct ieee80211_s *ic, struct iob_s *m0,
   Phase2((uint8_t *) wepseed, k->k_key, ctx->txttak, k->k_tsc & 0xffff);
   rc4_keysetup(&ctx->rc4, (uint8_t *) wepseed, 16);
 
-  /* encrypt frame body and compute WEP ICV */
-
-  iob = m0;
-  next = next0;
-  moff = hdrlen;
-  noff = hdrlen + IEEE80211_TKIP_HDRLEN;
-  left = m0->io_pktlen - moff;
-  crc = ~0;
-  while (left > 0)
-    {
-      if (moff == iob->io_len)
-        {
-          /* Nothing left to copy from iob */
-
-          iob = iob->io_flink;
-          moff = 0;
-        }
-
-      if (noff == next->io_len)
-        {
-          struct iob_s *newbuf;
-
-          /* next is full and there's more data to copy */
-
-          newbuf = iob_alloc(false);
-          if (newbuf == NULL)
-            {
-              goto nospace;
-            }
-
-          next->io_flink = newbuf;
-          next = newbuf;
-          next->io_len = 0;
-
-          if (next->io_len > left)
-            {
-              next->io_len = left;
-            }
-
-          noff = 0;
-        }
-
-      len = MIN(iob->io_len - moff, next->io_len - noff);
-
-      crc = ether_crc32_le_update(crc, IOB_DATA(iob) + moff, len);
-      rc4_crypt(&ctx->rc4, IOB_DATA(iob) + moff, IOB_DATA(next) + noff, len);
-
-      moff += len;
-      noff += len;
-      left -= len;
-    }
-
-  /* Reserve trailing space for TKIP MIC and WEP ICV */
-
-  if (IOB_FREESPACE(next) < IEEE80211_TKIP_TAILLEN)
-    {
-      struct iob_s *newbuf;
-
-      newbuf = iob_alloc(false);
-      if (newbuf == NULL)
-        {
-          goto nospace;
-        }
+  /* encrypt frame body and TKIP MIC and compute WEP ICV */
 
-      next->io_flink = newbuf;
-      next = newbuf;
-      next->io_len = 0;
-    }
-
-  /* Compute TKIP MIC over clear text */
-
-  mic = (FAR void *)IOB_DATA(next) + next->io_len;
-  ieee80211_tkip_mic(m0, hdrlen, ctx->txmic, mic);
+  crc = ieee80211_wep_crypt(&ctx->rc4, m0, hdrlen + IEEE80211_TKIP_HDRLEN,
+                            datalen, ~0, true);
   crc = ether_crc32_le_update(crc, mic, IEEE80211_TKIP_MICLEN);
   rc4_crypt(&ctx->rc4, mic, mic, IEEE80211_TKIP_MICLEN);
-  next->io_len += IEEE80211_TKIP_MICLEN;
 
   /* Finalize WEP ICV */
 
-  icvp = (FAR void *)IOB_DATA(next) + next->io_len;
   crc = ~crc;
   icvp[0] = crc;
   icvp[1] = crc >> 8;
   icvp[2] = crc >> 16;
   icvp[3] = crc >> 24;
   rc4_crypt(&ctx->rc4, icvp, icvp, IEEE80211_WEP_CRCLEN);
-  next->io_len += IEEE80211_WEP_CRCLEN;
-
-  next0->io_pktlen += IEEE80211_TKIP_TAILLEN;
-
-  iob_free_chain(m0);
-  return next0;
-
-nospace:
-  iob_free_chain(m0);
-  if (next0 != NULL)
-    {
-      iob_free_chain(next0);
-    }
 
-  return NULL;
+  return m0;
 }
 
+/* Decrypt and verify the frame in place, then strip the TKIP header, the
+ * TKIP MIC and the WEP ICV.
+ */
+
 struct iob_s *ieee80211_tkip_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
                                      struct ieee80211_key *k)
 {
@@ -390,18 +323,32 @@ struct iob_s *ieee80211_tkip_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
   uint32_t crc, crc0;
   uint8_t *ivp, *mic0;
   uint8_t tid;
-  struct iob_s *next0, *iob, *next;
-  int hdrlen, left, moff, noff, len;
+  int hdrlen, datalen;
+
+  /* The 802.11 header and the TKIP header must be present and contiguous
+   * in the first I/O buffer before they can be read.
+   */
+
+  if (m0->io_pktlen < sizeof(struct ieee80211_frame) + IEEE80211_TKIP_OVHD ||
+      (m0->io_len < sizeof(struct ieee80211_frame) &&
+       iob_contig(m0, sizeof(struct ieee80211_frame)) < 0))
+    {
+      iob_free_chain(m0);
+      return NULL;
+    }
 
   wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
   hdrlen = ieee80211_get_hdrlen(wh);
 
-  if (m0->io_pktlen < hdrlen + IEEE80211_TKIP_OVHD)
+  if (m0->io_pktlen < hdrlen + IEEE80211_TKIP_OVHD ||
+      (m0->io_len < hdrlen + IEEE80211_TKIP_HDRLEN &&
+       iob_contig(m0, hdrlen + IEEE80211_TKIP_HDRLEN) < 0))
     {
       iob_free_chain(m0);
       return NULL;
     }
 
+  wh  = (FAR struct ieee80211_frame *)IOB_DATA(m0);
   ivp = (uint8_t *) wh + hdrlen;
 
   /* check that ExtIV bit is set */
@@ -428,34 +375,12 @@ struct iob_s *ieee80211_tkip_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
     {
       /* Replayed frame, discard */
 
+      ic->ic_crypto_stats.cs_replays++;
       iob_free_chain(m0);
       return NULL;
     }
 
-  next0 = iob_alloc(false);
-  if (next0 == NULL)
-    {
-      goto nospace;
-    }
-
-  if (iob_clone(next0, m0) < 0)
-    {
-      goto nospace;
-    }
-
-  next0->io_pktlen -= IEEE80211_TKIP_OVHD;
-  next0->io_len = CONFIG_IEEE80211_BUFSIZE;
-
-  if (next0->io_len > next0->io_pktlen)
-    {
-      next0->io_len = next0->io_pktlen;
-    }
-
-  /* Copy 802.11 header and clear protected bit */
-
-  memcpy(IOB_DATA(next0), wh, hdrlen);
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(next0);
-  wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
+  datalen = m0->io_pktlen - hdrlen - IEEE80211_TKIP_OVHD;
 
   /* compute WEP seed */
 
@@ -469,59 +394,13 @@ struct iob_s *ieee80211_tkip_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
 
   /* decrypt frame body and compute WEP ICV */
 
-  iob = m0;
-  next = next0;
-  moff = hdrlen + IEEE80211_TKIP_HDRLEN;
-  noff = hdrlen;
-  left = next0->io_pktlen - noff;
-  crc = ~0;
-  while (left > 0)
-    {
-      if (moff == iob->io_len)
-        {
-          /* Nothing left to copy from iob */
-
-          iob = iob->io_flink;
-          moff = 0;
-        }
-
-      if (noff == next->io_len)
-        {
-          struct iob_s *newbuf;
-
-          /* next is full and there's more data to copy */
-
-          newbuf = iob_alloc(false);
-          if (newbuf == NULL)
-            {
-              goto nospace;
-            }
-
-          next->io_flink = newbuf;
-          next = newbuf;
-          next->io_len = 0;
-
-          if (next->io_len > left)
-            {
-              next->io_len = left;
-            }
-
-          noff = 0;
-        }
-
-      len = MIN(iob->io_len - moff, next->io_len - noff);
-
-      rc4_crypt(&ctx->rc4, IOB_DATA(iob) + moff, IOB_DATA(next) + noff, len);
-      crc = ether_crc32_le_update(crc, IOB_DATA(next) + noff, len);
-
-      moff += len;
-      noff += len;
-      left -= len;
-    }
+  crc = ieee80211_wep_crypt(&ctx->rc4, m0, hdrlen + IEEE80211_TKIP_HDRLEN,
+                            datalen, ~0, false);
 
   /* Extract and decrypt TKIP MIC and WEP ICV from m0's tail */
 
-  iob_copyout(buf, iob, moff, IEEE80211_TKIP_TAILLEN);
+  iob_copyout(buf, m0, IEEE80211_TKIP_TAILLEN,
+              m0->io_pktlen - IEEE80211_TKIP_TAILLEN);
   rc4_crypt(&ctx->rc4, buf, buf, IEEE80211_TKIP_TAILLEN);
 
   /* Include TKIP MIC in WEP ICV */
@@ -536,24 +415,33 @@ struct iob_s *ieee80211_tkip_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
   if (crc != letoh32(crc0))
     {
       iob_free_chain(m0);
-      iob_free_chain(next0);
       return NULL;
     }
 
   /* Compute TKIP MIC over decrypted message */
 
-  ieee80211_tkip_mic(next0, hdrlen, ctx->rxmic, mic);
+  ieee80211_tkip_mic_range(m0, hdrlen + IEEE80211_TKIP_HDRLEN, datalen,
+                           ctx->rxmic, mic);
 
   /* Check that it matches the MIC in received frame */
 
   if (memcmp(mic0, mic, IEEE80211_TKIP_MICLEN) != 0)
     {
       iob_free_chain(m0);
-      iob_free_chain(next0);
       ieee80211_michael_mic_failure(ic, tsc);
       return NULL;
     }
 
+  /* Clear protected bit and strip the TKIP header, MIC and ICV */
+
+  wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
+  if (ieee80211_crypto_strip(m0, hdrlen, IEEE80211_TKIP_HDRLEN,
+                             IEEE80211_TKIP_TAILLEN) < 0)
+    {
+      iob_free_chain(m0);
+      return NULL;
+    }
+
   /* update last seen packet number (MIC is validated) */
 
   *prsc = tsc;
@@ -562,17 +450,7 @@ struct iob_s *ieee80211_tkip_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
 
   ctx->rxttak_ok = 1;
 
-  iob_free_chain(m0);
-  return next0;
-
-nospace:
-  iob_free_chain(m0);
-  if (next0 != NULL)
-    {
-      iob_free_chain(next0);
-    }
-
-  return NULL;
+  return m0;
 }
 
 #ifdef CONFIG_IEEE80211_AP
@@ -42,7 +42,7 @@
 #include <nuttx/kmalloc.h>
 #include <nuttx/net/iob.h>
 
-#include "ieee80211/ieee80211_crypto.h"
+#include "ieee80211/ieee80211_var.h"
 #include "ieee80211/ieee80211_crypto.h"
 
 /****************************************************************************
@@ -101,42 +101,83 @@ void ieee80211_wep_delete_key(struct ieee80211_s *ic, struct ieee80211_key *k)
 #define IEEE80211_WEP_HDRLEN    \
     (IEEE80211_WEP_IVLEN + IEEE80211_WEP_KIDLEN)
 
+/* Run the RC4 key stream over 'len' bytes of the I/O buffer chain starting
+ * at 'offset', in place, folding the clear text into the running CRC-32
+ * 'crc'.  When encrypting the clear text is the input; when decrypting it
+ * is the output.  Returns the updated CRC.  Shared with TKIP.
+ */
+
+uint32_t ieee80211_wep_crypt(FAR struct rc4_ctx *rc4, FAR struct iob_s *iob,
+                             unsigned int offset, unsigned int len,
+                             uint32_t crc, bool encrypt)
+{
+  FAR uint8_t *data;
+  unsigned int avail;
+
+  while (iob != NULL && offset >= iob->io_len)
+    {
+      offset -= iob->io_len;
+      iob     = iob->io_flink;
+    }
+
+  while (iob != NULL && len > 0)
+    {
+      data  = IOB_DATA(iob) + offset;
+      avail = MIN(iob->io_len - offset, len);
+
+      if (encrypt)
+        {
+          crc = ether_crc32_le_update(crc, data, avail);
+          rc4_crypt(rc4, data, data, avail);
+        }
+      else
+        {
+          rc4_crypt(rc4, data, data, avail);
+          crc = ether_crc32_le_update(crc, data, avail);
+        }
+
+      len   -= avail;
+      iob    = iob->io_flink;
+      offset = 0;
+    }
+
+  return crc;
+}
+
+/* Encrypt the frame in place: the IV is inserted behind the 802.11 header,
+ * the body is encrypted where it lies and the ICV is appended to the
+ * tailroom of the chain.
+ */
+
 struct iob_s *ieee80211_wep_encrypt(struct ieee80211_s *ic, struct iob_s *m0,
                                     struct ieee80211_key *k)
 {
   struct ieee80211_wep_ctx *ctx = k->k_priv;
   uint8_t wepseed[16];
   const struct ieee80211_frame *wh;
-  struct iob_s *next0, *iob, *next;
   uint8_t *ivp, *icvp;
   uint32_t iv, crc;
-  int left, moff, noff, len, hdrlen;
+  int datalen, hdrlen;
 
-  next0 = iob_alloc(false);
-  if (next0 == NULL)
-    {
-      goto nospace;
-    }
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
+  hdrlen = ieee80211_get_hdrlen(wh);
+  datalen = m0->io_pktlen - hdrlen;
+
+  /* Make room for the IV and the ICV */
 
-  if (iob_clone(next0, m0) < 0)
+  m0 = ieee80211_crypto_hdrgap(ic, m0, hdrlen, IEEE80211_WEP_HDRLEN);
+  if (m0 == NULL)
     {
-      goto nospace;
+      return NULL;
     }
 
-  next0->io_pktlen += IEEE80211_WEP_HDRLEN;
-  next0->io_len = CONFIG_IEEE80211_BUFSIZE;
-
-  if (next0->io_len > next0->io_pktlen)
+  icvp = ieee80211_crypto_tailroom(ic, m0, IEEE80211_WEP_CRCLEN);
+  if (icvp == NULL)
     {
-      next0->io_len = next0->io_pktlen;
+      iob_free_chain(m0);
+      return NULL;
     }
 
-  /* Copy 802.11 header */
-
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
-  hdrlen = ieee80211_get_hdrlen(wh);
-  memcpy(IOB_DATA(next0), wh, hdrlen);
-
   /* Select a new IV for every MPDU */
 
   iv = (ctx->iv != 0) ? ctx->iv : arc4random();
@@ -149,7 +190,7 @@ struct iob_s *ieee80211_wep_encrypt(struct ieee80211_s *ic, struct iob_s *m0,
     }
 
   ctx->iv = iv + 1;
-  ivp = (FAR uint8_t *) IOB_DATA(next0) + hdrlen;
+  ivp = (FAR uint8_t *) IOB_DATA(m0) + hdrlen;
   ivp[0] = iv;
   ivp[1] = iv >> 8;
   ivp[2] = iv >> 16;
@@ -163,98 +204,23 @@ struct iob_s *ieee80211_wep_encrypt(struct ieee80211_s *ic, struct iob_s *m0,
 
   /* encrypt frame body and compute WEP ICV */
 
-  iob = m0;
-  next = next0;
-  moff = hdrlen;
-  noff = hdrlen + IEEE80211_WEP_HDRLEN;
-  left = m0->io_pktlen - moff;
-  crc = ~0;
-  while (left > 0)
-    {
-      if (moff == iob->io_len)
-        {
-          /* Nothing left to copy from iob */
-
-          iob = iob->io_flink;
-          moff = 0;
-        }
-
-      if (noff == next->io_len)
-        {
-          struct iob_s *newbuf;
-
-          /* next is full and there's more data to copy */
-
-          newbuf = iob_alloc(false);
-          if (newbuf == NULL)
-            {
-              goto nospace;
-            }
-
-          next->io_flink = newbuf;
-          next = newbuf;
-          next->io_len = 0;
-
-          if (next->io_len > left)
-            {
-              next->io_len = left;
-            }
-
-          noff = 0;
-        }
-
-      len = MIN(iob->io_len - moff, next->io_len - noff);
-
-      crc = ether_crc32_le_update(crc, IOB_DATA(iob) + moff, len);
-      rc4_crypt(&ctx->rc4, IOB_DATA(iob) + moff, IOB_DATA(next) + noff, len);
-
-      moff += len;
-      noff += len;
-      left -= len;
-    }
-
-  /* reserve trailing space for WEP ICV */
-
-  if (IOB_FREESPACE(next) < IEEE80211_WEP_CRCLEN)
-    {
-      struct iob_s *newbuf;
-
-      newbuf = iob_alloc(false);
-      if (newbuf == NULL)
-        {
-          goto nospace;
-        }
-
-      next->io_flink = newbuf;
-      next = newbuf;
-      next->io_len = 0;
-    }
+  crc = ieee80211_wep_crypt(&ctx->rc4, m0, hdrlen + IEEE80211_WEP_HDRLEN,
+                            datalen, ~0, true);
 
   /* Finalize WEP ICV */
 
-  icvp = (FAR void *)IOB_DATA(next) + next->io_len;
   crc = ~crc;
   icvp[0] = crc;
   icvp[1] = crc >> 8;
   icvp[2] = crc >> 16;
   icvp[3] = crc >> 24;
   rc4_crypt(&ctx->rc4, icvp, icvp, IEEE80211_WEP_CRCLEN);
-  next->io_len += IEEE80211_WEP_CRCLEN;
-  next0->io_pktlen += IEEE80211_WEP_CRCLEN;
 
-  iob_free_chain(m0);
-  return next0;
-
-nospace:
-  iob_free_chain(m0);
-  if (next0 != NULL)
-    {
-      iob_free_chain(next0);
-    }
-
-  return NULL;
+  return m0;
 }
 
+/* Decrypt and verify the frame in place, then strip the IV and the ICV */
+
 struct iob_s *ieee80211_wep_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
                                     struct ieee80211_key *k)
 {
@@ -263,123 +229,67 @@ struct iob_s *ieee80211_wep_decrypt(struct ieee80211_s *ic, struct iob_s *m0,
   uint8_t wepseed[16];
   uint32_t crc, crc0;
   uint8_t *ivp;
-  struct iob_s *next0, *iob, *next;
-  int hdrlen, left, moff, noff, len;
+  int hdrlen, datalen;
+
+  /* The 802.11 header and the IV must be present and contiguous in the
+   * first I/O buffer before they can be read.
+   */
+
+  if (m0->io_pktlen < sizeof(struct ieee80211_frame) + IEEE80211_WEP_TOTLEN ||
+      (m0->io_len < sizeof(struct ieee80211_frame) &&
+       iob_contig(m0, sizeof(struct ieee80211_frame)) < 0))
+    {
+      iob_free_chain(m0);
+      return NULL;
+    }
 
   wh = (FAR struct ieee80211_frame *)IOB_DATA(m0);
   hdrlen = ieee80211_get_hdrlen(wh);
 
-  if (m0->io_pktlen < hdrlen + IEEE80211_WEP_TOTLEN)
+  if (m0->io_pktlen < hdrlen + IEEE80211_WEP_TOTLEN ||
+      (m0->io_len < hdrlen + IEEE80211_WEP_HDRLEN &&
+       iob_contig(m0, hdrlen + IEEE80211_WEP_HDRLEN) < 0))
     {
       iob_free_chain(m0);
       return NULL;
     }
 
+  datalen = m0->io_pktlen - hdrlen - IEEE80211_WEP_TOTLEN;
+
   /* Concatenate IV and WEP Key */
 
+  wh  = (FAR struct ieee80211_frame *)IOB_DATA(m0);
   ivp = (uint8_t *) wh + hdrlen;
   memcpy(wepseed, ivp, IEEE80211_WEP_IVLEN);
   memcpy(wepseed + IEEE80211_WEP_IVLEN, k->k_key, k->k_len);
   rc4_keysetup(&ctx->rc4, wepseed, IEEE80211_WEP_IVLEN + k->k_len);
 
-  next0 = iob_alloc(false);
-  if (next0 == NULL)
-    {
-      goto nospace;
-    }
-
-  if (iob_clone(next0, m0) < 0)
-    {
-      goto nospace;
-    }
-
-  next0->io_pktlen -= IEEE80211_WEP_TOTLEN;
-  next0->io_len = CONFIG_IEEE80211_BUFSIZE;
-
-  if (next0->io_len > next0->io_pktlen)
-    {
-      next0->io_len = next0->io_pktlen;
-    }
-
-  /* Copy 802.11 header and clear protected bit */
-
-  memcpy(IOB_DATA(next0), wh, hdrlen);
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(next0);
-  wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
-
   /* Decrypt frame body and compute WEP ICV */
 
-  iob = m0;
-  next = next0;
-  moff = hdrlen + IEEE80211_WEP_HDRLEN;
-  noff = hdrlen;
-  left = next0->io_pktlen - noff;
-  crc = ~0;
-  while (left > 0)
-    {
-      if (moff == iob->io_len)
-        {
-          /* Nothing left to copy from iob */
-
-          iob = iob->io_flink;
-          moff = 0;
-        }
-
-      if (noff == next->io_len)
-        {
-          struct iob_s *newbuf;
-
-          /* next is full and there's more data to copy */
+  crc = ieee80211_wep_crypt(&ctx->rc4, m0, hdrlen + IEEE80211_WEP_HDRLEN,
+                            datalen, ~0, false);
 
-          newbuf = iob_alloc(false);
-          if (newbuf == NULL)
-            {
-              goto nospace;
-            }
+  /* Decrypt ICV and compare it with calculated ICV */
 
-          next->io_flink = newbuf;
-          next = newbuf;
-          next->io_len = 0;
-
-          if (next->io_len > left)
-            {
-              next->io_len = left;
-            }
-
-          noff = 0;
-        }
-
-      len = MIN(iob->io_len - moff, next->io_len - noff);
-
-      rc4_crypt(&ctx->rc4, IOB_DATA(iob) + moff, IOB_DATA(next) + noff, len);
-      crc = ether_crc32_le_update(crc, IOB_DATA(next) + noff, len);
-
-      moff += len;
-      noff += len;
-      left -= len;
-    }
-
-  /* Cecrypt ICV and compare it with calculated ICV */
-
-  iob_copyout((FAR uint8_t *) & crc0, iob, moff, IEEE80211_WEP_CRCLEN);
+  iob_copyout((FAR uint8_t *) & crc0, m0, IEEE80211_WEP_CRCLEN,
+              m0->io_pktlen - IEEE80211_WEP_CRCLEN);
   rc4_crypt(&ctx->rc4, (void *)&crc0, (void *)&crc0, IEEE80211_WEP_CRCLEN);
   crc = ~crc;
   if (crc != letoh32(crc0))
     {
       iob_free_chain(m0);
-      iob_free_chain(next0);
       return NULL;
     }
 
-  iob_free_chain(m0);
-  return next0;
+  /* Clear protected bit and strip the IV and ICV */
 
-nospace:
-  iob_free_chain(m0);
-  if (next0 != NULL)
+  wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
+  if (ieee80211_crypto_strip(m0, hdrlen, IEEE80211_WEP_HDRLEN,
+                             IEEE80211_WEP_CRCLEN) < 0)
     {
-      iob_free_chain(next0);
+      iob_free_chain(m0);
+      return NULL;
     }
 
-  return NULL;
+  return m0;
 }
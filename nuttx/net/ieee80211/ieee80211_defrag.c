@@ -0,0 +1,419 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_defrag.c
+ * Fragment reassembly table
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/net/iob.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_ifnet.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Receive lifetime of a partially reassembled MSDU (aMaxReceiveLifetime) */
+
+#define DEFRAG_LIFETIME   SEC2TICK(1)
+
+/* Expired MSDUs are freed on the low priority work queue */
+
+#define DEFRAG_WORK       LPWORK
+
+#define DEFRAG_HASHMASK   (IEEE80211_DEFRAG_HASHSIZE - 1)
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void ieee80211_defrag_timeout(FAR void *arg);
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_defrag_hash
+ *
+ * Description:
+ *   Hash the (TA, sequence number, TID) key of a fragmented MSDU.
+ *
+ ****************************************************************************/
+
+static inline unsigned int ieee80211_defrag_hash(FAR const uint8_t *ta,
+                                                 uint16_t seq, uint8_t tid)
+{
+  return ieee80211_mac_hash(ta, (uint32_t)seq << 4 | tid) & DEFRAG_HASHMASK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_defrag_lookup
+ *
+ * Description:
+ *   Find the entry of a fragmented MSDU.
+ *
+ ****************************************************************************/
+
+static FAR struct ieee80211_defrag *
+ieee80211_defrag_lookup(FAR struct ieee80211_s *ic, FAR const uint8_t *ta,
+                        uint16_t seq, uint8_t tid)
+{
+  FAR struct ieee80211_defrag *df;
+
+  df = ic->ic_defrag_hash[ieee80211_defrag_hash(ta, seq, tid)];
+  for (; df != NULL; df = df->df_hnext)
+    {
+      if (df->df_seq == seq && df->df_tid == tid &&
+          IEEE80211_ADDR_EQ(df->df_ta, ta))
+        {
+          break;
+        }
+    }
+
+  return df;
+}
+
+/****************************************************************************
+ * Name: ieee80211_defrag_release
+ *
+ * Description:
+ *   Remove an entry from the table, freeing the fragments it holds unless
+ *   they have been taken (df_m set to NULL).
+ *
+ ****************************************************************************/
+
+static void ieee80211_defrag_release(FAR struct ieee80211_s *ic,
+                                     FAR struct ieee80211_defrag *df)
+{
+  FAR struct ieee80211_defrag **pp;
+
+  pp = &ic->ic_defrag_hash[df->df_hash];
+  while (*pp != df)
+    {
+      pp = &(*pp)->df_hnext;
+    }
+
+  *pp = df->df_hnext;
+  dq_rem(&df->df_age, &ic->ic_defrag_age);
+
+  if (df->df_m != NULL)
+    {
+      iob_free_chain(df->df_m);
+      df->df_m = NULL;
+    }
+
+  DEBUGASSERT(df->df_ni->ni_ndefrag > 0);
+  df->df_ni->ni_ndefrag--;
+  df->df_ni = NULL;
+
+  df->df_hnext = ic->ic_defrag_free;
+  ic->ic_defrag_free = df;
+}
+
+/****************************************************************************
+ * Name: ieee80211_defrag_evict
+ *
+ * Description:
+ *   Make room for a new MSDU from node 'ni' by dropping the oldest one of
+ *   that node if it is at its limit, or else the oldest one of the table
+ *   if the table is full.
+ *
+ ****************************************************************************/
+
+static void ieee80211_defrag_evict(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_defrag *df;
+
+  df = (FAR struct ieee80211_defrag *)ic->ic_defrag_age.head;
+  if (ni->ni_ndefrag >= CONFIG_IEEE80211_DEFRAG_PERNODE)
+    {
+      while (df->df_ni != ni)
+        {
+          df = (FAR struct ieee80211_defrag *)df->df_age.flink;
+        }
+    }
+  else if (ic->ic_defrag_free != NULL)
+    {
+      return;
+    }
+
+  ic->ic_defrag_stats.ds_evictions++;
+  ieee80211_defrag_release(ic, df);
+}
+
+/****************************************************************************
+ * Name: ieee80211_defrag_timeout
+ *
+ * Description:
+ *   Discard the MSDUs that have exceeded their receive lifetime.  Entries
+ *   all have the same lifetime, so the age list is also sorted by expiry
+ *   and a single work item scheduled for its head is enough.  Runs on the
+ *   low priority work queue, as freeing IOBs needs the network lock.
+ *
+ ****************************************************************************/
+
+static void ieee80211_defrag_timeout(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  FAR struct ieee80211_defrag *df;
+  uip_lock_t flags;
+  int32_t remaining;
+
+  flags = uip_lock();
+  while ((df = (FAR struct ieee80211_defrag *)ic->ic_defrag_age.head) != NULL)
+    {
+      remaining = (int32_t)(df->df_expire - clock_systimer());
+      if (remaining > 0)
+        {
+          (void)work_queue(DEFRAG_WORK, &ic->ic_defrag_work,
+                           ieee80211_defrag_timeout, ic, remaining);
+          break;
+        }
+
+      ic->ic_defrag_stats.ds_timeouts++;
+      ieee80211_defrag_release(ic, df);
+    }
+
+  uip_unlock(flags);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_defrag_initialize
+ *
+ * Description:
+ *   Set up the fragment reassembly table of the interface.
+ *
+ ****************************************************************************/
+
+void ieee80211_defrag_initialize(FAR struct ieee80211_s *ic)
+{
+  int i;
+
+  memset(ic->ic_defrag, 0, sizeof(ic->ic_defrag));
+  memset(ic->ic_defrag_hash, 0, sizeof(ic->ic_defrag_hash));
+  memset(&ic->ic_defrag_stats, 0, sizeof(ic->ic_defrag_stats));
+  dq_init(&ic->ic_defrag_age);
+
+  ic->ic_defrag_free = NULL;
+  for (i = CONFIG_IEEE80211_DEFRAG_NENTRIES - 1; i >= 0; i--)
+    {
+      ic->ic_defrag[i].df_hnext = ic->ic_defrag_free;
+      ic->ic_defrag_free = &ic->ic_defrag[i];
+    }
+
+  memset(&ic->ic_defrag_work, 0, sizeof(ic->ic_defrag_work));
+}
+
+/****************************************************************************
+ * Name: ieee80211_defrag
+ *
+ * Description:
+ *   Handle defragmentation (see 9.5 and Annex C).  Returns the frame if it
+ *   is not fragmented or completes an MSDU (the fragments being
+ *   concatenated behind the header of the first one), or NULL if the
+ *   frame was absorbed or dropped.
+ *
+ ****************************************************************************/
+
+FAR struct iob_s *ieee80211_defrag(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_node *ni,
+                                   FAR struct iob_s *iob, int hdrlen)
+{
+  FAR const struct ieee80211_frame *owh;
+  FAR const struct ieee80211_frame *wh;
+  FAR struct ieee80211_defrag *df;
+  uint16_t rxseq;
+  uint16_t seq;
+  uint8_t frag;
+  uint8_t tid;
+  bool more;
+
+  wh    = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  rxseq = letoh16(*(FAR const uint16_t *)wh->i_seq);
+  seq   = rxseq >> IEEE80211_SEQ_SEQ_SHIFT;
+  frag  = rxseq & IEEE80211_SEQ_FRAG_MASK;
+  more  = (wh->i_fc[1] & IEEE80211_FC1_MORE_FRAG) != 0;
+
+  if (frag == 0 && !more)
+    {
+      return iob;               /* not fragmented */
+    }
+
+  tid = ieee80211_has_qos(wh) ? ieee80211_get_qos(wh) & IEEE80211_QOS_TID : 0;
+  df  = ieee80211_defrag_lookup(ic, wh->i_addr2, seq, tid);
+
+  if (frag == 0)
+    {
+      /* First fragment:  a stale MSDU with the same key is replaced */
+
+      if (df != NULL)
+        {
+          ieee80211_defrag_release(ic, df);
+        }
+
+      ieee80211_defrag_evict(ic, ni);
+
+      df = ic->ic_defrag_free;
+      ic->ic_defrag_free = df->df_hnext;
+
+      IEEE80211_ADDR_COPY(df->df_ta, wh->i_addr2);
+      df->df_seq    = seq;
+      df->df_tid    = tid;
+      df->df_frag   = 0;
+      df->df_m      = iob;
+      df->df_ni     = ni;
+      df->df_expire = clock_systimer() + DEFRAG_LIFETIME;
+      df->df_hash   = ieee80211_defrag_hash(wh->i_addr2, seq, tid);
+      df->df_hnext  = ic->ic_defrag_hash[df->df_hash];
+      ic->ic_defrag_hash[df->df_hash] = df;
+      ni->ni_ndefrag++;
+
+      /* If the work is still pending for an older head, it will re-arm
+       * itself for the new one.
+       */
+
+      if (dq_empty(&ic->ic_defrag_age) && work_available(&ic->ic_defrag_work))
+        {
+          (void)work_queue(DEFRAG_WORK, &ic->ic_defrag_work,
+                           ieee80211_defrag_timeout, ic, DEFRAG_LIFETIME);
+        }
+
+      dq_addlast(&df->df_age, &ic->ic_defrag_age);
+      return NULL;              /* MSDU or MMPDU not yet complete */
+    }
+
+  /* Fragments must arrive in order; frame type and receiver must match */
+
+  if (df != NULL)
+    {
+      owh = (FAR struct ieee80211_frame *)IOB_DATA(df->df_m);
+      if (df->df_frag + 1 != frag ||
+          ((wh->i_fc[0] ^ owh->i_fc[0]) & IEEE80211_FC0_TYPE_MASK) ||
+          !IEEE80211_ADDR_EQ(wh->i_addr1, owh->i_addr1))
+        {
+          df = NULL;
+        }
+    }
+
+  if (df == NULL)
+    {
+      ic->ic_defrag_stats.ds_dropped++;
+      iob_free_chain(iob);
+      return NULL;
+    }
+
+  df->df_frag = frag;
+
+  /* Strip 802.11 header and concatenate fragment */
+
+  iob = iob_trimhead(iob, hdrlen);
+  if (iob != NULL)
+    {
+      iob_concat(df->df_m, iob);
+    }
+
+  if (more)
+    {
+      return NULL;              /* MSDU or MMPDU not yet complete */
+    }
+
+  /* MSDU or MMPDU complete */
+
+  iob      = df->df_m;
+  df->df_m = NULL;
+  ieee80211_defrag_release(ic, df);
+
+  ic->ic_defrag_stats.ds_msdus++;
+  return iob;
+}
+
+/****************************************************************************
+ * Name: ieee80211_defrag_purge
+ *
+ * Description:
+ *   Discard the MSDUs being reassembled from node 'ni', or all of them if
+ *   'ni' is NULL.
+ *
+ ****************************************************************************/
+
+void ieee80211_defrag_purge(FAR struct ieee80211_s *ic,
+                            FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_defrag *df;
+  FAR struct ieee80211_defrag *next;
+
+  if (ni != NULL && ni->ni_ndefrag == 0)
+    {
+      return;
+    }
+
+  for (df = (FAR struct ieee80211_defrag *)ic->ic_defrag_age.head;
+       df != NULL; df = next)
+    {
+      next = (FAR struct ieee80211_defrag *)df->df_age.flink;
+      if (ni == NULL || df->df_ni == ni)
+        {
+          ieee80211_defrag_release(ic, df);
+        }
+    }
+
+  /* Called with a NULL 'ni' on detach too:  the work must not run after
+   * the interface is gone.
+   */
+
+  if (ni == NULL)
+    {
+      (void)work_cancel(DEFRAG_WORK, &ic->ic_defrag_work);
+    }
+}
@@ -0,0 +1,72 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_hash.h
+ * MAC address hash for the 802.11 lookup tables
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_HASH_H
+#define __NET_IEEE80211_IEEE80211_HASH_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_mac_hash
+ *
+ * Description:
+ *   Fibonacci hash of a MAC address, shared by the node, PMKSA and
+ *   defragmentation tables.  The OUI carries little entropy, so only the
+ *   last four octets are mixed, together with 'salt' for keys that have
+ *   more than the address.  The result has 16 significant bits; mask it to
+ *   the table size.
+ *
+ ****************************************************************************/
+
+static inline unsigned int ieee80211_mac_hash(const uint8_t *macaddr,
+                                              uint32_t salt)
+{
+  uint32_t key;
+
+  key = (uint32_t)macaddr[2] << 24 | (uint32_t)macaddr[3] << 16 |
+        (uint32_t)macaddr[4] << 8 | macaddr[5];
+  return ((key ^ salt) * 0x9e3779b1u) >> 16;
+}
+
+#endif /* __NET_IEEE80211_IEEE80211_HASH_H */
@@ -42,11 +42,23 @@
 #include <stdbool.h>
 #include <string.h>
 #include <queue.h>
+#include <errno.h>
+#include <assert.h>
+#include <debug.h>
 
+#include <arpa/inet.h>
+
+#include <nuttx/net/arp.h>
 #include <nuttx/net/iob.h>
+#include <nuttx/net/ieee80211.h>
+#include <nuttx/net/uip/uip.h>
+#include <nuttx/net/uip/uip-arch.h>
 
 #include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_debug.h"
+
+#include "net_internal.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -56,6 +68,26 @@
 #  define MIN(a,b) ((a) < (b) ? (a) : (b))
 #endif
 
+/* Configuration ************************************************************/
+
+#ifndef CONFIG_IEEE80211_TXQ_DEPTH
+#  define CONFIG_IEEE80211_TXQ_DEPTH 8
+#endif
+
+#ifndef CONFIG_IEEE80211_MGTQ_DEPTH
+#  define CONFIG_IEEE80211_MGTQ_DEPTH 16
+#endif
+
+/* Room left in front of an Ethernet frame copied out of d_buf, so that
+ * ieee80211_encap() can replace the Ethernet header with a QoS header and
+ * an LLC/SNAP header, and a cipher header can follow, without another I/O
+ * buffer.
+ */
+
+#define IEEE80211_IFOUTPUT_HEADROOM \
+  (sizeof(struct ieee80211_qosframe) + 8 - UIP_ETHH_LEN + \
+   IEEE80211_IOB_HEADROOM)
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -64,16 +96,304 @@
  * Private Data
  ****************************************************************************/
 
+/* Driver polls are serviced in strict priority order:  Voice first,
+ * background last.
+ */
+
+static const uint8_t g_ac_order[EDCA_NUM_AC] =
+{
+  EDCA_AC_VO, EDCA_AC_VI, EDCA_AC_BE, EDCA_AC_BK
+};
+
 /****************************************************************************
  * Public Data
  ****************************************************************************/
 
 /****************************************************************************
- * Public Functions
+ * Private Functions
  ****************************************************************************/
 
 /****************************************************************************
- * Private Functions
+ * Name: ieee80211_txac
+ *
+ * Description:
+ *   Select the EDCA access category for an outgoing frame.  Frames from the
+ *   upper layers are still Ethernet encapsulated and are classified by
+ *   their DSCP; raw 802.11 frames (IFSEND_RAW) are classified by the TID of
+ *   their QoS header.
+ *
+ ****************************************************************************/
+
+static enum ieee80211_edca_ac ieee80211_txac(FAR struct ieee80211_s *ic,
+                                             FAR struct iob_s *iob,
+                                             uint8_t flags)
+{
+  FAR const struct ieee80211_frame *wh;
+  int up;
+
+  if ((flags & IFSEND_RAW) == 0)
+    {
+      if ((ic->ic_flags & IEEE80211_F_QOS) == 0 ||
+          iob->io_len < sizeof(struct uip_eth_hdr))
+        {
+          return EDCA_AC_BE;
+        }
+
+      up = ieee80211_classify(ic, iob);
+    }
+  else
+    {
+      wh = (FAR const struct ieee80211_frame *)IOB_DATA(iob);
+      if ((wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) != IEEE80211_FC0_TYPE_DATA)
+        {
+          return EDCA_AC_VO;
+        }
+
+      if (!ieee80211_has_qos(wh))
+        {
+          return EDCA_AC_BE;
+        }
+
+      up = ieee80211_get_qos(wh) & IEEE80211_QOS_TID;
+    }
+
+  return ieee80211_up_to_ac(ic, up);
+}
+
+/****************************************************************************
+ * Name: ieee80211_txencrypt
+ *
+ * Description:
+ *   Encrypt an outgoing MPDU if its Protected bit asks for it and the
+ *   driver does not encrypt in hardware.  The key is chosen as the driver
+ *   would choose it, from the frame and the node in its packet header.
+ *
+ * Returned Value:
+ *   The MPDU to transmit or NULL if it was dropped (the chain and its node
+ *   reference having been released).
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static FAR struct iob_s *ieee80211_txencrypt(FAR struct ieee80211_s *ic,
+                                             FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_frame *wh;
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct ieee80211_node *ni;
+  FAR struct ieee80211_key *k;
+
+  if ((ic->ic_caps & IEEE80211_C_TXCRYPTO) != 0)
+    {
+      return iob;
+    }
+
+  if (iob->io_len < sizeof(struct ieee80211_frame))
+    {
+      iob = iob_pack(iob);
+      if (iob == NULL)
+        {
+          return NULL;
+        }
+    }
+
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  if ((wh->i_fc[1] & IEEE80211_FC1_PROTECTED) == 0)
+    {
+      return iob;
+    }
+
+  ph = IEEE80211_PKTHDR(iob);
+  ni = ph != NULL && ph->ph_ni != NULL ? ph->ph_ni : ic->ic_bss;
+
+  k = ieee80211_get_txkey(ic, wh, ni);
+  if (k == NULL)
+    {
+      ndbg("ERROR: No key to encrypt frame to %s\n",
+           ieee80211_addr2str(wh->i_addr1));
+      ieee80211_txfree(ic, iob);
+      return NULL;
+    }
+
+  /* The cipher frees the chain on failure but not the node reference */
+
+  ni = ph != NULL ? ph->ph_ni : NULL;
+  iob = ieee80211_encrypt(ic, iob, k);
+  if (iob == NULL && ni != NULL)
+    {
+      ieee80211_release_node(ic, ni);
+    }
+
+  return iob;
+}
+
+/****************************************************************************
+ * Name: ieee80211_txfree_queue
+ *
+ * Description:
+ *   Free every frame of a transmit queue with ieee80211_txfree().  The
+ *   frames are counted as drops.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_txfree_queue(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_txq_s *txq)
+{
+  FAR struct iob_s *iob;
+
+  while ((iob = iob_remove_queue(&txq->txq_queue)) != NULL)
+    {
+      ieee80211_txfree(ic, iob);
+    }
+
+  txq->txq_drops += txq->txq_len;
+  txq->txq_len    = 0;
+}
+
+/****************************************************************************
+ * Name: ieee80211_txnotify
+ *
+ * Description:
+ *   Notify the driver that outgoing frames are available, unless it has
+ *   already been notified and has not yet drained the queues.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_txnotify(FAR struct ieee80211_s *ic)
+{
+  FAR struct uip_driver_s *dev;
+
+  /* Are we currently accepting driver polls? */
+
+  if (ic->ic_txpolling)
+    {
+      return;
+    }
+
+  /* No.. Find the driver bound to this interface and notify it */
+
+  dev = netdev_findbyname(ic->ic_ifname);
+  if (dev == NULL || dev->d_txavail == NULL)
+    {
+      ndbg("ERROR: No TX poll callback for %s\n", ic->ic_ifname);
+      return;
+    }
+
+  /* Indicate that we are accepting driver polls.  The indication is
+   * cleared when a poll finds all of the transmit queues empty.
+   */
+
+  ic->ic_txpolling = true;
+  (void)dev->d_txavail(dev);
+}
+
+/****************************************************************************
+ * Name: ieee80211_txpoll_queue
+ *
+ * Description:
+ *   Offer each frame in one queue to the driver until the queue is empty
+ *   or the driver refuses further frames.
+ *
+ * Returned Value:
+ *   Zero if the queue was drained; non-zero if the driver stopped the poll.
+ *
+ ****************************************************************************/
+
+static int ieee80211_txpoll_queue(FAR struct ieee80211_s *ic,
+                                  FAR struct ieee80211_txq_s *txq,
+                                  ieee80211_txpoll_t callback)
+{
+  FAR struct iob_s *iob;
+  int ret;
+
+  while ((iob = iob_peek_queue(&txq->txq_queue)) != NULL)
+    {
+      ret = callback(ic, iob);
+      if (ret < 0)
+        {
+          /* The driver could not accept the frame; leave it at the head of
+           * the queue so that it is offered first on the next poll.
+           */
+
+          return ret;
+        }
+
+      (void)iob_remove_queue(&txq->txq_queue);
+      txq->txq_len--;
+      txq->txq_dequeued++;
+
+      if (ret > 0)
+        {
+          return ret;
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_txq_add
+ *
+ * Description:
+ *   Add an MPDU to a transmit queue holding at most 'depth' frames and
+ *   notify the driver.  A frame arriving at a full queue is dropped and
+ *   counted.
+ *
+ * Returned Value:
+ *   OK on success; a negated errno value on failure.  The I/O buffer chain
+ *   is freed on failure.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static int ieee80211_txq_add(FAR struct ieee80211_s *ic,
+                             FAR struct ieee80211_txq_s *txq,
+                             unsigned int depth, FAR struct iob_s *iob)
+{
+  int ret;
+
+  if (txq->txq_len >= depth)
+    {
+      nvdbg("Queue full, dropping frame\n");
+      txq->txq_drops++;
+      ieee80211_txfree(ic, iob);
+      return -ENOBUFS;
+    }
+
+  ret = iob_add_queue(iob, &txq->txq_queue);
+  if (ret < 0)
+    {
+      ndbg("ERROR: Failed to queue frame: %d\n", ret);
+      txq->txq_drops++;
+      ieee80211_txfree(ic, iob);
+      return ret;
+    }
+
+  txq->txq_len++;
+  txq->txq_enqueued++;
+  if (txq->txq_len > txq->txq_hiwat)
+    {
+      txq->txq_hiwat = txq->txq_len;
+    }
+
+  /* Start accepting driver polls if we are not already doing so */
+
+  ieee80211_txnotify(ic);
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
  ****************************************************************************/
 
 /****************************************************************************
@@ -86,13 +406,33 @@
 
 void ieee80211_ifinit(FAR struct ieee80211_s *ic)
 {
+  int ac;
+
   /* Perform one-time initialization */
   /* Initialize the I/O buffering (okay to call multiple times */
 
   iob_initialize();
 
   /* Perform pre-instance initialization */
-  /* NONE */
+
+  memset(&ic->ic_mgtq, 0, sizeof(struct ieee80211_txq_s));
+  IOB_QINIT(&ic->ic_mgtq.txq_queue);
+  memset(&ic->ic_pwrsaveq, 0, sizeof(struct ieee80211_txq_s));
+  IOB_QINIT(&ic->ic_pwrsaveq.txq_queue);
+
+  for (ac = 0; ac < EDCA_NUM_AC; ac++)
+    {
+      memset(&ic->ic_txq[ac], 0, sizeof(struct ieee80211_txq_s));
+      IOB_QINIT(&ic->ic_txq[ac].txq_queue);
+    }
+
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+  ieee80211_amsdu_initialize(ic);
+#endif
+
+  ieee80211_defrag_initialize(ic);
+
+  ic->ic_txpolling = false;
 }
 
 /****************************************************************************
@@ -103,23 +443,604 @@ void ieee80211_ifinit(FAR struct ieee80211_s *ic)
  *   accepting TX polls from the Ethernet driver (if we are not already doing
  *   so.
  *
+ *   Management frames (IFSEND_MGMT) and frames released from power save
+ *   buffering (IFSEND_PWRSAVE) are placed on their own queues.  All other
+ *   frames are classified to one of the four EDCA access
+ *   categories and placed on that category's queue.  A frame arriving at a
+ *   full queue is dropped and counted.  With CONFIG_IEEE80211_AMSDU_TX,
+ *   small data frames may first be held back to be aggregated into an
+ *   A-MSDU.
+ *
+ *   Ethernet frames are encapsulated, and frames that require it are
+ *   encrypted, before they are queued:  the driver only ever sees 802.11
+ *   MPDUs.  A frame that ieee80211_encap() holds back for a station in
+ *   power save mode is queued when it is released (IFSEND_PWRSAVE).
+ *
+ * Returned Value:
+ *   OK on success; a negated errno value on failure.  The I/O buffer chain
+ *   is freed on failure.
+ *
  ****************************************************************************/
 
 int ieee80211_ifsend(FAR struct ieee80211_s *ic, FAR struct iob_s *iob,
                      uint8_t flags)
 {
+  FAR struct ieee80211_pkthdr *ph;
+  enum ieee80211_edca_ac ac;
+  uip_lock_t lock;
+  int ret;
+
+  DEBUGASSERT(ic != NULL && iob != NULL);
+
+  lock = uip_lock();
+
+  /* Management and raw frames are already in 802.11 format.  Say so in the
+   * packet header so that neither ieee80211_encap() nor the driver takes
+   * them for Ethernet frames.
+   */
+
+  if ((flags & (IFSEND_MGMT | IFSEND_RAW)) != 0)
+    {
+      ph = IEEE80211_PKTHDR_GET(iob);
+      if (ph != NULL && ph->ph_dlt == 0)
+        {
+          ph->ph_dlt = DLT_IEEE802_11;
+        }
+    }
+
   /* Add the I/O buffer chain to the driver output queue */
-#warning Missing logic
 
-  /* Are we currently accepting driver polls? */
-#warning Missing logic
+  if ((flags & (IFSEND_MGMT | IFSEND_PWRSAVE)) != 0)
+    {
+      /* Management frames and frames released from power save buffering
+       * are already encapsulated.  They have queues of their own, so that
+       * a flood of them cannot hold up the data frames, or take all of the
+       * I/O buffers.
+       */
+
+      iob = ieee80211_txencrypt(ic, iob);
+      if (iob == NULL)
+        {
+          ret = -EIO;
+        }
+      else if ((flags & IFSEND_MGMT) != 0)
+        {
+          ret = ieee80211_txq_add(ic, &ic->ic_mgtq,
+                                  CONFIG_IEEE80211_MGTQ_DEPTH, iob);
+        }
+      else
+        {
+          ret = ieee80211_txq_add(ic, &ic->ic_pwrsaveq,
+                                  CONFIG_IEEE80211_PSQ_DEPTH, iob);
+        }
+    }
+  else
+    {
+      ac = ieee80211_txac(ic, iob, flags);
+      ic->ic_txclassified++;
+
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+      /* Small frames may be held back to be sent as part of an A-MSDU */
+
+      if ((flags & IFSEND_RAW) == 0 &&
+          ieee80211_amsdu_add(ic, ac, iob) == OK)
+        {
+          ret = OK;
+        }
+      else
+#endif
+        {
+          ret = ieee80211_txdata(ic, ac, iob);
+        }
+    }
+
+  uip_unlock(lock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_txdata
+ *
+ * Description:
+ *   Turn an Ethernet frame (or a raw 802.11 frame tagged by ph_dlt) into
+ *   the MPDU that the driver will transmit and queue it on access category
+ *   'ac'.  ieee80211_encap() adds the 802.11 header and a reference to the
+ *   destination node; ieee80211_txencrypt() then applies the cipher.  With
+ *   CONFIG_IEEE80211_HT, QoS data for a RA/TID with a Block Ack agreement
+ *   goes to the A-MPDU aggregation stage instead of the EDCA queue.
+ *
+ * Returned Value:
+ *   OK on success, including when the frame is held for a station in
+ *   power save mode; a negated errno value on failure.  The I/O buffer
+ *   chain is freed on failure.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_txdata(FAR struct ieee80211_s *ic, uint8_t ac,
+                     FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_node *ni;
+#ifdef CONFIG_IEEE80211_HT
+  int ret;
+#endif
+
+  iob = ieee80211_encap(ic, iob, &ni);
+  if (iob == NULL)
+    {
+      /* Either dropped or buffered by ieee80211_pwrsave().  ieee80211_encap()
+       * has logged the former.
+       */
+
+      return OK;
+    }
+
+  iob = ieee80211_txencrypt(ic, iob);
+  if (iob == NULL)
+    {
+      ic->ic_txq[ac].txq_drops++;
+      return -EIO;
+    }
+
+#ifdef CONFIG_IEEE80211_HT
+  ret = ieee80211_ampdu_enqueue(ic, ni, iob);
+  if (ret != -ENOENT)
+    {
+      if (ret == OK)
+        {
+          ieee80211_txnotify(ic);
+        }
+
+      return ret;
+    }
+#endif
+
+  return ieee80211_txq_enqueue(ic, ac, iob);
+}
+
+/****************************************************************************
+ * Name: ieee80211_txq_enqueue
+ *
+ * Description:
+ *   Add an MPDU to the queue of access category 'ac' and notify the
+ *   driver.  A frame arriving at a full queue is dropped and counted.
+ *
+ * Returned Value:
+ *   OK on success; a negated errno value on failure.  The I/O buffer chain
+ *   is freed on failure.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_txq_enqueue(FAR struct ieee80211_s *ic, uint8_t ac,
+                          FAR struct iob_s *iob)
+{
+  return ieee80211_txq_add(ic, &ic->ic_txq[ac], CONFIG_IEEE80211_TXQ_DEPTH,
+                           iob);
+}
+
+/****************************************************************************
+ * Name: ieee80211_ifpoll
+ *
+ * Description:
+ *   Called by the driver (normally in response to d_txavail or on TX
+ *   completion) to collect queued frames.  Frames are offered in priority
+ *   order: management, power save releases, then the EDCA access
+ *   categories from voice down to background.
+ *
+ *   The callback returns zero to accept the frame and continue, a positive
+ *   value to accept the frame and stop (e.g., the TX ring is now full), or
+ *   a negated errno value to refuse the frame.  A refused frame remains at
+ *   the head of its queue.  Accepted frames become the property of the
+ *   driver, which frees them with ieee80211_txfree().  Every frame is a
+ *   complete 802.11 MPDU, see ieee80211_txpoll_t.
+ *
+ * Returned Value:
+ *   Zero if all queues were drained; non-zero if the driver stopped the
+ *   poll.  In the latter case the driver must poll again when it can
+ *   accept more frames.
+ *
+ ****************************************************************************/
+
+int ieee80211_ifpoll(FAR struct ieee80211_s *ic, ieee80211_txpoll_t callback)
+{
+  FAR struct ieee80211_txq_s *txq;
+  uip_lock_t lock;
+  int ret;
+  int i;
+
+  DEBUGASSERT(ic != NULL && callback != NULL);
+
+  lock = uip_lock();
+
+  ret = ieee80211_txpoll_queue(ic, &ic->ic_mgtq, callback);
+  if (ret != 0)
+    {
+      goto out;
+    }
+
+#ifdef CONFIG_IEEE80211_BGSCAN
+  /* While a background scan has the radio on another channel, only the
+   * management frames (probe requests) go out.  The data frames wait for
+   * the return to the home channel, see ieee80211_iftxavail().
+   */
+
+  if (ic->ic_bgscan.bs_chan != NULL)
+    {
+      ic->ic_txpolling = false;
+      goto out;
+    }
+#endif
+
+  ret = ieee80211_txpoll_queue(ic, &ic->ic_pwrsaveq, callback);
+  if (ret != 0)
+    {
+      goto out;
+    }
+
+  for (i = 0; i < EDCA_NUM_AC; i++)
+    {
+      txq = &ic->ic_txq[g_ac_order[i]];
+      ret = ieee80211_txpoll_queue(ic, txq, callback);
+      if (ret != 0)
+        {
+          goto out;
+        }
+    }
+
+  /* Everything has been drained.  Stop accepting polls until the next
+   * frame is queued.
+   */
+
+  ic->ic_txpolling = false;
+
+out:
+  uip_unlock(lock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_txfree
+ *
+ * Description:
+ *   Free an outgoing frame along with the node reference held by its packet
+ *   header.  Drivers call this for the frames collected by
+ *   ieee80211_ifpoll() once they are done with them.
+ *
+ ****************************************************************************/
+
+void ieee80211_txfree(FAR struct ieee80211_s *ic, FAR struct iob_s *iob)
+{
+  FAR struct ieee80211_pkthdr *ph;
+
+  ph = IEEE80211_PKTHDR(iob);
+  if (ph != NULL && ph->ph_ni != NULL)
+    {
+      ieee80211_release_node(ic, ph->ph_ni);
+      ph->ph_ni = NULL;
+    }
+
+  iob_free_chain(iob);
+}
+
+/****************************************************************************
+ * Name: ieee80211_ifflush
+ *
+ * Description:
+ *   Discard all frames waiting in the transmit queues.
+ *
+ ****************************************************************************/
+
+void ieee80211_ifflush(FAR struct ieee80211_s *ic)
+{
+  uip_lock_t lock;
+  int ac;
+
+  lock = uip_lock();
+
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+  ieee80211_amsdu_discard(ic);
+#endif
+
+  ieee80211_txfree_queue(ic, &ic->ic_mgtq);
+  ieee80211_txfree_queue(ic, &ic->ic_pwrsaveq);
+
+  for (ac = 0; ac < EDCA_NUM_AC; ac++)
+    {
+      ieee80211_txfree_queue(ic, &ic->ic_txq[ac]);
+    }
+
+  ic->ic_txpolling = false;
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: ieee80211_ifinput
+ *
+ * Description:
+ *   Pass a received Ethernet frame to uIP.  The frame is copied into the
+ *   d_buf of the driver bound to the interface; IP and ARP packets are
+ *   handed to uIP and any response is sent back with ieee80211_ifoutput().
+ *
+ * Returned Value:
+ *   OK on success; a negated errno value on failure.  The I/O buffer chain
+ *   is always freed.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_ifinput(FAR struct ieee80211_s *ic, FAR struct iob_s *iob)
+{
+  FAR struct uip_driver_s *dev;
+  FAR struct uip_eth_hdr *ethhdr;
+  int ret = OK;
+
+  dev = netdev_findbyname(ic->ic_ifname);
+  if (dev == NULL)
+    {
+      iob_free_chain(iob);
+      return -ENODEV;
+    }
+
+  if (iob->io_pktlen < UIP_ETHH_LEN || iob->io_pktlen > CONFIG_NET_BUFSIZE)
+    {
+      ndbg("ERROR: Bad frame length: %u\n", iob->io_pktlen);
+      iob_free_chain(iob);
+      return -EMSGSIZE;
+    }
+
+  dev->d_len = iob_copyout(dev->d_buf, iob, iob->io_pktlen, 0);
+  iob_free_chain(iob);
+
+  ethhdr = (FAR struct uip_eth_hdr *)dev->d_buf;
+
+#ifdef CONFIG_NET_IPv6
+  if (ethhdr->type == htons(UIP_ETHTYPE_IP6))
+#else
+  if (ethhdr->type == htons(UIP_ETHTYPE_IP))
+#endif
+    {
+      arp_ipin(dev);
+      uip_input(dev);
+
+      /* If the above function invocation resulted in data that should be
+       * sent out on the network, d_len is set to a value > 0.
+       */
+
+      if (dev->d_len > 0)
+        {
+          arp_out(dev);
+          ret = ieee80211_ifoutput(ic, dev);
+        }
+    }
+  else if (ethhdr->type == htons(UIP_ETHTYPE_ARP))
+    {
+      arp_arpin(dev);
+      if (dev->d_len > 0)
+        {
+          ret = ieee80211_ifoutput(ic, dev);
+        }
+    }
+  else
+    {
+      nvdbg("Dropping frame of type %04x\n", ntohs(ethhdr->type));
+    }
+
+  dev->d_len = 0;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ifoutput
+ *
+ * Description:
+ *   Copy the Ethernet frame that uIP left in d_buf into an I/O buffer chain
+ *   and send it with ieee80211_ifsend().  The link layer address must
+ *   already have been resolved (arp_out()).  d_len is cleared.
+ *
+ * Returned Value:
+ *   OK on success; a negated errno value on failure.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_ifoutput(FAR struct ieee80211_s *ic,
+                       FAR struct uip_driver_s *dev)
+{
+  FAR struct iob_s *iob;
+  int ret;
+
+  iob = iob_alloc(false);
+  if (iob == NULL)
+    {
+      dev->d_len = 0;
+      return -ENOMEM;
+    }
+
+  iob->io_offset = IEEE80211_IFOUTPUT_HEADROOM;
+
+  ret = iob_copyin(iob, dev->d_buf, dev->d_len, 0, false);
+  dev->d_len = 0;
+  if (ret < 0)
+    {
+      iob_free_chain(iob);
+      return ret;
+    }
+
+  return ieee80211_ifsend(ic, iob, 0);
+}
+
+/****************************************************************************
+ * Name: ieee80211_iftxavail
+ *
+ * Description:
+ *   Notify the driver again that frames may be available, even if it was
+ *   notified before.  Used when frames held back by ieee80211_ifpoll() may
+ *   go out again.
+ *
+ ****************************************************************************/
+
+void ieee80211_iftxavail(FAR struct ieee80211_s *ic)
+{
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  ic->ic_txpolling = false;
+  ieee80211_txnotify(ic);
+  uip_unlock(lock);
+}
+
+/****************************************************************************
+ * Name: ieee80211_txstats
+ *
+ * Description:
+ *   Return the transmit path counters of the 802.11 interface 'ifname'.
+ *   The per access category queue counters are summed.  ts_encrypted counts
+ *   the protected frames that ieee80211_txencrypt() has passed through
+ *   ieee80211_encrypt() on their way into the queues.
+ *
+ * Returned Value:
+ *   OK on success; -ENODEV if there is no such 802.11 interface.
+ *
+ ****************************************************************************/
+
+int ieee80211_txstats(FAR const char *ifname,
+                      FAR struct ieee80211_txstats_s *stats)
+{
+  FAR struct ieee80211_s *ic;
+  FAR struct ieee80211_txq_s *txq;
+  uip_lock_t lock;
+  int ret = -ENODEV;
+  int ac;
+
+  DEBUGASSERT(ifname != NULL && stats != NULL);
+
+  lock = uip_lock();
+  ic = ieee80211_find_ifname(ifname);
+  if (ic != NULL)
+    {
+      memset(stats, 0, sizeof(struct ieee80211_txstats_s));
+      stats->ts_classified = ic->ic_txclassified;
+      stats->ts_encrypted  = ic->ic_crypto_stats.cs_encrypted;
+
+      for (ac = 0; ac < EDCA_NUM_AC; ac++)
+        {
+          txq = &ic->ic_txq[ac];
+          stats->ts_enqueued += txq->txq_enqueued;
+          stats->ts_dequeued += txq->txq_dequeued;
+          stats->ts_drops    += txq->txq_drops;
+          stats->ts_queued   += txq->txq_len;
+
+          if (txq->txq_hiwat > stats->ts_hiwat)
+            {
+              stats->ts_hiwat = txq->txq_hiwat;
+            }
+        }
+
+      stats->ts_mgtdrops = ic->ic_mgtq.txq_drops;
+      stats->ts_psdrops  = ic->ic_pwrsaveq.txq_drops;
+
+      ret = OK;
+    }
+
+  uip_unlock(lock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_iob_prepend
+ *
+ * Description:
+ *   Open 'len' bytes in front of the data in the I/O buffer chain.  The
+ *   headroom of the head I/O buffer is used if it is large enough;
+ *   otherwise a new I/O buffer is linked in front of the chain.  A new head
+ *   I/O buffer leaves IEEE80211_IOB_HEADROOM bytes unused in front of the
+ *   new data so that a cipher header can later be inserted in place.
+ *
+ * Returned Value:
+ *   The (possibly new) head of the chain.  On failure the chain is freed
+ *   and NULL is returned.
+ *
+ ****************************************************************************/
+
+FAR struct iob_s *ieee80211_iob_prepend(FAR struct iob_s *iob,
+                                        unsigned int len)
+{
+  FAR struct iob_s *head;
+
+  if (iob->io_offset >= len)
+    {
+      iob->io_offset -= len;
+      iob->io_len    += len;
+      iob->io_pktlen += len;
+      return iob;
+    }
+
+  DEBUGASSERT(len + IEEE80211_IOB_HEADROOM <= CONFIG_IOB_BUFSIZE);
+
+  head = iob_alloc(false);
+  if (head == NULL)
+    {
+      iob_free_chain(iob);
+      return NULL;
+    }
+
+  head->io_offset = IEEE80211_IOB_HEADROOM;
+  head->io_len    = len;
+  head->io_pktlen = iob->io_pktlen + len;
+  head->io_pkthdr = iob->io_pkthdr;
+  head->io_flink  = iob;
+  iob->io_pkthdr  = NULL;
+  return head;
+}
+
+/****************************************************************************
+ * Name: ieee80211_iob_append
+ *
+ * Description:
+ *   Extend the I/O buffer chain by 'len' contiguous bytes at its end.  The
+ *   free space in the last I/O buffer is used if it is large enough;
+ *   otherwise a new I/O buffer is linked at the end of the chain.
+ *
+ * Returned Value:
+ *   A pointer to the new bytes or NULL if no I/O buffer is available.  The
+ *   chain is not modified on failure.
+ *
+ ****************************************************************************/
+
+FAR uint8_t *ieee80211_iob_append(FAR struct iob_s *iob, unsigned int len)
+{
+  FAR struct iob_s *head = iob;
+  FAR struct iob_s *tail;
+
+  DEBUGASSERT(len <= CONFIG_IOB_BUFSIZE);
+
+  while (iob->io_flink != NULL)
+    {
+      iob = iob->io_flink;
+    }
 
-  /* No.. Allocate a callback structure */
-#warning Missing logic
+  if (IOB_FREESPACE(iob) < len)
+    {
+      tail = iob_alloc(false);
+      if (tail == NULL)
+        {
+          return NULL;
+        }
 
-  /* Initialize the callback structure */
-#warning Missing logic
+      iob->io_flink = tail;
+      iob = tail;
+    }
 
-  /* Indicate that we are accepting driver polls */
-#warning Missing logic
+  iob->io_len     += len;
+  head->io_pktlen += len;
+  return IOB_DATA(iob) + iob->io_len - len;
 }
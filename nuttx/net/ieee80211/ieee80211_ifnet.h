@@ -41,6 +41,10 @@
  ****************************************************************************/
 
 #include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
 #include <nuttx/net/iob.h>
 
 /****************************************************************************
@@ -48,11 +52,87 @@
  ****************************************************************************/
 
 #define IFSEND_MCAST   (1 << 0)  /* Send as multi-cast */
+#define IFSEND_MGMT    (1 << 1)  /* 802.11 management frame */
+#define IFSEND_RAW     (1 << 2)  /* Raw 802.11 frame (no Ethernet header) */
+#define IFSEND_PWRSAVE (1 << 3)  /* Frame released from a power save queue */
+
+/* Bytes kept free in front of a newly built 802.11 header so that the
+ * largest cipher header (CCMP/TKIP, 8 bytes) can be inserted in place.
+ */
+
+#define IEEE80211_IOB_HEADROOM 8
+
+/* Largest number of subframes in one A-MPDU descriptor */
+
+#ifndef CONFIG_IEEE80211_AMPDU_MAXFRAMES
+#  define CONFIG_IEEE80211_AMPDU_MAXFRAMES 32
+#endif
+
+/* Largest information element (ID, length and 255 bytes of payload) */
+
+#define IEEE80211_MGMT_MAXIE (2 + 255)
 
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
+/* The driver TX poll callback.  See ieee80211_ifpoll().  Every frame
+ * offered is an 802.11 MPDU (ph_dlt is DLT_IEEE802_11).  Frames with the
+ * Protected bit set are already encrypted unless the driver claims
+ * IEEE80211_C_TXCRYPTO.  ph_ni holds a node reference that the driver
+ * releases with the frame, see ieee80211_txfree().
+ */
+
+struct ieee80211_s;
+struct iob_s;
+struct uip_driver_s;
+
+typedef int (*ieee80211_txpoll_t)(FAR struct ieee80211_s *ic,
+                                  FAR struct iob_s *iob);
+
+#ifdef CONFIG_IEEE80211_HT
+/* One A-MPDU offered to the driver by ieee80211_ampdu_poll().  The
+ * subframes are complete (encapsulated and, if required, encrypted) MPDUs
+ * in sequence number order.  They remain the property of the aggregation
+ * stage until they are acknowledged:  the driver must not free them and
+ * must report the outcome of the transmission with ieee80211_ampdu_ack().
+ */
+
+struct ieee80211_node;
+
+struct ieee80211_ampdu_s
+  {
+    FAR struct ieee80211_node *am_ni;  /* Receiver of the A-MPDU */
+    uint8_t am_tid;                    /* Traffic identifier */
+    uint8_t am_nframes;                /* Number of subframes */
+    uint16_t am_ssn;                   /* Sequence number of am_frames[0] */
+    uint32_t am_len;                   /* PSDU length (delimiters, FCS,
+                                        * padding) */
+    FAR struct iob_s *am_frames[CONFIG_IEEE80211_AMPDU_MAXFRAMES];
+  };
+
+/* The driver A-MPDU poll callback.  See ieee80211_ampdu_poll() */
+
+typedef int (*ieee80211_ampdu_txpoll_t)(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_ampdu_s *ampdu);
+#endif
+
+/* State of a management frame under construction by the
+ * ieee80211_mgmt_*() functions.  The frame body is written at the end of an
+ * I/O buffer chain allocated once by ieee80211_mgmt_alloc(), so it is not
+ * limited to the size of one I/O buffer.
+ */
+
+struct ieee80211_mgmtbuf_s
+  {
+    FAR struct iob_s *mb_head;  /* Head I/O buffer (802.11 header first) */
+    FAR struct iob_s *mb_iob;   /* I/O buffer being filled */
+    FAR uint8_t *mb_frm;        /* Start of the bytes being written */
+    bool mb_bounce;             /* Bytes being written in mb_buf */
+    bool mb_overflow;           /* Chain was too short for the frame */
+    uint8_t mb_buf[IEEE80211_MGMT_MAXIE];
+  };
+
 /****************************************************************************
  * Global Data
  ****************************************************************************/
@@ -69,7 +149,6 @@
  *
  ****************************************************************************/
 
-struct ieee80211_s;
 void ieee80211_ifinit(FAR struct ieee80211_s *ic);
 
 /****************************************************************************
@@ -85,4 +164,335 @@ void ieee80211_ifinit(FAR struct ieee80211_s *ic);
 int ieee80211_ifsend(FAR struct ieee80211_s *ic, FAR struct iob_s *iob,
                      uint8_t flags);
 
+/****************************************************************************
+ * Name: ieee80211_ifpoll
+ *
+ * Description:
+ *   Called by the driver to collect queued frames in priority order.  The
+ *   callback returns zero to accept a frame and continue, a positive value
+ *   to accept the frame and stop, or a negated errno value to refuse the
+ *   frame (which then remains queued).
+ *
+ ****************************************************************************/
+
+int ieee80211_ifpoll(FAR struct ieee80211_s *ic, ieee80211_txpoll_t callback);
+
+/****************************************************************************
+ * Name: ieee80211_txdata
+ *
+ * Description:
+ *   Encapsulate and encrypt an Ethernet frame and queue the resulting MPDU
+ *   on access category 'ac'.  The network must be locked.  The frame is
+ *   freed on failure.
+ *
+ ****************************************************************************/
+
+int ieee80211_txdata(FAR struct ieee80211_s *ic, uint8_t ac,
+                     FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: ieee80211_txq_enqueue
+ *
+ * Description:
+ *   Add an MPDU to the queue of access category 'ac' and notify the
+ *   driver.  The network must be locked.  The frame is freed on failure.
+ *
+ ****************************************************************************/
+
+int ieee80211_txq_enqueue(FAR struct ieee80211_s *ic, uint8_t ac,
+                          FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: ieee80211_txfree
+ *
+ * Description:
+ *   Free an outgoing frame along with the node reference held by its packet
+ *   header.
+ *
+ ****************************************************************************/
+
+void ieee80211_txfree(FAR struct ieee80211_s *ic, FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: ieee80211_ifflush
+ *
+ * Description:
+ *   Discard all frames waiting in the transmit queues.
+ *
+ ****************************************************************************/
+
+void ieee80211_ifflush(FAR struct ieee80211_s *ic);
+
+/****************************************************************************
+ * Name: ieee80211_ifinput
+ *
+ * Description:
+ *   Pass a received (decapsulated) Ethernet frame to uIP through the d_buf
+ *   of the interface's driver, and send any response that uIP produces.
+ *   The network must be locked.  The I/O buffer chain is always freed.
+ *
+ ****************************************************************************/
+
+int ieee80211_ifinput(FAR struct ieee80211_s *ic, FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: ieee80211_ifoutput
+ *
+ * Description:
+ *   Send the Ethernet frame that uIP left in the d_buf of 'dev' (d_len
+ *   bytes, the link layer address already resolved with arp_out()) through
+ *   ieee80211_ifsend().  Drivers call this from their uip_poll() and
+ *   uip_timer() callbacks.  d_len is cleared.
+ *
+ ****************************************************************************/
+
+int ieee80211_ifoutput(FAR struct ieee80211_s *ic,
+                       FAR struct uip_driver_s *dev);
+
+/****************************************************************************
+ * Name: ieee80211_iftxavail
+ *
+ * Description:
+ *   Notify the driver that the transmit queues should be polled again,
+ *   whether or not it has already been notified.
+ *
+ ****************************************************************************/
+
+void ieee80211_iftxavail(FAR struct ieee80211_s *ic);
+
+/****************************************************************************
+ * Name: ieee80211_iob_prepend
+ *
+ * Description:
+ *   Open 'len' bytes in front of the data in the I/O buffer chain, using
+ *   the headroom of the head I/O buffer when possible.  Returns the new
+ *   head of the chain or NULL (the chain having been freed) on failure.
+ *
+ ****************************************************************************/
+
+FAR struct iob_s *ieee80211_iob_prepend(FAR struct iob_s *iob,
+                                        unsigned int len);
+
+/****************************************************************************
+ * Name: ieee80211_iob_append
+ *
+ * Description:
+ *   Extend the I/O buffer chain by 'len' contiguous bytes at its end, using
+ *   the tailroom of the last I/O buffer when possible.  Returns a pointer
+ *   to the new bytes or NULL if no I/O buffer is available.
+ *
+ ****************************************************************************/
+
+FAR uint8_t *ieee80211_iob_append(FAR struct iob_s *iob, unsigned int len);
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_alloc
+ *
+ * Description:
+ *   Allocate the I/O buffer chain of a management frame whose body is at
+ *   most 'len' bytes long.  Room for the 802.11 header is reserved at the
+ *   start of the head I/O buffer.  Returns OK or -ENOMEM.
+ *
+ ****************************************************************************/
+
+int ieee80211_mgmt_alloc(FAR struct ieee80211_mgmtbuf_s *mb,
+                         unsigned int len);
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_begin
+ *
+ * Description:
+ *   Return a contiguous area where up to 'maxlen' (at most
+ *   IEEE80211_MGMT_MAXIE) bytes of the frame body can be written, e.g. by
+ *   the ieee80211_add_*() functions.
+ *
+ ****************************************************************************/
+
+FAR uint8_t *ieee80211_mgmt_begin(FAR struct ieee80211_mgmtbuf_s *mb,
+                                  unsigned int maxlen);
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_end
+ *
+ * Description:
+ *   Append the bytes written since ieee80211_mgmt_begin() to the frame,
+ *   'frm' pointing just past the last of them.
+ *
+ ****************************************************************************/
+
+void ieee80211_mgmt_end(FAR struct ieee80211_mgmtbuf_s *mb,
+                        FAR const uint8_t *frm);
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_put
+ *
+ * Description:
+ *   Append 'len' bytes to the frame body.
+ *
+ ****************************************************************************/
+
+void ieee80211_mgmt_put(FAR struct ieee80211_mgmtbuf_s *mb,
+                        FAR const void *data, unsigned int len);
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_finish
+ *
+ * Description:
+ *   Trim the unused I/O buffers and return the frame, or NULL if the body
+ *   did not fit in the length given to ieee80211_mgmt_alloc().
+ *
+ ****************************************************************************/
+
+FAR struct iob_s *ieee80211_mgmt_finish(FAR struct ieee80211_mgmtbuf_s *mb);
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_discard
+ *
+ * Description:
+ *   Abandon a frame under construction.
+ *
+ ****************************************************************************/
+
+void ieee80211_mgmt_discard(FAR struct ieee80211_mgmtbuf_s *mb);
+
+/****************************************************************************
+ * Name: ieee80211_defrag_initialize
+ *
+ * Description:
+ *   Set up the fragment reassembly table of the interface.
+ *
+ ****************************************************************************/
+
+void ieee80211_defrag_initialize(FAR struct ieee80211_s *ic);
+
+/****************************************************************************
+ * Name: ieee80211_defrag
+ *
+ * Description:
+ *   Pass a received (and decrypted) frame from node 'ni' through fragment
+ *   reassembly.  Returns the complete frame, or NULL if the frame was
+ *   held or dropped.  The network must be locked.
+ *
+ ****************************************************************************/
+
+FAR struct iob_s *ieee80211_defrag(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_node *ni,
+                                   FAR struct iob_s *iob, int hdrlen);
+
+/****************************************************************************
+ * Name: ieee80211_defrag_purge
+ *
+ * Description:
+ *   Discard the partially reassembled MSDUs of node 'ni' (all of them if
+ *   'ni' is NULL).  The network must be locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_defrag_purge(FAR struct ieee80211_s *ic,
+                            FAR struct ieee80211_node *ni);
+
+#ifdef CONFIG_IEEE80211_AP
+/****************************************************************************
+ * Name: ieee80211_beacon_update
+ *
+ * Description:
+ *   Called by HOSTAP drivers at each TBTT to get the beacon to transmit
+ *   (or to program into beacon memory).  The frame is patched in place
+ *   from a template and remains the property of the stack.  Returns NULL
+ *   if the template cannot be built.  If '*dtim' is set on return,
+ *   ieee80211_notify_dtim() must be called once the beacon has been sent.
+ *
+ ****************************************************************************/
+
+FAR const uint8_t *ieee80211_beacon_update(FAR struct ieee80211_s *ic,
+                                           uint64_t tsf,
+                                           FAR unsigned int *len,
+                                           FAR bool *dtim);
+#endif
+
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+/****************************************************************************
+ * Name: ieee80211_amsdu_initialize
+ *
+ * Description:
+ *   Reset the A-MSDU transmit aggregation state of the interface.
+ *
+ ****************************************************************************/
+
+void ieee80211_amsdu_initialize(FAR struct ieee80211_s *ic);
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_add
+ *
+ * Description:
+ *   Offer an Ethernet frame, classified to access category 'ac', to the
+ *   A-MSDU builder.  Returns OK if the frame was taken, or -ENOENT if it
+ *   cannot be aggregated and must be queued normally.  The network must be
+ *   locked.
+ *
+ ****************************************************************************/
+
+int ieee80211_amsdu_add(FAR struct ieee80211_s *ic, uint8_t ac,
+                        FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: ieee80211_amsdu_discard
+ *
+ * Description:
+ *   Free all frames held by the A-MSDU builder.  The network must be
+ *   locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_amsdu_discard(FAR struct ieee80211_s *ic);
+#endif
+
+#ifdef CONFIG_IEEE80211_HT
+/****************************************************************************
+ * Name: ieee80211_ampdu_enqueue
+ *
+ * Description:
+ *   Offer an encapsulated (and, if required, encrypted) QoS data MPDU to
+ *   the A-MPDU aggregation stage.  Returns OK if the MPDU was taken,
+ *   -ENOENT if there is no Block Ack agreement for its RA/TID (the caller
+ *   still owns the MPDU and sends it normally), or -ENOBUFS if the MPDU
+ *   was taken but had to be dropped.
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_enqueue(FAR struct ieee80211_s *ic,
+                            FAR struct ieee80211_node *ni,
+                            FAR struct iob_s *iob);
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_poll
+ *
+ * Description:
+ *   Called by the driver to collect A-MPDUs.  Each aggregate is limited by
+ *   the Block Ack window, by CONFIG_IEEE80211_AMPDU_MAXLEN bytes and by
+ *   CONFIG_IEEE80211_AMPDU_MAXUSEC of air time.  The callback return value
+ *   has the same meaning as for ieee80211_ifpoll().
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_poll(FAR struct ieee80211_s *ic,
+                         ieee80211_ampdu_txpoll_t callback);
+
+/****************************************************************************
+ * Name: ieee80211_ampdu_ack
+ *
+ * Description:
+ *   Report the BlockAck received for an A-MPDU (or a zero bitmap if none
+ *   was received).  BlockAcks must be reported in the order in which the
+ *   A-MPDUs of the RA/TID were collected.  Acknowledged subframes are
+ *   freed; the others are queued for retransmission in the next aggregate.
+ *
+ ****************************************************************************/
+
+int ieee80211_ampdu_ack(FAR struct ieee80211_s *ic,
+                        FAR struct ieee80211_node *ni, uint8_t tid,
+                        uint16_t ssn, uint64_t bitmap);
+#endif
+
+
 #endif /* __NET_IEEE80211_IEEE80211_IFNET_H */
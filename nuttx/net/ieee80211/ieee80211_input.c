@@ -41,6 +41,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <wdog.h>
+#include <crc32.h>
 #include <assert.h>
 #include <errno.h>
 #include <debug.h>
@@ -62,21 +63,15 @@
 #include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
 #include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_ratectl.h"
 
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
 
-struct iob_s *ieee80211_defrag(struct ieee80211_s *, struct iob_s *, int);
-void ieee80211_defrag_timeout(void *);
-#ifdef CONFIG_IEEE80211_HT
-void ieee80211_input_ba(struct ieee80211_s *, struct iob_s *,
-                        struct ieee80211_node *, int,
-                        struct ieee80211_rxinfo *);
-void ieee80211_ba_move_window(struct ieee80211_s *, struct ieee80211_node *,
-                              uint8_t, uint16_t);
+#ifdef CONFIG_IEEE80211_RXALIGN
+static struct iob_s *ieee80211_align_iobuf(struct iob_s *);
 #endif
-struct iob_s *ieee80211_align_iobuf(struct iob_s *);
 static void ieee80211_decap(struct ieee80211_s *, struct iob_s *,
                             struct ieee80211_node *, int);
 #ifdef CONFIG_IEEE80211_HT
@@ -139,6 +134,8 @@ void ieee80211_recv_bar(struct ieee80211_s *, struct iob_s *,
                         struct ieee80211_node *);
 void ieee80211_bar_tid(struct ieee80211_s *, struct ieee80211_node *,
                        uint8_t, uint16_t);
+void ieee80211_recv_ba(struct ieee80211_s *, struct iob_s *,
+                       struct ieee80211_node *);
 #endif
 
 /****************************************************************************
@@ -173,6 +170,66 @@ unsigned int ieee80211_get_hdrlen(FAR const struct ieee80211_frame *wh)
   return size;
 }
 
+/* Pass a data frame that has passed protection checks up the stack */
+
+static void ieee80211_input_data(FAR struct ieee80211_s *ic,
+                                 FAR struct iob_s *iob,
+                                 FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_tidstats *ts;
+  FAR struct ieee80211_frame *wh;
+  int hdrlen;
+
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  hdrlen = ieee80211_get_hdrlen(wh);
+
+  ts = IEEE80211_TIDSTATS(ni, ieee80211_has_qos(wh) ?
+                          ieee80211_get_qos(wh) & IEEE80211_QOS_TID : 0);
+  ts->ts_rxframes++;
+  ts->ts_rxbytes += iob->io_pktlen;
+
+  iob = ieee80211_defrag(ic, ni, iob, hdrlen);
+  if (iob == NULL)
+    {
+      return;
+    }
+
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+
+#ifdef CONFIG_IEEE80211_HT
+  if ((ni->ni_flags & IEEE80211_NODE_HT) && ieee80211_has_qos(wh) &&
+      (ieee80211_get_qos(wh) & IEEE80211_QOS_AMSDU))
+    ieee80211_amsdu_decap(ic, iob, ni, hdrlen);
+  else
+#endif
+    ieee80211_decap(ic, iob, ni, hdrlen);
+}
+
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+/* Completion of an asynchronous software/hardware decryption submitted by
+ * ieee80211_input().  'arg' is a reference to the transmitting node.
+ */
+
+static void ieee80211_input_decrypted(FAR struct ieee80211_s *ic,
+                                      FAR struct iob_s *iob, FAR void *arg)
+{
+  FAR struct ieee80211_node *ni = (FAR struct ieee80211_node *)arg;
+
+  if (iob != NULL)
+    {
+      ieee80211_input_data(ic, iob, ni);
+    }
+  else
+    {
+      /* Replays are only told apart for inline decryption */
+
+      ni->ni_stats.ns_decrypterrs++;
+    }
+
+  ieee80211_release_node(ic, ni);
+}
+#endif
+
 /* Process a received frame.  The node associated with the sender
  * should be supplied.  If nothing was found in the node table then
  * the caller is assumed to supply a reference to ic_bss instead.
@@ -190,6 +247,9 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
   uint16_t *orxseq, nrxseq, qos;
   uint8_t dir, type, subtype, tid;
   int hdrlen, hasqos;
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+  FAR struct ieee80211_key *k;
+#endif
 
   DEBUGASSERT(ni != NULL);
 
@@ -263,6 +323,20 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
       ni->ni_rssi = rxi->rxi_rssi;
       ni->ni_rstamp = rxi->rxi_tstamp;
       ni->ni_inact = 0;
+
+      /* Exponential moving average with a weight of 1/8 */
+
+      if (ni->ni_stats.ns_rssiavg == 0)
+        {
+          ni->ni_stats.ns_rssiavg = rxi->rxi_rssi << 4;
+        }
+      else
+        {
+          ni->ni_stats.ns_rssiavg += ((int)(rxi->rxi_rssi << 4) -
+                                      (int)ni->ni_stats.ns_rssiavg) / 8;
+        }
+
+      ieee80211_ratectl_input(ic, ni, rxi->rxi_rssi);
     }
 
 #ifdef CONFIG_IEEE80211_AP
@@ -299,8 +373,10 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
               FAR struct iob_s *iob;
 
               iob = iob_remove_queue(&ni->ni_savedq);
-              iob_add_queue(iob, &ic->ic_pwrsaveq);
+              (void)ieee80211_ifsend(ic, iob, IFSEND_PWRSAVE);
             }
+
+          ni->ni_savedqlen = 0;
         }
     }
 #endif
@@ -416,6 +492,16 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
           goto out;
         }
 
+      /* (QoS) Null frames only carry the Power Management bit, which has
+       * been handled above.
+       */
+
+      subtype = wh->i_fc[0] & IEEE80211_FC0_SUBTYPE_MASK;
+      if ((subtype & IEEE80211_FC0_SUBTYPE_NODATA) != 0)
+        {
+          goto out;
+        }
+
 #ifdef CONFIG_IEEE80211_HT
       if (!(rxi->rxi_flags & IEEE80211_RXI_AMPDU_DONE) &&
           hasqos && (qos & IEEE80211_QOS_ACK_POLICY_MASK) ==
@@ -423,7 +509,8 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
         {
           /* check if we have a BA agreement for this RA/TID */
 
-          if (ni->ni_rx_ba[tid].ba_state != IEEE80211_BA_AGREED)
+          if (ni->ni_ba == NULL ||
+              ni->ni_ba->nb_rx[tid].ba_state != IEEE80211_BA_AGREED)
             {
               ndbg("ERROR: no BA agreement for %s, TID %d\n",
                    ieee80211_addr2str(ni->ni_macaddr), tid);
@@ -458,6 +545,32 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
                   goto err;
                 }
 
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+              /* Hand the frame to the crypto engine; processing resumes in
+               * ieee80211_input_decrypted().  If the engine is out of
+               * requests the frame is dropped:  decrypting it here would
+               * advance the replay counter past the frames of the same key
+               * that are still queued, and they would then be discarded as
+               * replays.
+               */
+
+              k = ieee80211_get_rxkey(ic, iob, ni);
+              if (k == NULL)
+                {
+                  goto err;
+                }
+
+              if (ieee80211_crypto_submit(ic, iob, k,
+                                          IEEE80211_CRYPTO_DECRYPT,
+                                          ieee80211_input_decrypted,
+                                          ieee80211_ref_node(ni)) != OK)
+                {
+                  ieee80211_release_node(ic, ni);
+                  goto err;
+                }
+
+              return;           /* don't free iob! */
+#else
               /* Do software decryption */
 
               iob = ieee80211_decrypt(ic, iob, ni);
@@ -467,6 +580,7 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
                 }
 
               wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+#endif
             }
         }
       else if ((wh->i_fc[1] & IEEE80211_FC1_PROTECTED) ||
@@ -477,13 +591,7 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
           goto out;
         }
 
-#ifdef CONFIG_IEEE80211_HT
-      if ((ni->ni_flags & IEEE80211_NODE_HT) &&
-          hasqos && (qos & IEEE80211_QOS_AMSDU))
-        ieee80211_amsdu_decap(ic, iob, ni, hdrlen);
-      else
-#endif
-        ieee80211_decap(ic, iob, ni, hdrlen);
+      ieee80211_input_data(ic, iob, ni);
       return;
 
     case IEEE80211_FC0_TYPE_MGT:
@@ -570,6 +678,10 @@ void ieee80211_input(struct ieee80211_s *ic, struct iob_s *iob,
         case IEEE80211_FC0_SUBTYPE_BAR:
           ieee80211_recv_bar(ic, iob, ni);
           break;
+
+        case IEEE80211_FC0_SUBTYPE_BA:
+          ieee80211_recv_ba(ic, iob, ni);
+          break;
 #endif
         default:
           break;
@@ -592,272 +704,6 @@ out:
     }
 }
 
-/* Handle defragmentation (see 9.5 and Annex C).  We support the concurrent
- * reception of fragments of three fragmented MSDUs or MMPDUs.
- */
-
-struct iob_s *ieee80211_defrag(struct ieee80211_s *ic, struct iob_s *iob,
-                               int hdrlen)
-{
-  const struct ieee80211_frame *owh, *wh;
-  struct ieee80211_defrag *df;
-  uint16_t rxseq, seq;
-  uint8_t frag;
-  int i;
-
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
-  rxseq = letoh16(*(const uint16_t *)wh->i_seq);
-  seq = rxseq >> IEEE80211_SEQ_SEQ_SHIFT;
-  frag = rxseq & IEEE80211_SEQ_FRAG_MASK;
-
-  if (frag == 0 && !(wh->i_fc[1] & IEEE80211_FC1_MORE_FRAG))
-    return iob;                 /* not fragmented */
-
-  if (frag == 0)
-    {
-      /* first fragment, setup entry in the fragment cache */
-
-      if (++ic->ic_defrag_cur == IEEE80211_DEFRAG_SIZE)
-        ic->ic_defrag_cur = 0;
-
-      df = &ic->ic_defrag[ic->ic_defrag_cur];
-      if (df->df_m != NULL)
-        {
-          /* Discard old entry */
-
-          iob_free_chain(df->df_m);
-        }
-
-      df->df_seq = seq;
-      df->df_frag = 0;
-      df->df_m = iob;
-
-      /* Start receive MSDU timer of aMaxReceiveLifetime */
-
-      wd_start(df->df_to, SEC2TICK(1));
-      return NULL;              /* MSDU or MMPDU not yet complete */
-    }
-
-  /* find matching entry in the fragment cache */
-
-  for (i = 0; i < IEEE80211_DEFRAG_SIZE; i++)
-    {
-      df = &ic->ic_defrag[i];
-      if (df->df_m == NULL)
-        {
-          continue;
-        }
-
-      if (df->df_seq != seq || df->df_frag + 1 != frag)
-        {
-          continue;
-        }
-
-      owh = (FAR struct ieee80211_frame *)IOB_DATA(df->df_m);
-
-      /* Frame type, source and destination must match */
-
-      if (((wh->i_fc[0] ^ owh->i_fc[0]) & IEEE80211_FC0_TYPE_MASK) ||
-          !IEEE80211_ADDR_EQ(wh->i_addr1, owh->i_addr1) ||
-          !IEEE80211_ADDR_EQ(wh->i_addr2, owh->i_addr2))
-        {
-          continue;
-        }
-
-      /* Matching entry found */
-
-      break;
-    }
-
-  if (i == IEEE80211_DEFRAG_SIZE)
-    {
-      /* No matching entry found, discard fragment */
-
-      iob_free_chain(iob);
-      return NULL;
-    }
-
-  df->df_frag = frag;
-
-  /* Strip 802.11 header and concatenate fragment */
-
-  iob = iob_trimhead(iob, hdrlen);
-  iob_concat(df->df_m, iob);
-  df->df_m->io_pktlen += iob->io_pktlen;
-
-  if (wh->i_fc[1] & IEEE80211_FC1_MORE_FRAG)
-    return NULL;                /* MSDU or MMPDU not yet complete */
-
-  /* MSDU or MMPDU complete */
-
-  wd_cancel(df->df_to);
-  iob = df->df_m;
-  df->df_m = NULL;
-  return iob;
-}
-
-/* Receive MSDU defragmentation timer exceeds aMaxReceiveLifetime  */
-
-void ieee80211_defrag_timeout(void *arg)
-{
-  struct ieee80211_defrag *df = arg;
-  uip_lock_t flags = uip_lock();
-
-  /* Discard all received fragments */
-
-  iob_free_chain(df->df_m);
-  df->df_m = NULL;
-
-  uip_unlock(flags);
-}
-
-#ifdef CONFIG_IEEE80211_HT
-
-/* Process a received data MPDU related to a specific HT-immediate Block Ack
- * agreement (see 9.10.7.6).
- */
-
-void ieee80211_input_ba(struct ieee80211_s *ic, struct iob_s *iob,
-                        struct ieee80211_node *ni, int tid,
-                        struct ieee80211_rxinfo *rxi)
-{
-  struct ieee80211_rx_ba *ba = &ni->ni_rx_ba[tid];
-  struct ieee80211_frame *wh;
-  int idx, count;
-  uint16_t sn;
-
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
-  sn = letoh16(*(uint16_t *) wh->i_seq) >> IEEE80211_SEQ_SEQ_SHIFT;
-
-  /* reset Block Ack inactivity timer */
-
-  wd_start(ba->ba_to, USEC2TICK(ba->ba_timeout_val), ieee80211_rx_ba_timeout, 1,
-           ba);
-
-  if (SEQ_LT(sn, ba->ba_winstart))
-    {
-      /* SN < WinStartB, discard the MPDU */
-
-      iob_free_chain(iob);
-      return;
-    }
-
-  if (SEQ_LT(ba->ba_winend, sn))
-    {                           /* WinEndB < SN */
-      count = (sn - ba->ba_winend) & 0xfff;
-      if (count > ba->ba_winsize)       /* no overlap */
-        count = ba->ba_winsize;
-      while (count-- > 0)
-        {
-          /* Gaps may exist */
-
-          if (ba->ba_buf[ba->ba_head].iob != NULL)
-            {
-              ieee80211_input(ic, ba->ba_buf[ba->ba_head].iob,
-                              ni, &ba->ba_buf[ba->ba_head].rxi);
-              ba->ba_buf[ba->ba_head].iob = NULL;
-            }
-
-          ba->ba_head = (ba->ba_head + 1) % IEEE80211_BA_MAX_WINSZ;
-        }
-
-      /* Move window forward */
-
-      ba->ba_winend = sn;
-      ba->ba_winstart = (sn - ba->ba_winsize + 1) & 0xfff;
-    }
-
-  /* WinStartB <= SN <= WinEndB */
-
-  idx = (sn - ba->ba_winstart) & 0xfff;
-  idx = (ba->ba_head + idx) % IEEE80211_BA_MAX_WINSZ;
-
-  /* Store the received MPDU in the buffer */
-
-  if (ba->ba_buf[idx].iob != NULL)
-    {
-      iob_free_chain(iob);
-      return;
-    }
-
-  ba->ba_buf[idx].iob = iob;
-
-  /* Store Rx meta-data too */
-
-  rxi->rxi_flags |= IEEE80211_RXI_AMPDU_DONE;
-  ba->ba_buf[idx].rxi = *rxi;
-
-  /* Pass reordered MPDUs up to the next MAC process */
-
-  while (ba->ba_buf[ba->ba_head].iob != NULL)
-    {
-      ieee80211_input(ic, ba->ba_buf[ba->ba_head].iob, ni,
-                      &ba->ba_buf[ba->ba_head].rxi);
-      ba->ba_buf[ba->ba_head].iob = NULL;
-
-      ba->ba_head = (ba->ba_head + 1) % IEEE80211_BA_MAX_WINSZ;
-
-      /* Move window forward */
-
-      ba->ba_winstart = (ba->ba_winstart + 1) & 0xfff;
-    }
-
-  ba->ba_winend = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
-}
-
-/* Change the value of WinStartB (move window forward) upon reception of a
- * BlockAckReq frame or an ADDBA Request (PBAC).
- */
-
-void ieee80211_ba_move_window(struct ieee80211_s *ic,
-                              struct ieee80211_node *ni, uint8_t tid,
-                              uint16_t ssn)
-{
-  struct ieee80211_rx_ba *ba = &ni->ni_rx_ba[tid];
-  int count;
-
-  /* assert(WinStartB <= SSN) */
-
-  count = (ssn - ba->ba_winstart) & 0xfff;
-  if (count > ba->ba_winsize)   /* no overlap */
-    count = ba->ba_winsize;
-  while (count-- > 0)
-    {
-      /* Gaps may exist */
-
-      if (ba->ba_buf[ba->ba_head].iob != NULL)
-        {
-          ieee80211_input(ic, ba->ba_buf[ba->ba_head].iob, ni,
-                          &ba->ba_buf[ba->ba_head].rxi);
-          ba->ba_buf[ba->ba_head].iob = NULL;
-        }
-
-      ba->ba_head = (ba->ba_head + 1) % IEEE80211_BA_MAX_WINSZ;
-    }
-
-  /* Move window forward */
-
-  ba->ba_winstart = ssn;
-
-  /* Pass reordered MPDUs up to the next MAC process */
-
-  while (ba->ba_buf[ba->ba_head].iob != NULL)
-    {
-      ieee80211_input(ic, ba->ba_buf[ba->ba_head].iob, ni,
-                      &ba->ba_buf[ba->ba_head].rxi);
-      ba->ba_buf[ba->ba_head].iob = NULL;
-
-      ba->ba_head = (ba->ba_head + 1) % IEEE80211_BA_MAX_WINSZ;
-
-      /* Move window forward */
-
-      ba->ba_winstart = (ba->ba_winstart + 1) & 0xfff;
-    }
-
-  ba->ba_winend = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
-}
-#endif /* !CONFIG_IEEE80211_HT */
-
 static void ieee80211_deliver_data(FAR struct ieee80211_s *ic,
                                    FAR struct iob_s *iob,
                                    FAR struct ieee80211_node *ni)
@@ -926,157 +772,157 @@ static void ieee80211_deliver_data(FAR struct ieee80211_s *ic,
         }
       else
         {
-          ether_input_mbuf(ic, iob);
+          (void)ieee80211_ifinput(ic, iob);
         }
     }
 }
 
-#ifdef __STRICT_ALIGNMENT
+#ifdef CONFIG_IEEE80211_RXALIGN
 
 /* Make sure protocol header (e.g. IP) is aligned on a 32-bit boundary.
- * This is achieved by copying I/O buffers so drivers should try to map their
- * buffers such that this copying is not necessary.  It is however not
- * always possible because 802.11 header length may vary (non-QoS+LLC
- * is 32 bytes while QoS+LLC is 34 bytes).  Some devices are smart and
- * add 2 padding bytes after the 802.11 header in the QoS case so this
- * function is there for stupid drivers/devices only.
- *
- * XXX -- this is horrible
+ * This is achieved by copying the frame so drivers should rather set
+ * IEEE80211_C_RXALIGN and deliver frames whose body is aligned.  Devices
+ * that add 2 padding bytes after a QoS header only need to move the
+ * 802.11 header over the padding.
  */
 
-struct iob_s *ieee80211_align_iobuf(struct iob_s *iob)
+static struct iob_s *ieee80211_align_iobuf(struct iob_s *iob)
 {
-  struct iob_s *next, *next0, **np;
-  void *newdata;
-  int off, pktlen;
+  FAR struct iob_s *copy;
+  FAR struct iob_s *src;
+  unsigned int offset;
 
-  next0 = NULL;
-  np = &next0;
-  off = 0;
-  pktlen = iob->io_pktlen;
-  while (pktlen > off)
+  copy = iob_alloc(false);
+  if (copy == NULL)
     {
-      if (next0 == NULL)
-        {
-          next = iob_alloc(false);
-          if (next == NULL)
-            {
-              iob_free_chain(iob);
-              return NULL;
-            }
-
-          if (iob_clone(next, iob) < 0)
-            {
-              iob_free(next);
-              iob_free_chain(iob);
-              return NULL;
-            }
-
-          next->io_len = CONFIG_IEEE80211_BUFSIZE;
-        }
-      else
-        {
-          next = iob_alloc(false);
-          if (next == NULL)
-            {
-              iob_free_chain(iob);
-              iob_free_chain(next0);
-              return NULL;
-            }
-
-          next->io_len = 0;
-        }
+      iob_free_chain(iob);
+      return NULL;
+    }
 
-      if (next0 == NULL)
-        {
-          unsigned int offset;
+  /* Place the data so that what follows the Ethernet header is aligned */
 
-          newdata =
-            (FAR void *)ALIGN(IOB_DATA(next) + UIP_ETHH_LEN) - UIP_ETHH_LEN;
-          offset = newdata - IOB_DATA(next);
-          next->io_offset += offset;
-          next->io_len -= offset;
-        }
+  copy->io_offset = (4 - (UIP_ETHH_LEN & 3)) & 3;
 
-      if (next->io_len > pktlen - off)
+  for (src = iob, offset = 0; src != NULL; src = src->io_flink)
+    {
+      if (iob_copyin(copy, IOB_DATA(src), src->io_len, offset, false) < 0)
         {
-          next->io_len = pktlen - off;
+          iob_free_chain(copy);
+          iob_free_chain(iob);
+          return NULL;
         }
 
-      iob_copyout(IOB_DATA(next), iob, off, next->io_len);
-      off += next->io_len;
-      *np = next;
-      np = next->io_flink;
+      offset += src->io_len;
     }
 
+  /* The packet header goes with the data */
+
+  copy->io_pkthdr = iob->io_pkthdr;
+  iob->io_pkthdr  = NULL;
+
   iob_free_chain(iob);
-  return next0;
+  return copy;
 }
-#endif /* __STRICT_ALIGNMENT */
+#endif /* CONFIG_IEEE80211_RXALIGN */
+
+/* Convert an 802.11 data frame to an Ethernet frame.  Drivers are expected
+ * to deliver the 802.11 and LLC/SNAP headers in the head I/O buffer: the
+ * Ethernet header is then built in place, in front of the payload, and
+ * no data is moved.
+ */
 
 static void ieee80211_decap(struct ieee80211_s *ic, struct iob_s *iob,
                             struct ieee80211_node *ni, int hdrlen)
 {
-  struct uip_eth_hdr ethhdr;
+  uint8_t addr[2 * IEEE80211_ADDR_LEN];
+  struct uip_eth_hdr *ethhdr;
   struct ieee80211_frame *wh;
   struct llc *llc;
+  unsigned int trim;
+  uint16_t type;
 
-  if (iob->io_len < hdrlen + LLC_SNAPFRAMELEN && (iob = iob_pack(iob)) == NULL)
+  if (iob->io_len < hdrlen + LLC_SNAPFRAMELEN)
     {
-      return;
+      /* Slow path for drivers that split the headers */
+
+      iob = iob_pack(iob);
+      if (iob == NULL || iob->io_len < hdrlen + LLC_SNAPFRAMELEN)
+        {
+          if (iob != NULL)
+            {
+              iob_free_chain(iob);
+            }
+
+          return;
+        }
     }
 
+  /* Save the destination and source addresses: the Ethernet header
+   * overlaps the 802.11 header.
+   */
+
   wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
   switch (wh->i_fc[1] & IEEE80211_FC1_DIR_MASK)
     {
     case IEEE80211_FC1_DIR_NODS:
-      IEEE80211_ADDR_COPY(ethhdr.dest, wh->i_addr1);
-      IEEE80211_ADDR_COPY(ethhdr.src, wh->i_addr2);
+      IEEE80211_ADDR_COPY(&addr[0], wh->i_addr1);
+      IEEE80211_ADDR_COPY(&addr[IEEE80211_ADDR_LEN], wh->i_addr2);
       break;
 
     case IEEE80211_FC1_DIR_TODS:
-      IEEE80211_ADDR_COPY(ethhdr.dest, wh->i_addr3);
-      IEEE80211_ADDR_COPY(ethhdr.src, wh->i_addr2);
+      IEEE80211_ADDR_COPY(&addr[0], wh->i_addr3);
+      IEEE80211_ADDR_COPY(&addr[IEEE80211_ADDR_LEN], wh->i_addr2);
       break;
 
     case IEEE80211_FC1_DIR_FROMDS:
-      IEEE80211_ADDR_COPY(ethhdr.dest, wh->i_addr1);
-      IEEE80211_ADDR_COPY(ethhdr.src, wh->i_addr3);
+      IEEE80211_ADDR_COPY(&addr[0], wh->i_addr1);
+      IEEE80211_ADDR_COPY(&addr[IEEE80211_ADDR_LEN], wh->i_addr3);
       break;
 
     case IEEE80211_FC1_DIR_DSTODS:
-      IEEE80211_ADDR_COPY(ethhdr.dest, wh->i_addr3);
-      IEEE80211_ADDR_COPY(ethhdr.src,
+      IEEE80211_ADDR_COPY(&addr[0], wh->i_addr3);
+      IEEE80211_ADDR_COPY(&addr[IEEE80211_ADDR_LEN],
                           ((struct ieee80211_frame_addr4 *)wh)->i_addr4);
       break;
     }
 
-  llc = (struct llc *)((void *)wh + hdrlen);
+  llc = (struct llc *)((FAR uint8_t *)wh + hdrlen);
   if (llc->llc_dsap == LLC_SNAP_LSAP &&
       llc->llc_ssap == LLC_SNAP_LSAP &&
       llc->llc_control == LLC_UI &&
       llc->llc_snap.org_code[0] == 0 &&
       llc->llc_snap.org_code[1] == 0 && llc->llc_snap.org_code[2] == 0)
     {
-      ethhdr.type = llc->llc_snap.type;
-      iob = iob_trimhead(iob, hdrlen + LLC_SNAPFRAMELEN - UIP_ETHH_LEN);
+      type = llc->llc_snap.type;
+      trim = hdrlen + LLC_SNAPFRAMELEN - UIP_ETHH_LEN;
     }
   else
     {
-      ethhdr.type = htons(iob->io_pktlen - hdrlen);
-      iob = iob_trimhead(iob, hdrlen - UIP_ETHH_LEN);
+      type = htons(iob->io_pktlen - hdrlen);
+      trim = hdrlen - UIP_ETHH_LEN;
     }
 
-  memcpy(IOB_DATA(iob), &ethhdr, UIP_ETHH_LEN);
+  /* The trimmed bytes all lie in the head I/O buffer */
 
-#ifdef __STRICT_ALIGNMENT
-  if (!ALIGNED_POINTER(IOB_DATA(iob) + UIP_ETHH_LEN, uint32_t))
+  iob->io_offset += trim;
+  iob->io_len    -= trim;
+  iob->io_pktlen -= trim;
+
+  ethhdr = (FAR struct uip_eth_hdr *)IOB_DATA(iob);
+  memcpy(ethhdr, addr, sizeof(addr));
+  ethhdr->type = type;
+
+#ifdef CONFIG_IEEE80211_RXALIGN
+  if ((ic->ic_caps & IEEE80211_C_RXALIGN) == 0 &&
+      (((uintptr_t)IOB_DATA(iob) + UIP_ETHH_LEN) & 3) != 0)
     {
       if ((iob = ieee80211_align_iobuf(iob)) == NULL)
         {
           return;
         }
     }
+
+  DEBUGASSERT((((uintptr_t)IOB_DATA(iob) + UIP_ETHH_LEN) & 3) == 0);
 #endif
 
   ieee80211_deliver_data(ic, iob, ni);
@@ -1479,6 +1325,116 @@ int ieee80211_save_ie(const uint8_t * frm, uint8_t ** ie)
   return 0;
 }
 
+/* Walk the information elements between frm and efrm once and record where
+ * each element of interest starts.  The walk stops at the first element that
+ * overruns the frame.  If crcp is not NULL, it is used as the seed of a CRC-32
+ * computed over all elements except the TIM, whose contents change with every
+ * beacon, and the result is stored back into it.
+ */
+
+void ieee80211_index_ies(struct ieee80211_ies *ies, const uint8_t *frm,
+                         const uint8_t *efrm, uint32_t *crcp)
+{
+  const uint8_t *start;
+  uint32_t crc;
+  int ndx;
+
+  memset(ies, 0, sizeof(*ies));
+  start = frm;
+  crc = crcp != NULL ? *crcp : 0;
+
+  while (frm + 2 <= efrm && frm + 2 + frm[1] <= efrm)
+    {
+      ndx = IEEE80211_IE_MAX;
+      switch (frm[0])
+        {
+        case IEEE80211_ELEMID_SSID:
+          ndx = IEEE80211_IE_SSID;
+          break;
+
+        case IEEE80211_ELEMID_RATES:
+          ndx = IEEE80211_IE_RATES;
+          break;
+
+        case IEEE80211_ELEMID_DSPARMS:
+          if (frm[1] >= 1)
+            {
+              ndx = IEEE80211_IE_DSPARMS;
+            }
+          break;
+
+        case IEEE80211_ELEMID_TIM:
+          ndx = IEEE80211_IE_TIM;
+
+          /* Checksum everything up to the TIM, then skip over it */
+
+          if (crcp != NULL)
+            {
+              crc = crc32part(start, frm - start, crc);
+              start = frm + 2 + frm[1];
+            }
+          break;
+
+        case IEEE80211_ELEMID_XRATES:
+          ndx = IEEE80211_IE_XRATES;
+          break;
+
+        case IEEE80211_ELEMID_ERP:
+          if (frm[1] >= 1)
+            {
+              ndx = IEEE80211_IE_ERP;
+            }
+          break;
+
+        case IEEE80211_ELEMID_RSN:
+          ndx = IEEE80211_IE_RSN;
+          break;
+
+        case IEEE80211_ELEMID_QOS_CAP:
+          ndx = IEEE80211_IE_QOS_CAP;
+          break;
+
+        case IEEE80211_ELEMID_EDCAPARMS:
+          ndx = IEEE80211_IE_EDCAPARMS;
+          break;
+
+        case IEEE80211_ELEMID_HTCAPS:
+          ndx = IEEE80211_IE_HTCAPS;
+          break;
+
+        case IEEE80211_ELEMID_HTOP:
+          ndx = IEEE80211_IE_HTOP;
+          break;
+
+        case IEEE80211_ELEMID_VENDOR:
+          if (frm[1] >= 4 && memcmp(frm + 2, MICROSOFT_OUI, 3) == 0)
+            {
+              if (frm[5] == 1)
+                {
+                  ndx = IEEE80211_IE_WPA;
+                }
+              else if (frm[1] >= 5 && frm[5] == 2 && frm[6] == 1)
+                {
+                  ndx = IEEE80211_IE_WMM;
+                }
+            }
+          break;
+        }
+
+      if (ndx != IEEE80211_IE_MAX)
+        {
+          ies->ie[ndx] = frm;
+        }
+
+      frm += 2 + frm[1];
+    }
+
+  if (crcp != NULL)
+    {
+      *crcp = crc32part(start, frm - start, crc);
+    }
+}
+
 /* Beacon/Probe response frame format:
  * [8]   Timestamp
  * [2]   Beacon interval
@@ -1510,10 +1466,8 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
   const uint8_t *wmmie;
   const uint8_t *rsnie;
   const uint8_t *wpaie;
-#ifdef CONFIG_IEEE80211_HT
-  const uint8_t *htcaps;
-  const uint8_t *htop;
-#endif
+  struct ieee80211_ies ies;
+  uint32_t crc;
   uint16_t capinfo;
   uint16_t bintval;
   uint8_t chan;
@@ -1532,126 +1486,63 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
    */
 
   DEBUGASSERT(ic->ic_opmode == IEEE80211_M_STA ||
-#ifdef CONFIG_IEEE80211_AP
-              ic->ic_opmode == IEEE80211_M_IBSS ||
-              ic->ic_opmode == IEEE80211_M_HOSTAP ||
-#endif
-              ic->ic_state == IEEE80211_S_SCAN);
-
-  /* Make sure all mandatory fixed fields are present */
-
-  if (iob->io_len < sizeof(*wh) + 12)
-    {
-      ndbg("ERROR: frame too short\n");
-      return;
-    }
-
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
-  frm = (const uint8_t *)&wh[1];
-  efrm = IOB_DATA(iob) + iob->io_len;
-
-  tstamp = frm;
-  frm += 8;
-  bintval = LE_READ_2(frm);
-  frm += 2;
-  capinfo = LE_READ_2(frm);
-  frm += 2;
-
-  ssid = NULL;
-  rates = NULL;
-  xrates = NULL;
-  edcaie = NULL;
-  wmmie = NULL;
-  rsnie NULL;
-  wpaie = NULL;
-
-#ifdef CONFIG_IEEE80211_HT
-  htcaps = NULL;
-  htop = NULL;
-#endif
-
-  bchan = ieee80211_chan2ieee(ic, ic->ic_bss->ni_chan);
-  chan = bchan;
-  erp = 0;
-  while (frm + 2 <= efrm)
-    {
-      if (frm + 2 + frm[1] > efrm)
-        {
-          break;
-        }
-
-      switch (frm[0])
-        {
-        case IEEE80211_ELEMID_SSID:
-          ssid = frm;
-          break;
-
-        case IEEE80211_ELEMID_RATES:
-          rates = frm;
-          break;
-
-        case IEEE80211_ELEMID_DSPARMS:
-          if (frm[1] < 1)
-            {
-              break;
-            }
-
-          chan = frm[2];
-          break;
-
-        case IEEE80211_ELEMID_XRATES:
-          xrates = frm;
-          break;
-
-        case IEEE80211_ELEMID_ERP:
-          if (frm[1] < 1)
-            {
-              break;
-            }
+#ifdef CONFIG_IEEE80211_AP
+              ic->ic_opmode == IEEE80211_M_IBSS ||
+              ic->ic_opmode == IEEE80211_M_HOSTAP ||
+#endif
+              ic->ic_state == IEEE80211_S_SCAN);
 
-          erp = frm[2];
-          break;
+  /* Make sure all mandatory fixed fields are present */
 
-        case IEEE80211_ELEMID_RSN:
-          rsnie = frm;
-          break;
+  if (iob->io_len < sizeof(*wh) + 12)
+    {
+      ndbg("ERROR: frame too short\n");
+      return;
+    }
 
-        case IEEE80211_ELEMID_EDCAPARMS:
-          edcaie = frm;
-          break;
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  frm = (const uint8_t *)&wh[1];
+  efrm = IOB_DATA(iob) + iob->io_len;
 
-#ifdef CONFIG_IEEE80211_HT
-        case IEEE80211_ELEMID_HTCAPS:
-          htcaps = frm;
-          break;
+  tstamp = frm;
+  frm += 8;
+  bintval = LE_READ_2(frm);
+  frm += 2;
+  capinfo = LE_READ_2(frm);
+  frm += 2;
 
-        case IEEE80211_ELEMID_HTOP:
-          htop = frm;
-          break;
-#endif
+  /* The checksum covers the beacon interval, the capabilities and all
+   * elements but the TIM.  Beacons are parsed further while scanning (RSN
+   * parameters are collected), so a checksum taken while scanning must never
+   * match one taken outside of a scan.
+   */
 
-        case IEEE80211_ELEMID_VENDOR:
-          if (frm[1] < 4)
-            {
-              break;
-            }
+  crc = crc32part(frm - 4, 4, 0);
+  ieee80211_index_ies(&ies, frm, efrm, &crc);
+  if (IEEE80211_SCANNING(ic))
+    {
+      crc = ~crc;
+    }
 
-          if (memcmp(frm + 2, MICROSOFT_OUI, 3) == 0)
-            {
-              if (frm[5] == 1)
-                {
-                  wpaie = frm;
-                }
-              else if (frm[1] >= 5 && frm[5] == 2 && frm[6] == 1)
-                {
-                  wmmie = frm;
-                }
-            }
+  ssid = ies.ie[IEEE80211_IE_SSID];
+  rates = ies.ie[IEEE80211_IE_RATES];
+  xrates = ies.ie[IEEE80211_IE_XRATES];
+  edcaie = ies.ie[IEEE80211_IE_EDCAPARMS];
+  wmmie = ies.ie[IEEE80211_IE_WMM];
+  rsnie = ies.ie[IEEE80211_IE_RSN];
+  wpaie = ies.ie[IEEE80211_IE_WPA];
 
-          break;
-        }
+  bchan = ieee80211_chan2ieee(ic, IEEE80211_CURCHAN(ic));
+  chan = bchan;
+  if (ies.ie[IEEE80211_IE_DSPARMS] != NULL)
+    {
+      chan = ies.ie[IEEE80211_IE_DSPARMS][2];
+    }
 
-      frm += 2 + frm[1];
+  erp = 0;
+  if (ies.ie[IEEE80211_IE_ERP] != NULL)
+    {
+      erp = ies.ie[IEEE80211_IE_ERP][2];
     }
 
   /* Supported rates element is mandatory */
@@ -1685,7 +1576,7 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
       return;
     }
 
-  if ((ic->ic_state != IEEE80211_S_SCAN ||
+  if ((!IEEE80211_SCANNING(ic) ||
        !(ic->ic_caps & IEEE80211_C_SCANALL)) && chan != bchan)
     {
       /* Frame was received on a channel different from the one indicated in
@@ -1713,7 +1604,7 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
     }
 
 #ifdef CONFIG_DEBUG_NET
-  if ((ni == NULL || ic->ic_state == IEEE80211_S_SCAN))
+  if ((ni == NULL || IEEE80211_SCANNING(ic)))
     {
       nvdbg("%s%s on chan %u (bss chan %u) ",
             (ni == NULL ? "new " : ""),
@@ -1739,6 +1630,15 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
   else
     {
       is_new = 0;
+
+      /* Nothing but the TSF and the TIM changed since the last beacon from
+       * this node: skip the element processing and only refresh timestamps.
+       */
+
+      if (!isprobe && ni->ni_iecrc == crc)
+        {
+          goto refresh;
+        }
     }
 
   /* When operating in station mode, check for state updates while we're
@@ -1799,7 +1699,7 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
         }
     }
 
-  if (ic->ic_state == IEEE80211_S_SCAN &&
+  if (IEEE80211_SCANNING(ic) &&
 #ifdef CONFIG_IEEE80211_AP
       ic->ic_opmode != IEEE80211_M_HOSTAP &&
 #endif
@@ -1842,7 +1742,7 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
           ni->ni_rsnprotos = IEEE80211_PROTO_NONE;
         }
     }
-  else if (ic->ic_state == IEEE80211_S_SCAN)
+  else if (IEEE80211_SCANNING(ic))
     {
       ni->ni_rsnprotos = IEEE80211_PROTO_NONE;
     }
@@ -1857,10 +1757,6 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
       memcpy(ni->ni_essid, &ssid[2], ssid[1]);
     }
 
-  IEEE80211_ADDR_COPY(ni->ni_bssid, wh->i_addr3);
-  ni->ni_rssi = rxi->rxi_rssi;
-  ni->ni_rstamp = rxi->rxi_tstamp;
-  memcpy(ni->ni_tstamp, tstamp, sizeof(ni->ni_tstamp));
   ni->ni_intval = bintval;
   ni->ni_capinfo = capinfo;
 
@@ -1873,6 +1769,17 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
 
   ieee80211_setup_rates(ic, ni, rates, xrates, IEEE80211_F_DOSORT);
 
+  /* Probe responses carry a different set of elements than beacons */
+
+  ni->ni_iecrc = isprobe ? 0 : crc;
+
+refresh:
+  IEEE80211_ADDR_COPY(ni->ni_bssid, wh->i_addr3);
+  ni->ni_rssi = rxi->rxi_rssi;
+  ni->ni_rstamp = rxi->rxi_tstamp;
+  ni->ni_lastseen = clock_systimer();
+  memcpy(ni->ni_tstamp, tstamp, sizeof(ni->ni_tstamp));
+
   /* When scanning we record results (nodes) with a zero refcnt.  Otherwise we
    * want to hold the reference for ibss neighbors so the nodes don't get
    * released prematurely. Anything else can be discarded (XXX and should be
@@ -1890,6 +1797,13 @@ void ieee80211_recv_probe_resp(struct ieee80211_s *ic, struct iob_s *iob,
        * operation.
        */
 
+#ifdef CONFIG_IEEE80211_AP
+      if (is_new && ic->ic_opmode == IEEE80211_M_IBSS)
+        {
+          ieee80211_ratectl_node_init(ic, ni);
+        }
+#endif
+
       if (ic->ic_newassoc)
         {
           (*ic->ic_newassoc) (ic, ni, 1);
@@ -1916,9 +1830,7 @@ void ieee80211_recv_probe_req(struct ieee80211_s *ic, struct iob_s *iob,
   const uint8_t *ssid;
   const uint8_t *rates;
   const uint8_t *xrates;
-#  ifdef CONFIG_IEEE80211_HT
-  const uint8_t *htcaps;
-#  endif
+  struct ieee80211_ies ies;
   uint8_t rate;
 
   if (ic->ic_opmode == IEEE80211_M_STA || ic->ic_state != IEEE80211_S_RUN)
@@ -1928,39 +1840,10 @@ void ieee80211_recv_probe_req(struct ieee80211_s *ic, struct iob_s *iob,
   frm = (const uint8_t *)&wh[1];
   efrm = IOB_DATA(iob) + iob->io_len;
 
-  ssid = NULL;
-  rates = NULL;
-  xrates = NULL;
-#  ifdef CONFIG_IEEE80211_HT
-  htcaps = NULL;
-#  endif
-
-  while (frm + 2 <= efrm)
-    {
-      if (frm + 2 + frm[1] > efrm)
-        {
-          break;
-        }
-
-      switch (frm[0])
-        {
-        case IEEE80211_ELEMID_SSID:
-          ssid = frm;
-          break;
-        case IEEE80211_ELEMID_RATES:
-          rates = frm;
-          break;
-        case IEEE80211_ELEMID_XRATES:
-          xrates = frm;
-          break;
-#  ifdef CONFIG_IEEE80211_HT
-        case IEEE80211_ELEMID_HTCAPS:
-          htcaps = frm;
-          break;
-#  endif
-        }
-      frm += 2 + frm[1];
-    }
+  ieee80211_index_ies(&ies, frm, efrm, NULL);
+  ssid = ies.ie[IEEE80211_IE_SSID];
+  rates = ies.ie[IEEE80211_IE_RATES];
+  xrates = ies.ie[IEEE80211_IE_XRATES];
 
   /* supported rates element is mandatory */
 
@@ -2104,9 +1987,7 @@ void ieee80211_recv_assoc_req(struct ieee80211_s *ic, struct iob_s *iob,
   const uint8_t *xrates;
   const uint8_t *rsnie;
   const uint8_t *wpaie;
-#  ifdef CONFIG_IEEE80211_HT
-  const uint8_t *htcaps;
-#  endif
+  struct ieee80211_ies ies;
   uint16_t capinfo;
   uint16_t bintval;
   int resp;
@@ -2148,57 +2029,12 @@ void ieee80211_recv_assoc_req(struct ieee80211_s *ic, struct iob_s *iob,
   else
     resp = IEEE80211_FC0_SUBTYPE_ASSOC_RESP;
 
-  ssid = NULL;
-  rates = NULL;
-  xrates = NULL;
-  rsnie = NULL;
-  wpaie = NULL;
-#  ifdef CONFIG_IEEE80211_HT
-  htcaps = NULL;
-#  endif
-
-  while (frm + 2 <= efrm)
-    {
-      if (frm + 2 + frm[1] > efrm)
-        {
-          break;
-        }
-
-      switch (frm[0])
-        {
-        case IEEE80211_ELEMID_SSID:
-          ssid = frm;
-          break;
-        case IEEE80211_ELEMID_RATES:
-          rates = frm;
-          break;
-        case IEEE80211_ELEMID_XRATES:
-          xrates = frm;
-          break;
-        case IEEE80211_ELEMID_RSN:
-          rsnie = frm;
-          break;
-        case IEEE80211_ELEMID_QOS_CAP:
-          break;
-#  ifdef CONFIG_IEEE80211_HT
-        case IEEE80211_ELEMID_HTCAPS:
-          htcaps = frm;
-          break;
-#  endif
-        case IEEE80211_ELEMID_VENDOR:
-          if (frm[1] < 4)
-            {
-              break;
-            }
-          if (memcmp(frm + 2, MICROSOFT_OUI, 3) == 0)
-            {
-              if (frm[5] == 1)
-                wpaie = frm;
-            }
-          break;
-        }
-      frm += 2 + frm[1];
-    }
+  ieee80211_index_ies(&ies, frm, efrm, NULL);
+  ssid = ies.ie[IEEE80211_IE_SSID];
+  rates = ies.ie[IEEE80211_IE_RATES];
+  xrates = ies.ie[IEEE80211_IE_XRATES];
+  rsnie = ies.ie[IEEE80211_IE_RSN];
+  wpaie = ies.ie[IEEE80211_IE_WPA];
 
   /* supported rates element is mandatory */
 
@@ -2392,7 +2228,8 @@ void ieee80211_recv_assoc_req(struct ieee80211_s *ic, struct iob_s *iob,
 
       /* everything looks fine, save IE and parameters */
 
-      if (ieee80211_save_ie(saveie, &ni->ni_rsnie) != 0)
+      if (ieee80211_save_ie(saveie, &ni->ni_rsnie) != 0 ||
+          ieee80211_node_rsn_attach(ni) < 0)
         {
           status = IEEE80211_STATUS_TOOMANY;
           goto end;
@@ -2403,32 +2240,16 @@ void ieee80211_recv_assoc_req(struct ieee80211_s *ic, struct iob_s *iob,
       ni->ni_rsngroupmgmtcipher = ic->ic_bss->ni_rsngroupmgmtcipher;
       ni->ni_rsncaps = rsn.rsn_caps;
 
+      /* Check if we have a cached PMK entry matching one of the PMKIDs
+       * specified in the RSN IE; if so, node_join skips 802.1X and starts
+       * the 4-way handshake.
+       */
+
+      ni->ni_flags &= ~IEEE80211_NODE_PMK;
       if (ieee80211_is_8021x_akm(ni->ni_rsnakms))
         {
-          struct ieee80211_pmk *pmk = NULL;
-          const uint8_t *pmkid = rsn.rsn_pmkids;
-
-          /* Check if we have a cached PMK entry matching one of the PMKIDs
-           * specified in the RSN IE.
-           */
-
-          while (rsn.rsn_npmkids-- > 0)
-            {
-              pmk = ieee80211_pmksa_find(ic, ni, pmkid);
-              if (pmk != NULL)
-                {
-                  break;
-                }
-
-              pmkid += IEEE80211_PMKID_LEN;
-            }
-
-          if (pmk != NULL)
-            {
-              memcpy(ni->ni_pmk, pmk->pmk_key, IEEE80211_PMK_LEN);
-              memcpy(ni->ni_pmkid, pmk->pmk_pmkid, IEEE80211_PMKID_LEN);
-              ni->ni_flags |= IEEE80211_NODE_PMK;
-            }
+          (void)ieee80211_pmksa_match(ic, ni, rsn.rsn_pmkids,
+                                      rsn.rsn_npmkids);
         }
     }
   else
@@ -2471,10 +2292,7 @@ void ieee80211_recv_assoc_resp(struct ieee80211_s *ic, struct iob_s *iob,
   const uint8_t *xrates;
   const uint8_t *edcaie;
   const uint8_t *wmmie;
-#ifdef CONFIG_IEEE80211_HT
-  const uint8_t *htcaps;
-  const uint8_t *htop;
-#endif
+  struct ieee80211_ies ies;
   uint16_t capinfo;
   uint16_t status;
   uint16_t associd;
@@ -2517,55 +2335,11 @@ void ieee80211_recv_assoc_resp(struct ieee80211_s *ic, struct iob_s *iob,
   associd = LE_READ_2(frm);
   frm += 2;
 
-  rates = NULL;
-  xrates = NULL;
-  edcaie = NULL;
-  wmmie = NULL;
-#ifdef CONFIG_IEEE80211_HT
-  htcaps = NULL;
-  htop = NULL;
-#endif
-
-  while (frm + 2 <= efrm)
-    {
-      if (frm + 2 + frm[1] > efrm)
-        {
-          break;
-        }
-
-      switch (frm[0])
-        {
-        case IEEE80211_ELEMID_RATES:
-          rates = frm;
-          break;
-        case IEEE80211_ELEMID_XRATES:
-          xrates = frm;
-          break;
-        case IEEE80211_ELEMID_EDCAPARMS:
-          edcaie = frm;
-          break;
-#ifdef CONFIG_IEEE80211_HT
-        case IEEE80211_ELEMID_HTCAPS:
-          htcaps = frm;
-          break;
-        case IEEE80211_ELEMID_HTOP:
-          htop = frm;
-          break;
-#endif
-        case IEEE80211_ELEMID_VENDOR:
-          if (frm[1] < 4)
-            {
-              break;
-            }
-          if (memcmp(frm + 2, MICROSOFT_OUI, 3) == 0)
-            {
-              if (frm[1] >= 5 && frm[5] == 2 && frm[6] == 1)
-                wmmie = frm;
-            }
-          break;
-        }
-      frm += 2 + frm[1];
-    }
+  ieee80211_index_ies(&ies, frm, efrm, NULL);
+  rates = ies.ie[IEEE80211_IE_RATES];
+  xrates = ies.ie[IEEE80211_IE_XRATES];
+  edcaie = ies.ie[IEEE80211_IE_EDCAPARMS];
+  wmmie = ies.ie[IEEE80211_IE_WMM];
 
   /* Supported rates element is mandatory */
 
@@ -2789,7 +2563,15 @@ void ieee80211_recv_addba_req(struct ieee80211_s *ic, struct iob_s *iob,
   timeout = LE_READ_2(&frm[5]);
   ssn = LE_READ_2(&frm[7]) >> 4;
 
-  ba = &ni->ni_rx_ba[tid];
+  /* Block Ack records are only attached to peers that use them */
+
+  if (ieee80211_node_ba_attach(ni) < 0)
+    {
+      status = IEEE80211_STATUS_REFUSED;
+      goto resp;
+    }
+
+  ba = &ni->ni_ba->nb_rx[tid];
 
   /* check if we already have a Block Ack agreement for this RA/TID */
 
@@ -2858,25 +2640,21 @@ void ieee80211_recv_addba_req(struct ieee80211_s *ic, struct iob_s *iob,
   ba->ba_winstart = ssn;
   ba->ba_winend = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
 
-  /* Allocate and setup our reordering buffer */
+  /* Allocate and setup our reordering buffer, sized to the window */
 
-  ba->ba_buf = kmalloc(IEEE80211_BA_MAX_WINSZ * sizeof(*ba->ba_buf));
-  if (ba->ba_buf == NULL)
+  if (ieee80211_reorder_alloc(ba) < 0)
     {
       status = IEEE80211_STATUS_REFUSED;
       goto resp;
     }
 
-  ba->ba_head = 0;
-
   /* Notify drivers of this new Block Ack agreement */
 
   if (ic->ic_ampdu_rx_start != NULL && ic->ic_ampdu_rx_start(ic, ni, tid) != 0)
     {
       /* Driver failed to setup, rollback */
 
-      kfree(ba->ba_buf);
-      ba->ba_buf = NULL;
+      ieee80211_reorder_free(ba);
       status = IEEE80211_STATUS_REFUSED;
       goto resp;
     }
@@ -2937,12 +2715,14 @@ void ieee80211_recv_addba_resp(struct ieee80211_s *ic, struct iob_s *iob,
    * have a Block Ack agreement.
    */
 
-  ba = &ni->ni_tx_ba[tid];
-  if (ba->ba_state != IEEE80211_BA_REQUESTED)
+  if (ni->ni_ba == NULL ||
+      ni->ni_ba->nb_tx[tid].ba_state != IEEE80211_BA_REQUESTED)
     {
       ndbg("ERROR: no matching ADDBA req found\n");
       return;
     }
+
+  ba = &ni->ni_ba->nb_tx[tid];
   if (token != ba->ba_token)
     {
       ndbg("ERROR: ignoring ADDBA resp from %s: token %x!=%x\n",
@@ -2966,6 +2746,22 @@ void ieee80211_recv_addba_resp(struct ieee80211_s *ic, struct iob_s *iob,
 
   ba->ba_state = IEEE80211_BA_AGREED;
 
+  /* The recipient may have asked for a smaller window */
+
+  if (bufsz != 0 && bufsz < ba->ba_winsize)
+    {
+      ba->ba_winsize = bufsz;
+      ba->ba_winend = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
+    }
+
+  /* set up A-MPDU aggregation; give up the agreement if we cannot */
+
+  if (ieee80211_ampdu_start(ic, ni, tid) < 0)
+    {
+      ieee80211_delba_request(ic, ni, IEEE80211_REASON_UNSPECIFIED, 1, tid);
+      return;
+    }
+
   /* notify drivers of this new Block Ack agreement */
 
   if (ic->ic_ampdu_tx_start != NULL)
@@ -2974,7 +2770,7 @@ void ieee80211_recv_addba_resp(struct ieee80211_s *ic, struct iob_s *iob,
   /* start Block Ack inactivity timeout */
 
   if (ba->ba_timeout_val != 0)
-    wd_start(ba->ba_to, USEC2TICK(ba->ba_timeout_val), ieee80211_rx_ba_timeout,
+    wd_start(ba->ba_to, USEC2TICK(ba->ba_timeout_val), ieee80211_tx_ba_timeout,
              1, ba);
 }
 
@@ -2992,7 +2788,6 @@ void ieee80211_recv_delba(struct ieee80211_s *ic, struct iob_s *iob,
   const uint8_t *frm;
   uint16_t params, reason;
   uint8_t tid;
-  int i;
 
   if (iob->io_len < sizeof(*wh) + 6)
     {
@@ -3010,11 +2805,17 @@ void ieee80211_recv_delba(struct ieee80211_s *ic, struct iob_s *iob,
   nvdbg("received DELBA from %s, TID %d, reason %d\n",
         ieee80211_addr2str(ni->ni_macaddr), tid, reason);
 
+  if (ni->ni_ba == NULL)
+    {
+      ndbg("ERROR: no matching Block Ack agreement\n");
+      return;
+    }
+
   if (params & IEEE80211_DELBA_INITIATOR)
     {
       /* MLME-DELBA.indication(Originator) */
 
-      struct ieee80211_rx_ba *ba = &ni->ni_rx_ba[tid];
+      struct ieee80211_rx_ba *ba = &ni->ni_ba->nb_rx[tid];
 
       if (ba->ba_state != IEEE80211_BA_AGREED)
         {
@@ -3033,29 +2834,15 @@ void ieee80211_recv_delba(struct ieee80211_s *ic, struct iob_s *iob,
 
       wd_cancel(ba->ba_to);
 
-      if (ba->ba_buf != NULL)
-        {
-          /* Free all MSDUs stored in reordering buffer */
-
-          for (i = 0; i < IEEE80211_BA_MAX_WINSZ; i++)
-            {
-              if (ba->ba_buf[i].iob != NULL)
-                {
-                  iob_free_chain(ba->ba_buf[i].iob);
-                }
-            }
-
-          /* Free reordering buffer */
+      /* Free all MSDUs stored in reordering buffer and the buffer */
 
-          kfree(ba->ba_buf, M_DEVBUF);
-          ba->ba_buf = NULL;
-        }
+      ieee80211_reorder_free(ba);
     }
   else
     {
       /* MLME-DELBA.indication(Recipient) */
 
-      struct ieee80211_tx_ba *ba = &ni->ni_tx_ba[tid];
+      struct ieee80211_tx_ba *ba = &ni->ni_ba->nb_tx[tid];
 
       if (ba->ba_state != IEEE80211_BA_AGREED)
         {
@@ -3073,6 +2860,10 @@ void ieee80211_recv_delba(struct ieee80211_s *ic, struct iob_s *iob,
       /* stop Block Ack inactivity timer */
 
       wd_cancel(ba->ba_to);
+
+      /* Free all MPDUs waiting for aggregation or acknowledgement */
+
+      ieee80211_ampdu_stop(ic, ni, tid);
     }
 }
 #endif /* !CONFIG_IEEE80211_HT */
@@ -3109,7 +2900,7 @@ void ieee80211_recv_sa_query_req(struct ieee80211_s *ic, struct iob_s *iob,
 
   /* Save Transaction Identifier for SA Query Response */
 
-  ni->ni_sa_query_trid = LE_READ_2(&frm[2]);
+  ni->ni_rsn->rn_sa_query_trid = LE_READ_2(&frm[2]);
 
   /* MLME-SAQuery.response */
 
@@ -3151,7 +2942,7 @@ void ieee80211_recv_sa_query_resp(struct ieee80211_s *ic, struct iob_s *iob,
 
   /* Check that Transaction Identifier matches */
 
-  if (ni->ni_sa_query_trid != LE_READ_2(&frm[2]))
+  if (ni->ni_rsn->rn_sa_query_trid != LE_READ_2(&frm[2]))
     {
       ndbg("ERROR: transaction identifier does not match\n");
       return;
@@ -3159,7 +2950,7 @@ void ieee80211_recv_sa_query_resp(struct ieee80211_s *ic, struct iob_s *iob,
 
   /* MLME-SAQuery.confirm */
 
-  wd_cancel(ni->ni_sa_query_to);
+  wd_cancel(ni->ni_rsn->rn_sa_query_to);
   ni->ni_flags &= ~IEEE80211_NODE_SA_QUERY;
 }
 #endif
@@ -3318,6 +3109,8 @@ void ieee80211_recv_pspoll(struct ieee80211_s *ic, struct iob_s *iob,
       return;
     }
 
+  ni->ni_savedqlen--;
+
   if (IOB_QEMPTY(&ni->ni_savedq))
     {
       /* Last queued frame, turn off the TIM bit */
@@ -3332,7 +3125,7 @@ void ieee80211_recv_pspoll(struct ieee80211_s *ic, struct iob_s *iob,
       wh->i_fc[1] |= IEEE80211_FC1_MORE_DATA;
     }
 
-  iob_add_queue(iob, &ic->ic_pwrsaveq);
+  (void)ieee80211_ifsend(ic, iob, IFSEND_PWRSAVE);
 }
 #endif /* CONFIG_IEEE80211_AP */
 
@@ -3402,6 +3195,78 @@ void ieee80211_recv_bar(struct ieee80211_s *ic, struct iob_s *iob,
     }
 }
 
+/* Process an incoming BlockAck control frame (see 7.2.1.8) and hand the
+ * acknowledgement bitmap to the A-MPDU aggregation stage.  Drivers that
+ * process BlockAck frames in hardware call ieee80211_ampdu_ack() directly.
+ */
+
+void ieee80211_recv_ba(struct ieee80211_s *ic, struct iob_s *iob,
+                       struct ieee80211_node *ni)
+{
+  const struct ieee80211_frame_min *wh;
+  const uint8_t *frm;
+  uint64_t bitmap;
+  uint16_t ctl, ssn;
+  uint8_t tid;
+  int i;
+
+  if (iob->io_len < sizeof(*wh) + 4)
+    {
+      ndbg("ERROR: frame too short\n");
+      return;
+    }
+
+  wh = (FAR struct ieee80211_frame_min *)IOB_DATA(iob);
+  frm = (const uint8_t *)&wh[1];
+
+  /* read BlockAck Control and Starting Sequence Control fields */
+
+  ctl = LE_READ_2(&frm[0]);
+  tid = ctl >> 12;
+  ssn = LE_READ_2(&frm[2]) >> 4;
+  frm += 4;
+
+  if (ctl & IEEE80211_BA_MULTI_TID)
+    {
+      /* Multi-TID BlockAck variant (PSMP only) */
+
+      return;
+    }
+
+  bitmap = 0;
+  if (ctl & IEEE80211_BA_COMPRESSED)
+    {
+      /* 64 bits, one per MSDU */
+
+      if (iob->io_len < sizeof(*wh) + 4 + 8)
+        {
+          ndbg("ERROR: frame too short\n");
+          return;
+        }
+
+      for (i = 7; i >= 0; i--)
+        bitmap = bitmap << 8 | frm[i];
+    }
+  else
+    {
+      /* 64 16-bit words, one bit per fragment; we do not fragment */
+
+      if (iob->io_len < sizeof(*wh) + 4 + 128)
+        {
+          ndbg("ERROR: frame too short\n");
+          return;
+        }
+
+      for (i = 0; i < 64; i++)
+        {
+          if (frm[2 * i] & 1)
+            bitmap |= (uint64_t)1 << i;
+        }
+    }
+
+  (void)ieee80211_ampdu_ack(ic, ni, tid, ssn, bitmap);
+}
+
 /* Process a BlockAckReq for a specific TID (see 9.10.7.6.3).
  * This is the common back-end for all BlockAckReq frame variants.
  */
@@ -3410,11 +3275,12 @@ void
 ieee80211_bar_tid(struct ieee80211_s *ic, struct ieee80211_node *ni,
                   uint8_t tid, uint16_t ssn)
 {
-  struct ieee80211_rx_ba *ba = &ni->ni_rx_ba[tid];
+  struct ieee80211_rx_ba *ba;
 
   /* Check if we have a Block Ack agreement for RA/TID */
 
-  if (ba->ba_state != IEEE80211_BA_AGREED)
+  if (ni->ni_ba == NULL ||
+      ni->ni_ba->nb_rx[tid].ba_state != IEEE80211_BA_AGREED)
     {
       /* XXX not sure in PBAC case */
       /* send a DELBA with reason code UNKNOWN-BA */
@@ -3425,6 +3291,8 @@ ieee80211_bar_tid(struct ieee80211_s *ic, struct ieee80211_node *ni,
       return;
     }
 
+  ba = &ni->ni_ba->nb_rx[tid];
+
   /* check if it is a Protected Block Ack agreement */
 
   if ((ni->ni_flags & IEEE80211_NODE_MFP) &&
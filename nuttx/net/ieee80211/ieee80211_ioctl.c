@@ -515,6 +515,9 @@ int ieee80211_ioctl(struct ieee80211_s *ic, unsigned long cmd, void *data)
   int i, error = 0;
   struct ieee80211_nwid nwid;
   struct ieee80211_wpapsk *psk;
+#ifdef CONFIG_IEEE80211_PBKDF2
+  struct ieee80211_wpapass *pass;
+#endif
   struct ieee80211_wmmparams *wmm;
   struct ieee80211_keyavail *ka;
   struct ieee80211_keyrun *kr;
@@ -547,6 +550,9 @@ int ieee80211_ioctl(struct ieee80211_s *ic, unsigned long cmd, void *data)
       ic->ic_des_esslen = nwid.i_len;
       memcpy(ic->ic_des_essid, nwid.i_nwid, nwid.i_len);
       error = -ENETRESET;
+#ifdef CONFIG_IEEE80211_PBKDF2
+      (void)ieee80211_psk_update(ic);
+#endif
       break;
     case SIOCG80211NWID:
       memset(&nwid, 0, sizeof(nwid));
@@ -607,6 +613,18 @@ int ieee80211_ioctl(struct ieee80211_s *ic, unsigned long cmd, void *data)
         }
       error = -ENETRESET;
       break;
+#ifdef CONFIG_IEEE80211_PBKDF2
+    case SIOCS80211WPAPASS:
+      pass = (struct ieee80211_wpapass *)data;
+      if (pass->i_len < 0 || pass->i_len > IEEE80211_PASSPHRASE_MAXLEN)
+        {
+          error = -EINVAL;
+          break;
+        }
+      error = ieee80211_set_passphrase(ic, pass->i_pass, pass->i_len,
+                                       NULL, NULL);
+      break;
+#endif
     case SIOCG80211WPAPSK:
       psk = (struct ieee80211_wpapsk *)data;
       if (ic->ic_flags & IEEE80211_F_PSK)
@@ -818,6 +836,24 @@ int ieee80211_ioctl(struct ieee80211_s *ic, unsigned long cmd, void *data)
             break;
           }
 
+#ifdef CONFIG_IEEE80211_BGSCAN
+        /* An associated station scans in the background and stays
+         * associated.  The results show up in the node list as they come.
+         */
+
+        if (ic->ic_opmode == IEEE80211_M_STA &&
+            ic->ic_state == IEEE80211_S_RUN)
+          {
+            error = ieee80211_bgscan_start(ic);
+            if (error != -ENOSYS)
+              {
+                break;
+              }
+
+            error = 0;
+          }
+#endif
+
         if ((ic->ic_scan_lock & IEEE80211_SCAN_REQUEST) == 0)
           {
             if (ic->ic_scan_lock & IEEE80211_SCAN_LOCKED)
@@ -220,6 +220,17 @@ struct ieee80211_keyrun
 #  define SIOCS80211KEYAVAIL    _IOW('i', 251, struct ieee80211_keyavail)
 #  define SIOCS80211KEYRUN      _IOW('i', 252, struct ieee80211_keyrun)
 
+/* WPA passphrase; the PSK is derived from it and the desired SSID */
+
+struct ieee80211_wpapass
+  {
+    char i_name[IFNAMSIZ];      /* if_name, e.g. "wi0" */
+    int i_len;                  /* 0 to forget the passphrase */
+    char i_pass[64];
+  };
+
+#  define SIOCS80211WPAPASS     _IOW('i', 253, struct ieee80211_wpapass)
+
 /* Scan request (will block) */
 #  define IEEE80211_SCAN_TIMEOUT    30  /* timeout in seconds */
 
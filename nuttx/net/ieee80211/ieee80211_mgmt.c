@@ -0,0 +1,296 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_mgmt.c
+ * Management frame builder writing across I/O buffer chains
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/net/iob.h>
+
+#include "ieee80211/ieee80211_ifnet.h"
+#include "ieee80211/ieee80211_var.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_freelist
+ *
+ * Description:
+ *   Free a list of I/O buffers one at a time.  Unlike iob_free_chain(),
+ *   this does not expect the list to describe a packet (the trailing
+ *   buffers of a frame under construction are empty).
+ *
+ ****************************************************************************/
+
+static void ieee80211_mgmt_freelist(FAR struct iob_s *iob)
+{
+  FAR struct iob_s *next;
+
+  while (iob != NULL)
+    {
+      next          = iob->io_flink;
+      iob->io_flink = NULL;
+      iob_free(iob);
+      iob           = next;
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_alloc
+ *
+ * Description:
+ *   Allocate, at once, the I/O buffer chain for a management frame whose
+ *   body is at most 'len' bytes.  The head I/O buffer starts with room for
+ *   the 802.11 header (filled in by the caller or by the output path) and
+ *   keeps IEEE80211_IOB_HEADROOM bytes in front of it for a cipher header.
+ *
+ * Returned Value:
+ *   OK on success or -ENOMEM if not enough I/O buffers are available.
+ *
+ ****************************************************************************/
+
+int ieee80211_mgmt_alloc(FAR struct ieee80211_mgmtbuf_s *mb, unsigned int len)
+{
+  FAR struct iob_s *tail;
+  FAR struct iob_s *next;
+  unsigned int avail;
+
+  DEBUGASSERT(IEEE80211_IOB_HEADROOM + sizeof(struct ieee80211_frame) <=
+              CONFIG_IOB_BUFSIZE);
+
+  mb->mb_head     = NULL;
+  mb->mb_iob      = NULL;
+  mb->mb_frm      = NULL;
+  mb->mb_bounce   = false;
+  mb->mb_overflow = false;
+
+  tail = iob_alloc(false);
+  if (tail == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  tail->io_offset = IEEE80211_IOB_HEADROOM;
+  tail->io_len    = sizeof(struct ieee80211_frame);
+  tail->io_pktlen = sizeof(struct ieee80211_frame);
+
+  mb->mb_head = tail;
+  mb->mb_iob  = tail;
+
+  for (avail = IOB_FREESPACE(tail); avail < len;
+       avail += CONFIG_IOB_BUFSIZE)
+    {
+      next = iob_alloc(false);
+      if (next == NULL)
+        {
+          ieee80211_mgmt_freelist(mb->mb_head);
+          mb->mb_head = NULL;
+          return -ENOMEM;
+        }
+
+      tail->io_flink = next;
+      tail           = next;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_begin
+ *
+ * Description:
+ *   Return where to write the next 'maxlen' bytes of the frame body.  The
+ *   space is contiguous:  it lies in the current I/O buffer if it fits
+ *   there, otherwise in a bounce buffer that ieee80211_mgmt_end() spreads
+ *   over the chain.  This lets the ieee80211_add_*() helpers, which write
+ *   an element to a flat buffer, be used unchanged.
+ *
+ ****************************************************************************/
+
+FAR uint8_t *ieee80211_mgmt_begin(FAR struct ieee80211_mgmtbuf_s *mb,
+                                  unsigned int maxlen)
+{
+  FAR struct iob_s *iob = mb->mb_iob;
+
+  DEBUGASSERT(maxlen <= IEEE80211_MGMT_MAXIE);
+
+  if (IOB_FREESPACE(iob) >= maxlen)
+    {
+      mb->mb_bounce = false;
+      mb->mb_frm    = IOB_DATA(iob) + iob->io_len;
+    }
+  else
+    {
+      mb->mb_bounce = true;
+      mb->mb_frm    = mb->mb_buf;
+    }
+
+  return mb->mb_frm;
+}
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_end
+ *
+ * Description:
+ *   Commit the bytes written since ieee80211_mgmt_begin(), 'frm' being the
+ *   end of what was written.
+ *
+ ****************************************************************************/
+
+void ieee80211_mgmt_end(FAR struct ieee80211_mgmtbuf_s *mb,
+                        FAR const uint8_t *frm)
+{
+  unsigned int len = frm - mb->mb_frm;
+
+  DEBUGASSERT(frm >= mb->mb_frm && len <= IEEE80211_MGMT_MAXIE);
+
+  if (mb->mb_bounce)
+    {
+      ieee80211_mgmt_put(mb, mb->mb_buf, len);
+    }
+  else
+    {
+      mb->mb_iob->io_len     += len;
+      mb->mb_head->io_pktlen += len;
+    }
+
+  mb->mb_frm = NULL;
+}
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_put
+ *
+ * Description:
+ *   Append 'len' bytes to the frame body, spreading them over as many
+ *   I/O buffers of the chain as needed.
+ *
+ ****************************************************************************/
+
+void ieee80211_mgmt_put(FAR struct ieee80211_mgmtbuf_s *mb,
+                        FAR const void *data, unsigned int len)
+{
+  FAR const uint8_t *src = data;
+  FAR struct iob_s *iob = mb->mb_iob;
+  unsigned int ncopy;
+
+  while (len > 0)
+    {
+      ncopy = IOB_FREESPACE(iob);
+      if (ncopy == 0)
+        {
+          if (iob->io_flink == NULL)
+            {
+              /* The length given to ieee80211_mgmt_alloc() was too small */
+
+              mb->mb_overflow = true;
+              return;
+            }
+
+          iob        = iob->io_flink;
+          mb->mb_iob = iob;
+          continue;
+        }
+
+      if (ncopy > len)
+        {
+          ncopy = len;
+        }
+
+      memcpy(IOB_DATA(iob) + iob->io_len, src, ncopy);
+      iob->io_len            += ncopy;
+      mb->mb_head->io_pktlen += ncopy;
+      src                    += ncopy;
+      len                    -= ncopy;
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_finish
+ *
+ * Description:
+ *   Release the I/O buffers left unused at the end of the chain and return
+ *   the frame.  NULL is returned (and the chain freed) if the body did not
+ *   fit in the length given to ieee80211_mgmt_alloc().
+ *
+ ****************************************************************************/
+
+FAR struct iob_s *ieee80211_mgmt_finish(FAR struct ieee80211_mgmtbuf_s *mb)
+{
+  FAR struct iob_s *head = mb->mb_head;
+
+  if (mb->mb_overflow)
+    {
+      ndbg("ERROR: management frame overflow\n");
+      ieee80211_mgmt_discard(mb);
+      return NULL;
+    }
+
+  ieee80211_mgmt_freelist(mb->mb_iob->io_flink);
+  mb->mb_iob->io_flink = NULL;
+
+  mb->mb_head = NULL;
+  mb->mb_iob  = NULL;
+  return head;
+}
+
+/****************************************************************************
+ * Name: ieee80211_mgmt_discard
+ *
+ * Description:
+ *   Free a frame under construction.
+ *
+ ****************************************************************************/
+
+void ieee80211_mgmt_discard(FAR struct ieee80211_mgmtbuf_s *mb)
+{
+  ieee80211_mgmt_freelist(mb->mb_head);
+  mb->mb_head = NULL;
+  mb->mb_iob  = NULL;
+}
@@ -0,0 +1,431 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_minstrel.c
+ * Minstrel sampling rate control
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <stdint.h>
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <debug.h>
+#  include <nuttx/clock.h>
+
+#  include "ieee80211/ieee80211_debug.h"
+#  include "ieee80211/ieee80211_var.h"
+#endif
+
+#include "ieee80211/ieee80211_ratectl.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define MINSTREL_INTERVAL  MSEC2TICK(CONFIG_IEEE80211_MINSTREL_INTERVAL)
+
+/* New observations get 25% weight in the success probability */
+
+#define MINSTREL_EWMA(old, new)  (((uint32_t)(old) * 3 + (new)) / 4)
+
+/* Rates that succeed less often than this have no expected throughput */
+
+#define MINSTREL_MINPROB   (IEEE80211_MINSTREL_SCALE / 10)
+
+/* Throughput is estimated for an MPDU of this length (incl. header/FCS) */
+
+#define MINSTREL_REFLEN    1228
+
+/* Per-frame overhead (usec): DIFS, average backoff, PLCP preamble and
+ * header, SIFS and ACK.  DSSS/CCK frames use a long preamble and a 1 Mb/s
+ * ACK.
+ */
+
+#define MINSTREL_DSSS_OVERHEAD  860
+#define MINSTREL_OFDM_OVERHEAD  180
+
+#define RV(ni, i)  ((ni)->ni_rates.rs_rates[i] & IEEE80211_RATE_VAL)
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void ieee80211_minstrel_node_init(FAR struct ieee80211_s *ic,
+                                         FAR struct ieee80211_node *ni);
+static void ieee80211_minstrel_choose(FAR struct ieee80211_s *ic,
+                                      FAR struct ieee80211_node *ni,
+                                      unsigned int len,
+                                      FAR struct ieee80211_ratechain *chain);
+static void ieee80211_minstrel_tx_complete(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR const struct ieee80211_ratechain *chain,
+                              FAR const struct ieee80211_txstatus *txs);
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+const struct ieee80211_ratectl_ops ieee80211_ratectl_minstrel =
+{
+  .rc_name        = "minstrel",
+  .rc_node_init   = ieee80211_minstrel_node_init,
+  .rc_choose      = ieee80211_minstrel_choose,
+  .rc_tx_complete = ieee80211_minstrel_tx_complete,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_minstrel_txtime
+ *
+ * Description:
+ *   Return the air time (usec) of one reference MPDU sent at rate (in
+ *   units of 500 kb/s), including its ACK.
+ *
+ ****************************************************************************/
+
+static uint16_t ieee80211_minstrel_txtime(uint8_t rate)
+{
+  unsigned int overhead;
+
+  if (rate == 0)
+    {
+      return UINT16_MAX;
+    }
+
+  if (rate == 2 || rate == 4 || rate == 11 || rate == 22)
+    {
+      overhead = MINSTREL_DSSS_OVERHEAD;
+    }
+  else
+    {
+      overhead = MINSTREL_OFDM_OVERHEAD;
+    }
+
+  return overhead + MINSTREL_REFLEN * 16 / rate;
+}
+
+/****************************************************************************
+ * Name: ieee80211_minstrel_update
+ *
+ * Description:
+ *   Fold the counters of the last interval into the success probabilities
+ *   and pick the best, second best and most reliable rates.
+ *
+ ****************************************************************************/
+
+static void ieee80211_minstrel_update(FAR struct ieee80211_node *ni,
+                                      FAR struct ieee80211_minstrel_node *mn)
+{
+  FAR struct ieee80211_minstrel_rate *mr;
+  uint32_t prob;
+  int best = 0;
+  int second = -1;
+  int maxprob = 0;
+  int i;
+
+  for (i = 0; i < mn->mn_nrates; i++)
+    {
+      mr = &mn->mn_r[i];
+      if (mr->mr_attempts > 0)
+        {
+          prob = (uint32_t)mr->mr_success * IEEE80211_MINSTREL_SCALE /
+                 mr->mr_attempts;
+
+          /* The first observation of a rate is taken as it is */
+
+          if (mr->mr_att_hist == mr->mr_attempts)
+            {
+              mr->mr_prob = prob;
+            }
+          else
+            {
+              mr->mr_prob = MINSTREL_EWMA(mr->mr_prob, prob);
+            }
+
+          mr->mr_attempts = 0;
+          mr->mr_success  = 0;
+        }
+
+      if (mr->mr_prob < MINSTREL_MINPROB)
+        {
+          mr->mr_tp = 0;
+        }
+      else
+        {
+          mr->mr_tp = (uint32_t)mr->mr_prob * 10000 / mr->mr_txtime;
+        }
+
+      if (mr->mr_tp > mn->mn_r[best].mr_tp)
+        {
+          best = i;
+        }
+    }
+
+  for (i = 0; i < mn->mn_nrates; i++)
+    {
+      mr = &mn->mn_r[i];
+      if (i != best && (second < 0 || mr->mr_tp > mn->mn_r[second].mr_tp))
+        {
+          second = i;
+        }
+
+      /* Of the rates that almost always get through, prefer the fastest;
+       * otherwise the one most likely to get through.
+       */
+
+      if (mr->mr_prob > IEEE80211_MINSTREL_SCALE * 95 / 100 &&
+          mn->mn_r[maxprob].mr_prob > IEEE80211_MINSTREL_SCALE * 95 / 100)
+        {
+          if (mr->mr_tp > mn->mn_r[maxprob].mr_tp)
+            {
+              maxprob = i;
+            }
+        }
+      else if (mr->mr_prob > mn->mn_r[maxprob].mr_prob)
+        {
+          maxprob = i;
+        }
+    }
+
+  if (second < 0)
+    {
+      second = best;
+    }
+
+  if (best != mn->mn_best)
+    {
+      nvdbg("%s: best rate %d -> %d (%d%%)\n",
+            ieee80211_addr2str(ni->ni_macaddr), RV(ni, mn->mn_best),
+            RV(ni, best),
+            mn->mn_r[best].mr_prob * 100 / IEEE80211_MINSTREL_SCALE);
+    }
+
+  mn->mn_best    = best;
+  mn->mn_second  = second;
+  mn->mn_maxprob = maxprob;
+  ni->ni_txrate  = best;
+}
+
+/****************************************************************************
+ * Name: ieee80211_minstrel_sample
+ *
+ * Description:
+ *   Return the next rate to sample, or -1 if this frame is not to be used
+ *   for sampling.  Rates are visited in turn, skipping the best one.
+ *
+ ****************************************************************************/
+
+static int ieee80211_minstrel_sample(FAR struct ieee80211_minstrel_node *mn)
+{
+  int ridx;
+
+  if (mn->mn_nrates < 2 ||
+      ((uint32_t)mn->mn_nsample + 1) * 100 >
+      (uint32_t)mn->mn_npkts * CONFIG_IEEE80211_MINSTREL_SAMPLE_PCT)
+    {
+      return -1;
+    }
+
+  ridx = mn->mn_sample + 1;
+  if (ridx >= mn->mn_nrates)
+    {
+      ridx = 0;
+    }
+
+  if (ridx == mn->mn_best)
+    {
+      ridx = ridx + 1 < mn->mn_nrates ? ridx + 1 : 0;
+    }
+
+  mn->mn_sample = ridx;
+  mn->mn_nsample++;
+  return ridx;
+}
+
+/****************************************************************************
+ * Name: ieee80211_minstrel_node_init
+ ****************************************************************************/
+
+static void ieee80211_minstrel_node_init(FAR struct ieee80211_s *ic,
+                                         FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_minstrel_node *mn = &ni->ni_rctl->rn_minstrel;
+  int i;
+
+  mn->mn_nrates = ni->ni_rates.rs_nrates;
+  if (mn->mn_nrates > IEEE80211_RATE_MAXSIZE)
+    {
+      mn->mn_nrates = IEEE80211_RATE_MAXSIZE;
+    }
+
+  for (i = 0; i < mn->mn_nrates; i++)
+    {
+      mn->mn_r[i].mr_txtime = ieee80211_minstrel_txtime(RV(ni, i));
+    }
+
+  mn->mn_update = clock_systimer() + MINSTREL_INTERVAL;
+}
+
+/****************************************************************************
+ * Name: ieee80211_minstrel_choose
+ *
+ * Description:
+ *   Normal frames go out with best, second best, most reliable and lowest
+ *   rate.  A sampling frame tries the sample rate first unless it is slower
+ *   than the best rate, in which case it only gets used if the best rate
+ *   fails; nothing is gained by sampling a slow rate up front.
+ *
+ ****************************************************************************/
+
+static void ieee80211_minstrel_choose(FAR struct ieee80211_s *ic,
+                                      FAR struct ieee80211_node *ni,
+                                      unsigned int len,
+                                      FAR struct ieee80211_ratechain *chain)
+{
+  FAR struct ieee80211_minstrel_node *mn = &ni->ni_rctl->rn_minstrel;
+  uint8_t rates[IEEE80211_RATECHAIN_MAX];
+  int sample;
+  int i;
+  int j;
+  int n;
+
+  if ((int32_t)(clock_systimer() - mn->mn_update) >= 0)
+    {
+      ieee80211_minstrel_update(ni, mn);
+      mn->mn_update = clock_systimer() + MINSTREL_INTERVAL;
+    }
+
+  /* The sampling budget is kept over a long run of frames, not per
+   * interval: at the lowest rates an interval holds only a few frames.
+   */
+
+  if (++mn->mn_npkts >= 0x8000)
+    {
+      mn->mn_npkts   >>= 1;
+      mn->mn_nsample >>= 1;
+    }
+
+  sample = ieee80211_minstrel_sample(mn);
+
+  if (sample < 0)
+    {
+      rates[0] = mn->mn_best;
+      rates[1] = mn->mn_second;
+    }
+  else if (RV(ni, sample) < RV(ni, mn->mn_best))
+    {
+      rates[0] = mn->mn_best;
+      rates[1] = sample;
+    }
+  else
+    {
+      rates[0] = sample;
+      rates[1] = mn->mn_best;
+    }
+
+  rates[2] = mn->mn_maxprob;
+  rates[3] = 0;
+
+  /* Drop repeated rates */
+
+  for (i = 0, n = 0; i < IEEE80211_RATECHAIN_MAX; i++)
+    {
+      for (j = 0; j < n; j++)
+        {
+          if (chain->rc_ridx[j] == rates[i])
+            {
+              break;
+            }
+        }
+
+      if (j == n)
+        {
+          chain->rc_ridx[n]  = rates[i];
+          chain->rc_tries[n] = IEEE80211_RATECHAIN_TRIES;
+          n++;
+        }
+    }
+
+  /* A sampling attempt is not retried at the same rate */
+
+  if (sample >= 0 && chain->rc_ridx[0] == sample)
+    {
+      chain->rc_tries[0] = 1;
+    }
+
+  chain->rc_nrates = n;
+}
+
+/****************************************************************************
+ * Name: ieee80211_minstrel_tx_complete
+ ****************************************************************************/
+
+static void ieee80211_minstrel_tx_complete(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR const struct ieee80211_ratechain *chain,
+                              FAR const struct ieee80211_txstatus *txs)
+{
+  FAR struct ieee80211_minstrel_node *mn = &ni->ni_rctl->rn_minstrel;
+  FAR struct ieee80211_minstrel_rate *mr;
+  unsigned int tries;
+  int i;
+
+  for (i = 0; i <= txs->txs_final; i++)
+    {
+      if (chain->rc_ridx[i] >= mn->mn_nrates)
+        {
+          continue;
+        }
+
+      mr = &mn->mn_r[chain->rc_ridx[i]];
+      tries = i < txs->txs_final ? chain->rc_tries[i] : txs->txs_tries;
+
+      mr->mr_attempts += tries;
+      mr->mr_att_hist += tries;
+
+      if (i == txs->txs_final && txs->txs_acked)
+        {
+          mr->mr_success++;
+          mr->mr_succ_hist++;
+        }
+    }
+}
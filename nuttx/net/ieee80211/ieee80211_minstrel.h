@@ -0,0 +1,106 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_minstrel.h
+ * Minstrel sampling rate control
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_MINSTREL_H
+#define __NET_IEEE80211_IEEE80211_MINSTREL_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <stdint.h>
+
+#ifndef IEEE80211_HOSTBENCH
+#  include "ieee80211/ieee80211.h"
+#endif
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Statistics update interval (msec) */
+
+#ifndef CONFIG_IEEE80211_MINSTREL_INTERVAL
+#  define CONFIG_IEEE80211_MINSTREL_INTERVAL 100
+#endif
+
+/* Share of data frames used to sample other rates (percent) */
+
+#ifndef CONFIG_IEEE80211_MINSTREL_SAMPLE_PCT
+#  define CONFIG_IEEE80211_MINSTREL_SAMPLE_PCT 10
+#endif
+
+/* Success probabilities are fixed point with this scale */
+
+#define IEEE80211_MINSTREL_SCALE  16384
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Statistics of one rate of a node */
+
+struct ieee80211_minstrel_rate
+  {
+    uint16_t mr_prob;           /* EWMA success probability */
+    uint16_t mr_attempts;       /* Attempts in this interval */
+    uint16_t mr_success;        /* Successes in this interval */
+    uint16_t mr_txtime;         /* Air time of a reference frame (usec) */
+    uint32_t mr_tp;             /* Expected throughput (relative) */
+    uint32_t mr_att_hist;       /* Attempts since association */
+    uint32_t mr_succ_hist;      /* Successes since association */
+  };
+
+/* Per-node state */
+
+struct ieee80211_minstrel_node
+  {
+    struct ieee80211_minstrel_rate mn_r[IEEE80211_RATE_MAXSIZE];
+    uint32_t mn_update;         /* Time of the next update (ticks) */
+    uint16_t mn_npkts;          /* Frames sent */
+    uint16_t mn_nsample;        /* Sampling frames sent */
+    uint8_t mn_nrates;          /* Copy of ni_rates.rs_nrates */
+    uint8_t mn_best;            /* Highest expected throughput */
+    uint8_t mn_second;          /* Second highest expected throughput */
+    uint8_t mn_maxprob;         /* Highest success probability */
+    uint8_t mn_sample;          /* Last rate sampled */
+  };
+
+#endif /* __NET_IEEE80211_IEEE80211_MINSTREL_H */
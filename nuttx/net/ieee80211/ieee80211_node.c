@@ -55,6 +55,7 @@
 #  include <net/if_bridge.h>
 #endif
 
+#include <nuttx/clock.h>
 #include <nuttx/kmalloc.h>
 #include <nuttx/tree.h>
 
@@ -62,6 +63,7 @@
 #include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
 #include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_ratectl.h"
 
 struct ieee80211_node *ieee80211_node_alloc(struct ieee80211_s *);
 void ieee80211_node_free(struct ieee80211_s *, struct ieee80211_node *);
@@ -130,6 +132,7 @@ void ieee80211_node_attach(struct ieee80211_s *ic)
 #endif
 
   RB_INIT(&ic->ic_tree);
+  ieee80211_nodetab_init(&ic->ic_nodetab);
   ic->ic_node_alloc = ieee80211_node_alloc;
   ic->ic_node_free = ieee80211_node_free;
   ic->ic_node_copy = ieee80211_node_copy;
@@ -155,7 +158,9 @@ void ieee80211_node_attach(struct ieee80211_s *ic)
   if (ic->ic_caps & (IEEE80211_C_HOSTAP | IEEE80211_C_IBSS))
     {
       ic->ic_tim_len = howmany(ic->ic_max_aid, 8);
-      ic->ic_tim_bitmap = kmalloc(ic->ic_tim_len);
+      ic->ic_tim_lo = ic->ic_tim_len;
+      ic->ic_tim_hi = 0;
+      ic->ic_tim_bitmap = kzalloc(ic->ic_tim_len);
       if (ic->ic_tim_bitmap == NULL)
         {
           nvdbg("No memory for TIM bitmap!\n");
@@ -192,8 +197,25 @@ void ieee80211_node_lateattach(struct ieee80211_s *ic)
   DEBUGASSERT(ni != NULL);
 
   ni->ni_chan = IEEE80211_CHAN_ANYC;
+  if (ieee80211_node_rsn_attach(ni) < 0)
+    {
+      /* XXX no way to recover */
+
+      ndbg("ERROR: No RSN state for ic_bss!\n");
+    }
+
   ic->ic_bss = ieee80211_ref_node(ni);
   ic->ic_txpower = IEEE80211_TXPOWER_MAX;
+
+#ifdef CONFIG_IEEE80211_RXALIGN
+  /* Drivers that do not align the received frames pay for a copy */
+
+  if ((ic->ic_caps & IEEE80211_C_RXALIGN) == 0)
+    {
+      ndbg("WARNING: %s: received frames will be copied for alignment\n",
+           ic->ic_ifname);
+    }
+#endif
 }
 
 void ieee80211_node_detach(struct ieee80211_s *ic)
@@ -219,25 +241,69 @@ void ieee80211_node_detach(struct ieee80211_s *ic)
 
   wd_cancel(ic->ic_inact_timeout);
   wd_cancel(ic->ic_node_cache_timeout);
+  ieee80211_rekey_cancel(ic);
 #endif
   wd_cancel(ic->ic_rsn_timeout);
 }
 
 /* AP scanning support */
 
-/* Initialize the active channel set based on the set
- * of available channels and the current PHY mode.
+/* Initialize the list of channels to scan based on the set of available
+ * channels and the current PHY mode.  The list is built once here, in
+ * ascending channel order, so that stepping to the next channel does not
+ * have to walk the whole channel table.
  */
 
 void ieee80211_reset_scan(FAR struct ieee80211_s *ic)
 {
-  memcpy(ic->ic_chan_scan, ic->ic_chan_active, sizeof(ic->ic_chan_active));
+  int nchans = 0;
+  int i;
+
+  for (i = 0; i <= IEEE80211_CHAN_MAX; i++)
+    {
+      if ((ic->ic_chan_active[i >> 3] & (1 << (i & 7))) != 0)
+        {
+          ic->ic_scan_chans[nchans++] = i;
+        }
+    }
 
-  /* NB: hack, setup so next_scan starts with the first channel */
+  ic->ic_scan_nchans = nchans;
+  ic->ic_scan_next   = 0;
+}
 
-  if (ic->ic_bss != NULL && ic->ic_bss->ni_chan == IEEE80211_CHAN_ANYC)
+/****************************************************************************
+ * Name: ieee80211_age_scan_cache
+ *
+ * Description:
+ *   Drop the scan results that have not been refreshed by a beacon or a
+ *   probe response for CONFIG_IEEE80211_SCAN_CACHE_AGE seconds.  Unlike
+ *   ieee80211_free_allnodes(), the BSS we are associated with and any
+ *   node still referenced are kept, so a new scan does not tear down the
+ *   association or forget the APs that are still around.
+ *
+ ****************************************************************************/
+
+void ieee80211_age_scan_cache(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_node *ni;
+  FAR struct ieee80211_node *next;
+  uint32_t now = clock_systimer();
+
+  for (ni = RB_MIN(ieee80211_tree, &ic->ic_tree); ni != NULL; ni = next)
     {
-      ic->ic_bss->ni_chan = &ic->ic_channels[IEEE80211_CHAN_MAX];
+      next = RB_NEXT(ieee80211_tree, &ic->ic_tree, ni);
+
+      if (ni != ic->ic_bss && ni->ni_refcnt == 0 &&
+          now - ni->ni_lastseen >=
+          SEC2TICK(CONFIG_IEEE80211_SCAN_CACHE_AGE))
+        {
+          ieee80211_free_node(ic, ni);
+        }
+    }
+
+  if (ic->ic_bss != NULL)
+    {
+      ieee80211_node_cleanup(ic, ic->ic_bss);   /* for station mode */
     }
 }
 
@@ -266,12 +332,22 @@ void ieee80211_begin_scan(struct ieee80211_s *ic)
         ic->ic_ifname,
         (ic->ic_flags & IEEE80211_F_ASCAN) ? "active" : "passive");
 
-  /* Flush any previously seen AP's. Note that the latter assumes we don't act
-   * as both an AP and a station, otherwise we'll potentially flush state of
-   * stations associated with us.
+  /* In station mode, only forget the AP's that have not been heard of for a
+   * while: the results of previous scans stay usable and a node we are
+   * still talking to is not freed under us.  Otherwise flush any previously
+   * seen AP's.  Note that the latter assumes we don't act as both an AP and
+   * a station, otherwise we'll potentially flush state of stations
+   * associated with us.
    */
 
-  ieee80211_free_allnodes(ic);
+  if (ic->ic_opmode == IEEE80211_M_STA)
+    {
+      ieee80211_age_scan_cache(ic);
+    }
+  else
+    {
+      ieee80211_free_allnodes(ic);
+    }
 
   /* Reset the current mode. Setting the current mode will also reset scan
    * state.
@@ -280,54 +356,46 @@ void ieee80211_begin_scan(struct ieee80211_s *ic)
   ieee80211_setmode(ic, ic->ic_curmode);
   ic->ic_scan_count = 0;
 
+  ic->ic_scan_stats.ss_scans++;
+  ic->ic_scan_stats.ss_start = clock_systimer();
+
   /* Scan the next channel. */
 
   ieee80211_next_scan(ic);
 }
 
-/* Switch to the next channel marked for scanning */
+/* Switch to the next channel of the scan list */
 
 void ieee80211_next_scan(struct ieee80211_s *ic)
 {
-  struct ieee80211_channel *chan;
-  int ibss;
-  int ndx;
-  int bit;
+  struct ieee80211_channel *chan = NULL;
 
-  chan = ic->ic_bss->ni_chan;
-  for (;;)
+  if (ic->ic_scan_nchans == 0)
     {
-      if (++chan > &ic->ic_channels[IEEE80211_CHAN_MAX])
-        {
-          chan = &ic->ic_channels[0];
-        }
+      ndbg("ERROR: no channel to scan\n");
+      return;
+    }
 
-      ibss = ieee80211_chan2ieee(ic, chan);
-      ndx = (ibss >> 3);
-      bit = (ibss & 7);
+  while (ic->ic_scan_next < ic->ic_scan_nchans)
+    {
+      chan = &ic->ic_channels[ic->ic_scan_chans[ic->ic_scan_next++]];
 
-      if ((ic->ic_chan_scan[ndx] & (1 << bit)) != 0)
-        {
-          /* Ignore channels marked passive-only during an active scan */
+      /* Ignore channels marked passive-only during an active scan */
 
-          if ((ic->ic_flags & IEEE80211_F_ASCAN) == 0 ||
-              (chan->ic_flags & IEEE80211_CHAN_PASSIVE) == 0)
-            {
-              break;
-            }
-        }
-
-      if (chan == ic->ic_bss->ni_chan)
+      if ((ic->ic_flags & IEEE80211_F_ASCAN) == 0 ||
+          (chan->ic_flags & IEEE80211_CHAN_PASSIVE) == 0)
         {
-          ieee80211_end_scan(ic);
-          return;
+          break;
         }
+
+      chan = NULL;
     }
 
-  ibss = ieee80211_chan2ieee(ic, chan);
-  ndx = (ibss >> 3);
-  bit = (ibss & 7);
-  ic->ic_chan_scan[ndx] &= ~(1 << bit);
+  if (chan == NULL)
+    {
+      ieee80211_end_scan(ic);
+      return;
+    }
 
   nvdbg("chan %d->%d\n",
         ieee80211_chan2ieee(ic, ic->ic_bss->ni_chan),
@@ -563,9 +631,11 @@ int ieee80211_match_bss(struct ieee80211_s *ic, struct ieee80211_node *ni)
 
 void ieee80211_end_scan(struct ieee80211_s *ic)
 {
+  FAR struct ieee80211_scan_stats *ss = &ic->ic_scan_stats;
   struct ieee80211_node *ni;
   struct ieee80211_node *nextbs;
   struct ieee80211_node *selbs;
+  uint32_t now;
 #ifdef CONFIG_IEEE80211_AP
   int ndx;
   int bit;
@@ -575,6 +645,19 @@ void ieee80211_end_scan(struct ieee80211_s *ic)
         ic->ic_ifname,
         (ic->ic_flags & IEEE80211_F_ASCAN) ? "active" : "passive");
 
+  /* If no BSS is selected, the scan goes on with another pass */
+
+  now          = clock_systimer();
+  ss->ss_last  = TICK2MSEC(now - ss->ss_start);
+  ss->ss_total += ss->ss_last;
+  ss->ss_start = now;
+  ss->ss_passes++;
+
+  if (ss->ss_last > ss->ss_max)
+    {
+      ss->ss_max = ss->ss_last;
+    }
+
   if (ic->ic_scan_count)
     ic->ic_flags &= ~IEEE80211_F_ASCAN;
 
@@ -751,6 +834,64 @@ wakeup:
   ic->ic_scan_lock = IEEE80211_SCAN_UNLOCKED;
 }
 
+/****************************************************************************
+ * Name: ieee80211_roam
+ *
+ * Description:
+ *   Move the association of a station to 'selbs', an AP of the scan cache
+ *   found better than the current one.  The old AP is deauthenticated and
+ *   the authentication with the new one starts at once, without the full
+ *   scan that a beacon miss would cause.
+ *
+ ****************************************************************************/
+
+void ieee80211_roam(FAR struct ieee80211_s *ic,
+                    FAR struct ieee80211_node *selbs)
+{
+  FAR struct ieee80211_node *ni = ic->ic_bss;
+  FAR struct ieee80211_node *oldbs;
+
+  nvdbg("%s: roaming from %s", ic->ic_ifname,
+        ieee80211_addr2str(ni->ni_bssid));
+  nvdbg(" to %s\n", ieee80211_addr2str(selbs->ni_bssid));
+
+  /* Whatever was queued for the old AP is dropped; the deauthentication
+   * goes out on the home channel before the driver retunes for the new AP.
+   */
+
+  ieee80211_ifflush(ic);
+  IEEE80211_SEND_MGMT(ic, ni, IEEE80211_FC0_SUBTYPE_DEAUTH,
+                      IEEE80211_REASON_AUTH_LEAVE);
+
+  oldbs = ieee80211_find_node(ic, ni->ni_macaddr);
+  if (oldbs != NULL)
+    {
+      ieee80211_node_newstate(oldbs, IEEE80211_STA_CACHE);
+    }
+
+  (*ic->ic_node_copy) (ic, ni, selbs);
+
+  ic->ic_curmode = ieee80211_chan2mode(ic, ni->ni_chan);
+  ieee80211_reset_erp(ic);
+
+  if (ic->ic_flags & IEEE80211_F_RSNON)
+    {
+      ieee80211_choose_rsnparams(ic);
+    }
+  else if (ic->ic_flags & IEEE80211_F_WEPON)
+    {
+      ni->ni_rsncipher = IEEE80211_CIPHER_USEGROUP;
+    }
+
+  ieee80211_node_newstate(selbs, IEEE80211_STA_BSS);
+
+  /* From RUN, a DEAUTH argument makes the state machine (re)authenticate
+   * with ic_bss, which is now the new AP.
+   */
+
+  ieee80211_new_state(ic, IEEE80211_S_AUTH, IEEE80211_FC0_SUBTYPE_DEAUTH);
+}
+
 /* Autoselect the best RSN parameters (protocol, AKMP, pairwise cipher...)
  * that are supported by both peers (STA mode only).
  */
@@ -800,7 +941,7 @@ void ieee80211_choose_rsnparams(struct ieee80211_s *ic)
       if (ni->ni_rsnprotos == IEEE80211_PROTO_RSN &&
           (pmk = ieee80211_pmksa_find(ic, ni, NULL)) != NULL)
         {
-          memcpy(ni->ni_pmkid, pmk->pmk_pmkid, IEEE80211_PMKID_LEN);
+          memcpy(ni->ni_rsn->rn_pmkid, pmk->pmk_pmkid, IEEE80211_PMKID_LEN);
           ni->ni_flags |= IEEE80211_NODE_PMKID;
         }
     }
@@ -843,11 +984,40 @@ int ieee80211_get_rate(struct ieee80211_s *ic)
 
 struct ieee80211_node *ieee80211_node_alloc(struct ieee80211_s *ic)
 {
-  return kmalloc(sizeof(struct ieee80211_node));
+  return ieee80211_nodepool_alloc();
 }
 
+#ifdef CONFIG_IEEE80211_HT
+/* Tear down all Block Ack agreements of a node and release its records */
+
+static void ieee80211_node_free_ba(struct ieee80211_s *ic,
+                                   struct ieee80211_node *ni)
+{
+  uint8_t tid;
+
+  if (ni->ni_ba == NULL)
+    return;
+
+  for (tid = 0; tid < IEEE80211_NUM_TID; tid++)
+    {
+      ieee80211_reorder_free(&ni->ni_ba->nb_rx[tid]);
+      ieee80211_ampdu_stop(ic, ni, tid);
+    }
+
+  ieee80211_node_ba_detach(ni);
+}
+#endif
+
 void ieee80211_node_cleanup(struct ieee80211_s *ic, struct ieee80211_node *ni)
 {
+  ieee80211_defrag_purge(ic, ni);
+
+#ifdef CONFIG_IEEE80211_HT
+  ieee80211_node_free_ba(ic, ni);
+#endif
+
+  ieee80211_node_rctl_detach(ni);
+
   if (ni->ni_rsnie != NULL)
     {
       kfree(ni->ni_rsnie);
@@ -858,16 +1028,59 @@ void ieee80211_node_cleanup(struct ieee80211_s *ic, struct ieee80211_node *ni)
 void ieee80211_node_free(struct ieee80211_s *ic, struct ieee80211_node *ni)
 {
   ieee80211_node_cleanup(ic, ni);
-  kfree(ni);
+  ieee80211_node_rsn_detach(ni);
+  ieee80211_nodepool_free(ni);
 }
 
 void ieee80211_node_copy(struct ieee80211_s *ic,
                          struct ieee80211_node *dst,
                          const struct ieee80211_node *src)
 {
+  struct ieee80211_node_rsn *rn;
+#ifndef CONFIG_IEEE80211_AUTHSCHED
+  WDOG_ID eapol_to;
+#endif
+  WDOG_ID sa_query_to;
+
   ieee80211_node_cleanup(ic, dst);
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  ieee80211_authsched_discard(ic, dst);
+#endif
+  rn = dst->ni_rsn;
   *dst = *src;
   dst->ni_rsnie = NULL;
+  dst->ni_ndefrag = 0;
+
+  /* Block Ack and rate control state belong to the source node; dst keeps
+   * its own RSN state (and timers) but takes over the source's key state,
+   * if any.
+   */
+
+  dst->ni_ba = NULL;
+  dst->ni_rctl = NULL;
+  dst->ni_rsn = rn;
+  if (rn != NULL)
+    {
+#ifndef CONFIG_IEEE80211_AUTHSCHED
+      eapol_to = rn->rn_eapol_to;
+      wd_cancel(eapol_to);
+#endif
+      sa_query_to = rn->rn_sa_query_to;
+      wd_cancel(sa_query_to);
+
+      if (src->ni_rsn != NULL)
+        *rn = *src->ni_rsn;
+      else
+        memset(rn, 0, sizeof(*rn));
+
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+      memset(&rn->rn_hs, 0, sizeof(rn->rn_hs));
+#else
+      rn->rn_eapol_to = eapol_to;
+#endif
+      rn->rn_sa_query_to = sa_query_to;
+    }
+
   if (src->ni_rsnie != NULL)
     ieee80211_save_ie(src->ni_rsnie, &dst->ni_rsnie);
 }
@@ -888,12 +1101,10 @@ void ieee80211_setup_node(struct ieee80211_s *ic,
   ieee80211_node_newstate(ni, IEEE80211_STA_CACHE);
 
   ni->ni_ic = ic;               /* back-pointer */
-#ifdef CONFIG_IEEE80211_AP
-  ni->ni_eapol_to = wd_create();
-  ni->ni_sa_query_to = wd_create();
-#endif
+  ni->ni_lastseen = clock_systimer();
   flags = uip_lock();
   RB_INSERT(ieee80211_tree, &ic->ic_tree, ni);
+  ieee80211_nodetab_insert(&ic->ic_nodetab, ni);
   ic->ic_nnodes++;
   uip_unlock(flags);
 }
@@ -927,8 +1138,10 @@ struct ieee80211_node *ieee80211_dup_bss(struct ieee80211_s *ic,
   return ni;
 }
 
-struct ieee80211_node *ieee80211_find_node(struct ieee80211_s *ic,
-                                           const uint8_t * macaddr)
+/* Search ic_tree for the nodes that did not fit in ic_nodetab */
+
+static struct ieee80211_node *ieee80211_find_node_tree(struct ieee80211_s *ic,
+                                                       const uint8_t *macaddr)
 {
   struct ieee80211_node *ni;
   int cmp;
@@ -949,6 +1162,17 @@ struct ieee80211_node *ieee80211_find_node(struct ieee80211_s *ic,
   return ni;
 }
 
+struct ieee80211_node *ieee80211_find_node(struct ieee80211_s *ic,
+                                           const uint8_t * macaddr)
+{
+  struct ieee80211_node *ni;
+
+  ni = ieee80211_nodetab_find(&ic->ic_nodetab, macaddr);
+  if (ni == NULL && ic->ic_nodetab.nt_spill > 0)
+    ni = ieee80211_find_node_tree(ic, macaddr);
+  return ni;
+}
+
 /* Return a reference to the appropriate node for sending
  * a data frame.  This handles node discovery in adhoc networks.
  *
@@ -972,9 +1196,18 @@ struct ieee80211_node *ieee80211_find_txnode(struct ieee80211_s *ic,
     return ieee80211_ref_node(ic->ic_bss);
 
 #ifdef CONFIG_IEEE80211_AP
+  /* Consecutive frames usually go to the same station */
+
   flags = uip_lock();
-  ni = ieee80211_find_node(ic, macaddr);
+  ni = ieee80211_nodetab_lookup(&ic->ic_nodetab, &ic->ic_nodetab.nt_txhit,
+                                macaddr);
+  if (ni == NULL && ic->ic_nodetab.nt_spill > 0)
+    ni = ieee80211_find_node_tree(ic, macaddr);
+
+  if (ni != NULL)
+    ieee80211_node_incref(ni);
   uip_unlock(flags);
+
   if (ni == NULL)
     {
       if (ic->ic_opmode != IEEE80211_M_IBSS &&
@@ -995,10 +1228,13 @@ struct ieee80211_node *ieee80211_find_txnode(struct ieee80211_s *ic,
 
       ni->ni_rates = ic->ic_bss->ni_rates;
       ni->ni_txrate = 0;
+      ieee80211_ratectl_node_init(ic, ni);
       if (ic->ic_newassoc)
         (*ic->ic_newassoc) (ic, ni, 1);
+      return ieee80211_ref_node(ni);
     }
-  return ieee80211_ref_node(ni);
+
+  return ni;
 #else
   return NULL;                  /* can't get there */
 #endif /* CONFIG_IEEE80211_AP */
@@ -1109,12 +1345,20 @@ struct ieee80211_node *ieee80211_find_rxnode(struct ieee80211_s *ic,
   if (!ieee80211_needs_rxnode(ic, wh, &bssid))
     return ieee80211_ref_node(ic->ic_bss);
 
+  /* Consecutive frames usually come from the same station */
+
   flags = uip_lock();
-  ni = ieee80211_find_node(ic, wh->i_addr2);
+  ni = ieee80211_nodetab_lookup(&ic->ic_nodetab, &ic->ic_nodetab.nt_rxhit,
+                                wh->i_addr2);
+  if (ni == NULL && ic->ic_nodetab.nt_spill > 0)
+    ni = ieee80211_find_node_tree(ic, wh->i_addr2);
+
+  if (ni != NULL)
+    ieee80211_node_incref(ni);
   uip_unlock(flags);
 
   if (ni != NULL)
-    return ieee80211_ref_node(ni);
+    return ni;
 #ifdef CONFIG_IEEE80211_AP
   if (ic->ic_opmode == IEEE80211_M_HOSTAP)
     return ieee80211_ref_node(ic->ic_bss);
@@ -1130,6 +1374,7 @@ struct ieee80211_node *ieee80211_find_rxnode(struct ieee80211_s *ic,
 
   ni->ni_rates = ic->ic_bss->ni_rates;
   ni->ni_txrate = 0;
+  ieee80211_ratectl_node_init(ic, ni);
   if (ic->ic_newassoc)
     (*ic->ic_newassoc) (ic, ni, 1);
 
@@ -1172,18 +1417,19 @@ void ieee80211_free_node(struct ieee80211_s *ic, struct ieee80211_node *ni)
   DEBUGASSERT(ni != ic->ic_bss);
 
   nvdbg("%s\n", ieee80211_addr2str(ni->ni_macaddr));
+  ieee80211_node_rsn_detach(ni);
 #ifdef CONFIG_IEEE80211_AP
-  wd_cancel(ni->ni_eapol_to);
-  wd_cancel(ni->ni_sa_query_to);
   IEEE80211_AID_CLR(ni->ni_associd, ic->ic_aid_bitmap);
 #endif
   RB_REMOVE(ieee80211_tree, &ic->ic_tree, ni);
+  ieee80211_nodetab_remove(&ic->ic_nodetab, ni);
   ic->ic_nnodes--;
 
 #ifdef CONFIG_IEEE80211_AP
   if (!IOB_QEMPTY(&ni->ni_savedq))
     {
       iob_free_queue(&ni->ni_savedq);
+      ni->ni_savedqlen = 0;
       if (ic->ic_set_tim != NULL)
         {
           (*ic->ic_set_tim) (ic, ni->ni_associd, 0);
@@ -1438,33 +1684,36 @@ void ieee80211_node_join_rsn(struct ieee80211_s *ic, struct ieee80211_node *ni)
      ieee80211_addr2str(ni->ni_macaddr), ni->ni_rsnprotos, ni->ni_rsnakms,
      ni->ni_rsnciphers, ni->ni_rsngroupcipher);
 
-  ni->ni_rsn_state = RSNA_AUTHENTICATION;
+  /* RSN state was attached by ieee80211_recv_assoc_req() */
+
+  DEBUGASSERT(ni->ni_rsn != NULL);
+  ni->ni_rsn->rn_state = RSNA_AUTHENTICATION;
   ic->ic_rsnsta++;
 
-  ni->ni_key_count = 0;
+  ni->ni_rsn->rn_key_count = 0;
   ni->ni_port_valid = 0;
   ni->ni_flags &= ~IEEE80211_NODE_TXRXPROT;
-  ni->ni_replaycnt = -1;        /* XXX */
-  ni->ni_rsn_retries = 0;
+  ni->ni_rsn->rn_replaycnt = -1;        /* XXX */
+  ni->ni_rsn->rn_retries = 0;
   ni->ni_rsncipher = ni->ni_rsnciphers;
 
-  ni->ni_rsn_state = RSNA_AUTHENTICATION_2;
+  ni->ni_rsn->rn_state = RSNA_AUTHENTICATION_2;
 
   /* generate a new authenticator nonce (ANonce) */
 
-  arc4random_buf(ni->ni_nonce, EAPOL_KEY_NONCE_LEN);
+  arc4random_buf(ni->ni_rsn->rn_nonce, EAPOL_KEY_NONCE_LEN);
 
   if (!ieee80211_is_8021x_akm(ni->ni_rsnakms))
     {
-      memcpy(ni->ni_pmk, ic->ic_psk, IEEE80211_PMK_LEN);
+      memcpy(ni->ni_rsn->rn_pmk, ic->ic_psk, IEEE80211_PMK_LEN);
       ni->ni_flags |= IEEE80211_NODE_PMK;
-      (void)ieee80211_send_4way_msg1(ic, ni);
+      (void)ieee80211_authsched_start(ic, ni);
     }
   else if (ni->ni_flags & IEEE80211_NODE_PMK)
     {
       /* skip 802.1X auth if a cached PMK was found */
 
-      (void)ieee80211_send_4way_msg1(ic, ni);
+      (void)ieee80211_authsched_start(ic, ni);
     }
   else
     {
@@ -1499,6 +1748,7 @@ void ieee80211_node_join_11g(struct ieee80211_s *ic, struct ieee80211_node *ni)
       /* Joining STA is non-ERP. */
 
       ic->ic_nonerpsta++;
+      IEEE80211_MGMT_CHANGED(ic);
 
       nvdbg("[%s] station is non-ERP, %d non-ERP stations associated\n",
             ieee80211_addr2str(ni->ni_macaddr), ic->ic_nonerpsta);
@@ -1558,6 +1808,7 @@ void ieee80211_node_join(struct ieee80211_s *ic, struct ieee80211_node *ni,
 
   /* give driver a chance to setup state like ni_txrate */
 
+  ieee80211_ratectl_node_init(ic, ni);
   if (ic->ic_newassoc)
     (*ic->ic_newassoc) (ic, ni, newassoc);
 
@@ -1595,29 +1846,9 @@ void ieee80211_node_join(struct ieee80211_s *ic, struct ieee80211_node *ni,
 
 void ieee80211_node_leave_ht(struct ieee80211_s *ic, struct ieee80211_node *ni)
 {
-  struct ieee80211_rx_ba *ba;
-  uint8_t tid;
-  int i;
-
   /* Free all Block Ack records */
 
-  for (tid = 0; tid < IEEE80211_NUM_TID; tid++)
-    {
-      ba = &ni->ni_rx_ba[tid];
-      if (ba->ba_buf != NULL)
-        {
-          for (i = 0; i < IEEE80211_BA_MAX_WINSZ; i++)
-            {
-              if (ba->ba_buf[i].iob != NULL)
-                {
-                  iob_free_chain(ba->ba_buf[i].iob);
-                }
-            }
-
-          kfree(ba->ba_buf);
-          ba->ba_buf = NULL;
-        }
-    }
+  ieee80211_node_free_ba(ic, ni);
 }
 #  endif                               /* !CONFIG_IEEE80211_HT */
 
@@ -1625,24 +1856,26 @@ void ieee80211_node_leave_ht(struct ieee80211_s *ic, struct ieee80211_node *ni)
 
 void ieee80211_node_leave_rsn(struct ieee80211_s *ic, struct ieee80211_node *ni)
 {
-  ni->ni_rsn_state = RSNA_DISCONNECTED;
+  if (ni->ni_rsn == NULL)
+    return;
+
+  ieee80211_authsched_discard(ic, ni);
+  ni->ni_rsn->rn_state = RSNA_DISCONNECTED;
   ic->ic_rsnsta--;
 
-  ni->ni_rsn_state = RSNA_INITIALIZE;
-  if ((ni->ni_flags & IEEE80211_NODE_REKEY) && --ic->ic_rsn_keydonesta == 0)
-    ieee80211_setkeysdone(ic);
-  ni->ni_flags &= ~IEEE80211_NODE_REKEY;
+  ni->ni_rsn->rn_state = RSNA_INITIALIZE;
+  ieee80211_rekey_done(ic, ni);
 
   ni->ni_flags &= ~IEEE80211_NODE_PMK;
-  ni->ni_rsn_gstate = RSNA_IDLE;
-
-  wd_cancel(ni->ni_eapol_to);
-  wd_cancel(ni->ni_sa_query_to);
+  ni->ni_rsn->rn_gstate = RSNA_IDLE;
 
-  ni->ni_rsn_retries = 0;
   ni->ni_flags &= ~IEEE80211_NODE_TXRXPROT;
   ni->ni_port_valid = 0;
-  (*ic->ic_delete_key) (ic, ni, &ni->ni_pairwise_key);
+  (*ic->ic_delete_key) (ic, ni, &ni->ni_rsn->rn_pairwise_key);
+
+  /* Stops the EAPOL and SA Query timers */
+
+  ieee80211_node_rsn_detach(ni);
 }
 
 /* Handle a station leaving an 11g network */
@@ -1676,6 +1909,7 @@ void ieee80211_node_leave_11g(struct ieee80211_s *ic, struct ieee80211_node *ni)
     {
       DEBUGASSERT(ic->ic_nonerpsta != 0);
       /* leaving STA was non-ERP */
+      IEEE80211_MGMT_CHANGED(ic);
       if (--ic->ic_nonerpsta == 0)
         {
           /* All associated STAs are now ERP capable, disable use of protection 
@@ -1721,6 +1955,7 @@ void ieee80211_node_leave(struct ieee80211_s *ic, struct ieee80211_node *ni)
   if (!IOB_QEMPTY(&ni->ni_savedq))
     {
       iob_free_queue(&ni->ni_savedq);
+      ni->ni_savedqlen = 0;
       if (ic->ic_set_tim != NULL)
         {
           (*ic->ic_set_tim) (ic, ni->ni_associd, 0);
@@ -1886,20 +2121,65 @@ int ieee80211_ibss_merge(struct ieee80211_s *ic,
   return -ENETRESET;
 }
 
+/* Set or clear the bit of a station in the TIM virtual bit map.  The first
+ * and last non-zero octets are tracked here so that building the TIM
+ * element does not have to scan the whole bit map at every beacon.
+ */
+
 void ieee80211_set_tim(struct ieee80211_s *ic, int aid, int set)
 {
-  int ndx;
-  int bit;
-  aid &= 0xc000;
+  unsigned int ndx;
+  uint8_t bit;
+
+  aid = IEEE80211_AID(aid);
   ndx = (aid >> 3);
-  bit = (aid & 7);
+  bit = 1 << (aid & 7);
+  DEBUGASSERT(ndx < ic->ic_tim_len);
+
   if (set)
     {
-      ic->ic_tim_bitmap[ndx] |= (1 << bit);
+      ic->ic_tim_bitmap[ndx] |= bit;
+      if (ndx < ic->ic_tim_lo)
+        {
+          ic->ic_tim_lo = ndx;
+        }
+
+      if (ndx > ic->ic_tim_hi)
+        {
+          ic->ic_tim_hi = ndx;
+        }
+
+      return;
     }
-  else
+
+  ic->ic_tim_bitmap[ndx] &= ~bit;
+  if (ic->ic_tim_bitmap[ndx] != 0 || ic->ic_tim_lo > ic->ic_tim_hi)
     {
-      ic->ic_tim_bitmap[ndx] &= ~(1 << bit);
+      return;
+    }
+
+  if (ndx == ic->ic_tim_lo)
+    {
+      while (ic->ic_tim_lo <= ic->ic_tim_hi &&
+             ic->ic_tim_bitmap[ic->ic_tim_lo] == 0)
+        {
+          ic->ic_tim_lo++;
+        }
+
+      if (ic->ic_tim_lo > ic->ic_tim_hi)
+        {
+          /* The bit map is empty */
+
+          ic->ic_tim_lo = ic->ic_tim_len;
+          ic->ic_tim_hi = 0;
+        }
+    }
+  else if (ndx == ic->ic_tim_hi)
+    {
+      while (ic->ic_tim_bitmap[ic->ic_tim_hi] == 0)
+        {
+          ic->ic_tim_hi--;
+        }
     }
 }
 
@@ -1923,6 +2203,8 @@ void ieee80211_notify_dtim(struct ieee80211_s *ic)
           break;
         }
 
+      ni->ni_savedqlen--;
+
       if (!IOB_QEMPTY(&ni->ni_savedq))
         {
           /* more queued frames, set the more data bit */
@@ -1931,7 +2213,7 @@ void ieee80211_notify_dtim(struct ieee80211_s *ic)
           wh->i_fc[1] |= IEEE80211_FC1_MORE_DATA;
         }
 
-      iob_add_queue(iob, &ic->ic_pwrsaveq);
+      (void)ieee80211_ifsend(ic, iob, IFSEND_PWRSAVE);
     }
 
   /* XXX assumes everything has been sent */
@@ -54,9 +54,53 @@
 #define IEEE80211_TRANS_WAIT    5     /* transition wait */
 #define IEEE80211_INACT_WAIT    5     /* inactivity timer interval */
 #define IEEE80211_INACT_MAX    (300/IEEE80211_INACT_WAIT)
-#define IEEE80211_CACHE_SIZE    100
+#define IEEE80211_CACHE_SIZE    (CONFIG_IEEE80211_NODE_NPOOL - 1) /* less ic_bss */
 #define IEEE80211_CACHE_WAIT    3600
 
+/* Node storage pools: every node takes one entry of the node pool, RSN,
+ * Block Ack and rate control state are attached only to the nodes that
+ * need them.
+ */
+
+#ifndef CONFIG_IEEE80211_NODE_NPOOL
+#  define CONFIG_IEEE80211_NODE_NPOOL 64
+#endif
+
+#ifndef CONFIG_IEEE80211_NODE_NRSN
+#  define CONFIG_IEEE80211_NODE_NRSN 16
+#endif
+
+#ifndef CONFIG_IEEE80211_NODE_NBA
+#  define CONFIG_IEEE80211_NODE_NBA 4
+#endif
+
+#ifndef CONFIG_IEEE80211_NODE_NRATECTL
+#  define CONFIG_IEEE80211_NODE_NRATECTL 16
+#endif
+
+/* Frames buffered for a station in power save mode (ni_savedq) */
+
+#ifndef CONFIG_IEEE80211_PSQ_DEPTH
+#  define CONFIG_IEEE80211_PSQ_DEPTH 32
+#endif
+
+/* Scan results not refreshed for this long (seconds) are dropped when a
+ * new scan begins in station mode.
+ */
+
+#ifndef CONFIG_IEEE80211_SCAN_CACHE_AGE
+#  define CONFIG_IEEE80211_SCAN_CACHE_AGE 60
+#endif
+
+/* Node reference counts are updated with the compiler's atomic builtins
+ * where the target has a native 32-bit compare-and-swap; otherwise
+ * interrupts are disabled around the update.
+ */
+
+#if defined(__GNUC__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+#  define IEEE80211_NODE_ATOMIC_REFCNT 1
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -135,8 +179,83 @@ struct ieee80211_rxinfo
 #define IEEE80211_RXI_HWDEC        0x00000001
 #define IEEE80211_RXI_AMPDU_DONE    0x00000002
 
+/* Per-packet metadata kept in the descriptor attached to the head IOB of a
+ * frame (CONFIG_IOB_PKTHDR).  On transmit, ph_ni carries the reference the
+ * driver must release once the frame is gone; on receive, ph_rxi travels
+ * with frames held in the A-MPDU reordering buffer, and ph_next links the
+ * MPDUs released from it together.
+ */
+
+struct ieee80211_pkthdr
+  {
+    union
+      {
+        struct ieee80211_node *phu_ni;  /* Tx: destination node */
+        struct iob_s *phu_next;         /* Rx: next released MPDU */
+      } ph_u;
+    struct ieee80211_rxinfo ph_rxi;     /* Rx meta-data */
+    uint8_t ph_tid;                     /* QoS TID */
+    uint8_t ph_ac;                      /* EDCA access category */
+    uint8_t ph_txrate;                  /* Tx rate index hint */
+    uint8_t ph_txretries;               /* Tx retry limit hint, 0: default */
+    uint16_t ph_dlt;                    /* link type, 0: Ethernet frame */
+    uint16_t ph_flags;
+  };
+
+#define ph_ni   ph_u.phu_ni
+#define ph_next ph_u.phu_next
+
+#define IEEE80211_PH_TXHINT        0x0001      /* ph_txrate/retries valid */
+#define IEEE80211_PH_AMSDU         0x0002      /* A-MSDU for TID ph_tid */
+
+/* The descriptor pool is optional for the I/O buffer layer, so that the
+ * other protocols do not pay for it, but the 802.11 stack selects it:  the
+ * transmit path hands the node reference to the driver and the reordering
+ * buffer keeps the Rx meta-data only there.  A frame may still arrive
+ * without a descriptor when the pool is exhausted, so IEEE80211_PKTHDR()
+ * may return NULL.
+ */
+
+#ifndef CONFIG_IOB_PKTHDR
+#  error CONFIG_IOB_PKTHDR is required by the 802.11 stack
+#endif
+
+/* struct ieee80211_pkthdr must fit in the descriptor data area.  The array
+ * size goes negative, and the build fails, if CONFIG_IOB_PKTHDR_SIZE is too
+ * small for it.
+ */
+
+typedef char ieee80211_pkthdr_fits
+  [sizeof(struct ieee80211_pkthdr) <=
+   sizeof(((FAR struct iob_pkthdr_s *)0)->ph_data) ? 1 : -1];
+
+/* Link types of 802.11 frames (see ph_dlt).  ieee80211_ifsend() tags every
+ * frame that is already in 802.11 format with DLT_IEEE802_11.
+ */
+
+#ifndef DLT_IEEE802_11
+#  define DLT_IEEE802_11           105
+#endif
+#ifndef DLT_IEEE802_11_RADIO
+#  define DLT_IEEE802_11_RADIO     127
+#endif
+
+/* Return the metadata of the frame in iob, or NULL if it has none */
+
+#define IEEE80211_PKTHDR(iob) \
+    ((FAR struct ieee80211_pkthdr *)IOB_PKTHDR(iob))
+
+/* Return the metadata of the frame in iob, attaching a zeroed descriptor
+ * if it has none yet.
+ */
+
+#define IEEE80211_PKTHDR_GET(iob) \
+    ((FAR struct ieee80211_pkthdr *)iob_pkthdr_attach(iob))
+
 /* Block Acknowledgement Record */
 
+struct ieee80211_txagg_s;
+
 struct ieee80211_tx_ba
   {
     struct ieee80211_node *ba_ni;       /* backpointer for callbacks */
@@ -157,25 +276,132 @@ struct ieee80211_tx_ba
 #define IEEE80211_BA_MAX_WINSZ    128 /* maximum we will accept */
 
     uint8_t ba_token;
+    struct ieee80211_txagg_s *ba_agg;   /* A-MPDU state while agreed */
+  };
+
+/* One A-MPDU reordering slot */
+
+struct ieee80211_ba_slot
+  {
+    struct iob_s *bs_iob;               /* Rx meta-data in its pkthdr */
   };
 
+#define IEEE80211_BA_BITMAP_WORDS    (IEEE80211_BA_MAX_WINSZ / 32)
+
 struct ieee80211_rx_ba
   {
     struct ieee80211_node *ba_ni;       /* backpointer for callbacks */
-    struct
-      {
-        struct iob_s *m;
-        struct ieee80211_rxinfo rxi;
-      } *ba_buf;
+    struct ieee80211_ba_slot *ba_buf;   /* ba_winsize slots, ring */
+    uint32_t ba_bitmap[IEEE80211_BA_BITMAP_WORDS]; /* bit n: WinStartB+n held */
     WDOG_ID ba_to;
     int ba_timeout_val;
     int ba_state;
     uint16_t ba_winstart;
     uint16_t ba_winend;
     uint16_t ba_winsize;
-    uint16_t ba_head;
+    uint16_t ba_head;                   /* slot of WinStartB */
+    uint8_t ba_gen;                     /* bumped when the slots are freed */
+  };
+
+/* Block Ack state, attached to a node from a pool on the first ADDBA */
+
+struct ieee80211_node_ba
+  {
+    struct ieee80211_tx_ba nb_tx[IEEE80211_NUM_TID];
+    struct ieee80211_rx_ba nb_rx[IEEE80211_NUM_TID];
   };
 
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+/* Handshake scheduling state of a node (see ieee80211_authsched.c) */
+
+#define IEEE80211_HS_WAITING    0x01    /* Waiting for a handshake slot */
+#define IEEE80211_HS_ACTIVE     0x02    /* Holds a handshake slot */
+#define IEEE80211_HS_QUEUED     0x04    /* Message 2 waiting for the worker */
+#define IEEE80211_HS_BUSY       0x08    /* Message 2 being verified */
+#define IEEE80211_HS_TIMER      0x10    /* EAPOL retry timer running */
+
+/* Message 2 carries the RSN or WPA element of the station, at most 64
+ * bytes.  Longer frames are verified inline.
+ */
+
+#define IEEE80211_HS_MSG2LEN    (sizeof(struct ieee80211_eapol_key) + 64)
+
+struct ieee80211_hsjob
+  {
+    dq_entry_t hs_link;                 /* as_waiting or as_ready */
+    dq_entry_t hs_tlink;                /* as_timers */
+    struct ieee80211_node *hs_ni;       /* backpointer */
+    uint32_t hs_start;                  /* Slot taken (system ticks) */
+    uint32_t hs_expire;                 /* EAPOL retry time (system ticks) */
+    uint16_t hs_seq;                    /* Identifies the queued message 2 */
+    uint16_t hs_len;                    /* Bytes in hs_msg2 */
+    uint16_t hs_rsnoff;                 /* Offset of the RSN IE in hs_msg2 */
+    uint8_t hs_flags;                   /* IEEE80211_HS_* */
+    uint8_t hs_msg2[IEEE80211_HS_MSG2LEN];
+  };
+#endif
+
+/* RSN key management and SA Query state, attached to a node from a pool
+ * when it joins an RSN (always for ic_bss).
+ */
+
+struct ieee80211_node_rsn
+  {
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+    struct ieee80211_hsjob rn_hs;
+#else
+    WDOG_ID rn_eapol_to;
+#endif
+    unsigned int rn_state;
+    unsigned int rn_gstate;
+    unsigned int rn_retries;
+    uint8_t rn_nonce[EAPOL_KEY_NONCE_LEN];
+    uint8_t rn_pmk[IEEE80211_PMK_LEN];
+    uint8_t rn_pmkid[IEEE80211_PMKID_LEN];
+    uint64_t rn_replaycnt;
+    uint8_t rn_replaycnt_ok;
+    uint64_t rn_reqreplaycnt;
+    uint8_t rn_reqreplaycnt_ok;
+    struct ieee80211_key rn_pairwise_key;
+    struct ieee80211_ptk rn_ptk;
+    uint8_t rn_key_count;
+
+    /* SA Query */
+
+    uint16_t rn_sa_query_trid;
+    WDOG_ID rn_sa_query_to;
+    int rn_sa_query_count;
+  };
+
+/* Per-station counters.  They are plain increments made under the network
+ * lock and are only formatted when read (see ieee80211_procfs.c).  TIDs
+ * 8-15 are counted together with TIDs 0-7.
+ */
+
+#define IEEE80211_STATS_NTID    8
+
+struct ieee80211_tidstats
+  {
+    uint32_t ts_txframes;       /* MSDUs encapsulated for the station */
+    uint32_t ts_txbytes;
+    uint32_t ts_rxframes;       /* MPDUs accepted from the station */
+    uint32_t ts_rxbytes;
+  };
+
+struct ieee80211_nodestats
+  {
+    struct ieee80211_tidstats ns_tid[IEEE80211_STATS_NTID];
+    uint32_t ns_txattempts;     /* Transmissions reported by the driver */
+    uint32_t ns_txretries;      /* Attempts after the first one */
+    uint32_t ns_txfailed;       /* Frames never acknowledged */
+    uint32_t ns_decrypterrs;    /* Frames that failed decryption */
+    uint32_t ns_replays;        /* Frames dropped as replays */
+    uint16_t ns_rssiavg;        /* RSSI moving average, in 1/16 units */
+  };
+
+#define IEEE80211_TIDSTATS(ni, tid) \
+    (&(ni)->ni_stats.ns_tid[(tid) & (IEEE80211_STATS_NTID - 1)])
+
 /* Node specific information.  Note that drivers are expected
  * to derive from this structure to add device-specific per-node
  * state.  This is done by overriding the ic_node_* methods in
@@ -194,6 +420,7 @@ struct ieee80211_node
     /* hardware */
 
     uint32_t ni_rstamp;         /* recv timestamp */
+    uint32_t ni_lastseen;       /* last beacon/probe response (ticks) */
     uint8_t ni_rssi;            /* recv ssi */
 
     /* header */
@@ -211,18 +438,16 @@ struct ieee80211_node
     struct ieee80211_rateset ni_rates;  /* negotiated rate set */
     struct ieee80211_channel *ni_chan;
     uint8_t ni_erp;             /* 11g only */
+    uint32_t ni_iecrc;          /* CRC of last beacon IEs, minus TIM */
 
     /* power saving mode */
 
     uint8_t ni_pwrsave;
     struct iob_queue_s ni_savedq;       /* Packets queued for pspoll */
+    uint16_t ni_savedqlen;              /* Number of packets in ni_savedq */
 
     /* RSN */
 
-    WDOG_ID ni_eapol_to;
-    unsigned int ni_rsn_state;
-    unsigned int ni_rsn_gstate;
-    unsigned int ni_rsn_retries;
     unsigned int ni_rsnprotos;
     unsigned int ni_rsnakms;
     unsigned int ni_rsnciphers;
@@ -230,29 +455,19 @@ struct ieee80211_node
     enum ieee80211_cipher ni_rsngroupmgmtcipher;
     uint16_t ni_rsncaps;
     enum ieee80211_cipher ni_rsncipher;
-    uint8_t ni_nonce[EAPOL_KEY_NONCE_LEN];
-    uint8_t ni_pmk[IEEE80211_PMK_LEN];
-    uint8_t ni_pmkid[IEEE80211_PMKID_LEN];
-    uint64_t ni_replaycnt;
-    uint8_t ni_replaycnt_ok;
-    uint64_t ni_reqreplaycnt;
-    uint8_t ni_reqreplaycnt_ok;
     uint8_t *ni_rsnie;
-    struct ieee80211_key ni_pairwise_key;
-    struct ieee80211_ptk ni_ptk;
-    uint8_t ni_key_count;
     int ni_port_valid;
+    struct ieee80211_node_rsn *ni_rsn;  /* key state; NULL until joined */
 
-    /* SA Query */
+    /* Block Ack records; NULL until the first ADDBA */
+
+    struct ieee80211_node_ba *ni_ba;
 
-    uint16_t ni_sa_query_trid;
-    WDOG_ID ni_sa_query_to;
-    int ni_sa_query_count;
+    /* Rate control state; NULL unless the interface has an algorithm */
 
-    /* Block Ack records */
+    union ieee80211_ratectl_node *ni_rctl;
 
-    struct ieee80211_tx_ba ni_tx_ba[IEEE80211_NUM_TID];
-    struct ieee80211_rx_ba ni_rx_ba[IEEE80211_NUM_TID];
+    struct ieee80211_nodestats ni_stats;
 
     /* others */
 
@@ -261,6 +476,7 @@ struct ieee80211_node
     uint16_t ni_rxseq;          /* seq previous received */
     uint16_t ni_qos_txseqs[IEEE80211_NUM_TID];
     uint16_t ni_qos_rxseqs[IEEE80211_NUM_TID];
+    uint8_t ni_ndefrag;         /* MSDUs being reassembled */
     int ni_fails;               /* failure count to associate */
     int ni_inact;               /* inactivity mark count */
     int ni_txrate;              /* index to ni_rates[] */
@@ -300,15 +516,22 @@ MALLOC_DECLARE(M_80211_NODE);
 
 static __inline void ieee80211_node_incref(struct ieee80211_node *ni)
 {
+#ifdef IEEE80211_NODE_ATOMIC_REFCNT
+  (void)__sync_add_and_fetch(&ni->ni_refcnt, 1);
+#else
   irqstate_t flags;
 
   flags = irqsave();
   ni->ni_refcnt++;
   irqrestore(flags);
+#endif
 }
 
 static __inline unsigned int ieee80211_node_decref(struct ieee80211_node *ni)
 {
+#ifdef IEEE80211_NODE_ATOMIC_REFCNT
+  return __sync_sub_and_fetch(&ni->ni_refcnt, 1);
+#else
   unsigned int refcnt;
   irqstate_t flags;
 
@@ -316,6 +539,7 @@ static __inline unsigned int ieee80211_node_decref(struct ieee80211_node *ni)
   refcnt = --ni->ni_refcnt;
   irqrestore(flags);
   return refcnt;
+#endif
 }
 
 static __inline struct ieee80211_node *ieee80211_ref_node(struct ieee80211_node
@@ -339,11 +563,24 @@ void ieee80211_begin_scan(struct ieee80211_s *);
 void ieee80211_next_scan(struct ieee80211_s *);
 void ieee80211_end_scan(struct ieee80211_s *);
 void ieee80211_reset_scan(struct ieee80211_s *);
+void ieee80211_age_scan_cache(FAR struct ieee80211_s *ic);
+void ieee80211_roam(FAR struct ieee80211_s *ic,
+                    FAR struct ieee80211_node *selbs);
 struct ieee80211_node *ieee80211_alloc_node(struct ieee80211_s *,
                                             const uint8_t *);
 struct ieee80211_node *ieee80211_dup_bss(struct ieee80211_s *, const uint8_t *);
 struct ieee80211_node *ieee80211_find_node(struct ieee80211_s *,
                                            const uint8_t *);
+FAR struct ieee80211_node *ieee80211_nodepool_alloc(void);
+void ieee80211_nodepool_free(FAR struct ieee80211_node *ni);
+int ieee80211_node_rsn_attach(FAR struct ieee80211_node *ni);
+void ieee80211_node_rsn_detach(FAR struct ieee80211_node *ni);
+#ifdef CONFIG_IEEE80211_HT
+int ieee80211_node_ba_attach(FAR struct ieee80211_node *ni);
+void ieee80211_node_ba_detach(FAR struct ieee80211_node *ni);
+#endif
+int ieee80211_node_rctl_attach(FAR struct ieee80211_node *ni);
+void ieee80211_node_rctl_detach(FAR struct ieee80211_node *ni);
 struct ieee80211_node *ieee80211_find_rxnode(struct ieee80211_s *,
                                              const struct ieee80211_frame *);
 struct ieee80211_node *ieee80211_find_txnode(struct ieee80211_s *,
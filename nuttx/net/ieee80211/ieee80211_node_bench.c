@@ -0,0 +1,275 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_node_bench.c
+ * Host benchmark for node table lookups.  This is not part of the NuttX
+ * build.  Build and run it on the development host with:
+ *
+ *   cc -O2 -DIEEE80211_HOSTBENCH -I.. -idirafter ../../include \
+ *      -o node_bench ieee80211_node_bench.c
+ *   ./node_bench
+ *
+ * It compares the RB tree walk that ieee80211_find_node() used to do with
+ * the node table index that ieee80211_node.c uses now, both the plain
+ * hash and the per-direction last-hit cache, for tables of 1, 32 and 256
+ * nodes.  The index is the real one from ieee80211_nodetab.h, and the
+ * bench checks that it agrees with the tree, also after removals.
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <nuttx/tree.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define IEEE80211_ADDR_LEN      6
+#define CONFIG_IEEE80211_NODE_HASHSIZE 512      /* Twice the largest table */
+#define BENCH_LOOKUPS           (4 * 1024 * 1024)
+#define BENCH_BURST             8       /* Frames per station in a burst */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Only the members of struct ieee80211_node that the index touches */
+
+struct ieee80211_node
+  {
+    RB_ENTRY(ieee80211_node) ni_node;
+    uint8_t ni_macaddr[IEEE80211_ADDR_LEN];
+  };
+
+RB_HEAD(bench_tree, ieee80211_node);
+
+#include "ieee80211/ieee80211_nodetab.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const unsigned int g_nnodes[] = { 1, 32, 256 };
+
+static struct bench_tree g_tree;
+static struct ieee80211_nodetab_s g_nodetab;
+static struct ieee80211_node g_nodes[256];
+static uint16_t g_pattern[BENCH_LOOKUPS];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static int bench_cmp(const struct ieee80211_node *b1,
+                     const struct ieee80211_node *b2)
+{
+  return memcmp(b1->ni_macaddr, b2->ni_macaddr, IEEE80211_ADDR_LEN);
+}
+
+RB_GENERATE_STATIC(bench_tree, ieee80211_node, ni_node, bench_cmp);
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* The RB tree walk formerly done by ieee80211_find_node() */
+
+static struct ieee80211_node *find_tree(const uint8_t *macaddr)
+{
+  struct ieee80211_node *ni;
+  int cmp;
+
+  ni = RB_ROOT(&g_tree);
+  while (ni != NULL)
+    {
+      cmp = memcmp(macaddr, ni->ni_macaddr, IEEE80211_ADDR_LEN);
+      if (cmp < 0)
+        {
+          ni = RB_LEFT(ni, ni_node);
+        }
+      else if (cmp > 0)
+        {
+          ni = RB_RIGHT(ni, ni_node);
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  return ni;
+}
+
+static struct ieee80211_node *find_hash(const uint8_t *macaddr)
+{
+  return ieee80211_nodetab_find(&g_nodetab, macaddr);
+}
+
+/* What ieee80211_find_rxnode()/ieee80211_find_txnode() do */
+
+static struct ieee80211_node *find_cached(const uint8_t *macaddr)
+{
+  return ieee80211_nodetab_lookup(&g_nodetab, &g_nodetab.nt_rxhit, macaddr);
+}
+
+static void setup(unsigned int nnodes)
+{
+  unsigned int i;
+
+  RB_INIT(&g_tree);
+  ieee80211_nodetab_init(&g_nodetab);
+
+  /* Stations from a handful of vendors, as seen by a real AP */
+
+  for (i = 0; i < nnodes; i++)
+    {
+      g_nodes[i].ni_macaddr[0] = 0x00;
+      g_nodes[i].ni_macaddr[1] = 0x1b + (i & 3);
+      g_nodes[i].ni_macaddr[2] = 0x63;
+      g_nodes[i].ni_macaddr[3] = (uint8_t)rand();
+      g_nodes[i].ni_macaddr[4] = (uint8_t)rand();
+      g_nodes[i].ni_macaddr[5] = (uint8_t)i;
+      RB_INSERT(bench_tree, &g_tree, &g_nodes[i]);
+      ieee80211_nodetab_insert(&g_nodetab, &g_nodes[i]);
+    }
+}
+
+typedef struct ieee80211_node *(*find_func_t)(const uint8_t *);
+
+static double bench(find_func_t func)
+{
+  struct ieee80211_node *ni;
+  unsigned int found = 0;
+  unsigned int i;
+  double start;
+  double elapsed;
+
+  start = now();
+  for (i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      ni = func(g_nodes[g_pattern[i]].ni_macaddr);
+      found += (ni != NULL);
+    }
+
+  elapsed = now() - start;
+  if (found != BENCH_LOOKUPS)
+    {
+      fprintf(stderr, "ERROR: %u lookups failed\n", BENCH_LOOKUPS - found);
+      exit(EXIT_FAILURE);
+    }
+
+  return elapsed * 1e9 / BENCH_LOOKUPS;
+}
+
+static void run(unsigned int nnodes, unsigned int burst)
+{
+  unsigned int i;
+  unsigned int n = 0;
+
+  for (i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      if (i % burst == 0)
+        {
+          n = (unsigned int)rand() % nnodes;
+        }
+
+      g_pattern[i] = n;
+    }
+
+  printf("%-6u %-6u %12.1f %12.1f %12.1f\n", nnodes, burst,
+         bench(find_tree), bench(find_hash), bench(find_cached));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(void)
+{
+  unsigned int nnodes;
+  unsigned int i;
+  unsigned int j;
+
+  srand(1);
+
+  /* Sanity check:  Both indexes must agree, also after removals */
+
+  setup(256);
+  for (i = 0; i < 256; i += 3)
+    {
+      RB_REMOVE(bench_tree, &g_tree, &g_nodes[i]);
+      ieee80211_nodetab_remove(&g_nodetab, &g_nodes[i]);
+    }
+
+  if (g_nodetab.nt_count != 256 - 86 || g_nodetab.nt_spill != 0)
+    {
+      fprintf(stderr, "ERROR: node count %u spill %u\n",
+              g_nodetab.nt_count, g_nodetab.nt_spill);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < 256; i++)
+    {
+      if (find_tree(g_nodes[i].ni_macaddr) !=
+          find_hash(g_nodes[i].ni_macaddr))
+        {
+          fprintf(stderr, "ERROR: index mismatch for node %u\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+
+  printf("%-6s %-6s %12s %12s %12s\n", "nodes", "burst",
+         "tree ns", "hash ns", "cached ns");
+  for (i = 0; i < sizeof(g_nnodes) / sizeof(g_nnodes[0]); i++)
+    {
+      nnodes = g_nnodes[i];
+      setup(nnodes);
+      for (j = 1; j <= BENCH_BURST; j *= BENCH_BURST)
+        {
+          run(nnodes, j);
+        }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,409 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_nodepool.c
+ * Fixed pools for node records and their RSN and Block Ack state
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <wdog.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_debug.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_ratectl.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define POOL_WORDS(n) (((n) + 31) / 32)
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Each pool has an allocation bitmap (1 = in use).  Every node seen during
+ * a scan takes an entry of g_nodepool; only associated RSN stations (and
+ * ic_bss) take RSN state, only peers with a Block Ack agreement take
+ * Block Ack state and only peers we send data to take rate control state.
+ */
+
+static struct ieee80211_node g_nodepool[CONFIG_IEEE80211_NODE_NPOOL];
+static uint32_t g_nodemap[POOL_WORDS(CONFIG_IEEE80211_NODE_NPOOL)];
+
+static struct ieee80211_node_rsn g_rsnpool[CONFIG_IEEE80211_NODE_NRSN];
+static uint32_t g_rsnmap[POOL_WORDS(CONFIG_IEEE80211_NODE_NRSN)];
+
+#ifdef CONFIG_IEEE80211_HT
+static struct ieee80211_node_ba g_bapool[CONFIG_IEEE80211_NODE_NBA];
+static uint32_t g_bamap[POOL_WORDS(CONFIG_IEEE80211_NODE_NBA)];
+#endif
+
+static union ieee80211_ratectl_node g_rctlpool[CONFIG_IEEE80211_NODE_NRATECTL];
+static uint32_t g_rctlmap[POOL_WORDS(CONFIG_IEEE80211_NODE_NRATECTL)];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_pool_take
+ *
+ * Description:
+ *   Claim the first free entry of a pool.  Returns its index or -ENOMEM.
+ *
+ ****************************************************************************/
+
+static int ieee80211_pool_take(FAR uint32_t *map, int nentries)
+{
+  uip_lock_t flags;
+  uint32_t bit;
+  int ndx;
+
+  flags = uip_lock();
+  for (ndx = 0; ndx < nentries; ndx++)
+    {
+      bit = (uint32_t)1 << (ndx & 31);
+      if ((map[ndx >> 5] & bit) == 0)
+        {
+          map[ndx >> 5] |= bit;
+          uip_unlock(flags);
+          return ndx;
+        }
+    }
+
+  uip_unlock(flags);
+  return -ENOMEM;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pool_give
+ *
+ * Description:
+ *   Return entry 'ndx' to a pool.
+ *
+ ****************************************************************************/
+
+static void ieee80211_pool_give(FAR uint32_t *map, int ndx)
+{
+  uip_lock_t flags;
+
+  flags = uip_lock();
+  DEBUGASSERT((map[ndx >> 5] & ((uint32_t)1 << (ndx & 31))) != 0);
+  map[ndx >> 5] &= ~((uint32_t)1 << (ndx & 31));
+  uip_unlock(flags);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_nodepool_alloc
+ *
+ * Description:
+ *   Allocate a zeroed node record without RSN or Block Ack state.  This is
+ *   the default ic_node_alloc method.  Returns NULL if the pool is empty.
+ *
+ ****************************************************************************/
+
+FAR struct ieee80211_node *ieee80211_nodepool_alloc(void)
+{
+  FAR struct ieee80211_node *ni;
+  int ndx;
+
+  ndx = ieee80211_pool_take(g_nodemap, CONFIG_IEEE80211_NODE_NPOOL);
+  if (ndx < 0)
+    {
+      ndbg("ERROR: Node pool exhausted\n");
+      return NULL;
+    }
+
+  ni = &g_nodepool[ndx];
+  memset(ni, 0, sizeof(struct ieee80211_node));
+  return ni;
+}
+
+/****************************************************************************
+ * Name: ieee80211_nodepool_free
+ *
+ * Description:
+ *   Return a node record to the pool.  Any RSN or Block Ack state must
+ *   already have been detached.
+ *
+ ****************************************************************************/
+
+void ieee80211_nodepool_free(FAR struct ieee80211_node *ni)
+{
+  DEBUGASSERT(ni >= g_nodepool &&
+              ni < &g_nodepool[CONFIG_IEEE80211_NODE_NPOOL]);
+  DEBUGASSERT(ni->ni_rsn == NULL && ni->ni_ba == NULL);
+
+  ieee80211_pool_give(g_nodemap, ni - g_nodepool);
+}
+
+/****************************************************************************
+ * Name: ieee80211_node_rsn_attach
+ *
+ * Description:
+ *   Give a node zeroed RSN key management state, including its EAPOL and
+ *   SA Query timers.  Does nothing if the node already has it.
+ *
+ * Returned Value:
+ *   OK on success; -ENOMEM if the pool or the watchdog timers are
+ *   exhausted.
+ *
+ ****************************************************************************/
+
+int ieee80211_node_rsn_attach(FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_node_rsn *rn;
+  int ndx;
+
+  if (ni->ni_rsn != NULL)
+    {
+      return OK;
+    }
+
+  ndx = ieee80211_pool_take(g_rsnmap, CONFIG_IEEE80211_NODE_NRSN);
+  if (ndx < 0)
+    {
+      ndbg("ERROR: No RSN state for %s\n",
+           ieee80211_addr2str(ni->ni_macaddr));
+      return -ENOMEM;
+    }
+
+  rn = &g_rsnpool[ndx];
+  memset(rn, 0, sizeof(struct ieee80211_node_rsn));
+
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  /* EAPOL retransmissions run off the handshake scheduler's timer */
+
+  rn->rn_sa_query_to = wd_create();
+  if (rn->rn_sa_query_to == NULL)
+#else
+  rn->rn_eapol_to = wd_create();
+  rn->rn_sa_query_to = wd_create();
+  if (rn->rn_eapol_to == NULL || rn->rn_sa_query_to == NULL)
+#endif
+    {
+      ndbg("ERROR: No watchdog for %s\n",
+           ieee80211_addr2str(ni->ni_macaddr));
+
+#ifndef CONFIG_IEEE80211_AUTHSCHED
+      if (rn->rn_eapol_to != NULL)
+        {
+          wd_delete(rn->rn_eapol_to);
+        }
+#endif
+
+      if (rn->rn_sa_query_to != NULL)
+        {
+          wd_delete(rn->rn_sa_query_to);
+        }
+
+      ieee80211_pool_give(g_rsnmap, ndx);
+      return -ENOMEM;
+    }
+
+  ni->ni_rsn = rn;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_node_rsn_detach
+ *
+ * Description:
+ *   Stop the RSN timers of a node, wipe its key material and return the
+ *   state to the pool.
+ *
+ ****************************************************************************/
+
+void ieee80211_node_rsn_detach(FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_node_rsn *rn = ni->ni_rsn;
+
+  if (rn == NULL)
+    {
+      return;
+    }
+
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  if (ni->ni_ic != NULL)
+    {
+      ieee80211_authsched_discard(ni->ni_ic, ni);
+    }
+#else
+  wd_delete(rn->rn_eapol_to);
+#endif
+  wd_delete(rn->rn_sa_query_to);
+  memset(rn, 0, sizeof(struct ieee80211_node_rsn));
+
+  ni->ni_rsn = NULL;
+  ieee80211_pool_give(g_rsnmap, rn - g_rsnpool);
+}
+
+#ifdef CONFIG_IEEE80211_HT
+/****************************************************************************
+ * Name: ieee80211_node_ba_attach
+ *
+ * Description:
+ *   Give a node Block Ack records for all TIDs, in the initial state.
+ *   Does nothing if the node already has them.
+ *
+ * Returned Value:
+ *   OK on success; -ENOMEM if the pool is exhausted.
+ *
+ ****************************************************************************/
+
+int ieee80211_node_ba_attach(FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_node_ba *nb;
+  int ndx;
+  int tid;
+
+  if (ni->ni_ba != NULL)
+    {
+      return OK;
+    }
+
+  ndx = ieee80211_pool_take(g_bamap, CONFIG_IEEE80211_NODE_NBA);
+  if (ndx < 0)
+    {
+      ndbg("ERROR: No Block Ack state for %s\n",
+           ieee80211_addr2str(ni->ni_macaddr));
+      return -ENOMEM;
+    }
+
+  nb = &g_bapool[ndx];
+  memset(nb, 0, sizeof(struct ieee80211_node_ba));
+
+  for (tid = 0; tid < IEEE80211_NUM_TID; tid++)
+    {
+      nb->nb_tx[tid].ba_ni = ni;
+      nb->nb_rx[tid].ba_ni = ni;
+    }
+
+  ni->ni_ba = nb;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_node_ba_detach
+ *
+ * Description:
+ *   Return the Block Ack records of a node to the pool.  The caller must
+ *   already have torn down every agreement (ieee80211_reorder_free() and
+ *   ieee80211_ampdu_stop()).
+ *
+ ****************************************************************************/
+
+void ieee80211_node_ba_detach(FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_node_ba *nb = ni->ni_ba;
+
+  if (nb == NULL)
+    {
+      return;
+    }
+
+  ni->ni_ba = NULL;
+  ieee80211_pool_give(g_bamap, nb - g_bapool);
+}
+#endif /* CONFIG_IEEE80211_HT */
+
+/****************************************************************************
+ * Name: ieee80211_node_rctl_attach
+ *
+ * Description:
+ *   Give a node rate control state.  The contents are left to the
+ *   algorithm to initialize.  Does nothing if the node already has it.
+ *
+ * Returned Value:
+ *   OK on success; -ENOMEM if the pool is exhausted.
+ *
+ ****************************************************************************/
+
+int ieee80211_node_rctl_attach(FAR struct ieee80211_node *ni)
+{
+  int ndx;
+
+  if (ni->ni_rctl != NULL)
+    {
+      return OK;
+    }
+
+  ndx = ieee80211_pool_take(g_rctlmap, CONFIG_IEEE80211_NODE_NRATECTL);
+  if (ndx < 0)
+    {
+      ndbg("ERROR: No rate control state for %s\n",
+           ieee80211_addr2str(ni->ni_macaddr));
+      return -ENOMEM;
+    }
+
+  ni->ni_rctl = &g_rctlpool[ndx];
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_node_rctl_detach
+ *
+ * Description:
+ *   Return the rate control state of a node to the pool.
+ *
+ ****************************************************************************/
+
+void ieee80211_node_rctl_detach(FAR struct ieee80211_node *ni)
+{
+  FAR union ieee80211_ratectl_node *rn = ni->ni_rctl;
+
+  if (rn == NULL)
+    {
+      return;
+    }
+
+  ni->ni_rctl = NULL;
+  ieee80211_pool_give(g_rctlmap, rn - g_rctlpool);
+}
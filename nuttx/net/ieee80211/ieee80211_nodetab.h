@@ -0,0 +1,257 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_nodetab.h
+ * Node table index:  open-addressing MAC hash with last-hit caches
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_NODETAB_H
+#define __NET_IEEE80211_IEEE80211_NODETAB_H
+
+/* The index only touches ni_macaddr, so it is kept apart from the rest of
+ * ieee80211_node.c; ieee80211_node_bench.c runs this same code on the
+ * host.  struct ieee80211_node must be complete before this header is
+ * included.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#else
+#  define FAR
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ieee80211/ieee80211_hash.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Number of buckets; must be a power of two */
+
+#ifndef CONFIG_IEEE80211_NODE_HASHSIZE
+#  define CONFIG_IEEE80211_NODE_HASHSIZE 256
+#endif
+
+#if (CONFIG_IEEE80211_NODE_HASHSIZE & (CONFIG_IEEE80211_NODE_HASHSIZE - 1)) != 0
+#  error CONFIG_IEEE80211_NODE_HASHSIZE must be a power of two
+#endif
+
+#define IEEE80211_NODETAB_MASK (CONFIG_IEEE80211_NODE_HASHSIZE - 1)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct ieee80211_nodetab_s
+  {
+    FAR struct ieee80211_node *nt_hash[CONFIG_IEEE80211_NODE_HASHSIZE];
+    FAR struct ieee80211_node *nt_rxhit;    /* last find_rxnode() hit */
+    FAR struct ieee80211_node *nt_txhit;    /* last find_txnode() hit */
+    unsigned int nt_count;                  /* # nodes in nt_hash */
+    unsigned int nt_spill;                  /* # nodes that did not fit */
+  };
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+static inline unsigned int ieee80211_nodetab_bucket(FAR const uint8_t *macaddr)
+{
+  return ieee80211_mac_hash(macaddr, 0) & IEEE80211_NODETAB_MASK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_nodetab_init
+ ****************************************************************************/
+
+static inline void ieee80211_nodetab_init(FAR struct ieee80211_nodetab_s *nt)
+{
+  memset(nt, 0, sizeof(struct ieee80211_nodetab_s));
+}
+
+/****************************************************************************
+ * Name: ieee80211_nodetab_insert
+ *
+ * Description:
+ *   Add a node to the hash.  One bucket is always left empty so that probe
+ *   sequences terminate; nodes that do not fit are only counted in
+ *   nt_spill and must be found some other way.
+ *
+ ****************************************************************************/
+
+static inline void ieee80211_nodetab_insert(FAR struct ieee80211_nodetab_s *nt,
+                                            FAR struct ieee80211_node *ni)
+{
+  unsigned int i;
+
+  if (nt->nt_count >= IEEE80211_NODETAB_MASK)
+    {
+      nt->nt_spill++;
+      return;
+    }
+
+  i = ieee80211_nodetab_bucket(ni->ni_macaddr);
+  while (nt->nt_hash[i] != NULL)
+    {
+      i = (i + 1) & IEEE80211_NODETAB_MASK;
+    }
+
+  nt->nt_hash[i] = ni;
+  nt->nt_count++;
+}
+
+/****************************************************************************
+ * Name: ieee80211_nodetab_remove
+ *
+ * Description:
+ *   Remove a node from the hash and the last-hit caches, shifting the rest
+ *   of its probe sequence back so that no tombstones are needed.
+ *
+ ****************************************************************************/
+
+static inline void ieee80211_nodetab_remove(FAR struct ieee80211_nodetab_s *nt,
+                                            FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_node *nj;
+  unsigned int i;
+  unsigned int j;
+  unsigned int h;
+
+  if (nt->nt_rxhit == ni)
+    {
+      nt->nt_rxhit = NULL;
+    }
+
+  if (nt->nt_txhit == ni)
+    {
+      nt->nt_txhit = NULL;
+    }
+
+  for (i = ieee80211_nodetab_bucket(ni->ni_macaddr); nt->nt_hash[i] != ni;
+       i = (i + 1) & IEEE80211_NODETAB_MASK)
+    {
+      if (nt->nt_hash[i] == NULL)
+        {
+          /* Spilled node */
+
+          nt->nt_spill--;
+          return;
+        }
+    }
+
+  for (j = (i + 1) & IEEE80211_NODETAB_MASK;
+       (nj = nt->nt_hash[j]) != NULL;
+       j = (j + 1) & IEEE80211_NODETAB_MASK)
+    {
+      /* nj may fill the hole at i unless its home bucket lies in (i, j] */
+
+      h = ieee80211_nodetab_bucket(nj->ni_macaddr);
+      if (((j - h) & IEEE80211_NODETAB_MASK) >=
+          ((j - i) & IEEE80211_NODETAB_MASK))
+        {
+          nt->nt_hash[i] = nj;
+          i = j;
+        }
+    }
+
+  nt->nt_hash[i] = NULL;
+  nt->nt_count--;
+}
+
+/****************************************************************************
+ * Name: ieee80211_nodetab_find
+ *
+ * Description:
+ *   Look a MAC address up in the hash.  A NULL return is only final if
+ *   nt_spill is zero.
+ *
+ ****************************************************************************/
+
+static inline FAR struct ieee80211_node *
+ieee80211_nodetab_find(FAR const struct ieee80211_nodetab_s *nt,
+                       FAR const uint8_t *macaddr)
+{
+  FAR struct ieee80211_node *ni;
+  unsigned int i;
+
+  for (i = ieee80211_nodetab_bucket(macaddr); (ni = nt->nt_hash[i]) != NULL;
+       i = (i + 1) & IEEE80211_NODETAB_MASK)
+    {
+      if (memcmp(ni->ni_macaddr, macaddr, IEEE80211_ADDR_LEN) == 0)
+        {
+          return ni;
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: ieee80211_nodetab_lookup
+ *
+ * Description:
+ *   Like ieee80211_nodetab_find(), but try the last hit first and remember
+ *   a new one in '*hit' (nt_rxhit or nt_txhit).  Consecutive frames usually
+ *   come from, or go to, the same station.
+ *
+ ****************************************************************************/
+
+static inline FAR struct ieee80211_node *
+ieee80211_nodetab_lookup(FAR const struct ieee80211_nodetab_s *nt,
+                         FAR struct ieee80211_node **hit,
+                         FAR const uint8_t *macaddr)
+{
+  FAR struct ieee80211_node *ni = *hit;
+
+  if (ni != NULL &&
+      memcmp(ni->ni_macaddr, macaddr, IEEE80211_ADDR_LEN) == 0)
+    {
+      return ni;
+    }
+
+  ni = ieee80211_nodetab_find(nt, macaddr);
+  if (ni != NULL)
+    {
+      *hit = ni;
+    }
+
+  return ni;
+}
+
+#endif /* __NET_IEEE80211_IEEE80211_NODETAB_H */
@@ -56,6 +56,7 @@
 #  endif
 #endif
 
+#include <nuttx/kmalloc.h>
 #include <nuttx/net/arp.h>
 #include <nuttx/net/iob.h>
 #include <nuttx/net/uip/uip.h>
@@ -68,16 +69,27 @@
 
 #include "net_internal.h"
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Length of the Supported Rates and Extended Supported Rates elements of a
+ * rate set, and the largest such length.
+ */
+
+#define IEEE80211_RATES_LEN(rs) \
+  (2 + (rs)->rs_nrates + \
+   (((rs)->rs_nrates > IEEE80211_RATE_SIZE) ? 2 : 0))
+#define IEEE80211_RATES_MAXLEN (2 + 2 + IEEE80211_RATE_MAXSIZE)
+
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
 
-int ieee80211_classify(struct ieee80211_s *, struct iob_s *);
 static int ieee80211_mgmt_output(struct ieee80211_s *, struct ieee80211_node *,
                                  struct iob_s *, int);
 uint8_t *ieee80211_add_rsn_body(uint8_t *, struct ieee80211_s *,
                                 const struct ieee80211_node *, int);
-struct iob_s *ieee80211_getmgmt(int, unsigned int);
 struct iob_s *ieee80211_get_probe_req(struct ieee80211_s *,
                                       struct ieee80211_node *);
 #ifdef CONFIG_IEEE80211_AP
@@ -115,15 +127,15 @@ struct iob_s *ieee80211_get_action(struct ieee80211_s *,
  * Private Functions
  ****************************************************************************/
 
-/* IEEE 802.11 output routine. Normally this will directly call the
- * Ethernet output routine because 802.11 encapsulation is called
- * later by the driver. This function can be used to send raw frames
- * if the buffer has been tagged with a 802.11 data link type.
+/* IEEE 802.11 output routine.  Ethernet frames are handed to
+ * ieee80211_ifsend(), which does the 802.11 encapsulation and encryption
+ * before the frames are queued for the driver.  This function can be used
+ * to send raw frames if the buffer has been tagged with a 802.11 data link
+ * type.
  */
 
 #warning REVISIT: This was registered via the ifnet structure for use the driver level.
 #warning REVISIT: It is not currently integrated with the rest of the logic
-#warning REVISIT: Perhaps it should be included in ieee80211_ifsend()?
 
 /* The BSD networking layer calls back (via the now non-nonexistent if_output
  * function pointer) when the interface is ready to send data.  The original
@@ -140,8 +152,7 @@ int ieee80211_output(FAR struct ieee80211_s *ic, FAR struct iob_s *iob,
 {
   FAR struct uip_driver_s *dev;
   FAR struct ieee80211_frame *wh;
-  FAR struct m_tag *mtag;
-  uip_lock_t flags;
+  FAR struct ieee80211_pkthdr *ph;
   int error = 0;
 
   /* Get the driver structure */
@@ -161,11 +172,12 @@ int ieee80211_output(FAR struct ieee80211_s *ic, FAR struct iob_s *iob,
       goto bad;
     }
 
-  /* Try to get the DLT from a buffer tag */
+  /* Try to get the DLT from the packet header */
 
-  if ((mtag = m_tag_find(iob, PACKET_TAG_DLT, NULL)) != NULL)
+  ph = IEEE80211_PKTHDR(iob);
+  if (ph != NULL && ph->ph_dlt != 0)
     {
-      unsigned int dlt = *(unsigned int *)(mtag + 1);
+      unsigned int dlt = ph->ph_dlt;
 
       /* Fallback to Ethernet for non-802.11 linktypes */
 
@@ -195,23 +207,19 @@ int ieee80211_output(FAR struct ieee80211_s *ic, FAR struct iob_s *iob,
        * start output if interface not yet active.
        */
 
-      flags = uip_lock();
-      error = ieee80211_ifsend(ic, iob, flags);
+      error = ieee80211_ifsend(ic, iob, flags | IFSEND_RAW);
       if (error)
         {
           /* buffer is already freed */
 
-          uip_unlock(flags);
           ndbg("ERROR: %s: failed to queue raw tx frame\n", ic->ic_ifname);
-          return error;
         }
 
-      uip_unlock(flags);
       return error;
     }
 
 fallback:
-  return ether_output(ic, iob, dst);
+  return ieee80211_ifsend(ic, iob, flags);
 
 bad:
   if (iob)
@@ -233,18 +241,13 @@ static int ieee80211_mgmt_output(struct ieee80211_s *ic,
                                  struct ieee80211_node *ni, struct iob_s *iob,
                                  int type)
 {
+  FAR struct ieee80211_pkthdr *ph;
   struct ieee80211_frame *wh;
   int error;
 
   DEBUGASSERT(ni != NULL);
   ni->ni_inact = 0;
 
-  /* We want to pass the node down to the driver's start routine.  We could
-   * stick this in an m_tag and tack that on to the buffer.  However that's
-   * rather expensive to do for every frame so instead we stuff it in a special 
-   * pkthdr field.
-   */
-
   error = iob_contig(iob, sizeof(struct ieee80211_frame));
   if (error < 0)
     {
@@ -252,8 +255,18 @@ static int ieee80211_mgmt_output(struct ieee80211_s *ic,
       return error;
     }
 
-#warning REVISIT:  We do not want to burden everty IOB with this information
-//iob->io_priv = ni;
+  /* We want to pass the node down to the driver's start routine.  It goes
+   * in the packet header of the frame.
+   */
+
+  ph = IEEE80211_PKTHDR_GET(iob);
+  if (ph == NULL)
+    {
+      ndbg("ERROR: No packet header\n");
+      return -ENOMEM;
+    }
+
+  ph->ph_ni = ni;
 
   wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
   wh->i_fc[0] = IEEE80211_FC0_VERSION_0 | IEEE80211_FC0_TYPE_MGT | type;
@@ -314,8 +327,7 @@ static int ieee80211_mgmt_output(struct ieee80211_s *ic,
     }
 #endif
 
-  iob_add_queue(iob, &ic->ic_mgtq);
-  return 0;
+  return ieee80211_ifsend(ic, iob, IFSEND_MGMT);
 }
 
 /* EDCA tables are computed using the following formulas:
@@ -561,19 +573,21 @@ FAR struct iob_s *ieee80211_encap(FAR struct ieee80211_s *ic,
   FAR struct ieee80211_frame *wh;
   FAR struct ieee80211_node *ni = NULL;
   struct llc *llc;
-  FAR struct m_tag *mtag;
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct ieee80211_tidstats *ts;
   FAR uint8_t *addr;
   unsigned int dlt;
   unsigned int hdrlen;
   int addqos;
+  int amsdu;
   int tid;
-  int error;
 
   /* Handle raw frames if buffer is tagged as 802.11 */
 
-  if ((mtag = m_tag_find(iob, PACKET_TAG_DLT, NULL)) != NULL)
+  ph = IEEE80211_PKTHDR(iob);
+  if (ph != NULL && ph->ph_dlt != 0)
     {
-      dlt = *(unsigned int *)(mtag + 1);
+      dlt = ph->ph_dlt;
 
       if (!(dlt == DLT_IEEE802_11 || dlt == DLT_IEEE802_11_RADIO))
         {
@@ -611,6 +625,7 @@ FAR struct iob_s *ieee80211_encap(FAR struct ieee80211_s *ic,
         }
 
       ni->ni_inact = 0;
+      ph->ph_ni = ni;
       *pni = ni;
       return (iob);
     }
@@ -650,9 +665,24 @@ fallback:
     ni->ni_inact = 0;
   }
 
-  if ((ic->ic_flags & IEEE80211_F_QOS) && (ni->ni_flags & IEEE80211_NODE_QOS) &&
-      /* do not QoS-encapsulate EAPOL frames */
-      ethhdr.type != htons(UIP_ETHTYPE_PAE))
+  /* An A-MSDU built by the transmit aggregator is marked, along with its
+   * TID, in the packet header.  Only the DA and SA of its pseudo Ethernet
+   * header are meaningful; the subframes already have their own LLC/SNAP
+   * headers.
+   */
+
+  amsdu = ph != NULL && (ph->ph_flags & IEEE80211_PH_AMSDU) != 0;
+
+  if (amsdu)
+    {
+      tid = ph->ph_tid;
+      hdrlen = sizeof(struct ieee80211_qosframe);
+      addqos = 1;
+    }
+  else if ((ic->ic_flags & IEEE80211_F_QOS) &&
+           (ni->ni_flags & IEEE80211_NODE_QOS) &&
+           /* do not QoS-encapsulate EAPOL frames */
+           ethhdr.type != htons(UIP_ETHTYPE_PAE))
     {
       tid = ieee80211_classify(ic, iob);
       hdrlen = sizeof(struct ieee80211_qosframe);
@@ -664,19 +694,30 @@ fallback:
       addqos = 0;
     }
 
-  iob = iob_trimhead(iob, sizeof(struct uip_eth_hdr) - LLC_SNAPFRAMELEN);
-  llc = (FAR struct llc *)IOB_DATA(iob);
-  llc->llc_dsap = llc->llc_ssap = LLC_SNAP_LSAP;
-  llc->llc_control = LLC_UI;
-  llc->llc_snap.org_code[0] = 0;
-  llc->llc_snap.org_code[1] = 0;
-  llc->llc_snap.org_code[2] = 0;
-  llc->llc_snap.type = ethhdr.type;
+  if (amsdu)
+    {
+      iob = iob_trimhead(iob, sizeof(struct uip_eth_hdr));
+    }
+  else
+    {
+      iob = iob_trimhead(iob, sizeof(struct uip_eth_hdr) - LLC_SNAPFRAMELEN);
+      llc = (FAR struct llc *)IOB_DATA(iob);
+      llc->llc_dsap = llc->llc_ssap = LLC_SNAP_LSAP;
+      llc->llc_control = LLC_UI;
+      llc->llc_snap.org_code[0] = 0;
+      llc->llc_snap.org_code[1] = 0;
+      llc->llc_snap.org_code[2] = 0;
+      llc->llc_snap.type = ethhdr.type;
+    }
+
+  /* Prepend the 802.11 header.  A new head I/O buffer, if one is needed,
+   * keeps room in front of the header for an in-place cipher header.
+   */
 
-  error = iob_contig(iob, hdrlen);
-  if (error < 0)
+  iob = ieee80211_iob_prepend(iob, hdrlen);
+  if (iob == NULL)
     {
-      ndbg("ERROR: Failed to make contiguous: %d\n", error);
+      ndbg("ERROR: Failed to prepend 802.11 header\n");
       goto bad;
     }
 
@@ -688,12 +729,18 @@ fallback:
       FAR struct ieee80211_qosframe *qwh = (struct ieee80211_qosframe *)wh;
       uint16_t qos = tid;
 
+      if (amsdu)
+        {
+          qos |= IEEE80211_QOS_AMSDU;
+        }
+
       if (ic->ic_tid_noack & (1 << tid))
         {
           qos |= IEEE80211_QOS_ACK_POLICY_NOACK;
         }
 #ifdef CONFIG_IEEE80211_HT
-      else if (ni->ni_tx_ba[tid].ba_state == IEEE80211_BA_AGREED)
+      else if (ni->ni_ba != NULL &&
+               ni->ni_ba->nb_tx[tid].ba_state == IEEE80211_BA_AGREED)
         {
           qos |= IEEE80211_QOS_ACK_POLICY_BA;
         }
@@ -744,6 +791,15 @@ fallback:
       goto bad;
     }
 
+  /* The DA and SA of an A-MSDU are in its subframe headers; Address 3 is
+   * the BSSID.
+   */
+
+  if (amsdu)
+    {
+      IEEE80211_ADDR_COPY(wh->i_addr3, ni->ni_bssid);
+    }
+
   if ((ic->ic_flags & IEEE80211_F_WEPON) ||
       ((ic->ic_flags & IEEE80211_F_RSNON) &&
        (ni->ni_flags & IEEE80211_NODE_TXPROT)))
@@ -751,6 +807,34 @@ fallback:
       wh->i_fc[1] |= IEEE80211_FC1_PROTECTED;
     }
 
+  /* Record the node and the QoS classification in the packet header so that
+   * the aggregation code and the driver need not parse the frame again.
+   */
+
+  ph = IEEE80211_PKTHDR_GET(iob);
+  if (ph == NULL)
+    {
+      ndbg("ERROR: No packet header\n");
+      goto bad;
+    }
+
+  ph->ph_ni  = ni;
+  ph->ph_dlt = DLT_IEEE802_11;
+  if (addqos)
+    {
+      ph->ph_tid = tid;
+      ph->ph_ac  = ieee80211_up_to_ac(ic, tid);
+    }
+  else
+    {
+      ph->ph_tid = 0;
+      ph->ph_ac  = EDCA_AC_BE;
+    }
+
+  ts = IEEE80211_TIDSTATS(ni, ph->ph_tid);
+  ts->ts_txframes++;
+  ts->ts_txbytes += iob->io_pktlen;
+
 #ifdef CONFIG_IEEE80211_AP
   if (ic->ic_opmode == IEEE80211_M_HOSTAP &&
       ieee80211_pwrsave(ic, iob, ni) != 0)
@@ -851,22 +935,19 @@ uint8_t *ieee80211_add_ds_params(uint8_t * frm, struct ieee80211_s * ic,
 
 uint8_t *ieee80211_add_tim(uint8_t * frm, struct ieee80211_s * ic)
 {
-  unsigned int i, offset = 0, len;
-
-  /* find first non-zero octet in the virtual bit map */
-
-  for (i = 0; i < ic->ic_tim_len && ic->ic_tim_bitmap[i] == 0; i++);
-
-  /* clear the lsb as it is reserved for the broadcast indication bit */
+  unsigned int offset = 0, len = 1;
 
-  if (i < ic->ic_tim_len)
-    offset = i & ~1;
-
-  /* find last non-zero octet in the virtual bit map */
+  /* the first and last non-zero octets of the virtual bit map are kept
+   * up to date by ieee80211_set_tim()
+   */
 
-  for (i = ic->ic_tim_len - 1; i > 0 && ic->ic_tim_bitmap[i] == 0; i--);
+  if (ic->ic_tim_lo <= ic->ic_tim_hi)
+    {
+      /* clear the lsb as it is reserved for the broadcast indication bit */
 
-  len = i - offset + 1;
+      offset = ic->ic_tim_lo & ~1;
+      len = ic->ic_tim_hi - offset + 1;
+    }
 
   *frm++ = IEEE80211_ELEMID_TIM;
   *frm++ = len + 3;             /* length */
@@ -1101,7 +1182,7 @@ uint8_t *ieee80211_add_rsn_body(uint8_t * frm, struct ieee80211_s * ic,
 
       /* write PMKID List (only 1) */
 
-      memcpy(frm, ni->ni_pmkid, IEEE80211_PMKID_LEN);
+      memcpy(frm, ni->ni_rsn->rn_pmkid, IEEE80211_PMKID_LEN);
       frm += IEEE80211_PMKID_LEN;
     }
   else
@@ -1241,31 +1322,6 @@ uint8_t *ieee80211_add_tie(uint8_t * frm, uint8_t type, uint32_t value)
 }
 #endif
 
-struct iob_s *ieee80211_getmgmt(int type, unsigned int pktlen)
-{
-  struct iob_s *iob;
-
-  /* Reserve space for 802.11 header */
-
-  pktlen += sizeof(struct ieee80211_frame);
-  DEBUGASSERT(pktlen <= MCLBYTES);
-
-  iob = iob_alloc(false);
-  if (iob == NULL)
-    {
-      return NULL;
-    }
-
-  if (pktlen > CONFIG_IEEE80211_BUFSIZE)
-    {
-      iob_free(iob);
-      return NULL;
-    }
-
-  iob->io_len = sizeof(struct ieee80211_frame);
-  return iob;
-}
-
 /* Probe request frame format:
  * [tlv] SSID
  * [tlv] Supported rates
@@ -1278,22 +1334,19 @@ struct iob_s *ieee80211_get_probe_req(FAR struct ieee80211_s *ic,
 {
   FAR const struct ieee80211_rateset *rs =
     &ic->ic_sup_rates[ieee80211_chan2mode(ic, ni->ni_chan)];
-  FAR struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
   FAR uint8_t *frm;
 
-  iob = ieee80211_getmgmt(MT_DATA,
-                          2 + ic->ic_des_esslen +
-                          2 + MIN(rs->rs_nrates, IEEE80211_RATE_SIZE) +
-                          ((rs->rs_nrates > IEEE80211_RATE_SIZE) ?
-                           2 + rs->rs_nrates - IEEE80211_RATE_SIZE : 0) +
-                          ((ni->ni_flags & IEEE80211_NODE_HT) ? 28 : 0));
-
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb,
+                           2 + ic->ic_des_esslen +
+                           IEEE80211_RATES_LEN(rs) +
+                           ((ni->ni_flags & IEEE80211_NODE_HT) ? 28 : 0)) < 0)
     {
       return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 2 + IEEE80211_NWID_LEN +
+                             IEEE80211_RATES_MAXLEN);
   frm = ieee80211_add_ssid(frm, ic->ic_des_essid, ic->ic_des_esslen);
   frm = ieee80211_add_rates(frm, rs);
   if (rs->rs_nrates > IEEE80211_RATE_SIZE)
@@ -1301,15 +1354,18 @@ struct iob_s *ieee80211_get_probe_req(FAR struct ieee80211_s *ic,
       frm = ieee80211_add_xrates(frm, rs);
     }
 
+  ieee80211_mgmt_end(&mb, frm);
+
 #ifdef CONFIG_IEEE80211_HT
   if (ni->ni_flags & IEEE80211_NODE_HT)
     {
+      frm = ieee80211_mgmt_begin(&mb, 28);
       frm = ieee80211_add_htcaps(frm, ic);
+      ieee80211_mgmt_end(&mb, frm);
     }
 #endif
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 #ifdef CONFIG_IEEE80211_AP
@@ -1329,37 +1385,17 @@ struct iob_s *ieee80211_get_probe_req(FAR struct ieee80211_s *ic,
  * [tlv] HT Operation (802.11n)
  */
 
-struct iob_s *ieee80211_get_probe_resp(FAR struct ieee80211_s *ic,
-                                       FAR struct ieee80211_node *ni)
+/* Build the body of a probe response with the chain builder */
+
+static void ieee80211_build_probe_resp(FAR struct ieee80211_s *ic,
+                                       FAR struct ieee80211_node *ni,
+                                       FAR struct ieee80211_mgmtbuf_s *mb)
 {
   FAR const struct ieee80211_rateset *rs = &ic->ic_bss->ni_rates;
-  struct iob_s *iob;
-  uint8_t *frm;
-
-  iob = ieee80211_getmgmt(MT_DATA,
-                          8 + 2 + 2 +
-                          2 + ni->ni_esslen +
-                          2 + MIN(rs->rs_nrates, IEEE80211_RATE_SIZE) +
-                          2 + 1 +
-                          ((ic->ic_opmode == IEEE80211_M_IBSS) ? 2 + 2 : 0) +
-                          ((ic->ic_curmode == IEEE80211_MODE_11G) ? 2 + 1 : 0) +
-                          ((rs->rs_nrates > IEEE80211_RATE_SIZE) ?
-                           2 + rs->rs_nrates - IEEE80211_RATE_SIZE : 0) +
-                          (((ic->ic_flags & IEEE80211_F_RSNON) &&
-                            (ic->ic_bss->ni_rsnprotos & IEEE80211_PROTO_RSN)) ?
-                           2 + IEEE80211_RSNIE_MAXLEN : 0) +
-                          ((ic->ic_flags & IEEE80211_F_QOS) ? 2 + 18 : 0) +
-                          (((ic->ic_flags & IEEE80211_F_RSNON) &&
-                            (ic->ic_bss->ni_rsnprotos & IEEE80211_PROTO_WPA)) ?
-                           2 + IEEE80211_WPAIE_MAXLEN : 0) +
-                          ((ic->ic_flags & IEEE80211_F_HTON) ? 28 + 24 : 0));
-
-  if (iob == NULL)
-    {
-      return NULL;
-    }
+  FAR uint8_t *frm;
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(mb, 8 + 2 + 2 + 2 + IEEE80211_NWID_LEN +
+                             IEEE80211_RATES_MAXLEN + 3 + 4 + 3);
   memset(frm, 0, 8);
   frm += 8;                     /* timestamp is set by hardware */
   LE_WRITE_2(frm, ic->ic_bss->ni_intval);
@@ -1383,6 +1419,10 @@ struct iob_s *ieee80211_get_probe_resp(FAR struct ieee80211_s *ic,
       frm = ieee80211_add_xrates(frm, rs);
     }
 
+  ieee80211_mgmt_end(mb, frm);
+
+  frm = ieee80211_mgmt_begin(mb, 2 + IEEE80211_RSNIE_MAXLEN + 2 + 18 +
+                             2 + IEEE80211_WPAIE_MAXLEN + 28 + 24);
   if ((ic->ic_flags & IEEE80211_F_RSNON) &&
       (ic->ic_bss->ni_rsnprotos & IEEE80211_PROTO_RSN))
     {
@@ -1408,8 +1448,105 @@ struct iob_s *ieee80211_get_probe_resp(FAR struct ieee80211_s *ic,
     }
 #  endif
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  ieee80211_mgmt_end(mb, frm);
+}
+
+/* In HOSTAP mode the probe response body is the same for every station
+ * (the AP advertises its own channel and capabilities).  It is kept as a
+ * template that is copied into each response and rebuilt only when the
+ * BSS configuration changes (see IEEE80211_MGMT_CHANGED()).
+ */
+
+static int ieee80211_update_probe_resp(FAR struct ieee80211_s *ic,
+                                       unsigned int len)
+{
+  struct ieee80211_mgmtbuf_s mb;
+  FAR struct iob_s *iob;
+  FAR uint8_t *buf;
+  unsigned int bodylen;
+
+  if (ic->ic_prresp != NULL && ic->ic_prresp_gen == ic->ic_mgmt_gen &&
+      ic->ic_prresp_flags == ic->ic_flags)
+    {
+      return OK;
+    }
+
+  if (ieee80211_mgmt_alloc(&mb, len) < 0)
+    {
+      return -ENOMEM;
+    }
+
+  ieee80211_build_probe_resp(ic, ic->ic_bss, &mb);
+  iob = ieee80211_mgmt_finish(&mb);
+  if (iob == NULL)
+    {
+      return -E2BIG;
+    }
+
+  bodylen = iob->io_pktlen - sizeof(struct ieee80211_frame);
+  buf     = (FAR uint8_t *)kmalloc(bodylen);
+  if (buf == NULL)
+    {
+      iob_free_chain(iob);
+      return -ENOMEM;
+    }
+
+  iob_copyout(buf, iob, bodylen, sizeof(struct ieee80211_frame));
+  iob_free_chain(iob);
+
+  if (ic->ic_prresp != NULL)
+    {
+      kfree(ic->ic_prresp);
+    }
+
+  ic->ic_prresp       = buf;
+  ic->ic_prresp_len   = bodylen;
+  ic->ic_prresp_gen   = ic->ic_mgmt_gen;
+  ic->ic_prresp_flags = ic->ic_flags;
+  return OK;
+}
+
+struct iob_s *ieee80211_get_probe_resp(FAR struct ieee80211_s *ic,
+                                       FAR struct ieee80211_node *ni)
+{
+  FAR const struct ieee80211_rateset *rs = &ic->ic_bss->ni_rates;
+  struct ieee80211_mgmtbuf_s mb;
+  unsigned int len;
+
+  len = 8 + 2 + 2 +
+        2 + ic->ic_bss->ni_esslen +
+        IEEE80211_RATES_LEN(rs) +
+        3 +
+        ((ic->ic_opmode == IEEE80211_M_IBSS) ? 2 + 2 : 0) +
+        ((ic->ic_curmode == IEEE80211_MODE_11G) ? 2 + 1 : 0) +
+        (((ic->ic_flags & IEEE80211_F_RSNON) &&
+          (ic->ic_bss->ni_rsnprotos & IEEE80211_PROTO_RSN)) ?
+         2 + IEEE80211_RSNIE_MAXLEN : 0) +
+        ((ic->ic_flags & IEEE80211_F_QOS) ? 2 + 18 : 0) +
+        (((ic->ic_flags & IEEE80211_F_RSNON) &&
+          (ic->ic_bss->ni_rsnprotos & IEEE80211_PROTO_WPA)) ?
+         2 + IEEE80211_WPAIE_MAXLEN : 0) +
+        ((ic->ic_flags & IEEE80211_F_HTON) ? 28 + 24 : 0);
+
+  if (ic->ic_opmode == IEEE80211_M_HOSTAP &&
+      ieee80211_update_probe_resp(ic, len) == OK)
+    {
+      if (ieee80211_mgmt_alloc(&mb, ic->ic_prresp_len) < 0)
+        {
+          return NULL;
+        }
+
+      ieee80211_mgmt_put(&mb, ic->ic_prresp, ic->ic_prresp_len);
+      return ieee80211_mgmt_finish(&mb);
+    }
+
+  if (ieee80211_mgmt_alloc(&mb, len) < 0)
+    {
+      return NULL;
+    }
+
+  ieee80211_build_probe_resp(ic, ni, &mb);
+  return ieee80211_mgmt_finish(&mb);
 }
 #endif /* CONFIG_IEEE80211_AP */
 
@@ -1423,26 +1560,24 @@ struct iob_s *ieee80211_get_auth(struct ieee80211_s *ic,
                                  struct ieee80211_node *ni, uint16_t status,
                                  uint16_t seq)
 {
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
 
-  iob = iob_alloc(false);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 2 * 3) < 0)
     {
       return NULL;
     }
 
-  IOB_ALIGN(iob, 2 * 3);
-  iob->io_pktlen = iob->io_len = 2 * 3;
-
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 2 * 3);
   LE_WRITE_2(frm, IEEE80211_AUTH_ALG_OPEN);
   frm += 2;
   LE_WRITE_2(frm, seq);
   frm += 2;
   LE_WRITE_2(frm, status);
+  frm += 2;
+  ieee80211_mgmt_end(&mb, frm);
 
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 /* Deauthentication frame format:
@@ -1452,20 +1587,19 @@ struct iob_s *ieee80211_get_auth(struct ieee80211_s *ic,
 struct iob_s *ieee80211_get_deauth(struct ieee80211_s *ic,
                                    struct ieee80211_node *ni, uint16_t reason)
 {
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
+  uint8_t *frm;
 
-  iob = iob_alloc(false);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 2) < 0)
     {
       return NULL;
     }
 
-  IOB_ALIGN(iob, 2);
-
-  iob->io_pktlen = iob->io_len = 2;
-  (FAR uint16_t *) IOB_DATA(iob) = htole16(reason);
+  frm = ieee80211_mgmt_begin(&mb, 2);
+  LE_WRITE_2(frm, reason);
+  ieee80211_mgmt_end(&mb, frm + 2);
 
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 /* (Re)Association request frame format:
@@ -1484,33 +1618,31 @@ struct iob_s *ieee80211_get_assoc_req(struct ieee80211_s *ic,
                                       struct ieee80211_node *ni, int type)
 {
   const struct ieee80211_rateset *rs = &ni->ni_rates;
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
   uint16_t capinfo;
 
-  iob = ieee80211_getmgmt(MT_DATA,
-                          2 + 2 +
-                          ((type == IEEE80211_FC0_SUBTYPE_REASSOC_REQ) ?
-                           IEEE80211_ADDR_LEN : 0) +
-                          2 + ni->ni_esslen +
-                          2 + MIN(rs->rs_nrates, IEEE80211_RATE_SIZE) +
-                          ((rs->rs_nrates > IEEE80211_RATE_SIZE) ?
-                           2 + rs->rs_nrates - IEEE80211_RATE_SIZE : 0) +
-                          (((ic->ic_flags & IEEE80211_F_RSNON) &&
-                            (ni->ni_rsnprotos & IEEE80211_PROTO_RSN)) ?
-                           2 + IEEE80211_RSNIE_MAXLEN : 0) +
-                          ((ni->ni_flags & IEEE80211_NODE_QOS) ? 2 + 1 : 0) +
-                          (((ic->ic_flags & IEEE80211_F_RSNON) &&
-                            (ni->ni_rsnprotos & IEEE80211_PROTO_WPA)) ?
-                           2 + IEEE80211_WPAIE_MAXLEN : 0) +
-                          ((ni->ni_flags & IEEE80211_NODE_HT) ? 28 : 0));
-
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb,
+                           2 + 2 +
+                           ((type == IEEE80211_FC0_SUBTYPE_REASSOC_REQ) ?
+                            IEEE80211_ADDR_LEN : 0) +
+                           2 + ni->ni_esslen +
+                           IEEE80211_RATES_LEN(rs) +
+                           (((ic->ic_flags & IEEE80211_F_RSNON) &&
+                             (ni->ni_rsnprotos & IEEE80211_PROTO_RSN)) ?
+                            2 + IEEE80211_RSNIE_MAXLEN : 0) +
+                           ((ni->ni_flags & IEEE80211_NODE_QOS) ? 2 + 1 : 0) +
+                           (((ic->ic_flags & IEEE80211_F_RSNON) &&
+                             (ni->ni_rsnprotos & IEEE80211_PROTO_WPA)) ?
+                            2 + IEEE80211_WPAIE_MAXLEN : 0) +
+                           ((ni->ni_flags & IEEE80211_NODE_HT) ? 28 : 0)) < 0)
     {
       return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 2 + 2 + IEEE80211_ADDR_LEN +
+                             2 + IEEE80211_NWID_LEN +
+                             IEEE80211_RATES_MAXLEN);
   capinfo = IEEE80211_CAPINFO_ESS;
   if (ic->ic_flags & IEEE80211_F_WEPON)
     capinfo |= IEEE80211_CAPINFO_PRIVACY;
@@ -1532,6 +1664,10 @@ struct iob_s *ieee80211_get_assoc_req(struct ieee80211_s *ic,
   frm = ieee80211_add_rates(frm, rs);
   if (rs->rs_nrates > IEEE80211_RATE_SIZE)
     frm = ieee80211_add_xrates(frm, rs);
+  ieee80211_mgmt_end(&mb, frm);
+
+  frm = ieee80211_mgmt_begin(&mb, 2 + IEEE80211_RSNIE_MAXLEN + 2 + 1 +
+                             2 + IEEE80211_WPAIE_MAXLEN + 28);
   if ((ic->ic_flags & IEEE80211_F_RSNON) &&
       (ni->ni_rsnprotos & IEEE80211_PROTO_RSN))
     frm = ieee80211_add_rsn(frm, ic, ni);
@@ -1544,9 +1680,9 @@ struct iob_s *ieee80211_get_assoc_req(struct ieee80211_s *ic,
   if (ni->ni_flags & IEEE80211_NODE_HT)
     frm = ieee80211_add_htcaps(frm, ic);
 #endif
+  ieee80211_mgmt_end(&mb, frm);
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 #ifdef CONFIG_IEEE80211_AP
@@ -1568,25 +1704,23 @@ struct iob_s *ieee80211_get_assoc_resp(struct ieee80211_s *ic,
                                        uint16_t status)
 {
   const struct ieee80211_rateset *rs = &ni->ni_rates;
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
 
-  iob = ieee80211_getmgmt(MT_DATA,
-                          2 + 2 + 2 +
-                          2 + MIN(rs->rs_nrates, IEEE80211_RATE_SIZE) +
-                          ((rs->rs_nrates > IEEE80211_RATE_SIZE) ?
-                           2 + rs->rs_nrates - IEEE80211_RATE_SIZE : 0) +
-                          ((ni->ni_flags & IEEE80211_NODE_QOS) ? 2 + 18 : 0) +
-                          ((status ==
-                            IEEE80211_STATUS_TRY_AGAIN_LATER) ? 2 + 7 : 0) +
-                          ((ni->ni_flags & IEEE80211_NODE_HT) ? 28 + 24 : 0));
-
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb,
+                           2 + 2 + 2 +
+                           IEEE80211_RATES_LEN(rs) +
+                           ((ni->ni_flags & IEEE80211_NODE_QOS) ? 2 + 18 : 0) +
+                           ((status ==
+                             IEEE80211_STATUS_TRY_AGAIN_LATER) ? 2 + 5 : 0) +
+                           ((ni->ni_flags & IEEE80211_NODE_HT) ?
+                            28 + 24 : 0)) < 0)
     {
       return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 2 + 2 + 2 + IEEE80211_RATES_MAXLEN +
+                             2 + 18 + 2 + 5 + 28 + 24);
   frm = ieee80211_add_capinfo(frm, ic, ni);
   LE_WRITE_2(frm, status);
   frm += 2;
@@ -1627,8 +1761,8 @@ struct iob_s *ieee80211_get_assoc_resp(struct ieee80211_s *ic,
     }
 #  endif
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  ieee80211_mgmt_end(&mb, frm);
+  return ieee80211_mgmt_finish(&mb);
 }
 #endif /* CONFIG_IEEE80211_AP */
 
@@ -1639,19 +1773,19 @@ struct iob_s *ieee80211_get_assoc_resp(struct ieee80211_s *ic,
 struct iob_s *ieee80211_get_disassoc(struct ieee80211_s *ic,
                                      struct ieee80211_node *ni, uint16_t reason)
 {
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
+  uint8_t *frm;
 
-  iob = iob_alloc(false);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 2) < 0)
     {
       return NULL;
     }
 
-  IOB_ALIGN(iob, 2);
+  frm = ieee80211_mgmt_begin(&mb, 2);
+  LE_WRITE_2(frm, reason);
+  ieee80211_mgmt_end(&mb, frm + 2);
 
-  iob->io_pktlen = iob->io_len = 2;
-  (FAR uint16_t *) IOB_DATA(iob) = htole16(reason);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 #ifdef CONFIG_IEEE80211_HT
@@ -1668,18 +1802,17 @@ struct iob_s *ieee80211_get_disassoc(struct ieee80211_s *ic,
 struct iob_s *ieee80211_get_addba_req(struct ieee80211_s *ic,
                                       struct ieee80211_node *ni, uint8_t tid)
 {
-  struct ieee80211_tx_ba *ba = &ni->ni_tx_ba[tid];
-  struct iob_s *iob;
+  struct ieee80211_tx_ba *ba = &ni->ni_ba->nb_tx[tid];
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
   uint16_t params;
 
-  iob = ieee80211_getmgmt(MT_DATA, 9);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 9) < 0)
     {
-      return iob;
+      return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 9);
   *frm++ = IEEE80211_CATEG_BA;
   *frm++ = IEEE80211_ACTION_ADDBA_REQ;
   *frm++ = ba->ba_token;
@@ -1690,9 +1823,9 @@ struct iob_s *ieee80211_get_addba_req(struct ieee80211_s *ic,
   frm += 2;
   LE_WRITE_2(frm, ba->ba_winstart);
   frm += 2;
+  ieee80211_mgmt_end(&mb, frm);
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 /* ADDBA Response frame format:
@@ -1708,21 +1841,24 @@ struct iob_s *ieee80211_get_addba_resp(struct ieee80211_s *ic,
                                        struct ieee80211_node *ni, uint8_t tid,
                                        uint8_t token, uint16_t status)
 {
-  struct ieee80211_rx_ba *ba = &ni->ni_rx_ba[tid];
-  struct iob_s *iob;
+  struct ieee80211_rx_ba *ba;
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
   uint16_t params;
 
-  iob = ieee80211_getmgmt(MT_DATA, 9);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 9) < 0)
     {
-      return iob;
+      return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 9);
   *frm++ = IEEE80211_CATEG_BA;
   *frm++ = IEEE80211_ACTION_ADDBA_RESP;
   *frm++ = token;
+
+  /* A refused request may have no Block Ack records to report */
+
+  ba = (status == 0) ? &ni->ni_ba->nb_rx[tid] : NULL;
   LE_WRITE_2(frm, status);
   frm += 2;
   params = tid << 2 | IEEE80211_BA_ACK_POLICY;
@@ -1743,9 +1879,9 @@ struct iob_s *ieee80211_get_addba_resp(struct ieee80211_s *ic,
     }
 
   frm += 2;
+  ieee80211_mgmt_end(&mb, frm);
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 /* DELBA frame format:
@@ -1759,17 +1895,16 @@ struct iob_s *ieee80211_get_delba(struct ieee80211_s *ic,
                                   struct ieee80211_node *ni, uint8_t tid,
                                   uint8_t dir, uint16_t reason)
 {
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
   uint16_t params;
 
-  iob = ieee80211_getmgmt(MT_DATA, 6);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 6) < 0)
     {
-      return iob;
+      return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 6);
   *frm++ = IEEE80211_CATEG_BA;
   *frm++ = IEEE80211_ACTION_DELBA;
   params = tid << 12;
@@ -1782,9 +1917,9 @@ struct iob_s *ieee80211_get_delba(struct ieee80211_s *ic,
   frm += 2;
   LE_WRITE_2(frm, reason);
   frm += 2;
+  ieee80211_mgmt_end(&mb, frm);
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 #endif /* !CONFIG_IEEE80211_HT */
 
@@ -1797,23 +1932,22 @@ struct iob_s *ieee80211_get_delba(struct ieee80211_s *ic,
 struct iob_s *ieee80211_get_sa_query(struct ieee80211_s *ic,
                                      struct ieee80211_node *ni, uint8_t action)
 {
-  struct iob_s *iob;
+  struct ieee80211_mgmtbuf_s mb;
   uint8_t *frm;
 
-  iob = ieee80211_getmgmt(MT_DATA, 4);
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb, 4) < 0)
     {
       return NULL;
     }
 
-  frm = (FAR uint8_t *) IOB_DATA(iob);
+  frm = ieee80211_mgmt_begin(&mb, 4);
   *frm++ = IEEE80211_CATEG_SA_QUERY;
   *frm++ = action;              /* ACTION_SA_QUERY_REQ/RESP */
-  LE_WRITE_2(frm, ni->ni_sa_query_trid);
+  LE_WRITE_2(frm, ni->ni_rsn->rn_sa_query_trid);
   frm += 2;
+  ieee80211_mgmt_end(&mb, frm);
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-  return iob;
+  return ieee80211_mgmt_finish(&mb);
 }
 
 struct iob_s *ieee80211_get_action(struct ieee80211_s *ic,
@@ -1982,6 +2116,105 @@ int ieee80211_send_mgmt(struct ieee80211_s *ic, struct ieee80211_node *ni,
   return ret;
 }
 
+/* Fill in the header of a frame built by ieee80211_mgmt_alloc() and queue
+ * it on the management queue with a reference on 'ni'.
+ */
+
+static int ieee80211_send_raw(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR struct iob_s *iob, uint8_t fc0,
+                              uint8_t fc1, FAR const uint8_t *da)
+{
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct ieee80211_frame *wh;
+  int ret;
+
+  ph = IEEE80211_PKTHDR_GET(iob);
+  if (ph == NULL)
+    {
+      iob_free_chain(iob);
+      return -ENOMEM;
+    }
+
+  ph->ph_ni = ieee80211_ref_node(ni);
+
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  wh->i_fc[0] = IEEE80211_FC0_VERSION_0 | fc0;
+  wh->i_fc[1] = fc1;
+  *(uint16_t *) & wh->i_dur[0] = 0;
+  *(uint16_t *) & wh->i_seq[0] =
+    htole16(ni->ni_txseq << IEEE80211_SEQ_SEQ_SHIFT);
+  ni->ni_txseq++;
+  IEEE80211_ADDR_COPY(wh->i_addr1, da);
+  IEEE80211_ADDR_COPY(wh->i_addr2, ic->ic_myaddr);
+  IEEE80211_ADDR_COPY(wh->i_addr3, da);
+
+  ret = ieee80211_ifsend(ic, iob, IFSEND_MGMT);
+  if (ret < 0)
+    {
+      ieee80211_release_node(ic, ni);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_send_nulldata
+ *
+ * Description:
+ *   Send a Null data frame to the AP we are associated with (STA mode).
+ *   With 'pwrsave' set, the Power Management bit tells the AP to buffer
+ *   our traffic until the next frame with the bit clear.  The frame goes
+ *   through the management queue so that it is sent ahead of the data.
+ *
+ ****************************************************************************/
+
+int ieee80211_send_nulldata(FAR struct ieee80211_s *ic,
+                            FAR struct ieee80211_node *ni, bool pwrsave)
+{
+  struct ieee80211_mgmtbuf_s mb;
+  FAR struct iob_s *iob;
+
+  if (ieee80211_mgmt_alloc(&mb, 0) < 0 ||
+      (iob = ieee80211_mgmt_finish(&mb)) == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  return ieee80211_send_raw(ic, ni, iob,
+                            IEEE80211_FC0_TYPE_DATA |
+                            IEEE80211_FC0_SUBTYPE_NODATA,
+                            IEEE80211_FC1_DIR_TODS |
+                            (pwrsave ? IEEE80211_FC1_PWR_MGT : 0),
+                            ni->ni_bssid);
+}
+
+/****************************************************************************
+ * Name: ieee80211_send_bcast_probe
+ *
+ * Description:
+ *   Send a broadcast probe request for the desired SSID without touching
+ *   the state of ic_bss nor arming the management timer, so it may be used
+ *   while associated (background scan).
+ *
+ ****************************************************************************/
+
+int ieee80211_send_bcast_probe(FAR struct ieee80211_s *ic)
+{
+  FAR struct iob_s *iob;
+
+  iob = ieee80211_get_probe_req(ic, ic->ic_bss);
+  if (iob == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  return ieee80211_send_raw(ic, ic->ic_bss, iob,
+                            IEEE80211_FC0_TYPE_MGT |
+                            IEEE80211_FC0_SUBTYPE_PROBE_REQ,
+                            IEEE80211_FC1_DIR_NODS, etherbroadcastaddr);
+}
+
 /* Build a RTS (Request To Send) control frame (see 7.2.1.1) */
 
 struct iob_s *ieee80211_get_rts(struct ieee80211_s *ic,
@@ -2059,47 +2292,35 @@ FAR struct iob_s *ieee80211_beacon_alloc(FAR struct ieee80211_s *ic,
                                          FAR struct ieee80211_node *ni)
 {
   FAR const struct ieee80211_rateset *rs = &ni->ni_rates;
+  struct ieee80211_mgmtbuf_s mb;
+  FAR struct ieee80211_pkthdr *ph;
   FAR struct ieee80211_frame *wh;
   FAR struct iob_s *iob;
   FAR uint8_t *frm;
-  int error;
-
-  iob = ieee80211_getmgmt(MT_DATA,
-                          8 + 2 + 2 +
-                          2 +
-                          ((ic->ic_flags & IEEE80211_F_HIDENWID) ? 0 : ni->
-                           ni_esslen) + 2 + MIN(rs->rs_nrates,
-                                                IEEE80211_RATE_SIZE) + 2 + 1 +
-                          2 + ((ic->ic_opmode == IEEE80211_M_IBSS) ? 2 : 254) +
-                          ((ic->ic_curmode ==
-                            IEEE80211_MODE_11G) ? 2 + 1 : 0) + ((rs->rs_nrates >
-                                                                 IEEE80211_RATE_SIZE)
-                                                                ? 2 +
-                                                                rs->rs_nrates -
-                                                                IEEE80211_RATE_SIZE
-                                                                : 0) +
-                          (((ic->ic_flags & IEEE80211_F_RSNON) &&
-                            (ni->ni_rsnprotos & IEEE80211_PROTO_RSN)) ? 2 +
-                           IEEE80211_RSNIE_MAXLEN : 0) +
-                          ((ic->ic_flags & IEEE80211_F_QOS) ? 2 + 18 : 0) +
-                          (((ic->ic_flags & IEEE80211_F_RSNON) &&
-                            (ni->ni_rsnprotos & IEEE80211_PROTO_WPA)) ? 2 +
-                           IEEE80211_WPAIE_MAXLEN : 0) +
-                          ((ic->ic_flags & IEEE80211_F_HTON) ? 28 + 24 : 0));
 
-  if (iob == NULL)
+  if (ieee80211_mgmt_alloc(&mb,
+                           8 + 2 + 2 +
+                           2 + ((ic->ic_flags & IEEE80211_F_HIDENWID) ?
+                                0 : ni->ni_esslen) +
+                           IEEE80211_RATES_LEN(rs) +
+                           3 +
+                           ((ic->ic_opmode == IEEE80211_M_IBSS) ?
+                            2 + 2 : 2 + 3 + ic->ic_tim_len) +
+                           ((ic->ic_curmode == IEEE80211_MODE_11G) ? 2 + 1 : 0) +
+                           (((ic->ic_flags & IEEE80211_F_RSNON) &&
+                             (ni->ni_rsnprotos & IEEE80211_PROTO_RSN)) ?
+                            2 + IEEE80211_RSNIE_MAXLEN : 0) +
+                           ((ic->ic_flags & IEEE80211_F_QOS) ? 2 + 18 : 0) +
+                           (((ic->ic_flags & IEEE80211_F_RSNON) &&
+                             (ni->ni_rsnprotos & IEEE80211_PROTO_WPA)) ?
+                            2 + IEEE80211_WPAIE_MAXLEN : 0) +
+                           ((ic->ic_flags & IEEE80211_F_HTON) ?
+                            28 + 24 : 0)) < 0)
     {
       return NULL;
     }
 
-  error = iob_contig(iob, sizeof(struct ieee80211_frame));
-  if (error < 0)
-    {
-      ndbg("ERROR: Failed to make contiguous: %d\n", error);
-      return NULL;
-    }
-
-  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(mb.mb_head);
   wh->i_fc[0] =
     IEEE80211_FC0_VERSION_0 | IEEE80211_FC0_TYPE_MGT |
     IEEE80211_FC0_SUBTYPE_BEACON;
@@ -2110,7 +2331,8 @@ FAR struct iob_s *ieee80211_beacon_alloc(FAR struct ieee80211_s *ic,
   IEEE80211_ADDR_COPY(wh->i_addr3, ni->ni_bssid);
   *(uint16_t *) wh->i_seq = 0;
 
-  frm = (uint8_t *) & wh[1];
+  frm = ieee80211_mgmt_begin(&mb, 8 + 2 + 2 + 2 + IEEE80211_NWID_LEN +
+                             2 + IEEE80211_RATE_SIZE + 3 + 4);
   memset(frm, 0, 8);
   frm += 8;                     /* timestamp is set by hardware */
   LE_WRITE_2(frm, ni->ni_intval);
@@ -2131,11 +2353,21 @@ FAR struct iob_s *ieee80211_beacon_alloc(FAR struct ieee80211_s *ic,
     {
       frm = ieee80211_add_ibss_params(frm, ni);
     }
-  else
+
+  ieee80211_mgmt_end(&mb, frm);
+
+  /* The TIM may be up to 255 bytes long:  give it an area of its own */
+
+  if (ic->ic_opmode != IEEE80211_M_IBSS)
     {
+      frm = ieee80211_mgmt_begin(&mb, 2 + 3 + ic->ic_tim_len);
       frm = ieee80211_add_tim(frm, ic);
+      ieee80211_mgmt_end(&mb, frm);
     }
 
+  frm = ieee80211_mgmt_begin(&mb, 2 + 1 + 2 + IEEE80211_RATE_MAXSIZE -
+                             IEEE80211_RATE_SIZE + 2 + IEEE80211_RSNIE_MAXLEN +
+                             2 + 18 + 2 + IEEE80211_WPAIE_MAXLEN + 28 + 24);
   if (ic->ic_curmode == IEEE80211_MODE_11G)
     {
       frm = ieee80211_add_erp(frm, ic);
@@ -2171,20 +2403,169 @@ FAR struct iob_s *ieee80211_beacon_alloc(FAR struct ieee80211_s *ic,
     }
 #  endif
 
-  iob->io_pktlen = iob->io_len = frm - IOB_DATA(iob);
-#  warning REVISIT:  We do not want to burden everty IOB with this information
-//iob->io_priv = ni;
+  ieee80211_mgmt_end(&mb, frm);
+
+  iob = ieee80211_mgmt_finish(&mb);
+  if (iob == NULL)
+    {
+      return NULL;
+    }
+
+  ph = IEEE80211_PKTHDR_GET(iob);
+  if (ph == NULL)
+    {
+      iob_free_chain(iob);
+      return NULL;
+    }
+
+  ph->ph_ni = ni;
   return iob;
 }
 
+/* (Re)build the beacon template of a HOSTAP interface.  The buffer leaves
+ * room for the largest TIM so that it does not move as stations enter and
+ * leave power save mode.
+ */
+
+static int ieee80211_beacon_build(FAR struct ieee80211_s *ic)
+{
+  FAR struct iob_s *iob;
+  unsigned int size;
+  unsigned int len;
+  unsigned int off;
+
+  iob = ieee80211_beacon_alloc(ic, ic->ic_bss);
+  if (iob == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  len  = iob->io_pktlen;
+  size = len + 2 + 3 + ic->ic_tim_len;
+  if (size > ic->ic_bcn_size)
+    {
+      if (ic->ic_bcn != NULL)
+        {
+          kfree(ic->ic_bcn);
+          ic->ic_bcn_size = 0;
+        }
+
+      ic->ic_bcn = (FAR uint8_t *)kmalloc(size);
+      if (ic->ic_bcn == NULL)
+        {
+          iob_free_chain(iob);
+          return -ENOMEM;
+        }
+
+      ic->ic_bcn_size = size;
+    }
+
+  iob_copyout(ic->ic_bcn, iob, len, 0);
+  iob_free_chain(iob);
+
+  /* Locate the TIM element after the fixed fields */
+
+  off = sizeof(struct ieee80211_frame) + 8 + 2 + 2;
+  while (off + 2 <= len && ic->ic_bcn[off] != IEEE80211_ELEMID_TIM)
+    {
+      off += 2 + ic->ic_bcn[off + 1];
+    }
+
+  if (off + 2 > len)
+    {
+      kfree(ic->ic_bcn);
+      ic->ic_bcn      = NULL;
+      ic->ic_bcn_size = 0;
+      return -EINVAL;
+    }
+
+  ic->ic_bcn_len    = len;
+  ic->ic_bcn_timoff = off;
+  ic->ic_bcn_gen    = ic->ic_mgmt_gen;
+  ic->ic_bcn_flags  = ic->ic_flags;
+  return OK;
+}
+
+/* Return the beacon to transmit at the next TBTT.  Only the Timestamp (if
+ * 'tsf' is non-zero), the DTIM count and the TIM element of the template
+ * are rewritten; the template itself is rebuilt after configuration
+ * changes only.
+ */
+
+FAR const uint8_t *ieee80211_beacon_update(FAR struct ieee80211_s *ic,
+                                           uint64_t tsf,
+                                           FAR unsigned int *len,
+                                           FAR bool *dtim)
+{
+  FAR uint8_t *tim;
+  FAR uint8_t *frm;
+  unsigned int oldlen;
+  unsigned int newlen;
+  unsigned int tail;
+  int i;
+
+  DEBUGASSERT(ic->ic_opmode == IEEE80211_M_HOSTAP && ic->ic_tim_len > 0);
+
+  if (ic->ic_bcn == NULL || ic->ic_bcn_gen != ic->ic_mgmt_gen ||
+      ic->ic_bcn_flags != ic->ic_flags)
+    {
+      if (ieee80211_beacon_build(ic) < 0)
+        {
+          ndbg("ERROR: Failed to build the beacon\n");
+          return NULL;
+        }
+    }
+
+  /* Move the elements that follow the TIM if its length changes */
+
+  tim    = ic->ic_bcn + ic->ic_bcn_timoff;
+  oldlen = 2 + tim[1];
+  newlen = 2 + 3 + 1;
+  if (ic->ic_tim_lo <= ic->ic_tim_hi)
+    {
+      newlen = 2 + 3 + ic->ic_tim_hi - (ic->ic_tim_lo & ~1) + 1;
+    }
+
+  if (newlen != oldlen)
+    {
+      tail = ic->ic_bcn_len - ic->ic_bcn_timoff - oldlen;
+      memmove(tim + newlen, tim + oldlen, tail);
+      ic->ic_bcn_len = ic->ic_bcn_len - oldlen + newlen;
+    }
+
+  frm = ieee80211_add_tim(tim, ic);
+  DEBUGASSERT(frm == tim + newlen);
+  UNUSED(frm);
+
+  if (tsf != 0)
+    {
+      frm = ic->ic_bcn + sizeof(struct ieee80211_frame);
+      for (i = 0; i < 8; i++)
+        {
+          frm[i] = (uint8_t)(tsf >> (8 * i));
+        }
+    }
+
+  /* Count down to the next DTIM */
+
+  *dtim = (ic->ic_dtim_count == 0);
+  ic->ic_dtim_count = (ic->ic_dtim_count == 0) ?
+    ic->ic_dtim_period - 1 : ic->ic_dtim_count - 1;
+
+  *len = ic->ic_bcn_len;
+  return ic->ic_bcn;
+}
+
 /* Check if an outgoing MSDU or management frame should be buffered into
  * the AP for power management.  Return 1 if the frame was buffered into
- * the AP, or 0 if the frame shall be transmitted immediately.
+ * the AP (or dropped because the buffer of the station is full), or 0 if
+ * the frame shall be transmitted immediately.
  */
 
 int ieee80211_pwrsave(struct ieee80211_s *ic, struct iob_s *iob,
                       struct ieee80211_node *ni)
 {
+  FAR struct ieee80211_pkthdr *ph;
   const struct ieee80211_frame *wh;
 
   DEBUGASSERT(ic->ic_opmode == IEEE80211_M_HOSTAP);
@@ -2221,16 +2602,26 @@ int ieee80211_pwrsave(struct ieee80211_s *ic, struct iob_s *iob,
         }
     }
 
-  /* NB: ni == ic->ic_bss for broadcast/multicast */
+  /* Similar to ieee80211_mgmt_output, store the node in the packet header.
+   * NB: ni == ic->ic_bss for broadcast/multicast
+   */
 
-  iob_add_queue(iob, &ni->ni_savedq);
+  ph = IEEE80211_PKTHDR_GET(iob);
+  if (ph == NULL)
+    {
+      return 0;
+    }
 
-  /* Similar to ieee80211_mgmt_output, store the node in a special pkthdr
-   * field.
-   */
+  ph->ph_ni = ni;
+  if (ni->ni_savedqlen >= CONFIG_IEEE80211_PSQ_DEPTH ||
+      iob_add_queue(iob, &ni->ni_savedq) < 0)
+    {
+      ic->ic_pwrsaveq.txq_drops++;
+      ieee80211_txfree(ic, iob);
+      return 1;
+    }
 
-#  warning REVISIT:  We do not want to burden everty IOB with this information
-//iob->io_priv = ni;
+  ni->ni_savedqlen++;
   return 1;
 }
 #endif /* CONFIG_IEEE80211_AP */
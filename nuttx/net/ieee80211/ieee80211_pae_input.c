@@ -97,7 +97,7 @@ void ieee80211_eapol_key_input(FAR struct ieee80211_s *ic,
   int totlen;
 
   ethhdr = (FAR struct uip_eth_hdr *)IOB_DATA(iob);
-  if (IEEE80211_IS_MULTICAST(ethhdr->dest))
+  if (IEEE80211_IS_MULTICAST(ethhdr->dest) || ni->ni_rsn == NULL)
     {
       goto done;
     }
@@ -257,7 +257,7 @@ static void ieee80211_recv_4way_msg1(FAR struct ieee80211_s *ic,
   if (ic->ic_opmode != IEEE80211_M_STA && ic->ic_opmode != IEEE80211_M_IBSS)
     return;
 #endif
-  if (ni->ni_replaycnt_ok && BE_READ_8(key->replaycnt) <= ni->ni_replaycnt)
+  if (ni->ni_rsn->rn_replaycnt_ok && BE_READ_8(key->replaycnt) <= ni->ni_rsn->rn_replaycnt)
     {
       return;
     }
@@ -305,15 +305,15 @@ static void ieee80211_recv_4way_msg1(FAR struct ieee80211_s *ic,
                ieee80211_addr2str(ni->ni_macaddr));
           return;
         }
-      memcpy(ni->ni_pmk, pmk->pmk_key, IEEE80211_PMK_LEN);
+      memcpy(ni->ni_rsn->rn_pmk, pmk->pmk_key, IEEE80211_PMK_LEN);
     }
   else                          /* use pre-shared key */
-    memcpy(ni->ni_pmk, ic->ic_psk, IEEE80211_PMK_LEN);
+    memcpy(ni->ni_rsn->rn_pmk, ic->ic_psk, IEEE80211_PMK_LEN);
   ni->ni_flags |= IEEE80211_NODE_PMK;
 
   /* save authenticator's nonce (ANonce) */
 
-  memcpy(ni->ni_nonce, key->nonce, EAPOL_KEY_NONCE_LEN);
+  memcpy(ni->ni_rsn->rn_nonce, key->nonce, EAPOL_KEY_NONCE_LEN);
 
   /* generate supplicant's nonce (SNonce) */
 
@@ -321,8 +321,8 @@ static void ieee80211_recv_4way_msg1(FAR struct ieee80211_s *ic,
 
   /* TPTK = CalcPTK(PMK, ANonce, SNonce) */
 
-  ieee80211_derive_ptk(ni->ni_rsnakms, ni->ni_pmk, ni->ni_macaddr,
-                       ic->ic_myaddr, ni->ni_nonce, ic->ic_nonce, &tptk);
+  ieee80211_derive_ptk(ni->ni_rsnakms, ni->ni_rsn->rn_pmk, ni->ni_macaddr,
+                       ic->ic_myaddr, ni->ni_rsn->rn_nonce, ic->ic_nonce, &tptk);
 
   nvdbg("%s: received msg %d/%d of the %s handshake from %s\n",
         ic->ic_ifname, 1, 4, "4-way", ieee80211_addr2str(ni->ni_macaddr));
@@ -348,20 +348,30 @@ static void ieee80211_recv_4way_msg2(FAR struct ieee80211_s *ic,
 
   /* discard if we're not expecting this message */
 
-  if (ni->ni_rsn_state != RSNA_PTKSTART &&
-      ni->ni_rsn_state != RSNA_PTKCALCNEGOTIATING)
+  if (ni->ni_rsn->rn_state != RSNA_PTKSTART &&
+      ni->ni_rsn->rn_state != RSNA_PTKCALCNEGOTIATING)
     {
-      ndbg("ERROR: unexpected in state: %d\n", ni->ni_rsn_state);
+      ndbg("ERROR: unexpected in state: %d\n", ni->ni_rsn->rn_state);
       return;
     }
-  ni->ni_rsn_state = RSNA_PTKCALCNEGOTIATING;
 
   /* NB: replay counter has already been verified by caller */
 
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  /* Leave the PTK derivation and MIC check to the handshake worker */
+
+  if (ieee80211_authsched_msg2(ic, ni, key, rsnie) == OK)
+    {
+      return;
+    }
+#endif
+
+  ni->ni_rsn->rn_state = RSNA_PTKCALCNEGOTIATING;
+
   /* PTK = CalcPTK(ANonce, SNonce) */
 
-  ieee80211_derive_ptk(ni->ni_rsnakms, ni->ni_pmk, ic->ic_myaddr,
-                       ni->ni_macaddr, ni->ni_nonce, key->nonce, &tptk);
+  ieee80211_derive_ptk(ni->ni_rsnakms, ni->ni_rsn->rn_pmk, ic->ic_myaddr,
+                       ni->ni_macaddr, ni->ni_rsn->rn_nonce, key->nonce, &tptk);
 
   /* check Key MIC field using KCK */
 
@@ -371,13 +381,25 @@ static void ieee80211_recv_4way_msg2(FAR struct ieee80211_s *ic,
       return;                   /* will timeout.. */
     }
 
-  wd_cancel(ni->ni_eapol_to);
-  ni->ni_rsn_state = RSNA_PTKCALCNEGOTIATING_2;
-  ni->ni_rsn_retries = 0;
+  ieee80211_4way_msg2_verified(ic, ni, &tptk, rsnie);
+}
+
+/* Continue the 4-Way Handshake once the MIC of Message 2 has been verified
+ * with the temporary PTK.
+ */
+
+void ieee80211_4way_msg2_verified(FAR struct ieee80211_s *ic,
+                                  FAR struct ieee80211_node *ni,
+                                  FAR const struct ieee80211_ptk *tptk,
+                                  FAR const uint8_t *rsnie)
+{
+  ieee80211_eapol_timer_stop(ic, ni);
+  ni->ni_rsn->rn_state = RSNA_PTKCALCNEGOTIATING_2;
+  ni->ni_rsn->rn_retries = 0;
 
   /* install TPTK as PTK now that MIC is verified */
 
-  memcpy(&ni->ni_ptk, &tptk, sizeof(tptk));
+  memcpy(&ni->ni_rsn->rn_ptk, tptk, sizeof(*tptk));
 
   /* The RSN IE must match bit-wise with what the STA included in its
    * (Re)Association Request.
@@ -418,7 +440,7 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
   if (ic->ic_opmode != IEEE80211_M_STA && ic->ic_opmode != IEEE80211_M_IBSS)
     return;
 #endif
-  if (ni->ni_replaycnt_ok && BE_READ_8(key->replaycnt) <= ni->ni_replaycnt)
+  if (ni->ni_rsn->rn_replaycnt_ok && BE_READ_8(key->replaycnt) <= ni->ni_rsn->rn_replaycnt)
     {
       return;
     }
@@ -433,7 +455,7 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
 
   /* check that ANonce matches that of Message 1 */
 
-  if (memcmp(key->nonce, ni->ni_nonce, EAPOL_KEY_NONCE_LEN) != 0)
+  if (memcmp(key->nonce, ni->ni_rsn->rn_nonce, EAPOL_KEY_NONCE_LEN) != 0)
     {
       ndbg("ERROR: ANonce does not match msg 1/4\n");
       return;
@@ -441,7 +463,7 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
 
   /* TPTK = CalcPTK(PMK, ANonce, SNonce) */
 
-  ieee80211_derive_ptk(ni->ni_rsnakms, ni->ni_pmk, ni->ni_macaddr,
+  ieee80211_derive_ptk(ni->ni_rsnakms, ni->ni_rsn->rn_pmk, ni->ni_macaddr,
                        ic->ic_myaddr, key->nonce, ic->ic_nonce, &tptk);
 
   info = BE_READ_2(key->info);
@@ -456,12 +478,12 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
 
   /* install TPTK as PTK now that MIC is verified */
 
-  memcpy(&ni->ni_ptk, &tptk, sizeof(tptk));
+  memcpy(&ni->ni_rsn->rn_ptk, &tptk, sizeof(tptk));
 
   /* if encrypted, decrypt Key Data field using KEK */
 
   if ((info & EAPOL_KEY_ENCRYPTED) &&
-      ieee80211_eapol_key_decrypt(key, ni->ni_ptk.kek) != 0)
+      ieee80211_eapol_key_decrypt(key, ni->ni_rsn->rn_ptk.kek) != 0)
     {
       ndbg("ERROR: decryption failed\n");
       return;
@@ -597,8 +619,8 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
 
   /* update the last seen value of the key replay counter field */
 
-  ni->ni_replaycnt = BE_READ_8(key->replaycnt);
-  ni->ni_replaycnt_ok = 1;
+  ni->ni_rsn->rn_replaycnt = BE_READ_8(key->replaycnt);
+  ni->ni_rsn->rn_replaycnt_ok = 1;
 
   nvdbg("%s: received msg %d/%d of the %s handshake from %s\n",
         ic->ic_ifname, 3, 4, "4-way", ieee80211_addr2str(ni->ni_macaddr));
@@ -624,12 +646,12 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
 
       /* map PTK to 802.11 key */
 
-      k = &ni->ni_pairwise_key;
+      k = &ni->ni_rsn->rn_pairwise_key;
       memset(k, 0, sizeof(*k));
       k->k_cipher = ni->ni_rsncipher;
       k->k_rsc[0] = prsc;
       k->k_len = keylen;
-      memcpy(k->k_key, ni->ni_ptk.tk, k->k_len);
+      memcpy(k->k_key, ni->ni_rsn->rn_ptk.tk, k->k_len);
 
       /* install the PTK */
 
@@ -722,7 +744,7 @@ void ieee80211_recv_4way_msg3(FAR struct ieee80211_s *ic,
     {
       ni->ni_flags |= IEEE80211_NODE_TXRXPROT;
 #ifdef CONFIG_IEEE80211_AP
-      if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_key_count == 2)
+      if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_rsn->rn_key_count == 2)
 #endif
         {
           ndbg("ERROR: marking port %s valid\n",
@@ -752,9 +774,9 @@ static void ieee80211_recv_4way_msg4(FAR struct ieee80211_s *ic,
 
   /* discard if we're not expecting this message */
 
-  if (ni->ni_rsn_state != RSNA_PTKINITNEGOTIATING)
+  if (ni->ni_rsn->rn_state != RSNA_PTKINITNEGOTIATING)
     {
-      ndbg("ERROR: unexpected in state: %d\n", ni->ni_rsn_state);
+      ndbg("ERROR: unexpected in state: %d\n", ni->ni_rsn->rn_state);
       return;
     }
 
@@ -762,15 +784,16 @@ static void ieee80211_recv_4way_msg4(FAR struct ieee80211_s *ic,
 
   /* check Key MIC field using KCK */
 
-  if (ieee80211_eapol_key_check_mic(key, ni->ni_ptk.kck) != 0)
+  if (ieee80211_eapol_key_check_mic(key, ni->ni_rsn->rn_ptk.kck) != 0)
     {
       ndbg("ERROR: key MIC failed\n");
       return;                   /* will timeout.. */
     }
 
-  wd_cancel(ni->ni_eapol_to);
-  ni->ni_rsn_state = RSNA_PTKINITDONE;
-  ni->ni_rsn_retries = 0;
+  ieee80211_eapol_timer_stop(ic, ni);
+  ni->ni_rsn->rn_state = RSNA_PTKINITDONE;
+  ni->ni_rsn->rn_retries = 0;
+  ieee80211_authsched_done(ic, ni);
 
   if (ni->ni_rsncipher != IEEE80211_CIPHER_USEGROUP)
     {
@@ -778,11 +801,11 @@ static void ieee80211_recv_4way_msg4(FAR struct ieee80211_s *ic,
 
       /* map PTK to 802.11 key */
 
-      k = &ni->ni_pairwise_key;
+      k = &ni->ni_rsn->rn_pairwise_key;
       memset(k, 0, sizeof(*k));
       k->k_cipher = ni->ni_rsncipher;
       k->k_len = ieee80211_cipher_keylen(k->k_cipher);
-      memcpy(k->k_key, ni->ni_ptk.tk, k->k_len);
+      memcpy(k->k_key, ni->ni_rsn->rn_ptk.tk, k->k_len);
 
       /* install the PTK */
 
@@ -798,7 +821,7 @@ static void ieee80211_recv_4way_msg4(FAR struct ieee80211_s *ic,
       ni->ni_flags |= IEEE80211_NODE_TXRXPROT;
     }
 
-  if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_key_count == 2)
+  if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_rsn->rn_key_count == 2)
     {
       ndbg("ERROR: marking port %s valid\n",
            ieee80211_addr2str(ni->ni_macaddr));
@@ -816,7 +839,7 @@ static void ieee80211_recv_4way_msg4(FAR struct ieee80211_s *ic,
     }
   else
     {
-      ni->ni_rsn_gstate = RSNA_IDLE;
+      ni->ni_rsn->rn_gstate = RSNA_IDLE;
     }
 }
 
@@ -831,7 +854,7 @@ static void ieee80211_recv_4way_msg2or4(FAR struct ieee80211_s *ic,
   const uint8_t *frm, *efrm;
   const uint8_t *rsnie;
 
-  if (BE_READ_8(key->replaycnt) != ni->ni_replaycnt)
+  if (BE_READ_8(key->replaycnt) != ni->ni_rsn->rn_replaycnt)
     {
       return;
     }
@@ -889,13 +912,13 @@ static void ieee80211_recv_rsn_group_msg1(FAR struct ieee80211_s *ic,
   if (ic->ic_opmode != IEEE80211_M_STA && ic->ic_opmode != IEEE80211_M_IBSS)
     return;
 #endif
-  if (BE_READ_8(key->replaycnt) <= ni->ni_replaycnt)
+  if (BE_READ_8(key->replaycnt) <= ni->ni_rsn->rn_replaycnt)
     {
       return;
     }
   /* check Key MIC field using KCK */
 
-  if (ieee80211_eapol_key_check_mic(key, ni->ni_ptk.kck) != 0)
+  if (ieee80211_eapol_key_check_mic(key, ni->ni_rsn->rn_ptk.kck) != 0)
     {
       ndbg("ERROR: key MIC failed\n");
       return;
@@ -905,7 +928,7 @@ static void ieee80211_recv_rsn_group_msg1(FAR struct ieee80211_s *ic,
   /* check that encrypted and decrypt Key Data field using KEK */
 
   if (!(info & EAPOL_KEY_ENCRYPTED) ||
-      ieee80211_eapol_key_decrypt(key, ni->ni_ptk.kek) != 0)
+      ieee80211_eapol_key_decrypt(key, ni->ni_rsn->rn_ptk.kek) != 0)
     {
       ndbg("ERROR: decryption failed\n");
       return;
@@ -1018,7 +1041,7 @@ static void ieee80211_recv_rsn_group_msg1(FAR struct ieee80211_s *ic,
   if (info & EAPOL_KEY_SECURE)
     {
 #ifdef CONFIG_IEEE80211_AP
-      if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_key_count == 2)
+      if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_rsn->rn_key_count == 2)
 #endif
         {
           nvdbg("marking port %s valid\n", ieee80211_addr2str(ni->ni_macaddr));
@@ -1029,7 +1052,7 @@ static void ieee80211_recv_rsn_group_msg1(FAR struct ieee80211_s *ic,
 
   /* Update the last seen value of the key replay counter field */
 
-  ni->ni_replaycnt = BE_READ_8(key->replaycnt);
+  ni->ni_rsn->rn_replaycnt = BE_READ_8(key->replaycnt);
 
   nvdbg("%s: received msg %d/%d of the %s handshake from %s\n",
         ic->ic_ifname, 1, 2, "group key", ieee80211_addr2str(ni->ni_macaddr));
@@ -1059,14 +1082,14 @@ static void ieee80211_recv_wpa_group_msg1(FAR struct ieee80211_s *ic,
   if (ic->ic_opmode != IEEE80211_M_STA && ic->ic_opmode != IEEE80211_M_IBSS)
     return;
 #endif
-  if (BE_READ_8(key->replaycnt) <= ni->ni_replaycnt)
+  if (BE_READ_8(key->replaycnt) <= ni->ni_rsn->rn_replaycnt)
     {
       return;
     }
 
   /* check Key MIC field using KCK */
 
-  if (ieee80211_eapol_key_check_mic(key, ni->ni_ptk.kck) != 0)
+  if (ieee80211_eapol_key_check_mic(key, ni->ni_rsn->rn_ptk.kck) != 0)
     {
       ndbg("ERROR: key MIC failed\n");
       return;
@@ -1076,7 +1099,7 @@ static void ieee80211_recv_wpa_group_msg1(FAR struct ieee80211_s *ic,
    * the ENCRYPTED bit in the info field.
    */
 
-  if (ieee80211_eapol_key_decrypt(key, ni->ni_ptk.kek) != 0)
+  if (ieee80211_eapol_key_decrypt(key, ni->ni_rsn->rn_ptk.kek) != 0)
     {
       ndbg("ERROR: decryption failed\n");
       return;
@@ -1124,7 +1147,7 @@ static void ieee80211_recv_wpa_group_msg1(FAR struct ieee80211_s *ic,
   if (info & EAPOL_KEY_SECURE)
     {
 #ifdef CONFIG_IEEE80211_AP
-      if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_key_count == 2)
+      if (ic->ic_opmode != IEEE80211_M_IBSS || ++ni->ni_rsn->rn_key_count == 2)
 #endif
         {
           nvdbg("marking port %s valid\n", ieee80211_addr2str(ni->ni_macaddr));
@@ -1135,7 +1158,7 @@ static void ieee80211_recv_wpa_group_msg1(FAR struct ieee80211_s *ic,
 
   /* Update the last seen value of the key replay counter field */
 
-  ni->ni_replaycnt = BE_READ_8(key->replaycnt);
+  ni->ni_rsn->rn_replaycnt = BE_READ_8(key->replaycnt);
 
   nvdbg("%s: received msg %d/%d of the %s handshake from %s\n",
         ic->ic_ifname, 1, 2, "group key", ieee80211_addr2str(ni->ni_macaddr));
@@ -1158,34 +1181,32 @@ static void ieee80211_recv_group_msg2(FAR struct ieee80211_s *ic,
 
   /* discard if we're not expecting this message */
 
-  if (ni->ni_rsn_gstate != RSNA_REKEYNEGOTIATING)
+  if (ni->ni_rsn->rn_gstate != RSNA_REKEYNEGOTIATING)
     {
-      ndbg("ERROR: %s: unexpected in state: %d\n", ni->ni_rsn_gstate);
+      ndbg("ERROR: %s: unexpected in state: %d\n", ni->ni_rsn->rn_gstate);
       return;
     }
-  if (BE_READ_8(key->replaycnt) != ni->ni_replaycnt)
+  if (BE_READ_8(key->replaycnt) != ni->ni_rsn->rn_replaycnt)
     {
       return;
     }
 
   /* check Key MIC field using KCK */
 
-  if (ieee80211_eapol_key_check_mic(key, ni->ni_ptk.kck) != 0)
+  if (ieee80211_eapol_key_check_mic(key, ni->ni_rsn->rn_ptk.kck) != 0)
     {
       ndbg("ERROR: key MIC failed\n");
       return;
     }
 
-  wd_cancel(ni->ni_eapol_to);
-  ni->ni_rsn_gstate = RSNA_REKEYESTABLISHED;
+  ieee80211_eapol_timer_stop(ic, ni);
+  ni->ni_rsn->rn_gstate = RSNA_REKEYESTABLISHED;
 
-  if ((ni->ni_flags & IEEE80211_NODE_REKEY) && --ic->ic_rsn_keydonesta == 0)
-    ieee80211_setkeysdone(ic);
-  ni->ni_flags &= ~IEEE80211_NODE_REKEY;
+  ieee80211_rekey_done(ic, ni);
   ni->ni_flags |= IEEE80211_NODE_TXRXPROT;
 
-  ni->ni_rsn_gstate = RSNA_IDLE;
-  ni->ni_rsn_retries = 0;
+  ni->ni_rsn->rn_gstate = RSNA_IDLE;
+  ni->ni_rsn->rn_retries = 0;
 
   nvdbg("%s: received msg %d/%d of the %s handshake from %s\n",
         ic->ic_ifname, 2, 2, "group key", ieee80211_addr2str(ni->ni_macaddr));
@@ -1207,15 +1228,15 @@ static void ieee80211_recv_eapol_key_req(FAR struct ieee80211_s *ic,
 
   /* enforce monotonicity of key request replay counter */
 
-  if (ni->ni_reqreplaycnt_ok &&
-      BE_READ_8(key->replaycnt) <= ni->ni_reqreplaycnt)
+  if (ni->ni_rsn->rn_reqreplaycnt_ok &&
+      BE_READ_8(key->replaycnt) <= ni->ni_rsn->rn_reqreplaycnt)
     {
       return;
     }
   info = BE_READ_2(key->info);
 
   if (!(info & EAPOL_KEY_KEYMIC) ||
-      ieee80211_eapol_key_check_mic(key, ni->ni_ptk.kck) != 0)
+      ieee80211_eapol_key_check_mic(key, ni->ni_rsn->rn_ptk.kck) != 0)
     {
       ndbg("ERROR: key request MIC failed\n");
       return;
@@ -1223,8 +1244,8 @@ static void ieee80211_recv_eapol_key_req(FAR struct ieee80211_s *ic,
 
   /* update key request replay counter now that MIC is verified */
 
-  ni->ni_reqreplaycnt = BE_READ_8(key->replaycnt);
-  ni->ni_reqreplaycnt_ok = 1;
+  ni->ni_rsn->rn_reqreplaycnt = BE_READ_8(key->replaycnt);
+  ni->ni_rsn->rn_reqreplaycnt_ok = 1;
 
   if (info & EAPOL_KEY_ERROR)
     {                           /* TKIP MIC failure */
@@ -64,6 +64,8 @@ static uint8_t *ieee80211_add_gtk_kde(uint8_t *, struct ieee80211_node *,
                                       const struct ieee80211_key *);
 static uint8_t *ieee80211_add_pmkid_kde(uint8_t *, const uint8_t *);
 static uint8_t *ieee80211_add_igtk_kde(uint8_t *, const struct ieee80211_key *);
+static uint8_t *ieee80211_add_rekey_kdes(uint8_t *, struct ieee80211_s *,
+                                         struct ieee80211_node *);
 #endif
 static struct iob_s *ieee80211_get_eapol_key(int, unsigned int);
 
@@ -170,7 +172,7 @@ static int ieee80211_send_eapol_key(FAR struct ieee80211_s *ic,
 
   if (info & EAPOL_KEY_KEYACK)
     {
-      wd_start(ni->ni_eapol_to, MSEC2TICK(100), ieee80211_eapol_timeout, ni);
+      ieee80211_eapol_timer_start(ic, ni, MSEC2TICK(100));
     }
 #endif
 
@@ -191,11 +193,11 @@ void ieee80211_eapol_timeout(void *arg)
   uip_lock_t flags;
 
   ndbg("ERROR: no answer from station %s in state %d\n",
-       ieee80211_addr2str(ni->ni_macaddr), ni->ni_rsn_state);
+       ieee80211_addr2str(ni->ni_macaddr), ni->ni_rsn->rn_state);
 
   flags = uip_lock();
 
-  switch (ni->ni_rsn_state)
+  switch (ni->ni_rsn->rn_state)
     {
     case RSNA_PTKSTART:
     case RSNA_PTKCALCNEGOTIATING:
@@ -206,7 +208,7 @@ void ieee80211_eapol_timeout(void *arg)
       break;
     }
 
-  switch (ni->ni_rsn_gstate)
+  switch (ni->ni_rsn->rn_gstate)
     {
     case RSNA_REKEYNEGOTIATING:
       (void)ieee80211_send_group_msg1(ic, ni);
@@ -277,6 +279,41 @@ static uint8_t *ieee80211_add_igtk_kde(uint8_t * frm,
   memcpy(frm, k->k_key, 16);
   return frm + 16;
 }
+
+/* Add the GTK KDE and, with MFP, the IGTK KDE of the new group keys during
+ * a rekey.  They only differ between stations in the TxRx flag and whether
+ * the IGTK is sent, so each variant is built once per rekey.
+ */
+
+static uint8_t *ieee80211_add_rekey_kdes(FAR uint8_t * frm,
+                                         FAR struct ieee80211_s *ic,
+                                         FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+  FAR uint8_t *end;
+  int v;
+
+  v = ((ni->ni_rsncipher == IEEE80211_CIPHER_USEGROUP) ? 1 : 0) |
+      ((ni->ni_flags & IEEE80211_NODE_MFP) ? 2 : 0);
+
+  if (rk->rk_kdelen[v] == 0)
+    {
+      end = ieee80211_add_gtk_kde(rk->rk_kde[v], ni,
+                                  &ic->ic_nw_keys[(ic->ic_def_txkey == 1) ?
+                                                  2 : 1]);
+      if (ni->ni_flags & IEEE80211_NODE_MFP)
+        {
+          end = ieee80211_add_igtk_kde(end,
+                                       &ic->ic_nw_keys[(ic->ic_igtk_kid ==
+                                                        4) ? 5 : 4]);
+        }
+
+      rk->rk_kdelen[v] = end - rk->rk_kde[v];
+    }
+
+  memcpy(frm, rk->rk_kde[v], rk->rk_kdelen[v]);
+  return frm + rk->rk_kdelen[v];
+}
 #endif /* CONFIG_IEEE80211_AP */
 
 static FAR struct iob_s *ieee80211_get_eapol_key(int type, unsigned int pktlen)
@@ -315,8 +352,8 @@ int ieee80211_send_4way_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
   uint16_t info, keylen;
   uint8_t *frm;
 
-  ni->ni_rsn_state = RSNA_PTKSTART;
-  if (++ni->ni_rsn_retries > 3)
+  ni->ni_rsn->rn_state = RSNA_PTKSTART;
+  if (++ni->ni_rsn->rn_retries > 3)
     {
       IEEE80211_SEND_MGMT(ic, ni, IEEE80211_FC0_SUBTYPE_DEAUTH,
                           IEEE80211_REASON_4WAY_TIMEOUT);
@@ -340,7 +377,7 @@ int ieee80211_send_4way_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
 
   /* Copy the authenticator's nonce (ANonce) */
 
-  memcpy(key->nonce, ni->ni_nonce, EAPOL_KEY_NONCE_LEN);
+  memcpy(key->nonce, ni->ni_rsn->rn_nonce, EAPOL_KEY_NONCE_LEN);
 
   keylen = ieee80211_cipher_keylen(ni->ni_rsncipher);
   BE_WRITE_2(key->keylen, keylen);
@@ -352,7 +389,7 @@ int ieee80211_send_4way_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
   if (ni->ni_rsnprotos == IEEE80211_PROTO_RSN &&
       ieee80211_is_8021x_akm(ni->ni_rsnakms))
     {
-      frm = ieee80211_add_pmkid_kde(frm, ni->ni_pmkid);
+      frm = ieee80211_add_pmkid_kde(frm, ni->ni_rsn->rn_pmkid);
     }
 
   iob->io_pktlen = iob->io_len = frm - (uint8_t *) key;
@@ -360,8 +397,8 @@ int ieee80211_send_4way_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
   nvdbg("%s: sending msg %d/%d of the %s handshake to %s\n",
         ic->ic_ifname, 1, 4, "4-way", ieee80211_addr2str(ni->ni_macaddr));
 
-  ni->ni_replaycnt++;
-  BE_WRITE_8(key->replaycnt, ni->ni_replaycnt);
+  ni->ni_rsn->rn_replaycnt++;
+  BE_WRITE_8(key->replaycnt, ni->ni_rsn->rn_replaycnt);
 
   return ieee80211_send_eapol_key(ic, iob, ni, NULL);
 }
@@ -443,8 +480,8 @@ int ieee80211_send_4way_msg3(struct ieee80211_s *ic, struct ieee80211_node *ni)
   uint16_t info, keylen;
   uint8_t *frm;
 
-  ni->ni_rsn_state = RSNA_PTKINITNEGOTIATING;
-  if (++ni->ni_rsn_retries > 3)
+  ni->ni_rsn->rn_state = RSNA_PTKINITNEGOTIATING;
+  if (++ni->ni_rsn->rn_retries > 3)
     {
       IEEE80211_SEND_MGMT(ic, ni, IEEE80211_FC0_SUBTYPE_DEAUTH,
                           IEEE80211_REASON_4WAY_TIMEOUT);
@@ -478,10 +515,10 @@ int ieee80211_send_4way_msg3(struct ieee80211_s *ic, struct ieee80211_node *ni)
 
   /* Use same nonce as in Message 1 */
 
-  memcpy(key->nonce, ni->ni_nonce, EAPOL_KEY_NONCE_LEN);
+  memcpy(key->nonce, ni->ni_rsn->rn_nonce, EAPOL_KEY_NONCE_LEN);
 
-  ni->ni_replaycnt++;
-  BE_WRITE_8(key->replaycnt, ni->ni_replaycnt);
+  ni->ni_rsn->rn_replaycnt++;
+  BE_WRITE_8(key->replaycnt, ni->ni_rsn->rn_replaycnt);
 
   keylen = ieee80211_cipher_keylen(ni->ni_rsncipher);
   BE_WRITE_2(key->keylen, keylen);
@@ -526,7 +563,7 @@ int ieee80211_send_4way_msg3(struct ieee80211_s *ic, struct ieee80211_node *ni)
   nvbg("%s: sending msg %d/%d of the %s handshake to %s\n",
        ic->ic_ifname, 3, 4, "4-way", ieee80211_addr2str(ni->ni_macaddr));
 
-  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_ptk);
+  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_rsn->rn_ptk);
 }
 #endif /* CONFIG_IEEE80211_AP */
 
@@ -551,7 +588,7 @@ int ieee80211_send_4way_msg4(struct ieee80211_s *ic, struct ieee80211_node *ni)
 
   /* Copy key replay counter from authenticator */
 
-  BE_WRITE_8(key->replaycnt, ni->ni_replaycnt);
+  BE_WRITE_8(key->replaycnt, ni->ni_rsn->rn_replaycnt);
 
   if (ni->ni_rsnprotos == IEEE80211_PROTO_WPA)
     {
@@ -578,7 +615,7 @@ int ieee80211_send_4way_msg4(struct ieee80211_s *ic, struct ieee80211_node *ni)
   nvdbg("%s: sending msg %d/%d of the %s handshake to %s\n",
         ic->ic_ifname, 4, 4, "4-way", ieee80211_addr2str(ni->ni_macaddr));
 
-  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_ptk);
+  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_rsn->rn_ptk);
 }
 
 #ifdef CONFIG_IEEE80211_AP
@@ -594,8 +631,8 @@ int ieee80211_send_group_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
   uint8_t *frm;
   uint8_t kid;
 
-  ni->ni_rsn_gstate = RSNA_REKEYNEGOTIATING;
-  if (++ni->ni_rsn_retries > 3)
+  ni->ni_rsn->rn_gstate = RSNA_REKEYNEGOTIATING;
+  if (++ni->ni_rsn->rn_retries > 3)
     {
       IEEE80211_SEND_MGMT(ic, ni, IEEE80211_FC0_SUBTYPE_DEAUTH,
                           IEEE80211_REASON_GROUP_TIMEOUT);
@@ -632,8 +669,8 @@ int ieee80211_send_group_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
     EAPOL_KEY_KEYACK | EAPOL_KEY_KEYMIC | EAPOL_KEY_SECURE |
     EAPOL_KEY_ENCRYPTED;
 
-  ni->ni_replaycnt++;
-  BE_WRITE_8(key->replaycnt, ni->ni_replaycnt);
+  ni->ni_rsn->rn_replaycnt++;
+  BE_WRITE_8(key->replaycnt, ni->ni_rsn->rn_replaycnt);
 
   frm = (uint8_t *) & key[1];
   if (ni->ni_rsnprotos == IEEE80211_PROTO_WPA)
@@ -653,19 +690,18 @@ int ieee80211_send_group_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
     {
       /* RSN */
 
-      frm = ieee80211_add_gtk_kde(frm, ni, k);
-      if (ni->ni_flags & IEEE80211_NODE_MFP)
+      if (ni->ni_flags & IEEE80211_NODE_REKEY)
         {
-          if (ni->ni_flags & IEEE80211_NODE_REKEY)
-            {
-              kid = (ic->ic_igtk_kid == 4) ? 5 : 4;
-            }
-          else
+          frm = ieee80211_add_rekey_kdes(frm, ic, ni);
+        }
+      else
+        {
+          frm = ieee80211_add_gtk_kde(frm, ni, k);
+          if (ni->ni_flags & IEEE80211_NODE_MFP)
             {
-              kid = ic->ic_igtk_kid;
+              frm = ieee80211_add_igtk_kde(frm,
+                                           &ic->ic_nw_keys[ic->ic_igtk_kid]);
             }
-
-          frm = ieee80211_add_igtk_kde(frm, &ic->ic_nw_keys[kid]);
         }
     }
 
@@ -682,7 +718,7 @@ int ieee80211_send_group_msg1(struct ieee80211_s *ic, struct ieee80211_node *ni)
   nvdbg("%s: sending msg %d/%d of the %s handshake to %s\n",
         ic->ic_ifname, 1, 2, "group key", ieee80211_addr2str(ni->ni_macaddr));
 
-  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_ptk);
+  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_rsn->rn_ptk);
 }
 #endif /* CONFIG_IEEE80211_AP */
 
@@ -708,7 +744,7 @@ int ieee80211_send_group_msg2(struct ieee80211_s *ic, struct ieee80211_node *ni,
 
   /* Copy key replay counter from authenticator */
 
-  BE_WRITE_8(key->replaycnt, ni->ni_replaycnt);
+  BE_WRITE_8(key->replaycnt, ni->ni_rsn->rn_replaycnt);
 
   if (ni->ni_rsnprotos == IEEE80211_PROTO_WPA)
     {
@@ -729,7 +765,7 @@ int ieee80211_send_group_msg2(struct ieee80211_s *ic, struct ieee80211_node *ni,
   nvdbg("%s: sending msg %d/%d of the %s handshake to %s\n",
         ic->ic_ifname, 2, 2, "group key", ieee80211_addr2str(ni->ni_macaddr));
 
-  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_ptk);
+  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_rsn->rn_ptk);
 }
 
 /* EAPOL-Key Request frames are sent by the supplicant to request that the
@@ -765,11 +801,11 @@ int ieee80211_send_eapol_key_req(FAR struct ieee80211_s *ic,
 
   /* Use our separate key replay counter for key requests */
 
-  BE_WRITE_8(key->replaycnt, ni->ni_reqreplaycnt);
-  ni->ni_reqreplaycnt++;
+  BE_WRITE_8(key->replaycnt, ni->ni_rsn->rn_reqreplaycnt);
+  ni->ni_rsn->rn_reqreplaycnt++;
 
   nvdbg("%s: sending EAPOL-Key request to %s\n",
         ic->ic_ifname, ieee80211_addr2str(ni->ni_macaddr));
 
-  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_ptk);
+  return ieee80211_send_eapol_key(ic, iob, ni, &ni->ni_rsn->rn_ptk);
 }
@@ -0,0 +1,165 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_pbkdf2.c
+ * PBKDF2-HMAC-SHA1 for WPA passphrases
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ieee80211_sha1.h"
+#include "ieee80211_pbkdf2.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Length in bits of a message made of one key pad block and one digest,
+ * as hashed by each HMAC iteration of PBKDF2.
+ */
+
+#define PBKDF2_MSGBITS  ((SHA1_BLOCK_LENGTH + SHA1_DIGEST_LENGTH) * 8)
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_pbkdf2_sha1
+ ****************************************************************************/
+
+void ieee80211_pbkdf2_sha1(FAR const uint8_t *pass, size_t passlen,
+                           FAR const uint8_t *salt, size_t saltlen,
+                           unsigned int iterations, FAR uint8_t *out,
+                           size_t outlen)
+{
+  HMAC_SHA1_CTX hmac;
+  HMAC_SHA1_CTX ctx;
+  uint8_t digest[SHA1_DIGEST_LENGTH];
+  uint8_t count[4];
+  uint32_t w[16];
+  uint32_t h[5];
+  uint32_t t[5];
+  uint32_t blk;
+  unsigned int n;
+  size_t len;
+  int i;
+
+  /* Hash the inner and outer key pads once for all iterations */
+
+  HMAC_SHA1_Init(&hmac, pass, passlen);
+
+  /* After the key pad, an HMAC over a digest is exactly one more block:
+   * the 20 byte digest, the padding and the length.  Only the first five
+   * words change from one iteration to the next.
+   */
+
+  memset(w, 0, sizeof(w));
+  w[5]  = 0x80000000;
+  w[15] = PBKDF2_MSGBITS;
+
+  for (blk = 1; outlen > 0; blk++)
+    {
+      /* U1 = HMAC(P, S || INT(blk)) */
+
+      count[0] = blk >> 24;
+      count[1] = blk >> 16;
+      count[2] = blk >> 8;
+      count[3] = blk;
+
+      ctx = hmac;
+      HMAC_SHA1_Update(&ctx, salt, saltlen);
+      HMAC_SHA1_Update(&ctx, count, sizeof(count));
+      HMAC_SHA1_Final(digest, &ctx);
+
+      for (i = 0; i < 5; i++)
+        {
+          t[i] = (uint32_t)digest[4 * i] << 24 |
+                 (uint32_t)digest[4 * i + 1] << 16 |
+                 (uint32_t)digest[4 * i + 2] << 8 | digest[4 * i + 3];
+          w[i] = t[i];
+        }
+
+      /* Un = HMAC(P, Un-1), T = U1 ^ ... ^ Uc.  Each iteration continues
+       * from the key pad states of the HMAC context with one compression
+       * each for the inner and the outer hash.
+       */
+
+      for (n = 1; n < iterations; n++)
+        {
+          memcpy(h, hmac.ictx.state, sizeof(h));
+          ieee80211_sha1_compress(h, w);
+          memcpy(w, h, sizeof(h));
+
+          memcpy(h, hmac.octx.state, sizeof(h));
+          ieee80211_sha1_compress(h, w);
+          memcpy(w, h, sizeof(h));
+
+          t[0] ^= h[0];
+          t[1] ^= h[1];
+          t[2] ^= h[2];
+          t[3] ^= h[3];
+          t[4] ^= h[4];
+        }
+
+      for (i = 0; i < 5; i++)
+        {
+          digest[4 * i]     = t[i] >> 24;
+          digest[4 * i + 1] = t[i] >> 16;
+          digest[4 * i + 2] = t[i] >> 8;
+          digest[4 * i + 3] = t[i];
+        }
+
+      len = outlen < SHA1_DIGEST_LENGTH ? outlen : SHA1_DIGEST_LENGTH;
+      memcpy(out, digest, len);
+      out    += len;
+      outlen -= len;
+    }
+
+  /* Do not leave key material on the stack */
+
+  memset(&hmac, 0, sizeof(hmac));
+  memset(&ctx, 0, sizeof(ctx));
+  memset(digest, 0, sizeof(digest));
+  memset(w, 0, sizeof(w));
+  memset(h, 0, sizeof(h));
+  memset(t, 0, sizeof(t));
+}
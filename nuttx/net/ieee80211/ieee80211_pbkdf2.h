@@ -0,0 +1,82 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_pbkdf2.h
+ * PBKDF2-HMAC-SHA1 for WPA passphrases
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_PBKDF2_H
+#define __NET_IEEE80211_IEEE80211_PBKDF2_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#else
+#  define FAR
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* WPA/RSN passphrase to PSK mapping (802.11 Annex M.4) */
+
+#define IEEE80211_PSK_ITERATIONS  4096
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_pbkdf2_sha1
+ *
+ * Description:
+ *   PBKDF2 (RFC 2898) with HMAC-SHA1 as the pseudo random function.  The
+ *   HMAC key pads are hashed once by HMAC_SHA1_Init(); each of the
+ *   'iterations' then costs two SHA-1 compressions per 20 bytes of output.
+ *   With a WPA passphrase, the SSID as salt, 4096 iterations and 32 bytes
+ *   of output, this gives the PSK.
+ *
+ ****************************************************************************/
+
+void ieee80211_pbkdf2_sha1(FAR const uint8_t *pass, size_t passlen,
+                           FAR const uint8_t *salt, size_t saltlen,
+                           unsigned int iterations, FAR uint8_t *out,
+                           size_t outlen);
+
+#endif /* __NET_IEEE80211_IEEE80211_PBKDF2_H */
@@ -0,0 +1,269 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_pbkdf2_bench.c
+ * Host benchmark for the passphrase to PSK derivation.  This is not part
+ * of the NuttX build.  Build and run it on the development host with:
+ *
+ *   cc -O2 -DIEEE80211_HOSTBENCH -o pbkdf2_bench \
+ *      ieee80211_pbkdf2_bench.c ieee80211_pbkdf2.c ieee80211_sha1.c
+ *   ./pbkdf2_bench
+ *
+ * It checks HMAC_SHA1 against RFC 2202 and ieee80211_pbkdf2_sha1() against
+ * the 802.11 Annex M.4 test vectors and against a plain PBKDF2 that runs a
+ * complete HMAC-SHA1 for every iteration, then compares the time each
+ * takes to derive a PSK.
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ieee80211_sha1.h"
+#include "ieee80211_pbkdf2.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define PSK_LEN       32
+#define BENCH_PSKS    20    /* Derivations timed per case */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct psk_vector_s
+{
+  const char *pass;
+  const char *ssid;
+  uint8_t psk[PSK_LEN];
+};
+
+typedef void (*pbkdf2_func_t)(const uint8_t *, size_t, const uint8_t *,
+                              size_t, unsigned int, uint8_t *, size_t);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* 802.11-2012 Annex M.4.1 */
+
+static const struct psk_vector_s g_vectors[] =
+{
+  {
+    "password", "IEEE",
+    {
+      0xf4, 0x2c, 0x6f, 0xc5, 0x2d, 0xf0, 0xeb, 0xef,
+      0x9e, 0xbb, 0x4b, 0x90, 0xb3, 0x8a, 0x5f, 0x90,
+      0x2e, 0x83, 0xfe, 0x1b, 0x13, 0x5a, 0x70, 0xe2,
+      0x3a, 0xed, 0x76, 0x2e, 0x97, 0x10, 0xa1, 0x2e
+    }
+  },
+  {
+    "ThisIsAPassword", "ThisIsASSID",
+    {
+      0x0d, 0xc0, 0xd6, 0xeb, 0x90, 0x55, 0x5e, 0xd6,
+      0x41, 0x97, 0x56, 0xb9, 0xa1, 0x5e, 0xc3, 0xe3,
+      0x20, 0x9b, 0x63, 0xdf, 0x70, 0x7d, 0xd5, 0x08,
+      0xd1, 0x45, 0x81, 0xf8, 0x98, 0x27, 0x21, 0xaf
+    }
+  },
+  {
+    "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+    "ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ",
+    {
+      0xbe, 0xcb, 0x93, 0x86, 0x6b, 0xb8, 0xc3, 0x83,
+      0x2c, 0xb7, 0x77, 0xc2, 0xf5, 0x59, 0x80, 0x7c,
+      0x8c, 0x59, 0xaf, 0xcb, 0x6e, 0xae, 0x73, 0x48,
+      0x85, 0x00, 0x13, 0x00, 0xa9, 0x81, 0xcc, 0x62
+    }
+  }
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* HMAC-SHA1 with the key pads hashed again for every message */
+
+static void hmac_sha1(const uint8_t *key, size_t keylen,
+                      const uint8_t *msg, size_t msglen, uint8_t *mac)
+{
+  HMAC_SHA1_CTX ctx;
+
+  HMAC_SHA1_Init(&ctx, key, keylen);
+  HMAC_SHA1_Update(&ctx, msg, msglen);
+  HMAC_SHA1_Final(mac, &ctx);
+}
+
+static void pbkdf2_plain(const uint8_t *pass, size_t passlen,
+                         const uint8_t *salt, size_t saltlen,
+                         unsigned int iterations, uint8_t *out,
+                         size_t outlen)
+{
+  uint8_t msg[64];
+  uint8_t u[SHA1_DIGEST_LENGTH];
+  uint8_t t[SHA1_DIGEST_LENGTH];
+  uint32_t blk;
+  unsigned int n;
+  size_t len;
+  size_t i;
+
+  for (blk = 1; outlen > 0; blk++)
+    {
+      memcpy(msg, salt, saltlen);
+      msg[saltlen]     = blk >> 24;
+      msg[saltlen + 1] = blk >> 16;
+      msg[saltlen + 2] = blk >> 8;
+      msg[saltlen + 3] = blk;
+
+      hmac_sha1(pass, passlen, msg, saltlen + 4, u);
+      memcpy(t, u, sizeof(t));
+
+      for (n = 1; n < iterations; n++)
+        {
+          hmac_sha1(pass, passlen, u, sizeof(u), u);
+          for (i = 0; i < sizeof(t); i++)
+            {
+              t[i] ^= u[i];
+            }
+        }
+
+      len = outlen < sizeof(t) ? outlen : sizeof(t);
+      memcpy(out, t, len);
+      out    += len;
+      outlen -= len;
+    }
+}
+
+static double bench(pbkdf2_func_t func)
+{
+  const struct psk_vector_s *v = &g_vectors[1];
+  uint8_t psk[PSK_LEN];
+  double start;
+  int i;
+
+  start = now();
+  for (i = 0; i < BENCH_PSKS; i++)
+    {
+      func((const uint8_t *)v->pass, strlen(v->pass),
+           (const uint8_t *)v->ssid, strlen(v->ssid),
+           IEEE80211_PSK_ITERATIONS, psk, sizeof(psk));
+    }
+
+  return (now() - start) * 1e3 / BENCH_PSKS;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(void)
+{
+  static const pbkdf2_func_t funcs[2] =
+  {
+    pbkdf2_plain, ieee80211_pbkdf2_sha1
+  };
+
+  /* RFC 2202 test case 6:  a key longer than one block */
+
+  static const uint8_t hmac_mac[SHA1_DIGEST_LENGTH] =
+  {
+    0xaa, 0x4a, 0xe5, 0xe1, 0x52, 0x72, 0xd0, 0x0e, 0x95, 0x70,
+    0x56, 0x37, 0xce, 0x8a, 0x3b, 0x55, 0xed, 0x40, 0x21, 0x12
+  };
+
+  static const char hmac_msg[] =
+    "Test Using Larger Than Block-Size Key - Hash Key First";
+
+  const struct psk_vector_s *v;
+  uint8_t hmac_key[80];
+  uint8_t mac[SHA1_DIGEST_LENGTH];
+  uint8_t psk[PSK_LEN];
+  double plain;
+  double fast;
+  size_t i;
+  int j;
+
+  memset(hmac_key, 0xaa, sizeof(hmac_key));
+  hmac_sha1(hmac_key, sizeof(hmac_key), (const uint8_t *)hmac_msg,
+            strlen(hmac_msg), mac);
+  if (memcmp(mac, hmac_mac, sizeof(mac)) != 0)
+    {
+      fprintf(stderr, "ERROR: HMAC-SHA1 wrong\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Sanity check:  Both implementations must produce the known PSKs */
+
+  for (i = 0; i < sizeof(g_vectors) / sizeof(g_vectors[0]); i++)
+    {
+      v = &g_vectors[i];
+      for (j = 0; j < 2; j++)
+        {
+          funcs[j]((const uint8_t *)v->pass, strlen(v->pass),
+                   (const uint8_t *)v->ssid, strlen(v->ssid),
+                   IEEE80211_PSK_ITERATIONS, psk, sizeof(psk));
+
+          if (memcmp(psk, v->psk, PSK_LEN) != 0)
+            {
+              fprintf(stderr, "ERROR: vector %u wrong (%s)\n",
+                      (unsigned int)i, j == 0 ? "plain" : "precomputed");
+              return EXIT_FAILURE;
+            }
+        }
+    }
+
+  plain = bench(pbkdf2_plain);
+  fast  = bench(ieee80211_pbkdf2_sha1);
+
+  printf("%-14s %10s\n", "PBKDF2", "ms/PSK");
+  printf("%-14s %10.2f\n", "plain HMAC", plain);
+  printf("%-14s %10.2f\n", "precomputed", fast);
+  printf("speedup        %10.2fx\n", plain / fast);
+  return EXIT_SUCCESS;
+}
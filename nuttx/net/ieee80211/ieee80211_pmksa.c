@@ -0,0 +1,398 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_pmksa.c
+ * Bounded PMKSA cache with LRU eviction and lifetime expiry
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <queue.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_crypto.h"
+#include "ieee80211/ieee80211_debug.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define PMKSA_HASHMASK   (IEEE80211_PMKSA_HASHSIZE - 1)
+
+/* Longest lifetime that fits the tick arithmetic; longer ones never
+ * expire.  SEC2TICK() multiplies by MSEC_PER_SEC and rounds in 32 bits
+ * (hence the one second of headroom), and the expiry test compares signed
+ * tick differences.
+ */
+
+#define PMKSA_MAXLIFETIME_MSEC  (UINT32_MAX / MSEC_PER_SEC - 1)
+#define PMKSA_MAXLIFETIME_TICK  (INT32_MAX / TICK_PER_SEC)
+
+#if PMKSA_MAXLIFETIME_MSEC < PMKSA_MAXLIFETIME_TICK
+#  define PMKSA_MAXLIFETIME  PMKSA_MAXLIFETIME_MSEC
+#else
+#  define PMKSA_MAXLIFETIME  PMKSA_MAXLIFETIME_TICK
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_hash
+ *
+ * Description:
+ *   Hash the address of the peer (the AA on a STA, the SPA on an AP).
+ *
+ ****************************************************************************/
+
+static inline unsigned int ieee80211_pmksa_hash(FAR const uint8_t *macaddr)
+{
+  return ieee80211_mac_hash(macaddr, 0) & PMKSA_HASHMASK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_expired
+ ****************************************************************************/
+
+static inline bool ieee80211_pmksa_expired(FAR const struct ieee80211_pmk *pmk)
+{
+  return pmk->pmk_lifetime != IEEE80211_PMK_INFINITE &&
+         (int32_t)(pmk->pmk_expire - clock_systimer()) <= 0;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_release
+ *
+ * Description:
+ *   Remove an entry from the cache and wipe the key.
+ *
+ ****************************************************************************/
+
+static void ieee80211_pmksa_release(FAR struct ieee80211_s *ic,
+                                    FAR struct ieee80211_pmk *pmk)
+{
+  FAR struct ieee80211_pmk **pp;
+
+  pp = &ic->ic_pmksa_hash[pmk->pmk_hash];
+  while (*pp != pmk)
+    {
+      pp = &(*pp)->pmk_hnext;
+    }
+
+  *pp = pmk->pmk_hnext;
+  dq_rem(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+
+  memset(pmk, 0, sizeof(struct ieee80211_pmk));
+  pmk->pmk_hnext = ic->ic_pmksa_free;
+  ic->ic_pmksa_free = pmk;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_alloc
+ *
+ * Description:
+ *   Take a free entry.  When the cache is full, expired entries are dropped
+ *   first and then the least recently used one.
+ *
+ ****************************************************************************/
+
+static FAR struct ieee80211_pmk *
+ieee80211_pmksa_alloc(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_pmk *pmk;
+  FAR struct ieee80211_pmk *next;
+
+  if (ic->ic_pmksa_free == NULL)
+    {
+      for (pmk = (FAR struct ieee80211_pmk *)ic->ic_pmksa_lru.head;
+           pmk != NULL; pmk = next)
+        {
+          next = (FAR struct ieee80211_pmk *)pmk->pmk_lru.flink;
+          if (ieee80211_pmksa_expired(pmk))
+            {
+              ic->ic_pmksa_stats.ps_expired++;
+              ieee80211_pmksa_release(ic, pmk);
+            }
+        }
+    }
+
+  if (ic->ic_pmksa_free == NULL)
+    {
+      pmk = (FAR struct ieee80211_pmk *)ic->ic_pmksa_lru.head;
+      nvdbg("evicting PMK of %s\n", ieee80211_addr2str(pmk->pmk_macaddr));
+      ic->ic_pmksa_stats.ps_evictions++;
+      ieee80211_pmksa_release(ic, pmk);
+    }
+
+  pmk = ic->ic_pmksa_free;
+  ic->ic_pmksa_free = pmk->pmk_hnext;
+  return pmk;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_lookup
+ *
+ * Description:
+ *   Find the entry of a (peer, AKMP) pair and, if 'pmkid' is not NULL, with
+ *   that PMKID.  An expired entry is dropped rather than returned.
+ *
+ ****************************************************************************/
+
+static FAR struct ieee80211_pmk *
+ieee80211_pmksa_lookup(FAR struct ieee80211_s *ic, enum ieee80211_akm akm,
+                       FAR const uint8_t *macaddr, FAR const uint8_t *pmkid)
+{
+  FAR struct ieee80211_pmk *pmk;
+
+  pmk = ic->ic_pmksa_hash[ieee80211_pmksa_hash(macaddr)];
+  for (; pmk != NULL; pmk = pmk->pmk_hnext)
+    {
+      if (pmk->pmk_akm == akm && IEEE80211_ADDR_EQ(pmk->pmk_macaddr, macaddr))
+        {
+          break;
+        }
+    }
+
+  if (pmk != NULL && ieee80211_pmksa_expired(pmk))
+    {
+      ic->ic_pmksa_stats.ps_expired++;
+      ieee80211_pmksa_release(ic, pmk);
+      return NULL;
+    }
+
+  if (pmk != NULL && pmkid != NULL &&
+      memcmp(pmk->pmk_pmkid, pmkid, IEEE80211_PMKID_LEN) != 0)
+    {
+      return NULL;
+    }
+
+  return pmk;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_initialize
+ *
+ * Description:
+ *   Set up the PMKSA cache of the interface.
+ *
+ ****************************************************************************/
+
+void ieee80211_pmksa_initialize(FAR struct ieee80211_s *ic)
+{
+  int i;
+
+  memset(ic->ic_pmksa, 0, sizeof(ic->ic_pmksa));
+  memset(ic->ic_pmksa_hash, 0, sizeof(ic->ic_pmksa_hash));
+  memset(&ic->ic_pmksa_stats, 0, sizeof(ic->ic_pmksa_stats));
+  dq_init(&ic->ic_pmksa_lru);
+
+  ic->ic_pmksa_free = NULL;
+  for (i = CONFIG_IEEE80211_PMKSA_NENTRIES - 1; i >= 0; i--)
+    {
+      ic->ic_pmksa[i].pmk_hnext = ic->ic_pmksa_free;
+      ic->ic_pmksa_free = &ic->ic_pmksa[i];
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_flush
+ *
+ * Description:
+ *   Drop all entries, clearing the keys from memory.
+ *
+ ****************************************************************************/
+
+void ieee80211_pmksa_flush(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_pmk *pmk;
+
+  while ((pmk = (FAR struct ieee80211_pmk *)ic->ic_pmksa_lru.head) != NULL)
+    {
+      ieee80211_pmksa_release(ic, pmk);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_add
+ *
+ * Description:
+ *   Add a PMK entry to the PMKSA cache, replacing the one of the same
+ *   (peer, AKMP) if any.  'lifetime' is in seconds; IEEE80211_PMK_INFINITE
+ *   entries are only dropped to make room.
+ *
+ ****************************************************************************/
+
+struct ieee80211_pmk *ieee80211_pmksa_add(struct ieee80211_s *ic,
+                                          enum ieee80211_akm akm,
+                                          const uint8_t * macaddr,
+                                          const uint8_t * key,
+                                          uint32_t lifetime)
+{
+  FAR struct ieee80211_pmk *pmk;
+
+  pmk = ieee80211_pmksa_lookup(ic, akm, macaddr, NULL);
+  if (pmk != NULL)
+    {
+      dq_rem(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+    }
+  else
+    {
+      pmk = ieee80211_pmksa_alloc(ic);
+      pmk->pmk_akm  = akm;
+      pmk->pmk_hash = ieee80211_pmksa_hash(macaddr);
+      IEEE80211_ADDR_COPY(pmk->pmk_macaddr, macaddr);
+
+      pmk->pmk_hnext = ic->ic_pmksa_hash[pmk->pmk_hash];
+      ic->ic_pmksa_hash[pmk->pmk_hash] = pmk;
+    }
+
+  dq_addlast(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+
+  if (lifetime > PMKSA_MAXLIFETIME)
+    {
+      lifetime = IEEE80211_PMK_INFINITE;
+    }
+
+  memcpy(pmk->pmk_key, key, IEEE80211_PMK_LEN);
+  pmk->pmk_lifetime = lifetime;
+  pmk->pmk_expire   = clock_systimer() + SEC2TICK(lifetime);
+
+#ifdef CONFIG_IEEE80211_AP
+  if (ic->ic_opmode == IEEE80211_M_HOSTAP)
+    {
+      ieee80211_derive_pmkid(pmk->pmk_akm, pmk->pmk_key,
+                             ic->ic_myaddr, macaddr, pmk->pmk_pmkid);
+    }
+  else
+#endif
+    {
+      ieee80211_derive_pmkid(pmk->pmk_akm, pmk->pmk_key,
+                             macaddr, ic->ic_myaddr, pmk->pmk_pmkid);
+    }
+
+  return pmk;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_find
+ *
+ * Description:
+ *   Check if we have a cached PMK entry for the specified node and PMKID
+ *   (any PMKID if NULL).  A hit makes the entry the most recently used.
+ *
+ ****************************************************************************/
+
+struct ieee80211_pmk *ieee80211_pmksa_find(struct ieee80211_s *ic,
+                                           struct ieee80211_node *ni,
+                                           const uint8_t * pmkid)
+{
+  FAR struct ieee80211_pmk *pmk;
+
+  pmk = ieee80211_pmksa_lookup(ic, ni->ni_rsnakms, ni->ni_macaddr, pmkid);
+  if (pmk == NULL)
+    {
+      ic->ic_pmksa_stats.ps_misses++;
+      return NULL;
+    }
+
+  ic->ic_pmksa_stats.ps_hits++;
+  dq_rem(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+  dq_addlast(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+  return pmk;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmksa_match
+ *
+ * Description:
+ *   Look for the cached PMK of a (re)associating station among the PMKIDs
+ *   of its RSN element.  There is one entry per (peer, AKMP), so one hash
+ *   lookup serves the whole list.  On a hit the PMK is installed in the
+ *   node so that the 4-way handshake starts without 802.1X authentication.
+ *
+ ****************************************************************************/
+
+FAR struct ieee80211_pmk *ieee80211_pmksa_match(FAR struct ieee80211_s *ic,
+                                                FAR struct ieee80211_node *ni,
+                                                FAR const uint8_t *pmkids,
+                                                int npmkids)
+{
+  FAR struct ieee80211_pmk *pmk;
+
+  if (npmkids == 0)
+    {
+      return NULL;
+    }
+
+  pmk = ieee80211_pmksa_lookup(ic, ni->ni_rsnakms, ni->ni_macaddr, NULL);
+  for (; pmk != NULL && npmkids > 0; npmkids--)
+    {
+      if (memcmp(pmk->pmk_pmkid, pmkids, IEEE80211_PMKID_LEN) == 0)
+        {
+          break;
+        }
+
+      pmkids += IEEE80211_PMKID_LEN;
+    }
+
+  if (pmk == NULL || npmkids == 0)
+    {
+      ic->ic_pmksa_stats.ps_misses++;
+      return NULL;
+    }
+
+  ic->ic_pmksa_stats.ps_hits++;
+  ic->ic_pmksa_stats.ps_fastassoc++;
+  dq_rem(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+  dq_addlast(&pmk->pmk_lru, &ic->ic_pmksa_lru);
+
+  memcpy(ni->ni_rsn->rn_pmk, pmk->pmk_key, IEEE80211_PMK_LEN);
+  memcpy(ni->ni_rsn->rn_pmkid, pmk->pmk_pmkid, IEEE80211_PMKID_LEN);
+  ni->ni_flags |= IEEE80211_NODE_PMK;
+  return pmk;
+}
@@ -24,6 +24,8 @@
  * Included Files
  ****************************************************************************/
 
+#include "ieee80211/ieee80211_hash.h"
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -72,6 +74,36 @@ struct ieee80211_rsnparams
     const uint8_t *rsn_pmkids;
   };
 
+/* Slots of the information element index built by ieee80211_index_ies() */
+
+enum ieee80211_ie_index
+  {
+    IEEE80211_IE_SSID = 0,
+    IEEE80211_IE_RATES,
+    IEEE80211_IE_DSPARMS,     /* only if at least 1 byte long */
+    IEEE80211_IE_TIM,
+    IEEE80211_IE_XRATES,
+    IEEE80211_IE_ERP,         /* only if at least 1 byte long */
+    IEEE80211_IE_RSN,
+    IEEE80211_IE_QOS_CAP,
+    IEEE80211_IE_EDCAPARMS,
+    IEEE80211_IE_HTCAPS,
+    IEEE80211_IE_HTOP,
+    IEEE80211_IE_WPA,         /* Microsoft OUI, type 1 */
+    IEEE80211_IE_WMM,         /* Microsoft OUI, type 2, subtype 1 */
+    IEEE80211_IE_MAX
+  };
+
+/* Each slot points at the element header (ID, length) inside the frame or is
+ * NULL if the element is absent.  If an element appears more than once, the
+ * last occurrence wins.
+ */
+
+struct ieee80211_ies
+  {
+    const uint8_t *ie[IEEE80211_IE_MAX];
+  };
+
 /* unaligned big endian access */
 
 #define BE_READ_2(p)                \
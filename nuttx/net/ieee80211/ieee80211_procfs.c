@@ -0,0 +1,1069 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_procfs.c
+ * Per-station and per-interface 802.11 statistics under /proc/net
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/kmalloc.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/fs/dirent.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_var.h"
+
+#if defined(CONFIG_FS_PROCFS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_NET80211)
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Space reserved for the text of one station and for the interface
+ * statistics.  Output that does not fit is truncated.
+ */
+
+#define IEEE80211_PROCFS_STALEN   1024
+#define IEEE80211_PROCFS_STATSLEN 1536
+
+/* Directory levels below /proc: "net", "net/<ifname>" and
+ * "net/<ifname>/<file>"
+ */
+
+#define IEEE80211_PROCFS_NET      1
+#define IEEE80211_PROCFS_IF       2
+#define IEEE80211_PROCFS_FILE     3
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* The files in each interface directory */
+
+enum ieee80211_procfs_file_e
+  {
+    IEEE80211_PROCFS_STATIONS = 0,    /* net/<ifname>/stations */
+    IEEE80211_PROCFS_STATS,           /* net/<ifname>/stats */
+    IEEE80211_PROCFS_NFILES
+  };
+
+/* This structure describes one open "file".  The text is formatted once
+ * when the file is opened so that a reader sees a consistent snapshot and
+ * the counters themselves are never formatted by the network code.
+ */
+
+struct ieee80211_procfs_file_s
+{
+  struct procfs_file_s base;        /* Base open file structure */
+  size_t buflen;                    /* Bytes of text in buffer[] */
+  size_t bufsize;                   /* Allocated size of buffer[] */
+  char buffer[1];                   /* Formatted text, bufsize bytes */
+};
+
+/* An open "net" or "net/<ifname>" directory */
+
+struct ieee80211_procfs_dir_s
+{
+  struct procfs_dir_priv_s base;    /* Base directory private data */
+  char ifname[IFNAMSIZ];            /* Interface of a level 2 directory */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+/* File system methods */
+
+static int     ieee80211_procfs_open(FAR struct file *filep,
+                 FAR const char *relpath, int oflags, mode_t mode);
+static int     ieee80211_procfs_close(FAR struct file *filep);
+static ssize_t ieee80211_procfs_read(FAR struct file *filep,
+                 FAR char *buffer, size_t buflen);
+
+static int     ieee80211_procfs_dup(FAR const struct file *oldp,
+                 FAR struct file *newp);
+
+static int     ieee80211_procfs_opendir(FAR const char *relpath,
+                 FAR struct fs_dirent_s *dir);
+static int     ieee80211_procfs_closedir(FAR struct fs_dirent_s *dir);
+static int     ieee80211_procfs_readdir(FAR struct fs_dirent_s *dir);
+static int     ieee80211_procfs_rewinddir(FAR struct fs_dirent_s *dir);
+
+static int     ieee80211_procfs_stat(FAR const char *relpath,
+                 FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+
+static const char * const g_ieee80211_procfs_files[IEEE80211_PROCFS_NFILES] =
+{
+  "stations",                       /* IEEE80211_PROCFS_STATIONS */
+  "stats"                           /* IEEE80211_PROCFS_STATS */
+};
+
+static const char * const g_ieee80211_procfs_acname[EDCA_NUM_AC] =
+{
+  "BE", "BK", "VI", "VO"
+};
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See include/nuttx/fs/procfs.h
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations ieee80211_procfsoperations =
+{
+  ieee80211_procfs_open,        /* open */
+  ieee80211_procfs_close,       /* close */
+  ieee80211_procfs_read,        /* read */
+  NULL,                         /* write */
+
+  ieee80211_procfs_dup,         /* dup */
+
+  ieee80211_procfs_opendir,     /* opendir */
+  ieee80211_procfs_closedir,    /* closedir */
+  ieee80211_procfs_readdir,     /* readdir */
+  ieee80211_procfs_rewinddir,   /* rewinddir */
+
+  ieee80211_procfs_stat         /* stat */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_procfs_parse
+ *
+ * Description:
+ *   Decompose a path of the form "net[/<ifname>[/<file>]]".  The interface
+ *   name is returned in ifname (which must hold IFNAMSIZ bytes) and the
+ *   file in *file.
+ *
+ * Returned Value:
+ *   The directory level of the path (IEEE80211_PROCFS_NET, _IF or _FILE)
+ *   or -ENOENT if the path does not name an existing 802.11 interface or
+ *   one of its files.
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_parse(FAR const char *relpath, FAR char *ifname,
+                                  FAR int *file)
+{
+  FAR struct ieee80211_s *ic;
+  FAR const char *name;
+  size_t len;
+  uip_lock_t lock;
+  int i;
+
+  if (strncmp(relpath, "net", 3) != 0)
+    {
+      return -ENOENT;
+    }
+
+  relpath += 3;
+  if (*relpath == '/')
+    {
+      relpath++;
+    }
+  else if (*relpath != '\0')
+    {
+      return -ENOENT;
+    }
+
+  if (*relpath == '\0')
+    {
+      return IEEE80211_PROCFS_NET;
+    }
+
+  /* Look up the interface */
+
+  name = relpath;
+  len  = strcspn(name, "/");
+  if (len >= IFNAMSIZ)
+    {
+      return -ENOENT;
+    }
+
+  memcpy(ifname, name, len);
+  ifname[len] = '\0';
+
+  lock = uip_lock();
+  ic   = ieee80211_find_ifname(ifname);
+  uip_unlock(lock);
+
+  if (ic == NULL)
+    {
+      return -ENOENT;
+    }
+
+  relpath += len;
+  if (*relpath == '/')
+    {
+      relpath++;
+    }
+
+  if (*relpath == '\0')
+    {
+      return IEEE80211_PROCFS_IF;
+    }
+
+  /* And the file within the interface directory */
+
+  for (i = 0; i < IEEE80211_PROCFS_NFILES; i++)
+    {
+      if (strcmp(relpath, g_ieee80211_procfs_files[i]) == 0)
+        {
+          *file = i;
+          return IEEE80211_PROCFS_FILE;
+        }
+    }
+
+  return -ENOENT;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_printf
+ *
+ * Description:
+ *   Append formatted text to an open file, truncating silently when the
+ *   buffer is full.
+ *
+ ****************************************************************************/
+
+static void ieee80211_procfs_printf(FAR struct ieee80211_procfs_file_s *priv,
+                                    FAR const char *fmt, ...)
+{
+  va_list ap;
+  size_t remaining;
+  int n;
+
+  remaining = priv->bufsize - priv->buflen;
+  if (remaining <= 1)
+    {
+      return;
+    }
+
+  va_start(ap, fmt);
+  n = vsnprintf(&priv->buffer[priv->buflen], remaining, fmt, ap);
+  va_end(ap);
+
+  if (n > 0)
+    {
+      priv->buflen += (size_t)n < remaining ? (size_t)n : remaining - 1;
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_qlen
+ *
+ * Description:
+ *   Return the number of I/O buffer chains in a queue.
+ *
+ ****************************************************************************/
+
+static unsigned int ieee80211_procfs_qlen(FAR struct iob_queue_s *q)
+{
+  FAR struct iob_qentry_s *qentry;
+  unsigned int n = 0;
+
+  for (qentry = q->qh_head; qentry != NULL; qentry = qentry->qe_flink)
+    {
+      n++;
+    }
+
+  return n;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_txq
+ *
+ * Description:
+ *   Format the counters of one transmit queue.
+ *
+ ****************************************************************************/
+
+static void ieee80211_procfs_txq(FAR struct ieee80211_procfs_file_s *priv,
+                                 FAR const char *prefix,
+                                 FAR const char *name,
+                                 FAR const struct ieee80211_txq_s *txq)
+{
+  ieee80211_procfs_printf(priv,
+                          "%s%s:  len %u hiwat %u enqueued %lu "
+                          "dequeued %lu drops %lu\n",
+                          prefix, name, txq->txq_len, txq->txq_hiwat,
+                          (unsigned long)txq->txq_enqueued,
+                          (unsigned long)txq->txq_dequeued,
+                          (unsigned long)txq->txq_drops);
+}
+
+#ifdef CONFIG_IEEE80211_HT
+/****************************************************************************
+ * Name: ieee80211_procfs_bastate
+ ****************************************************************************/
+
+static FAR const char *ieee80211_procfs_bastate(int state)
+{
+  switch (state)
+    {
+    case IEEE80211_BA_REQUESTED:
+      return "requested";
+
+    case IEEE80211_BA_AGREED:
+      return "agreed";
+
+    default:
+      return "-";
+    }
+}
+#endif
+
+/****************************************************************************
+ * Name: ieee80211_procfs_station
+ *
+ * Description:
+ *   Format the statistics of one node.  Called with the network locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_procfs_station(FAR struct ieee80211_procfs_file_s *priv,
+                                     FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_nodestats *ns = &ni->ni_stats;
+  FAR struct ieee80211_tidstats *ts;
+  unsigned int rate = 0;
+  int tid;
+
+  if (ni->ni_txrate >= 0 && ni->ni_txrate < ni->ni_rates.rs_nrates)
+    {
+      rate = ni->ni_rates.rs_rates[ni->ni_txrate] & IEEE80211_RATE_VAL;
+    }
+
+  ieee80211_procfs_printf(priv,
+                          "%-12s%02x:%02x:%02x:%02x:%02x:%02x\n", "Station:",
+                          ni->ni_macaddr[0], ni->ni_macaddr[1],
+                          ni->ni_macaddr[2], ni->ni_macaddr[3],
+                          ni->ni_macaddr[4], ni->ni_macaddr[5]);
+  ieee80211_procfs_printf(priv, "%-12s%u\n", "AID:",
+                          IEEE80211_AID(ni->ni_associd));
+  ieee80211_procfs_printf(priv, "%-12s%u (avg %u.%u)\n", "RSSI:",
+                          ni->ni_rssi, ns->ns_rssiavg >> 4,
+                          ((ns->ns_rssiavg & 15) * 10) >> 4);
+  ieee80211_procfs_printf(priv, "%-12s%u.%u Mb/s\n", "TxRate:",
+                          rate >> 1, (rate & 1) * 5);
+  ieee80211_procfs_printf(priv, "%-12s%lu\n", "TxAttempts:",
+                          (unsigned long)ns->ns_txattempts);
+  ieee80211_procfs_printf(priv, "%-12s%lu\n", "TxRetries:",
+                          (unsigned long)ns->ns_txretries);
+  ieee80211_procfs_printf(priv, "%-12s%lu\n", "TxFailed:",
+                          (unsigned long)ns->ns_txfailed);
+  ieee80211_procfs_printf(priv, "%-12s%lu\n", "DecryptErr:",
+                          (unsigned long)ns->ns_decrypterrs);
+  ieee80211_procfs_printf(priv, "%-12s%lu\n", "Replays:",
+                          (unsigned long)ns->ns_replays);
+  ieee80211_procfs_printf(priv, "%-12s%u\n", "PSQueue:",
+                          ieee80211_procfs_qlen(&ni->ni_savedq));
+
+  /* One line for each TID that has carried traffic or has a Block Ack
+   * agreement.
+   */
+
+#ifdef CONFIG_IEEE80211_HT
+  ieee80211_procfs_printf(priv, "%-4s%10s %10s %10s %10s  %-16s%-16s\n",
+                          "TID", "TxFrames", "TxBytes", "RxFrames",
+                          "RxBytes", "BA-TX", "BA-RX");
+#else
+  ieee80211_procfs_printf(priv, "%-4s%10s %10s %10s %10s\n",
+                          "TID", "TxFrames", "TxBytes", "RxFrames",
+                          "RxBytes");
+#endif
+
+  for (tid = 0; tid < IEEE80211_STATS_NTID; tid++)
+    {
+#ifdef CONFIG_IEEE80211_HT
+      FAR struct ieee80211_tx_ba *txba = NULL;
+      FAR struct ieee80211_rx_ba *rxba = NULL;
+
+      if (ni->ni_ba != NULL)
+        {
+          txba = &ni->ni_ba->nb_tx[tid];
+          rxba = &ni->ni_ba->nb_rx[tid];
+        }
+#endif
+
+      ts = &ns->ns_tid[tid];
+      if (ts->ts_txframes == 0 && ts->ts_rxframes == 0
+#ifdef CONFIG_IEEE80211_HT
+          && (txba == NULL || txba->ba_state == IEEE80211_BA_INIT)
+          && (rxba == NULL || rxba->ba_state == IEEE80211_BA_INIT)
+#endif
+         )
+        {
+          continue;
+        }
+
+      ieee80211_procfs_printf(priv, "%-4d%10lu %10lu %10lu %10lu", tid,
+                              (unsigned long)ts->ts_txframes,
+                              (unsigned long)ts->ts_txbytes,
+                              (unsigned long)ts->ts_rxframes,
+                              (unsigned long)ts->ts_rxbytes);
+
+#ifdef CONFIG_IEEE80211_HT
+      if (txba != NULL && txba->ba_state == IEEE80211_BA_AGREED)
+        {
+          ieee80211_procfs_printf(priv, "  %4u/%-11u", txba->ba_winstart,
+                                  txba->ba_winsize);
+        }
+      else
+        {
+          ieee80211_procfs_printf(priv, "  %-16s",
+                                  ieee80211_procfs_bastate(txba != NULL ?
+                                    txba->ba_state : IEEE80211_BA_INIT));
+        }
+
+      if (rxba != NULL && rxba->ba_state == IEEE80211_BA_AGREED)
+        {
+          ieee80211_procfs_printf(priv, "%4u/%u", rxba->ba_winstart,
+                                  rxba->ba_winsize);
+        }
+      else
+        {
+          ieee80211_procfs_printf(priv, "%s",
+                                  ieee80211_procfs_bastate(rxba != NULL ?
+                                    rxba->ba_state : IEEE80211_BA_INIT));
+        }
+#endif
+
+      ieee80211_procfs_printf(priv, "\n");
+    }
+
+  ieee80211_procfs_printf(priv, "\n");
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_stations
+ *
+ * Description:
+ *   Format net/<ifname>/stations: the BSS we are associated with in
+ *   station mode, the associated stations of an access point, or the peers
+ *   of an IBSS.  Called with the network locked.
+ *
+ ****************************************************************************/
+
+static void
+ieee80211_procfs_stations(FAR struct ieee80211_procfs_file_s *priv,
+                          FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_node *ni;
+
+  if (ic->ic_opmode == IEEE80211_M_STA)
+    {
+      if (ic->ic_state == IEEE80211_S_RUN && ic->ic_bss != NULL)
+        {
+          ieee80211_procfs_station(priv, ic->ic_bss);
+        }
+
+      return;
+    }
+
+  RB_FOREACH(ni, ieee80211_tree, &ic->ic_tree)
+    {
+      if (ni == ic->ic_bss)
+        {
+          continue;
+        }
+
+#ifdef CONFIG_IEEE80211_AP
+      if (ic->ic_opmode == IEEE80211_M_HOSTAP && ni->ni_associd == 0)
+        {
+          continue;
+        }
+#endif
+
+      ieee80211_procfs_station(priv, ni);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_stats
+ *
+ * Description:
+ *   Format net/<ifname>/stats.  Called with the network locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_procfs_stats(FAR struct ieee80211_procfs_file_s *priv,
+                                   FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_scan_stats *ss = &ic->ic_scan_stats;
+  int ac;
+
+  ieee80211_procfs_printf(priv, "%-12s%s\n", "State:",
+                          ieee80211_state_name[ic->ic_state]);
+  ieee80211_procfs_printf(priv, "%-12s%d\n", "Nodes:", ic->ic_nnodes);
+
+  /* Transmit queues */
+
+  ieee80211_procfs_printf(priv, "%-12s%lu\n", "TxClassify:",
+                          (unsigned long)ic->ic_txclassified);
+
+  for (ac = 0; ac < EDCA_NUM_AC; ac++)
+    {
+      ieee80211_procfs_txq(priv, "TxQueue", g_ieee80211_procfs_acname[ac],
+                           &ic->ic_txq[ac]);
+    }
+
+  ieee80211_procfs_txq(priv, "MgmtQueue", "", &ic->ic_mgtq);
+  ieee80211_procfs_txq(priv, "PSQueue", "", &ic->ic_pwrsaveq);
+
+  /* Receive side drops */
+
+  ieee80211_procfs_printf(priv,
+                          "%-12smsdus %lu evictions %lu timeouts %lu "
+                          "dropped %lu\n", "Defrag:",
+                          (unsigned long)ic->ic_defrag_stats.ds_msdus,
+                          (unsigned long)ic->ic_defrag_stats.ds_evictions,
+                          (unsigned long)ic->ic_defrag_stats.ds_timeouts,
+                          (unsigned long)ic->ic_defrag_stats.ds_dropped);
+#ifdef CONFIG_IEEE80211_HT
+  ieee80211_procfs_printf(priv, "%-12sstale %lu dups %lu\n", "Reorder:",
+                          (unsigned long)ic->ic_reorder_stats.rs_stale,
+                          (unsigned long)ic->ic_reorder_stats.rs_dups);
+#endif
+
+  ieee80211_procfs_printf(priv,
+                          "%-12sencrypted %lu decrypted %lu inplace %lu "
+                          "iobs %lu nobufs %lu replays %lu\n", "Crypto:",
+                          (unsigned long)ic->ic_crypto_stats.cs_encrypted,
+                          (unsigned long)ic->ic_crypto_stats.cs_decrypted,
+                          (unsigned long)ic->ic_crypto_stats.cs_inplace,
+                          (unsigned long)ic->ic_crypto_stats.cs_iobs,
+                          (unsigned long)ic->ic_crypto_stats.cs_nobufs,
+                          (unsigned long)ic->ic_crypto_stats.cs_replays);
+  ieee80211_procfs_printf(priv,
+                          "%-12shits %lu misses %lu fastassoc %lu "
+                          "evictions %lu expired %lu\n", "PMKSA:",
+                          (unsigned long)ic->ic_pmksa_stats.ps_hits,
+                          (unsigned long)ic->ic_pmksa_stats.ps_misses,
+                          (unsigned long)ic->ic_pmksa_stats.ps_fastassoc,
+                          (unsigned long)ic->ic_pmksa_stats.ps_evictions,
+                          (unsigned long)ic->ic_pmksa_stats.ps_expired);
+#ifdef CONFIG_IEEE80211_PBKDF2
+  ieee80211_procfs_printf(priv, "%-12sderived %lu cachehits %lu%s\n",
+                          "PSK:",
+                          (unsigned long)ic->ic_pskreq.pr_derived,
+                          (unsigned long)ic->ic_pskreq.pr_cachehits,
+                          ic->ic_pskreq.pr_busy ? " (deriving)" : "");
+#endif
+#ifdef CONFIG_IEEE80211_AP
+  ieee80211_procfs_printf(priv,
+                          "%-12sstarted %lu completed %lu stations %lu "
+                          "last %lu ms max %lu ms%s\n", "Rekey:",
+                          (unsigned long)ic->ic_rekey.rk_stats.rk_started,
+                          (unsigned long)ic->ic_rekey.rk_stats.rk_completed,
+                          (unsigned long)ic->ic_rekey.rk_stats.rk_stations,
+                          (unsigned long)ic->ic_rekey.rk_stats.rk_lastms,
+                          (unsigned long)ic->ic_rekey.rk_stats.rk_maxms,
+                          ic->ic_rekey.rk_active ? " (in progress)" : "");
+#endif
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+  {
+    FAR const struct ieee80211_hs_stats *hs = &ic->ic_authsched.as_stats;
+
+    ieee80211_procfs_printf(priv,
+                            "%-12sstarted %lu completed %lu failed %lu "
+                            "deferred %lu active %u peak %lu micfail %lu\n",
+                            "4-Way:",
+                            (unsigned long)hs->hs_started,
+                            (unsigned long)hs->hs_completed,
+                            (unsigned long)hs->hs_failed,
+                            (unsigned long)hs->hs_deferred,
+                            ic->ic_authsched.as_active,
+                            (unsigned long)hs->hs_peak,
+                            (unsigned long)hs->hs_micfail);
+    ieee80211_procfs_printf(priv,
+                            "%-12savg %lu max %lu last %lu ms\n",
+                            "4-Way time:",
+                            hs->hs_completed == 0 ? 0ul :
+                            (unsigned long)(hs->hs_totalms /
+                                            hs->hs_completed),
+                            (unsigned long)hs->hs_maxms,
+                            (unsigned long)hs->hs_lastms);
+  }
+#endif
+
+  /* Aggregation */
+
+#ifdef CONFIG_IEEE80211_HT
+  ieee80211_procfs_printf(priv,
+                          "%-12saggregates %lu subframes %lu acked %lu "
+                          "retries %lu drops %lu bars %lu\n", "A-MPDU:",
+                          (unsigned long)ic->ic_ampdu_stats.am_aggregates,
+                          (unsigned long)ic->ic_ampdu_stats.am_subframes,
+                          (unsigned long)ic->ic_ampdu_stats.am_acked,
+                          (unsigned long)ic->ic_ampdu_stats.am_retries,
+                          (unsigned long)ic->ic_ampdu_stats.am_drops,
+                          (unsigned long)ic->ic_ampdu_stats.am_bars);
+#endif
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+  ieee80211_procfs_printf(priv,
+                          "%-12samsdus %lu msdus %lu single %lu "
+                          "timeouts %lu nobufs %lu\n", "A-MSDU:",
+                          (unsigned long)ic->ic_amsdu_stats.as_amsdus,
+                          (unsigned long)ic->ic_amsdu_stats.as_msdus,
+                          (unsigned long)ic->ic_amsdu_stats.as_single,
+                          (unsigned long)ic->ic_amsdu_stats.as_timeouts,
+                          (unsigned long)ic->ic_amsdu_stats.as_nobufs);
+#endif
+
+  /* Scanning.  Times are in milliseconds. */
+
+  ieee80211_procfs_printf(priv,
+                          "%-12sscans %lu passes %lu last %lu max %lu "
+                          "total %lu\n", "Scan:",
+                          (unsigned long)ss->ss_scans,
+                          (unsigned long)ss->ss_passes,
+                          (unsigned long)ss->ss_last,
+                          (unsigned long)ss->ss_max,
+                          (unsigned long)ss->ss_total);
+#ifdef CONFIG_IEEE80211_BGSCAN
+  ieee80211_procfs_printf(priv, "%-12sscans %lu slices %lu roams %lu\n",
+                          "BgScan:",
+                          (unsigned long)ss->ss_bgscans,
+                          (unsigned long)ss->ss_slices,
+                          (unsigned long)ss->ss_roams);
+#endif
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_open
+ ****************************************************************************/
+
+static int ieee80211_procfs_open(FAR struct file *filep,
+                                 FAR const char *relpath, int oflags,
+                                 mode_t mode)
+{
+  FAR struct ieee80211_procfs_file_s *priv;
+  FAR struct ieee80211_s *ic;
+  char ifname[IFNAMSIZ];
+  size_t bufsize;
+  uip_lock_t lock;
+  int file;
+  int ret;
+
+  fvdbg("Open '%s'\n", relpath);
+
+  /* PROCFS is read-only.  Any attempt to open with any kind of write
+   * access is not permitted.
+   */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      fdbg("ERROR: Only O_RDONLY supported\n");
+      return -EACCES;
+    }
+
+  ret = ieee80211_procfs_parse(relpath, ifname, &file);
+  if (ret < 0)
+    {
+      return ret;
+    }
+  else if (ret != IEEE80211_PROCFS_FILE)
+    {
+      return -EISDIR;
+    }
+
+  /* Size the buffer.  The node count may change before the text is
+   * formatted; the output is truncated rather than overrun if it grows.
+   */
+
+  bufsize = IEEE80211_PROCFS_STATSLEN;
+  if (file == IEEE80211_PROCFS_STATIONS)
+    {
+      lock = uip_lock();
+      ic   = ieee80211_find_ifname(ifname);
+      bufsize = ic != NULL ?
+                (ic->ic_nnodes + 1) * IEEE80211_PROCFS_STALEN : 1;
+      uip_unlock(lock);
+    }
+
+  priv = (FAR struct ieee80211_procfs_file_s *)
+    kmalloc(sizeof(struct ieee80211_procfs_file_s) + bufsize);
+
+  if (!priv)
+    {
+      fdbg("ERROR: Failed to allocate file attributes\n");
+      return -ENOMEM;
+    }
+
+  memset(&priv->base, 0, sizeof(struct procfs_file_s));
+  priv->buflen  = 0;
+  priv->bufsize = bufsize;
+
+  /* Take the snapshot */
+
+  lock = uip_lock();
+  ic   = ieee80211_find_ifname(ifname);
+  if (ic != NULL)
+    {
+      if (file == IEEE80211_PROCFS_STATIONS)
+        {
+          ieee80211_procfs_stations(priv, ic);
+        }
+      else
+        {
+          ieee80211_procfs_stats(priv, ic);
+        }
+    }
+
+  uip_unlock(lock);
+
+  if (ic == NULL)
+    {
+      kfree(priv);
+      return -ENOENT;
+    }
+
+  filep->f_priv = (FAR void *)priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_close
+ ****************************************************************************/
+
+static int ieee80211_procfs_close(FAR struct file *filep)
+{
+  FAR struct ieee80211_procfs_file_s *priv;
+
+  /* Recover our private data from the struct file instance */
+
+  priv = (FAR struct ieee80211_procfs_file_s *)filep->f_priv;
+  DEBUGASSERT(priv);
+
+  kfree(priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_read
+ ****************************************************************************/
+
+static ssize_t ieee80211_procfs_read(FAR struct file *filep,
+                                     FAR char *buffer, size_t buflen)
+{
+  FAR struct ieee80211_procfs_file_s *priv;
+  off_t offset;
+  ssize_t ret;
+
+  fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+  /* Recover our private data from the struct file instance */
+
+  priv = (FAR struct ieee80211_procfs_file_s *)filep->f_priv;
+  DEBUGASSERT(priv);
+
+  offset = filep->f_pos;
+  ret    = procfs_memcpy(priv->buffer, priv->buflen, buffer, buflen,
+                         &offset);
+
+  /* Update the file offset */
+
+  if (ret > 0)
+    {
+      filep->f_pos += ret;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_dup(FAR const struct file *oldp,
+                                FAR struct file *newp)
+{
+  FAR struct ieee80211_procfs_file_s *oldpriv;
+  FAR struct ieee80211_procfs_file_s *newpriv;
+  size_t size;
+
+  fvdbg("Dup %p->%p\n", oldp, newp);
+
+  /* Recover our private data from the old struct file instance */
+
+  oldpriv = (FAR struct ieee80211_procfs_file_s *)oldp->f_priv;
+  DEBUGASSERT(oldpriv);
+
+  /* Allocate a new container, snapshot included */
+
+  size    = sizeof(struct ieee80211_procfs_file_s) + oldpriv->bufsize;
+  newpriv = (FAR struct ieee80211_procfs_file_s *)kmalloc(size);
+  if (!newpriv)
+    {
+      fdbg("ERROR: Failed to allocate file attributes\n");
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldpriv, size);
+
+  /* Save the new attributes in the new file structure */
+
+  newp->f_priv = (FAR void *)newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_opendir
+ *
+ * Description:
+ *   Open a directory for read access
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_opendir(FAR const char *relpath,
+                                    FAR struct fs_dirent_s *dir)
+{
+  FAR struct ieee80211_procfs_dir_s *priv;
+  char ifname[IFNAMSIZ];
+  int file;
+  int ret;
+
+  fvdbg("relpath: \"%s\"\n", relpath ? relpath : "NULL");
+  DEBUGASSERT(relpath && dir && !dir->u.procfs);
+
+  ret = ieee80211_procfs_parse(relpath, ifname, &file);
+  if (ret < 0)
+    {
+      return ret;
+    }
+  else if (ret == IEEE80211_PROCFS_FILE)
+    {
+      return -ENOTDIR;
+    }
+
+  priv = (FAR struct ieee80211_procfs_dir_s *)
+    kzalloc(sizeof(struct ieee80211_procfs_dir_s));
+
+  if (!priv)
+    {
+      fdbg("ERROR: Failed to allocate the directory structure\n");
+      return -ENOMEM;
+    }
+
+  /* The interfaces are counted as they are read since they may come and
+   * go while the directory is open.
+   */
+
+  priv->base.level    = ret;
+  priv->base.index    = 0;
+  priv->base.nentries = ret == IEEE80211_PROCFS_IF ?
+                        IEEE80211_PROCFS_NFILES : 0;
+
+  if (ret == IEEE80211_PROCFS_IF)
+    {
+      strncpy(priv->ifname, ifname, IFNAMSIZ);
+    }
+
+  dir->u.procfs = (FAR void *)priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_closedir
+ *
+ * Description: Close the directory listing
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_closedir(FAR struct fs_dirent_s *dir)
+{
+  FAR struct ieee80211_procfs_dir_s *priv;
+
+  DEBUGASSERT(dir && dir->u.procfs);
+  priv = dir->u.procfs;
+
+  if (priv)
+    {
+      kfree(priv);
+    }
+
+  dir->u.procfs = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_readdir
+ *
+ * Description: Read the next directory entry
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_readdir(FAR struct fs_dirent_s *dir)
+{
+  FAR struct ieee80211_procfs_dir_s *priv;
+  FAR struct ieee80211_s *ic;
+  FAR dq_entry_t *entry;
+  uip_lock_t lock;
+  int index;
+
+  DEBUGASSERT(dir && dir->u.procfs);
+  priv  = dir->u.procfs;
+  index = priv->base.index;
+
+  if (priv->base.level == IEEE80211_PROCFS_IF)
+    {
+      /* The files of one interface */
+
+      if (index >= priv->base.nentries)
+        {
+          fvdbg("Entry %d: End of directory\n", index);
+          return -ENOENT;
+        }
+
+      dir->fd_dir.d_type = DTYPE_FILE;
+      strncpy(dir->fd_dir.d_name, g_ieee80211_procfs_files[index],
+              NAME_MAX + 1);
+    }
+  else
+    {
+      /* One subdirectory per 802.11 interface */
+
+      lock = uip_lock();
+      for (entry = ieee80211_s_head.head; entry != NULL && index > 0;
+           entry = entry->flink)
+        {
+          index--;
+        }
+
+      if (entry == NULL)
+        {
+          uip_unlock(lock);
+          fvdbg("Entry %d: End of directory\n", priv->base.index);
+          return -ENOENT;
+        }
+
+      ic = (FAR struct ieee80211_s *)entry;
+      dir->fd_dir.d_type = DTYPE_DIRECTORY;
+      strncpy(dir->fd_dir.d_name, ic->ic_ifname, NAME_MAX + 1);
+      uip_unlock(lock);
+    }
+
+  priv->base.index++;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_rewinddir
+ *
+ * Description: Reset directory read to the first entry
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_rewinddir(FAR struct fs_dirent_s *dir)
+{
+  FAR struct ieee80211_procfs_dir_s *priv;
+
+  DEBUGASSERT(dir && dir->u.procfs);
+  priv = dir->u.procfs;
+
+  priv->base.index = 0;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_procfs_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int ieee80211_procfs_stat(FAR const char *relpath,
+                                 FAR struct stat *buf)
+{
+  char ifname[IFNAMSIZ];
+  int file;
+  int ret;
+
+  ret = ieee80211_procfs_parse(relpath, ifname, &file);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  if (ret == IEEE80211_PROCFS_FILE)
+    {
+      buf->st_mode = S_IFREG|S_IROTH|S_IRGRP|S_IRUSR;
+    }
+  else
+    {
+      buf->st_mode = S_IFDIR|S_IROTH|S_IRGRP|S_IRUSR;
+    }
+
+  /* File/directory size, access block size */
+
+  buf->st_size    = 0;
+  buf->st_blksize = 0;
+  buf->st_blocks  = 0;
+
+  return OK;
+}
+
+#endif /* CONFIG_FS_PROCFS && !CONFIG_FS_PROCFS_EXCLUDE_NET80211 */
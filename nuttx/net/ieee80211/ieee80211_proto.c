@@ -57,8 +57,10 @@
 #include <nuttx/net/iob.h>
 
 #include "ieee80211/ieee80211_debug.h"
+#include "ieee80211/ieee80211_ifnet.h"
 #include "ieee80211/ieee80211_var.h"
 #include "ieee80211/ieee80211_priv.h"
+#include "ieee80211/ieee80211_ratectl.h"
 
 const char *const ieee80211_mgt_subtype_name[] = {
   "assoc_req", "assoc_resp", "reassoc_req", "reassoc_resp",
@@ -108,8 +110,23 @@ void ieee80211_proto_attach(struct ieee80211_s *ic)
 
 void ieee80211_proto_detach(struct ieee80211_s *ic)
 {
-  iob_free_queue(&ic->ic_mgtq);
-  iob_free_queue(&ic->ic_pwrsaveq);
+  ieee80211_ifflush(ic);
+  ieee80211_defrag_purge(ic, NULL);
+
+#ifdef CONFIG_IEEE80211_AP
+  if (ic->ic_prresp != NULL)
+    {
+      kfree(ic->ic_prresp);
+      ic->ic_prresp = NULL;
+    }
+
+  if (ic->ic_bcn != NULL)
+    {
+      kfree(ic->ic_bcn);
+      ic->ic_bcn = NULL;
+      ic->ic_bcn_size = 0;
+    }
+#endif
 }
 
 #if defined(CONFIG_DEBUG_NET) && defined(CONFIG_DEBUG_VERBOSE)
@@ -349,6 +366,7 @@ void ieee80211_reset_erp(struct ieee80211_s *ic)
 {
   ic->ic_flags &= ~IEEE80211_F_USEPROT;
   ic->ic_nonerpsta = 0;
+  IEEE80211_MGMT_CHANGED(ic);
   ic->ic_longslotsta = 0;
 
   /* Enable short slot time iff:
@@ -419,13 +437,13 @@ int ieee80211_keyrun(struct ieee80211_s *ic, uint8_t * macaddr)
 
   /* check that the STA is in the correct state */
 
-  if (ni->ni_state != IEEE80211_STA_ASSOC ||
-      ni->ni_rsn_state != RSNA_AUTHENTICATION_2)
+  if (ni->ni_state != IEEE80211_STA_ASSOC || ni->ni_rsn == NULL ||
+      ni->ni_rsn->rn_state != RSNA_AUTHENTICATION_2)
     {
-      ndbg("ERROR: unexpected in state %d\n", ni->ni_rsn_state);
+      ndbg("ERROR: unexpected in state %d\n", ni->ni_state);
       return -EINVAL;
     }
-  ni->ni_rsn_state = RSNA_INITPMK;
+  ni->ni_rsn->rn_state = RSNA_INITPMK;
 
   /* make sure a PMK is available for this STA, otherwise deauth it */
 
@@ -437,36 +455,18 @@ int ieee80211_keyrun(struct ieee80211_s *ic, uint8_t * macaddr)
       ieee80211_node_leave(ic, ni);
       return -EINVAL;
     }
-  memcpy(ni->ni_pmk, pmk->pmk_key, IEEE80211_PMK_LEN);
-  memcpy(ni->ni_pmkid, pmk->pmk_pmkid, IEEE80211_PMKID_LEN);
+  memcpy(ni->ni_rsn->rn_pmk, pmk->pmk_key, IEEE80211_PMK_LEN);
+  memcpy(ni->ni_rsn->rn_pmkid, pmk->pmk_pmkid, IEEE80211_PMKID_LEN);
   ni->ni_flags |= IEEE80211_NODE_PMK;
 
   /* initiate key exchange (4-Way Handshake) with STA */
 
-  return ieee80211_send_4way_msg1(ic, ni);
+  return ieee80211_authsched_start(ic, ni);
 #endif /* CONFIG_IEEE80211_AP */
 }
 
 #ifdef CONFIG_IEEE80211_AP
 
-/* Initiate a group key handshake with a node. */
-
-static void ieee80211_node_gtk_rekey(void *arg, struct ieee80211_node *ni)
-{
-  struct ieee80211_s *ic = arg;
-
-  if (ni->ni_state != IEEE80211_STA_ASSOC || ni->ni_rsn_gstate != RSNA_IDLE)
-    return;
-
-  /* initiate a group key handshake with STA */
-
-  ni->ni_flags |= IEEE80211_NODE_REKEY;
-  if (ieee80211_send_group_msg1(ic, ni) != 0)
-    ni->ni_flags &= ~IEEE80211_NODE_REKEY;
-  else
-    ic->ic_rsn_keydonesta++;
-}
-
 /* This function is called in HostAP mode when the group key needs to be
  * changed.
  */
@@ -501,8 +501,9 @@ void ieee80211_setkeys(struct ieee80211_s *ic)
       arc4random_buf(k->k_key, k->k_len);
     }
 
-  ic->ic_rsn_keydonesta = 0;
-  ieee80211_iterate_nodes(ic, ieee80211_node_gtk_rekey, ic);
+  /* initiate a group key handshake with all associated STAs */
+
+  ieee80211_rekey_start(ic);
 }
 
 /* The group key handshake has been completed with all associated stations. */
@@ -550,7 +551,7 @@ void ieee80211_sa_query_timeout(void *arg)
   uip_lock_t flags;
 
   flags = uip_lock();
-  if (++ni->ni_sa_query_count >= 3)
+  if (++ni->ni_rsn->rn_sa_query_count >= 3)
     {
       ni->ni_flags &= ~IEEE80211_NODE_SA_QUERY;
       ni->ni_flags |= IEEE80211_NODE_SA_QUERY_FAILED;
@@ -569,22 +570,25 @@ ieee80211_sa_query_request(struct ieee80211_s *ic, struct ieee80211_node *ni)
 {
   /* MLME-SAQuery.request */
 
+  if (ni->ni_rsn == NULL)
+    return;
+
   if (!(ni->ni_flags & IEEE80211_NODE_SA_QUERY))
     {
       ni->ni_flags |= IEEE80211_NODE_SA_QUERY;
       ni->ni_flags &= ~IEEE80211_NODE_SA_QUERY_FAILED;
-      ni->ni_sa_query_count = 0;
+      ni->ni_rsn->rn_sa_query_count = 0;
     }
 
   /* generate new Transaction Identifier */
 
-  ni->ni_sa_query_trid++;
+  ni->ni_rsn->rn_sa_query_trid++;
 
   /* send SA Query Request */
 
   IEEE80211_SEND_ACTION(ic, ni, IEEE80211_CATEG_SA_QUERY,
                         IEEE80211_ACTION_SA_QUERY_REQ, 0);
-  wd_start(ni->ni_sa_query_to, MSEC2TICK(10), ieee80211_sa_query_timeout, ni);
+  wd_start(ni->ni_rsn->rn_sa_query_to, MSEC2TICK(10), ieee80211_sa_query_timeout, ni);
 }
 #endif /* CONFIG_IEEE80211_AP */
 
@@ -608,7 +612,7 @@ void ieee80211_tx_ba_timeout(void *arg)
     {
       /* Block Ack inactivity timeout */
 
-      tid = ((void *)ba - (void *)ni->ni_tx_ba) / sizeof(*ba);
+      tid = ((void *)ba - (void *)ni->ni_ba->nb_tx) / sizeof(*ba);
       ieee80211_delba_request(ic, ni, IEEE80211_REASON_TIMEOUT, 1, tid);
     }
 
@@ -627,7 +631,7 @@ void ieee80211_rx_ba_timeout(void *arg)
 
   /* Block Ack inactivity timeout */
 
-  tid = ((void *)ba - (void *)ni->ni_rx_ba) / sizeof(*ba);
+  tid = ((void *)ba - (void *)ni->ni_ba->nb_rx) / sizeof(*ba);
   ieee80211_delba_request(ic, ni, IEEE80211_REASON_TIMEOUT, 0, tid);
 
   uip_unlock(flags);
@@ -639,7 +643,13 @@ int
 ieee80211_addba_request(struct ieee80211_s *ic, struct ieee80211_node *ni,
                         uint16_t ssn, uint8_t tid)
 {
-  struct ieee80211_tx_ba *ba = &ni->ni_tx_ba[tid];
+  struct ieee80211_tx_ba *ba;
+
+  /* Block Ack records are only attached to peers that use them */
+
+  if (ieee80211_node_ba_attach(ni) < 0)
+    return -ENOMEM;
+  ba = &ni->ni_ba->nb_tx[tid];
 
   /* MLME-ADDBA.request */
   /* setup Block Ack */
@@ -670,11 +680,14 @@ ieee80211_delba_request(struct ieee80211_s *ic, struct ieee80211_node *ni,
 
   IEEE80211_SEND_ACTION(ic, ni, IEEE80211_CATEG_BA,
                         IEEE80211_ACTION_DELBA, reason << 16 | dir << 8 | tid);
+  if (ni->ni_ba == NULL)
+    return;
+
   if (dir)
     {
       /* MLME-DELBA.confirm(Originator) */
 
-      struct ieee80211_tx_ba *ba = &ni->ni_tx_ba[tid];
+      struct ieee80211_tx_ba *ba = &ni->ni_ba->nb_tx[tid];
 
       if (ic->ic_ampdu_tx_stop != NULL)
         ic->ic_ampdu_tx_stop(ic, ni, tid);
@@ -684,13 +697,16 @@ ieee80211_delba_request(struct ieee80211_s *ic, struct ieee80211_node *ni,
       /* stop Block Ack inactivity timer */
 
       wd_cancel(ba->ba_to);
+
+      /* Free all MPDUs waiting for aggregation or acknowledgement */
+
+      ieee80211_ampdu_stop(ic, ni, tid);
     }
   else
     {
       /* MLME-DELBA.confirm(Recipient) */
 
-      struct ieee80211_rx_ba *ba = &ni->ni_rx_ba[tid];
-      int i;
+      struct ieee80211_rx_ba *ba = &ni->ni_ba->nb_rx[tid];
 
       if (ic->ic_ampdu_rx_stop != NULL)
         ic->ic_ampdu_rx_stop(ic, ni, tid);
@@ -701,23 +717,9 @@ ieee80211_delba_request(struct ieee80211_s *ic, struct ieee80211_node *ni,
 
       wd_cancel(ba->ba_to);
 
-      if (ba->ba_buf != NULL)
-        {
-          /* Free all MSDUs stored in reordering buffer */
-
-          for (i = 0; i < IEEE80211_BA_MAX_WINSZ; i++)
-            {
-              if (ba->ba_buf[i].m != NULL)
-                {
-                  iob_free_chain(ba->ba_buf[i].m);
-                }
-            }
-
-          /* Free reordering buffer */
+      /* Free all MSDUs stored in reordering buffer and the buffer */
 
-          kfree(ba->ba_buf);
-          ba->ba_buf = NULL;
-        }
+      ieee80211_reorder_free(ba);
     }
 }
 #endif /* !CONFIG_IEEE80211_HT */
@@ -794,8 +796,8 @@ void ieee80211_auth_open(struct ieee80211_s *ic,
 
           ic->ic_bss->ni_flags &= ~IEEE80211_NODE_TXRXPROT;
           ic->ic_bss->ni_port_valid = 0;
-          ic->ic_bss->ni_replaycnt_ok = 0;
-          (*ic->ic_delete_key) (ic, ic->ic_bss, &ic->ic_bss->ni_pairwise_key);
+          ic->ic_bss->ni_rsn->rn_replaycnt_ok = 0;
+          (*ic->ic_delete_key) (ic, ic->ic_bss, &ic->ic_bss->ni_rsn->rn_pairwise_key);
         }
 
       if (status != 0)
@@ -825,6 +827,7 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
 {
   struct ieee80211_node *ni;
   enum ieee80211_state ostate;
+  uint8_t lastbss[IEEE80211_ADDR_LEN];
   unsigned int rate;
 #ifdef CONFIG_IEEE80211_AP
   uip_lock_t flags;
@@ -833,6 +836,8 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
   ostate = ic->ic_state;
   nvdbg("%s -> %s\n", ieee80211_state_name[ostate],
         ieee80211_state_name[nstate]);
+
+  IEEE80211_MGMT_CHANGED(ic);
   ic->ic_state = nstate;        /* state transition */
   ni = ic->ic_bss;              /* NB: no reference held */
   if (ostate == IEEE80211_S_RUN)
@@ -914,11 +919,13 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
         justcleanup:
 #ifdef CONFIG_IEEE80211_AP
           if (ic->ic_opmode == IEEE80211_M_HOSTAP)
-            wd_cancel(ic->ic_rsn_timeout);
+            {
+              wd_cancel(ic->ic_rsn_timeout);
+              ieee80211_rekey_cancel(ic);
+            }
 #endif
           ic->ic_mgt_timer = 0;
-          iob_free_queue(&ic->ic_mgtq);
-          iob_free_queue(&ic->ic_pwrsaveq);
+          ieee80211_ifflush(ic);
           ieee80211_free_allnodes(ic);
           break;
         }
@@ -926,8 +933,11 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
     case IEEE80211_S_SCAN:
       ic->ic_flags &= ~IEEE80211_F_SIBSS;
 
-      /* initialize bss for probe request */
+      /* initialize bss for probe request.  Remember which AP we were
+       * talking to so it can be charged with the failure below.
+       */
 
+      IEEE80211_ADDR_COPY(lastbss, ni->ni_macaddr);
       IEEE80211_ADDR_COPY(ni->ni_macaddr, etherbroadcastaddr);
       IEEE80211_ADDR_COPY(ni->ni_bssid, etherbroadcastaddr);
       ni->ni_rates = ic->ic_sup_rates[ieee80211_chan2mode(ic, ni->ni_chan)];
@@ -964,7 +974,14 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
           nvdbg("%s: no recent beacons from %s; rescanning\n",
                 ic->ic_ifname, ieee80211_addr2str(ic->ic_bss->ni_bssid));
 
-          ieee80211_free_allnodes(ic);
+          /* A station keeps its scan results:  the other AP's of the ESS
+           * are candidates to move to, and begin_scan() ages the cache.
+           */
+
+          if (ic->ic_opmode != IEEE80211_M_STA)
+            {
+              ieee80211_free_allnodes(ic);
+            }
 
           /* FALLTHROUGH */
 
@@ -972,7 +989,7 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
         case IEEE80211_S_ASSOC:
           /* timeout restart scan */
 
-          ni = ieee80211_find_node(ic, ic->ic_bss->ni_macaddr);
+          ni = ieee80211_find_node(ic, lastbss);
           if (ni != NULL)
             ni->ni_fails++;
           ieee80211_begin_scan(ic);
@@ -1046,6 +1063,11 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
 
         case IEEE80211_S_SCAN: /* adhoc/hostap mode */
         case IEEE80211_S_ASSOC:        /* infra mode */
+          if (ic->ic_opmode == IEEE80211_M_STA)
+            {
+              ieee80211_ratectl_node_init(ic, ni);
+            }
+
           DEBUGASSERT(ni->ni_txrate < ni->ni_rates.rs_nrates);
 
 #if defined(CONFIG_DEBUG_NET) && defined(CONFIG_DEBUG_VERBOSE)
@@ -1082,6 +1104,10 @@ static int ieee80211_newstate(struct ieee80211_s *ic,
         }
       break;
     }
+
+#ifdef CONFIG_IEEE80211_BGSCAN
+  ieee80211_bgscan_newstate(ic, ostate);
+#endif
   return 0;
 }
 
@@ -40,6 +40,8 @@
 
 #include <nuttx/config.h>
 
+#include <stdbool.h>
+
 #include <nuttx/net/iob.h>
 
 /****************************************************************************
@@ -82,6 +84,7 @@ struct sockaddr;
 struct ieee80211_node;
 struct ieee80211_rxinfo;
 struct ieee80211_rsnparams;
+struct ieee80211_ies;
 
 void ieee80211_set_link_state(struct ieee80211_s *ic,
                               enum ieee80211_linkstate_e linkstate);
@@ -106,6 +109,39 @@ struct iob_s *ieee80211_beacon_alloc(struct ieee80211_s *,
                                      struct ieee80211_node *);
 int ieee80211_save_ie(const uint8_t *, uint8_t **);
 void ieee80211_eapol_timeout(void *);
+#ifdef CONFIG_IEEE80211_AP
+void ieee80211_4way_msg2_verified(FAR struct ieee80211_s *,
+                                  FAR struct ieee80211_node *,
+                                  FAR const struct ieee80211_ptk *,
+                                  FAR const uint8_t *);
+#endif
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+void ieee80211_authsched_initialize(FAR struct ieee80211_s *);
+void ieee80211_authsched_uninitialize(FAR struct ieee80211_s *);
+int ieee80211_authsched_start(FAR struct ieee80211_s *,
+                              FAR struct ieee80211_node *);
+void ieee80211_authsched_done(FAR struct ieee80211_s *,
+                              FAR struct ieee80211_node *);
+void ieee80211_authsched_discard(FAR struct ieee80211_s *,
+                                 FAR struct ieee80211_node *);
+int ieee80211_authsched_msg2(FAR struct ieee80211_s *,
+                             FAR struct ieee80211_node *,
+                             FAR const struct ieee80211_eapol_key *,
+                             FAR const uint8_t *);
+void ieee80211_eapol_timer_start(FAR struct ieee80211_s *,
+                                 FAR struct ieee80211_node *, uint32_t);
+void ieee80211_eapol_timer_stop(FAR struct ieee80211_s *,
+                                FAR struct ieee80211_node *);
+#else
+#  define ieee80211_authsched_start(ic, ni) ieee80211_send_4way_msg1(ic, ni)
+#  define ieee80211_authsched_done(ic, ni)
+#  define ieee80211_authsched_discard(ic, ni)
+#  define ieee80211_eapol_timer_start(ic, ni, ticks) \
+     wd_start((ni)->ni_rsn->rn_eapol_to, (ticks), ieee80211_eapol_timeout, \
+              1, (ni))
+#  define ieee80211_eapol_timer_stop(ic, ni) \
+     wd_cancel((ni)->ni_rsn->rn_eapol_to)
+#endif
 
 int ieee80211_send_4way_msg1(struct ieee80211_s *, struct ieee80211_node *);
 int ieee80211_send_4way_msg2(struct ieee80211_s *,
@@ -121,9 +157,19 @@ int ieee80211_send_eapol_key_req(struct ieee80211_s *, struct ieee80211_node *,
                                  uint16_t, uint64_t);
 int ieee80211_pwrsave(struct ieee80211_s *, struct iob_s *,
                       struct ieee80211_node *);
+int ieee80211_send_nulldata(FAR struct ieee80211_s *ic,
+                            FAR struct ieee80211_node *ni, bool pwrsave);
+int ieee80211_send_bcast_probe(FAR struct ieee80211_s *ic);
 #define    ieee80211_new_state(_ic, _nstate, _arg) \
     (((_ic)->ic_newstate)((_ic), (_nstate), (_arg)))
+#ifdef CONFIG_IEEE80211_BGSCAN
+int ieee80211_bgscan_start(FAR struct ieee80211_s *ic);
+void ieee80211_bgscan_newstate(FAR struct ieee80211_s *ic,
+                               enum ieee80211_state ostate);
+void ieee80211_bgscan_discard(FAR struct ieee80211_s *ic);
+#endif
 enum ieee80211_edca_ac ieee80211_up_to_ac(struct ieee80211_s *, int);
+int ieee80211_classify(struct ieee80211_s *, struct iob_s *);
 uint8_t *ieee80211_add_capinfo(uint8_t *, struct ieee80211_s *,
                                const struct ieee80211_node *);
 uint8_t *ieee80211_add_ssid(uint8_t *, const uint8_t *, unsigned int);
@@ -146,6 +192,8 @@ uint8_t *ieee80211_add_htcaps(uint8_t *, struct ieee80211_s *);
 uint8_t *ieee80211_add_htop(uint8_t *, struct ieee80211_s *);
 uint8_t *ieee80211_add_tie(uint8_t *, uint8_t, uint32_t);
 
+void ieee80211_index_ies(struct ieee80211_ies *, const uint8_t *,
+                         const uint8_t *, uint32_t *);
 int ieee80211_parse_rsn(struct ieee80211_s *, const uint8_t *,
                         struct ieee80211_rsnparams *);
 int ieee80211_parse_wpa(struct ieee80211_s *, const uint8_t *,
@@ -166,10 +214,27 @@ void ieee80211_gtk_rekey_timeout(void *);
 int ieee80211_keyrun(struct ieee80211_s *, uint8_t *);
 void ieee80211_setkeys(struct ieee80211_s *);
 void ieee80211_setkeysdone(struct ieee80211_s *);
+#ifdef CONFIG_IEEE80211_AP
+void ieee80211_rekey_start(FAR struct ieee80211_s *);
+void ieee80211_rekey_done(FAR struct ieee80211_s *,
+                          FAR struct ieee80211_node *);
+void ieee80211_rekey_cancel(FAR struct ieee80211_s *);
+#endif
 void ieee80211_sa_query_timeout(void *);
 void ieee80211_sa_query_request(struct ieee80211_s *, struct ieee80211_node *);
 
 #ifdef CONFIG_IEEE80211_HT
+int ieee80211_reorder_alloc(struct ieee80211_rx_ba *);
+void ieee80211_reorder_free(struct ieee80211_rx_ba *);
+void ieee80211_input_ba(struct ieee80211_s *, struct iob_s *,
+                        struct ieee80211_node *, int,
+                        struct ieee80211_rxinfo *);
+void ieee80211_ba_move_window(struct ieee80211_s *, struct ieee80211_node *,
+                              uint8_t, uint16_t);
+int ieee80211_ampdu_start(struct ieee80211_s *, struct ieee80211_node *,
+                          uint8_t);
+void ieee80211_ampdu_stop(struct ieee80211_s *, struct ieee80211_node *,
+                          uint8_t);
 void ieee80211_tx_ba_timeout(void *);
 void ieee80211_rx_ba_timeout(void *);
 int ieee80211_addba_request(struct ieee80211_s *,
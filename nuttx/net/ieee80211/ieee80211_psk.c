@@ -0,0 +1,579 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_psk.c
+ * WPA passphrase to PSK derivation and persistent PMK cache
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <sys/ioctl.h>
+
+#include <nuttx/wqueue.h>
+#include <nuttx/net/uip/uip.h>
+
+#ifdef CONFIG_IEEE80211_PMKCACHE
+#  include <nuttx/configdata.h>
+#endif
+
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_crypto.h"
+#include "ieee80211/ieee80211_sha1.h"
+#include "ieee80211/ieee80211_pbkdf2.h"
+
+#ifdef CONFIG_IEEE80211_PBKDF2
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Derivation takes tens to hundreds of milliseconds; keep it off the high
+ * priority queue that runs the drivers.
+ */
+
+#define PSK_WORK LPWORK
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Inputs of one derivation, copied out of the interface so that the worker
+ * can run without the network locked.
+ */
+
+struct ieee80211_pskin_s
+{
+  uint16_t gen;
+  uint8_t ssidlen;
+  uint8_t passlen;
+  uint8_t ssid[IEEE80211_NWID_LEN];
+  char pass[IEEE80211_PASSPHRASE_MAXLEN];
+};
+
+#ifdef CONFIG_IEEE80211_PMKCACHE
+/* One PMK cache record.  Records are found by SSID and by a hash of the
+ * SSID and passphrase, so the passphrase itself is never written out.
+ */
+
+struct ieee80211_pmkrec_s
+{
+  uint8_t pc_ssidlen;
+  uint8_t pc_ssid[IEEE80211_NWID_LEN];
+  uint8_t pc_hash[SHA1_DIGEST_LENGTH];
+  uint8_t pc_pmk[IEEE80211_PMK_LEN];
+};
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_IEEE80211_PMKCACHE
+/****************************************************************************
+ * Name: ieee80211_pmkcache_hash
+ *
+ * Description:
+ *   Hash the SSID and passphrase that a cached PMK was derived from.
+ *
+ ****************************************************************************/
+
+static void ieee80211_pmkcache_hash(FAR const struct ieee80211_pskin_s *in,
+                                    FAR uint8_t *hash)
+{
+  SHA1_CTX ctx;
+
+  SHA1Init(&ctx);
+  SHA1Update(&ctx, &in->ssidlen, 1);
+  SHA1Update(&ctx, in->ssid, in->ssidlen);
+  SHA1Update(&ctx, in->pass, in->passlen);
+  SHA1Final(hash, &ctx);
+  memset(&ctx, 0, sizeof(ctx));
+}
+
+static int ieee80211_pmkcache_get(int fd, int instance,
+                                  FAR struct ieee80211_pmkrec_s *rec)
+{
+  struct config_data_s cfg;
+
+  cfg.id         = CONFIG_IEEE80211_PMKCACHE_ID;
+  cfg.instance   = instance;
+  cfg.configdata = (FAR uint8_t *)rec;
+  cfg.len        = sizeof(struct ieee80211_pmkrec_s);
+
+  return ioctl(fd, CFGDIOC_GETCONFIG, (unsigned long)&cfg);
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmkcache_lookup
+ *
+ * Description:
+ *   Look for the PMK of an SSID and passphrase pair in the configuration
+ *   data device.
+ *
+ * Returned Value:
+ *   True if the PMK was found and copied to 'pmk'.
+ *
+ ****************************************************************************/
+
+static bool ieee80211_pmkcache_lookup(FAR const struct ieee80211_pskin_s *in,
+                                      FAR uint8_t *pmk)
+{
+  struct ieee80211_pmkrec_s rec;
+  uint8_t hash[SHA1_DIGEST_LENGTH];
+  bool found = false;
+  int fd;
+  int i;
+
+  fd = open(CONFIG_IEEE80211_PMKCACHE_PATH, O_RDONLY);
+  if (fd < 0)
+    {
+      return false;
+    }
+
+  ieee80211_pmkcache_hash(in, hash);
+
+  for (i = 0; i < CONFIG_IEEE80211_PMKCACHE_NENTRIES && !found; i++)
+    {
+      if (ieee80211_pmkcache_get(fd, i, &rec) >= 0 &&
+          rec.pc_ssidlen == in->ssidlen &&
+          memcmp(rec.pc_ssid, in->ssid, in->ssidlen) == 0 &&
+          memcmp(rec.pc_hash, hash, SHA1_DIGEST_LENGTH) == 0)
+        {
+          memcpy(pmk, rec.pc_pmk, IEEE80211_PMK_LEN);
+          found = true;
+        }
+    }
+
+  memset(&rec, 0, sizeof(rec));
+  close(fd);
+  return found;
+}
+
+/****************************************************************************
+ * Name: ieee80211_pmkcache_store
+ *
+ * Description:
+ *   Save a freshly derived PMK.  The record of the same SSID is replaced if
+ *   there is one, otherwise a free record is used; when the cache is full,
+ *   the hash picks the record to overwrite.
+ *
+ ****************************************************************************/
+
+static void ieee80211_pmkcache_store(FAR const struct ieee80211_pskin_s *in,
+                                     FAR const uint8_t *pmk)
+{
+  struct ieee80211_pmkrec_s rec;
+  struct config_data_s cfg;
+  uint8_t hash[SHA1_DIGEST_LENGTH];
+  int slot = -1;
+  int fd;
+  int i;
+
+  fd = open(CONFIG_IEEE80211_PMKCACHE_PATH, O_RDWR);
+  if (fd < 0)
+    {
+      nvdbg("cannot open %s: %d\n", CONFIG_IEEE80211_PMKCACHE_PATH, errno);
+      return;
+    }
+
+  ieee80211_pmkcache_hash(in, hash);
+
+  for (i = 0; i < CONFIG_IEEE80211_PMKCACHE_NENTRIES; i++)
+    {
+      if (ieee80211_pmkcache_get(fd, i, &rec) < 0)
+        {
+          if (slot < 0)
+            {
+              slot = i;
+            }
+        }
+      else if (rec.pc_ssidlen == in->ssidlen &&
+               memcmp(rec.pc_ssid, in->ssid, in->ssidlen) == 0)
+        {
+          slot = i;
+          break;
+        }
+    }
+
+  if (slot < 0)
+    {
+      slot = hash[0] % CONFIG_IEEE80211_PMKCACHE_NENTRIES;
+    }
+
+  memset(&rec, 0, sizeof(rec));
+  rec.pc_ssidlen = in->ssidlen;
+  memcpy(rec.pc_ssid, in->ssid, in->ssidlen);
+  memcpy(rec.pc_hash, hash, SHA1_DIGEST_LENGTH);
+  memcpy(rec.pc_pmk, pmk, IEEE80211_PMK_LEN);
+
+  cfg.id         = CONFIG_IEEE80211_PMKCACHE_ID;
+  cfg.instance   = slot;
+  cfg.configdata = (FAR uint8_t *)&rec;
+  cfg.len        = sizeof(rec);
+
+  if (ioctl(fd, CFGDIOC_SETCONFIG, (unsigned long)&cfg) < 0)
+    {
+      ndbg("PMK cache write failed: %d\n", errno);
+    }
+
+  memset(&rec, 0, sizeof(rec));
+  close(fd);
+}
+#endif /* CONFIG_IEEE80211_PMKCACHE */
+
+/****************************************************************************
+ * Name: ieee80211_psk_snapshot
+ *
+ * Description:
+ *   Copy the current SSID and passphrase.
+ *
+ * Returned Value:
+ *   False if there is no passphrase or no SSID to derive a PSK from.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static bool ieee80211_psk_snapshot(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_pskin_s *in)
+{
+  FAR struct ieee80211_pskreq_s *pr = &ic->ic_pskreq;
+
+  if (pr->pr_passlen == 0 || ic->ic_des_esslen == 0)
+    {
+      return false;
+    }
+
+  in->gen     = pr->pr_gen;
+  in->ssidlen = ic->ic_des_esslen;
+  in->passlen = pr->pr_passlen;
+  memcpy(in->ssid, ic->ic_des_essid, in->ssidlen);
+  memcpy(in->pass, pr->pr_pass, in->passlen);
+  return true;
+}
+
+/****************************************************************************
+ * Name: ieee80211_psk_apply
+ *
+ * Description:
+ *   Install a new PSK.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_psk_apply(FAR struct ieee80211_s *ic,
+                                FAR const uint8_t *psk)
+{
+  memcpy(ic->ic_psk, psk, IEEE80211_PMK_LEN);
+  ic->ic_flags |= IEEE80211_F_PSK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_psk_worker
+ *
+ * Description:
+ *   Derive the PSK on the low priority work queue.  If the SSID or the
+ *   passphrase changed while the derivation ran, the result is thrown away
+ *   and the derivation is run again, unless the PSK for the new inputs has
+ *   been installed meanwhile (from the PMK cache).
+ *
+ ****************************************************************************/
+
+static void ieee80211_psk_worker(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  FAR struct ieee80211_pskreq_s *pr = &ic->ic_pskreq;
+  struct ieee80211_pskin_s in;
+  uint8_t psk[IEEE80211_PMK_LEN];
+  ieee80211_psk_done_t done;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+
+  while ((ic->ic_flags & IEEE80211_F_PSK) == 0 &&
+         ieee80211_psk_snapshot(ic, &in))
+    {
+      uip_unlock(lock);
+
+      ieee80211_pbkdf2_sha1((FAR const uint8_t *)in.pass, in.passlen,
+                            in.ssid, in.ssidlen, IEEE80211_PSK_ITERATIONS,
+                            psk, sizeof(psk));
+#ifdef CONFIG_IEEE80211_PMKCACHE
+      ieee80211_pmkcache_store(&in, psk);
+#endif
+
+      lock = uip_lock();
+      pr->pr_derived++;
+
+      if (in.gen == pr->pr_gen)
+        {
+          ieee80211_psk_apply(ic, psk);
+
+          done        = pr->pr_done;
+          arg         = pr->pr_arg;
+          pr->pr_done = NULL;
+          pr->pr_busy = false;
+
+          if (done != NULL)
+            {
+              done(ic, OK, arg);
+            }
+          else if (ic->ic_opmode == IEEE80211_M_STA &&
+                   ic->ic_state != IEEE80211_S_INIT)
+            {
+              /* Nobody is waiting: restart the association with the new
+               * key, as the driver would have done on -ENETRESET.
+               */
+
+              ieee80211_new_state(ic, IEEE80211_S_SCAN, -1);
+            }
+
+          goto out;
+        }
+    }
+
+  pr->pr_busy = false;
+
+out:
+  uip_unlock(lock);
+  memset(&in, 0, sizeof(in));
+  memset(psk, 0, sizeof(psk));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_set_passphrase
+ *
+ * Description:
+ *   Set the WPA passphrase from which the PSK is derived, together with the
+ *   desired SSID.  A NULL or empty passphrase forgets the current one.
+ *   'done', if not NULL, is called when a derivation on the work queue
+ *   completes.
+ *
+ * Returned Value:
+ *   -ENETRESET if the PSK is already in place (or the passphrase was
+ *   cleared), -EINPROGRESS if it is being derived, or -EINVAL if the
+ *   passphrase is malformed or no SSID has been set.
+ *
+ ****************************************************************************/
+
+int ieee80211_set_passphrase(FAR struct ieee80211_s *ic,
+                             FAR const char *pass, size_t len,
+                             ieee80211_psk_done_t done, FAR void *arg)
+{
+  FAR struct ieee80211_pskreq_s *pr = &ic->ic_pskreq;
+  uip_lock_t lock;
+  size_t i;
+
+  if (pass != NULL && len > 0)
+    {
+      if (len < IEEE80211_PASSPHRASE_MINLEN ||
+          len > IEEE80211_PASSPHRASE_MAXLEN || ic->ic_des_esslen == 0)
+        {
+          return -EINVAL;
+        }
+
+      for (i = 0; i < len; i++)
+        {
+          if (pass[i] < 0x20 || pass[i] > 0x7e)
+            {
+              return -EINVAL;
+            }
+        }
+    }
+  else
+    {
+      len = 0;
+    }
+
+  lock = uip_lock();
+  memset(pr->pr_pass, 0, sizeof(pr->pr_pass));
+  memcpy(pr->pr_pass, pass, len);
+  pr->pr_passlen = len;
+
+  if (len == 0)
+    {
+      pr->pr_gen++;
+      pr->pr_done = NULL;
+      ic->ic_flags &= ~IEEE80211_F_PSK;
+      memset(ic->ic_psk, 0, sizeof(ic->ic_psk));
+      uip_unlock(lock);
+      return -ENETRESET;
+    }
+
+  pr->pr_done = done;
+  pr->pr_arg  = arg;
+  uip_unlock(lock);
+
+  return ieee80211_psk_update(ic);
+}
+
+/****************************************************************************
+ * Name: ieee80211_psk_update
+ *
+ * Description:
+ *   Derive the PSK again after the passphrase or the desired SSID changed.
+ *   The PSK is taken from the PMK cache if it has been derived before,
+ *   otherwise the derivation is queued and IEEE80211_F_PSK stays clear
+ *   until it completes.
+ *
+ * Returned Value:
+ *   -ENETRESET if the PSK is in place, -EINPROGRESS if it is being derived,
+ *   -EAGAIN if the derivation could not be queued or OK if there is no
+ *   passphrase to derive it from.
+ *
+ ****************************************************************************/
+
+int ieee80211_psk_update(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_pskreq_s *pr = &ic->ic_pskreq;
+  struct ieee80211_pskin_s in;
+  uip_lock_t lock;
+  int ret = -EINPROGRESS;
+#ifdef CONFIG_IEEE80211_PMKCACHE
+  uint8_t psk[IEEE80211_PMK_LEN];
+  bool hit;
+#endif
+
+  lock = uip_lock();
+
+  /* The old PSK belongs to another SSID or passphrase */
+
+  pr->pr_gen++;
+  ic->ic_flags &= ~IEEE80211_F_PSK;
+  memset(ic->ic_psk, 0, sizeof(ic->ic_psk));
+
+  if (!ieee80211_psk_snapshot(ic, &in))
+    {
+      uip_unlock(lock);
+      return OK;
+    }
+
+#ifdef CONFIG_IEEE80211_PMKCACHE
+  uip_unlock(lock);
+  hit = ieee80211_pmkcache_lookup(&in, psk);
+  lock = uip_lock();
+
+  if (in.gen != pr->pr_gen)
+    {
+      /* Changed again meanwhile; that update takes care of it */
+
+      goto out;
+    }
+
+  if (hit)
+    {
+      /* A worker still queued for an older generation is not needed any
+       * more.  One that is already running stops when it sees
+       * IEEE80211_F_PSK, rather than deriving again and restarting the
+       * association that now has the right key.
+       */
+
+      if (!work_available(&pr->pr_work))
+        {
+          (void)work_cancel(PSK_WORK, &pr->pr_work);
+          pr->pr_busy = false;
+        }
+
+      ieee80211_psk_apply(ic, psk);
+      pr->pr_cachehits++;
+      pr->pr_done = NULL;
+      ret = -ENETRESET;
+      goto out;
+    }
+#endif
+
+  /* A running worker notices the new generation and derives again */
+
+  if (!pr->pr_busy)
+    {
+      if (work_queue(PSK_WORK, &pr->pr_work, ieee80211_psk_worker,
+                     ic, 0) == OK)
+        {
+          pr->pr_busy = true;
+        }
+      else
+        {
+          ret = -EAGAIN;
+        }
+    }
+
+#ifdef CONFIG_IEEE80211_PMKCACHE
+out:
+#endif
+  uip_unlock(lock);
+
+  memset(&in, 0, sizeof(in));
+#ifdef CONFIG_IEEE80211_PMKCACHE
+  memset(psk, 0, sizeof(psk));
+#endif
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ieee80211_psk_discard
+ *
+ * Description:
+ *   Cancel any pending derivation and forget the passphrase.
+ *
+ ****************************************************************************/
+
+void ieee80211_psk_discard(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_pskreq_s *pr = &ic->ic_pskreq;
+
+  (void)work_cancel(PSK_WORK, &pr->pr_work);
+  pr->pr_gen++;
+  pr->pr_busy    = false;
+  pr->pr_done    = NULL;
+  pr->pr_passlen = 0;
+  memset(pr->pr_pass, 0, sizeof(pr->pr_pass));
+}
+
+#endif /* CONFIG_IEEE80211_PBKDF2 */
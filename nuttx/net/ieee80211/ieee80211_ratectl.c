@@ -0,0 +1,402 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_ratectl.c
+ * Pluggable transmit rate control
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <debug.h>
+#  include <nuttx/clock.h>
+
+#  include "ieee80211/ieee80211_debug.h"
+#  include "ieee80211/ieee80211_var.h"
+#endif
+
+#include "ieee80211/ieee80211_ratectl.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* AMRR is evaluated once this many frames have been reported */
+
+#define AMRR_NFRAMES 11
+
+/* RSSADAPT packet rate statistics are refreshed this often */
+
+#define RSSADAPT_INTERVAL MSEC2TICK(100)
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void ieee80211_amrr_rc_node_init(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_node *ni);
+static void ieee80211_amrr_rc_choose(FAR struct ieee80211_s *ic,
+                                     FAR struct ieee80211_node *ni,
+                                     unsigned int len,
+                                     FAR struct ieee80211_ratechain *chain);
+static void ieee80211_amrr_rc_tx_complete(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR const struct ieee80211_ratechain *chain,
+                              FAR const struct ieee80211_txstatus *txs);
+
+static void ieee80211_rssadapt_rc_node_init(FAR struct ieee80211_s *ic,
+                                            FAR struct ieee80211_node *ni);
+static void ieee80211_rssadapt_rc_choose(FAR struct ieee80211_s *ic,
+                                         FAR struct ieee80211_node *ni,
+                                         unsigned int len,
+                                         FAR struct ieee80211_ratechain *chain);
+static void ieee80211_rssadapt_rc_tx_complete(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR const struct ieee80211_ratechain *chain,
+                              FAR const struct ieee80211_txstatus *txs);
+static void ieee80211_rssadapt_rc_input(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_node *ni,
+                                        int rssi);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Success thresholds shared by all AMRR nodes */
+
+static struct ieee80211_amrr g_amrr =
+{
+  .amrr_min_success_threshold = 1,
+  .amrr_max_success_threshold = 15
+};
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+const struct ieee80211_ratectl_ops ieee80211_ratectl_amrr =
+{
+  .rc_name        = "amrr",
+  .rc_node_init   = ieee80211_amrr_rc_node_init,
+  .rc_choose      = ieee80211_amrr_rc_choose,
+  .rc_tx_complete = ieee80211_amrr_rc_tx_complete,
+};
+
+const struct ieee80211_ratectl_ops ieee80211_ratectl_rssadapt =
+{
+  .rc_name        = "rssadapt",
+  .rc_node_init   = ieee80211_rssadapt_rc_node_init,
+  .rc_choose      = ieee80211_rssadapt_rc_choose,
+  .rc_tx_complete = ieee80211_rssadapt_rc_tx_complete,
+  .rc_input       = ieee80211_rssadapt_rc_input,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_ratechain_down
+ *
+ * Description:
+ *   Build a chain that starts at ridx and steps down one rate per entry,
+ *   always ending at the lowest rate.  Used by the algorithms that only
+ *   pick a single rate.
+ *
+ ****************************************************************************/
+
+static void ieee80211_ratechain_down(FAR struct ieee80211_ratechain *chain,
+                                     int ridx)
+{
+  int n = 0;
+
+  while (ridx > 0 && n < IEEE80211_RATECHAIN_MAX - 1)
+    {
+      chain->rc_ridx[n]  = ridx--;
+      chain->rc_tries[n] = IEEE80211_RATECHAIN_TRIES;
+      n++;
+    }
+
+  chain->rc_ridx[n]  = 0;
+  chain->rc_tries[n] = IEEE80211_RATECHAIN_TRIES;
+  chain->rc_nrates   = n + 1;
+}
+
+/* AMRR: one rate, moved up or down after every AMRR_NFRAMES frames */
+
+static void ieee80211_amrr_rc_node_init(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_node *ni)
+{
+  ieee80211_amrr_node_init(&g_amrr, &ni->ni_rctl->rn_amrr);
+}
+
+static void ieee80211_amrr_rc_choose(FAR struct ieee80211_s *ic,
+                                     FAR struct ieee80211_node *ni,
+                                     unsigned int len,
+                                     FAR struct ieee80211_ratechain *chain)
+{
+  ieee80211_ratechain_down(chain, ni->ni_txrate);
+}
+
+static void ieee80211_amrr_rc_tx_complete(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR const struct ieee80211_ratechain *chain,
+                              FAR const struct ieee80211_txstatus *txs)
+{
+  FAR struct ieee80211_amrr_node *amn = &ni->ni_rctl->rn_amrr;
+
+  amn->amn_txcnt++;
+  if (txs->txs_final > 0 || txs->txs_tries > 1)
+    {
+      amn->amn_retrycnt++;
+    }
+
+  if (!txs->txs_acked)
+    {
+      amn->amn_retrycnt++;
+    }
+
+  if (amn->amn_txcnt >= AMRR_NFRAMES)
+    {
+      ieee80211_amrr_choose(&g_amrr, ni, amn);
+    }
+}
+
+/* RSSADAPT: per-length RSSI thresholds for each rate */
+
+static void ieee80211_rssadapt_rc_node_init(FAR struct ieee80211_s *ic,
+                                            FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_rssadapt_node *rr = &ni->ni_rctl->rn_rssadapt;
+
+  ieee80211_rssadapt_updatestats(&rr->rr_ra);
+  rr->rr_update = clock_systimer() + RSSADAPT_INTERVAL;
+}
+
+static void ieee80211_rssadapt_rc_choose(FAR struct ieee80211_s *ic,
+                                         FAR struct ieee80211_node *ni,
+                                         unsigned int len,
+                                         FAR struct ieee80211_ratechain *chain)
+{
+  FAR struct ieee80211_rssadapt_node *rr = &ni->ni_rctl->rn_rssadapt;
+  struct ieee80211_frame wh;
+
+  if ((int32_t)(clock_systimer() - rr->rr_update) >= 0)
+    {
+      ieee80211_rssadapt_updatestats(&rr->rr_ra);
+      rr->rr_update = clock_systimer() + RSSADAPT_INTERVAL;
+    }
+
+  /* Only the frame type and receiver address are looked at */
+
+  memset(&wh, 0, sizeof(wh));
+  wh.i_fc[0] = IEEE80211_FC0_VERSION_0 | IEEE80211_FC0_TYPE_DATA;
+  IEEE80211_ADDR_COPY(wh.i_addr1, ni->ni_macaddr);
+
+  ni->ni_txrate = ieee80211_rssadapt_choose(&rr->rr_ra, &ni->ni_rates,
+                                            &wh, len, -1, NULL, 0);
+  ieee80211_ratechain_down(chain, ni->ni_txrate);
+}
+
+static void ieee80211_rssadapt_rc_tx_complete(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              FAR const struct ieee80211_ratechain *chain,
+                              FAR const struct ieee80211_txstatus *txs)
+{
+  FAR struct ieee80211_rssadapt *ra = &ni->ni_rctl->rn_rssadapt.rr_ra;
+  struct ieee80211_rssdesc id;
+  int i;
+
+  id.id_len  = txs->txs_len;
+  id.id_node = ni;
+  id.id_rssi = ni->ni_rssi;
+
+  /* Every rate that exhausted its attempts raises its threshold */
+
+  for (i = 0; i < txs->txs_final; i++)
+    {
+      id.id_rateidx = chain->rc_ridx[i];
+      ieee80211_rssadapt_lower_rate(ic, ni, ra, &id);
+    }
+
+  id.id_rateidx = chain->rc_ridx[txs->txs_final];
+  if (txs->txs_acked)
+    {
+      ieee80211_rssadapt_raise_rate(ic, ra, &id);
+    }
+  else
+    {
+      ieee80211_rssadapt_lower_rate(ic, ni, ra, &id);
+    }
+}
+
+static void ieee80211_rssadapt_rc_input(FAR struct ieee80211_s *ic,
+                                        FAR struct ieee80211_node *ni,
+                                        int rssi)
+{
+  ieee80211_rssadapt_input(ic, ni, &ni->ni_rctl->rn_rssadapt.rr_ra, rssi);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_attach
+ ****************************************************************************/
+
+void ieee80211_ratectl_attach(FAR struct ieee80211_s *ic,
+                              FAR const struct ieee80211_ratectl_ops *ops)
+{
+  nvdbg("%s: rate control %s\n", ic->ic_ifname,
+        ops != NULL ? ops->rc_name : "by driver");
+  ic->ic_ratectl = ops;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_node_init
+ ****************************************************************************/
+
+void ieee80211_ratectl_node_init(FAR struct ieee80211_s *ic,
+                                 FAR struct ieee80211_node *ni)
+{
+  FAR const struct ieee80211_ratectl_ops *ops = ic->ic_ratectl;
+
+  if (ops == NULL || ni->ni_rates.rs_nrates == 0)
+    {
+      return;
+    }
+
+  ni->ni_txrate = 0;
+
+  if (ieee80211_node_rctl_attach(ni) < 0)
+    {
+      return;
+    }
+
+  memset(ni->ni_rctl, 0, sizeof(union ieee80211_ratectl_node));
+  ops->rc_node_init(ic, ni);
+}
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_choose
+ ****************************************************************************/
+
+void ieee80211_ratectl_choose(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              unsigned int len,
+                              FAR struct ieee80211_ratechain *chain)
+{
+  FAR const struct ieee80211_ratectl_ops *ops = ic->ic_ratectl;
+
+  if (ops == NULL || ni->ni_rctl == NULL)
+    {
+      chain->rc_ridx[0]  = ni->ni_txrate;
+      chain->rc_tries[0] = IEEE80211_RATECHAIN_MAX *
+                           IEEE80211_RATECHAIN_TRIES;
+      chain->rc_nrates   = 1;
+      return;
+    }
+
+  ops->rc_choose(ic, ni, len, chain);
+}
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_tx_complete
+ ****************************************************************************/
+
+void ieee80211_ratectl_tx_complete(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_node *ni,
+                                   FAR const struct ieee80211_ratechain *chain,
+                                   FAR const struct ieee80211_txstatus *txs)
+{
+  FAR const struct ieee80211_ratectl_ops *ops = ic->ic_ratectl;
+  unsigned int attempts;
+  int i;
+
+  if (txs->txs_final >= chain->rc_nrates)
+    {
+      ndbg("ERROR: bad final chain entry %d/%d\n",
+           txs->txs_final, chain->rc_nrates);
+      return;
+    }
+
+  /* Every entry before the final one used all of its attempts */
+
+  attempts = txs->txs_tries;
+  for (i = 0; i < txs->txs_final; i++)
+    {
+      attempts += chain->rc_tries[i];
+    }
+
+  ni->ni_stats.ns_txattempts += attempts;
+  if (attempts > 1)
+    {
+      ni->ni_stats.ns_txretries += attempts - 1;
+    }
+
+  if (!txs->txs_acked)
+    {
+      ni->ni_stats.ns_txfailed++;
+    }
+
+  if (ops == NULL || ni->ni_rctl == NULL)
+    {
+      return;
+    }
+
+  ops->rc_tx_complete(ic, ni, chain, txs);
+}
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_input
+ ****************************************************************************/
+
+void ieee80211_ratectl_input(FAR struct ieee80211_s *ic,
+                             FAR struct ieee80211_node *ni, int rssi)
+{
+  FAR const struct ieee80211_ratectl_ops *ops = ic->ic_ratectl;
+
+  if (ops != NULL && ops->rc_input != NULL && ni->ni_rctl != NULL)
+    {
+      ops->rc_input(ic, ni, rssi);
+    }
+}
@@ -0,0 +1,219 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_ratectl.h
+ * Pluggable transmit rate control
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_RATECTL_H
+#define __NET_IEEE80211_IEEE80211_RATECTL_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <sys/time.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ieee80211/ieee80211_amrr.h"
+#include "ieee80211/ieee80211_rssadapt.h"
+#include "ieee80211/ieee80211_minstrel.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Longest multi-rate retry chain handed to the driver */
+
+#define IEEE80211_RATECHAIN_MAX   4
+
+/* Attempts per chain entry when the algorithm does not say otherwise */
+
+#define IEEE80211_RATECHAIN_TRIES 2
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct ieee80211_s;
+struct ieee80211_node;
+
+/* Multi-rate retry chain for one frame.  The driver tries rc_ridx[0]
+ * rc_tries[0] times, then moves on to the next entry, and so on.  Rates
+ * are indices into ni->ni_rates.
+ */
+
+struct ieee80211_ratechain
+  {
+    uint8_t rc_nrates;                          /* Entries in use */
+    uint8_t rc_ridx[IEEE80211_RATECHAIN_MAX];   /* Index into ni_rates */
+    uint8_t rc_tries[IEEE80211_RATECHAIN_MAX];  /* Attempts at each rate */
+  };
+
+/* Transmit status reported by the driver for a frame sent with a chain.
+ * Every entry before txs_final is assumed to have used all its attempts.
+ */
+
+struct ieee80211_txstatus
+  {
+    uint16_t txs_len;           /* Length of the MPDU */
+    uint8_t txs_final;          /* Chain entry of the last attempt */
+    uint8_t txs_tries;          /* Attempts made at that entry */
+    bool txs_acked;             /* The last attempt was acknowledged */
+  };
+
+/* RSSADAPT expects ieee80211_rssadapt_updatestats() to be called every
+ * 100 msec; the stack does so lazily from the transmit path.
+ */
+
+struct ieee80211_rssadapt_node
+  {
+    struct ieee80211_rssadapt rr_ra;
+    uint32_t rr_update;         /* Time of the next update (ticks) */
+  };
+
+/* Per-node state of whichever algorithm is attached to the interface */
+
+union ieee80211_ratectl_node
+  {
+    struct ieee80211_amrr_node rn_amrr;
+    struct ieee80211_rssadapt_node rn_rssadapt;
+    struct ieee80211_minstrel_node rn_minstrel;
+  };
+
+/* A rate control algorithm.  All methods are called with the network
+ * locked and only for nodes that have rate control state (ni->ni_rctl).
+ * rc_choose must leave its preferred rate in ni->ni_txrate.  rc_input is
+ * optional.
+ */
+
+struct ieee80211_ratectl_ops
+  {
+    FAR const char *rc_name;
+    void (*rc_node_init)(FAR struct ieee80211_s *ic,
+                         FAR struct ieee80211_node *ni);
+    void (*rc_choose)(FAR struct ieee80211_s *ic,
+                      FAR struct ieee80211_node *ni, unsigned int len,
+                      FAR struct ieee80211_ratechain *chain);
+    void (*rc_tx_complete)(FAR struct ieee80211_s *ic,
+                           FAR struct ieee80211_node *ni,
+                           FAR const struct ieee80211_ratechain *chain,
+                           FAR const struct ieee80211_txstatus *txs);
+    void (*rc_input)(FAR struct ieee80211_s *ic,
+                     FAR struct ieee80211_node *ni, int rssi);
+  };
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+extern const struct ieee80211_ratectl_ops ieee80211_ratectl_amrr;
+extern const struct ieee80211_ratectl_ops ieee80211_ratectl_rssadapt;
+extern const struct ieee80211_ratectl_ops ieee80211_ratectl_minstrel;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_attach
+ *
+ * Description:
+ *   Select the rate control algorithm of an interface.  Drivers call this
+ *   once after ieee80211_ifattach(), before the interface is brought up.
+ *   With ops == NULL (the default) the driver manages ni_txrate itself.
+ *
+ ****************************************************************************/
+
+void ieee80211_ratectl_attach(FAR struct ieee80211_s *ic,
+                              FAR const struct ieee80211_ratectl_ops *ops);
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_node_init
+ *
+ * Description:
+ *   Give a node that is about to exchange data frames fresh rate control
+ *   state and start it at its lowest rate.  If the pool is exhausted the
+ *   node stays there.  Does nothing if the driver manages rates itself.
+ *
+ ****************************************************************************/
+
+void ieee80211_ratectl_node_init(FAR struct ieee80211_s *ic,
+                                 FAR struct ieee80211_node *ni);
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_choose
+ *
+ * Description:
+ *   Fill in the retry chain for a data frame of len bytes to ni and update
+ *   ni->ni_txrate.  Nodes without rate control state get a single entry
+ *   at ni->ni_txrate.
+ *
+ ****************************************************************************/
+
+void ieee80211_ratectl_choose(FAR struct ieee80211_s *ic,
+                              FAR struct ieee80211_node *ni,
+                              unsigned int len,
+                              FAR struct ieee80211_ratechain *chain);
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_tx_complete
+ *
+ * Description:
+ *   Report the outcome of a frame sent with a chain returned by
+ *   ieee80211_ratectl_choose().  The attempts are also added to the
+ *   transmit counters of the node, with or without rate control.
+ *
+ ****************************************************************************/
+
+void ieee80211_ratectl_tx_complete(FAR struct ieee80211_s *ic,
+                                   FAR struct ieee80211_node *ni,
+                                   FAR const struct ieee80211_ratechain *chain,
+                                   FAR const struct ieee80211_txstatus *txs);
+
+/****************************************************************************
+ * Name: ieee80211_ratectl_input
+ *
+ * Description:
+ *   Feed the RSSI of a frame received from ni to the algorithm.
+ *
+ ****************************************************************************/
+
+void ieee80211_ratectl_input(FAR struct ieee80211_s *ic,
+                             FAR struct ieee80211_node *ni, int rssi);
+
+#endif /* __NET_IEEE80211_IEEE80211_RATECTL_H */
@@ -0,0 +1,756 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_ratectl_bench.c
+ * Host simulator for the transmit rate control algorithms.  This is not
+ * part of the NuttX build.  Build and run it on the development host with:
+ *
+ *   cc -O2 -DIEEE80211_HOSTBENCH -I.. -o ratectl_bench \
+ *      ieee80211_ratectl_bench.c -lm
+ *   ./ratectl_bench [-s seed] [-l length] [trace ...]
+ *
+ * The AMRR, RSSADAPT and Minstrel sources are compiled in unchanged and
+ * driven through the ieee80211_ratectl_*() interface by a saturated flow
+ * of data frames over a synthetic 802.11g channel: an SNR trace, a
+ * logistic frame error curve per rate, Gilbert-Elliott burst loss and a
+ * periodic interferer.  Time only advances by the air time of the
+ * simulated attempts, so the output is reproducible for a given seed and
+ * can be diffed to catch regressions when tuning.
+ *
+ * A trace file holds "msec snr_dB" pairs, one per line ('#' starts a
+ * comment); the SNR is interpolated linearly between them.  Without
+ * trace files a set of built-in scenarios is run.
+ *
+ * For every algorithm it reports the goodput, the goodput an oracle that
+ * always knows the best rate would get, retries per delivered frame, the
+ * share of frames dropped, the share of frames sent at a rate within 90%
+ * of the best and the time needed to get there after each SNR change.
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/time.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Just enough of the NuttX and 802.11 environment for the rate control
+ * sources.  The simulated clock ticks once per msec.
+ */
+
+#define FAR
+#define OK                        0
+#define nvdbg(...)
+#define ndbg(...)
+#define MSEC2TICK(msec)           (msec)
+
+#ifndef MAX
+#  define MAX(a,b)                ((a) > (b) ? (a) : (b))
+#endif
+
+#define IEEE80211_ADDR_LEN        6
+#define IEEE80211_RATE_BASIC      0x80
+#define IEEE80211_RATE_VAL        0x7f
+#define IEEE80211_RATE_MAXSIZE    15
+#define IEEE80211_FC0_VERSION_0   0x00
+#define IEEE80211_FC0_TYPE_MASK   0x0c
+#define IEEE80211_FC0_TYPE_CTL    0x04
+#define IEEE80211_FC0_TYPE_DATA   0x08
+#define IEEE80211_ADDR_COPY(d,s)  memcpy(d, s, IEEE80211_ADDR_LEN)
+
+/* Channel and traffic model */
+
+#define SIM_NRATES     12
+#define SIM_HDRLEN     28       /* MAC header and FCS of a data frame */
+#define SIM_REFLEN     1528     /* Length the error curves are given for */
+#define SIM_SLOPE      1.2      /* Steepness of the error curves (1/dB) */
+#define SIM_TARGET     0.9      /* Good rates get 90% of the best goodput */
+#define SIM_SETTLE     20       /* Good frames in a row to have converged */
+#define SIM_STEP       3.0      /* SNR change (dB) that counts as an event */
+#define SIM_MAXPOINTS  4096
+#define SIM_MAXEVENTS  32
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct ieee80211_rateset
+  {
+    uint8_t rs_nrates;
+    uint8_t rs_rates[IEEE80211_RATE_MAXSIZE];
+  };
+
+struct ieee80211_frame
+  {
+    uint8_t i_fc[2];
+    uint8_t i_dur[2];
+    uint8_t i_addr1[IEEE80211_ADDR_LEN];
+    uint8_t i_addr2[IEEE80211_ADDR_LEN];
+    uint8_t i_addr3[IEEE80211_ADDR_LEN];
+    uint8_t i_seq[2];
+  };
+
+struct ieee80211_s
+  {
+    char ic_ifname[8];
+    FAR const struct ieee80211_ratectl_ops *ic_ratectl;
+  };
+
+struct ieee80211_nodestats
+  {
+    uint32_t ns_txattempts;
+    uint32_t ns_txretries;
+    uint32_t ns_txfailed;
+  };
+
+struct ieee80211_node
+  {
+    uint8_t ni_macaddr[IEEE80211_ADDR_LEN];
+    uint8_t ni_rssi;
+    struct ieee80211_rateset ni_rates;
+    int ni_txrate;
+    union ieee80211_ratectl_node *ni_rctl;
+    struct ieee80211_nodestats ni_stats;
+  };
+
+/* An SNR trace plus burst loss and interference */
+
+struct sim_channel
+  {
+    char name[64];
+    unsigned int npoints;
+    double t[SIM_MAXPOINTS];            /* msec */
+    double snr[SIM_MAXPOINTS];          /* dB */
+    double burst_enter;                 /* P(good -> bad) per attempt */
+    double burst_leave;                 /* P(bad -> good) per attempt */
+    double burst_loss;                  /* P(loss) in the bad state */
+    unsigned int intf_period;           /* msec, 0: no interferer */
+    unsigned int intf_on;               /* msec the interferer is on */
+    double intf_db;                     /* SNR lost while it is on */
+  };
+
+struct sim_result
+  {
+    double goodput;                     /* Mb/s */
+    double retries;                     /* Retries per delivered frame */
+    double loss;                        /* Frames dropped (%) */
+    double target;                      /* Frames at a good rate (%) */
+    double converge;                    /* Mean convergence time (msec) */
+    unsigned int nconverged;
+    unsigned int nevents;
+  };
+
+struct sim_alg
+  {
+    const char *name;
+    FAR const struct ieee80211_ratectl_ops *ops;
+  };
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* Provided by the kernel on the target */
+
+static uint32_t clock_systimer(void);
+static int ratecheck(struct timeval *last, const struct timeval *interval);
+static int ieee80211_node_rctl_attach(FAR struct ieee80211_node *ni);
+
+/****************************************************************************
+ * Rate Control Algorithms
+ ****************************************************************************/
+
+#include "ieee80211/ieee80211_ratectl.h"
+
+#include "ieee80211_amrr.c"
+#include "ieee80211_rssadapt.c"
+#include "ieee80211_minstrel.c"
+#include "ieee80211_ratectl.c"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* 802.11g rates (500 kb/s units) and the SNR at which a reference frame
+ * gets through half of the time.
+ */
+
+static const uint8_t g_rates[SIM_NRATES] =
+{
+  2, 4, 11, 12, 18, 22, 24, 36, 48, 72, 96, 108
+};
+
+static const double g_snr50[SIM_NRATES] =
+{
+  1.0, 3.0, 5.0, 4.0, 5.0, 8.0, 7.0, 9.0, 12.0, 16.0, 20.0, 22.0
+};
+
+static const struct sim_alg g_algs[] =
+{
+  { "amrr",     &ieee80211_ratectl_amrr },
+  { "rssadapt", &ieee80211_ratectl_rssadapt },
+  { "minstrel", &ieee80211_ratectl_minstrel },
+};
+
+static struct sim_channel g_channel;
+static union ieee80211_ratectl_node g_rctl;
+static double g_now;                    /* Simulated time (usec) */
+static uint64_t g_rand;
+static uint64_t g_seed = 1;
+static unsigned int g_len = SIM_REFLEN;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* Kernel services, on simulated time */
+
+static uint32_t clock_systimer(void)
+{
+  return (uint32_t)(g_now / 1000);
+}
+
+static int ratecheck(struct timeval *last, const struct timeval *interval)
+{
+  uint64_t now = (uint64_t)g_now;
+  uint64_t then = (uint64_t)last->tv_sec * 1000000 + last->tv_usec;
+  uint64_t min = (uint64_t)interval->tv_sec * 1000000 + interval->tv_usec;
+
+  if (now - then >= min || then == 0)
+    {
+      last->tv_sec  = now / 1000000;
+      last->tv_usec = now % 1000000;
+      return 1;
+    }
+
+  return 0;
+}
+
+static int ieee80211_node_rctl_attach(FAR struct ieee80211_node *ni)
+{
+  ni->ni_rctl = &g_rctl;
+  return OK;
+}
+
+/* xorshift64*, uniform in [0, 1) */
+
+static double sim_random(void)
+{
+  g_rand ^= g_rand >> 12;
+  g_rand ^= g_rand << 25;
+  g_rand ^= g_rand >> 27;
+  return (double)((g_rand * 0x2545f4914f6cdd1dull) >> 11) / 9007199254740992.0;
+}
+
+static bool sim_dsss(uint8_t rate)
+{
+  return rate == 2 || rate == 4 || rate == 11 || rate == 22;
+}
+
+/* Air time (usec) of one attempt, including backoff and the ACK (or the
+ * ACK timeout); attempt counts the earlier attempts of the same frame.
+ */
+
+static double sim_airtime(uint8_t rate, unsigned int len,
+                          unsigned int attempt)
+{
+  unsigned int cw;
+  unsigned int bps;
+  unsigned int ackbps;
+  double data;
+  double ack;
+
+  if (sim_dsss(rate))
+    {
+      cw   = (32u << (attempt < 5 ? attempt : 5)) - 1;
+      data = 192 + len * 16.0 / rate;
+      ack  = 192 + 14 * 8;
+      return 50 + (cw > 1023 ? 1023 : cw) * 20 / 2.0 + data + 10 + ack;
+    }
+
+  /* OFDM: 4 usec symbols carrying rate * 2 bits, ACK at a basic rate */
+
+  cw     = (16u << (attempt < 6 ? attempt : 6)) - 1;
+  bps    = rate * 2;
+  ackbps = rate >= 48 ? 96 : rate >= 24 ? 48 : 24;
+  data   = 20 + 4 * ceil((22 + 8.0 * len) / bps);
+  ack    = 20 + 4 * ceil((22 + 8.0 * 14) / ackbps);
+  return 34 + (cw > 1023 ? 1023 : cw) * 9 / 2.0 + data + 16 + ack;
+}
+
+/* Probability that an attempt at rate index ridx gets through */
+
+static double sim_psuccess(int ridx, double snr, unsigned int len)
+{
+  double p;
+
+  p = 1.0 / (1.0 + exp(-SIM_SLOPE * (snr - g_snr50[ridx])));
+  return pow(p, (double)len / SIM_REFLEN);
+}
+
+/* Expected goodput (Mb/s) at rate index ridx if nothing were retried */
+
+static double sim_goodput(int ridx, double snr, unsigned int len)
+{
+  return sim_psuccess(ridx, snr, len) * 8.0 * (len - SIM_HDRLEN) /
+         sim_airtime(g_rates[ridx], len, 0);
+}
+
+static int sim_bestrate(double snr, unsigned int len, double *goodput)
+{
+  double tp;
+  int best = 0;
+  int i;
+
+  *goodput = 0;
+  for (i = 0; i < SIM_NRATES; i++)
+    {
+      tp = sim_goodput(i, snr, len);
+      if (tp > *goodput)
+        {
+          *goodput = tp;
+          best = i;
+        }
+    }
+
+  return best;
+}
+
+/* SNR at time t (msec), interpolated from the trace */
+
+static double sim_snr(const struct sim_channel *ch, double t)
+{
+  double snr = ch->snr[ch->npoints - 1];
+  unsigned int i;
+
+  for (i = 0; i + 1 < ch->npoints; i++)
+    {
+      if (t < ch->t[i + 1])
+        {
+          snr = ch->snr[i] + (ch->snr[i + 1] - ch->snr[i]) *
+                (t - ch->t[i]) / (ch->t[i + 1] - ch->t[i]);
+          break;
+        }
+    }
+
+  if (ch->intf_period > 0 && fmod(t, ch->intf_period) < ch->intf_on)
+    {
+      snr -= ch->intf_db;
+    }
+
+  return snr;
+}
+
+/* Times (msec) at which the SNR jumps; the start always counts */
+
+static unsigned int sim_events(const struct sim_channel *ch, double *events)
+{
+  unsigned int nevents = 0;
+  unsigned int i;
+
+  events[nevents++] = 0;
+  for (i = 0; i + 1 < ch->npoints && nevents < SIM_MAXEVENTS; i++)
+    {
+      if (ch->t[i + 1] - ch->t[i] <= 10 &&
+          fabs(ch->snr[i + 1] - ch->snr[i]) >= SIM_STEP && ch->t[i] > 0)
+        {
+          events[nevents++] = ch->t[i + 1];
+        }
+    }
+
+  return nevents;
+}
+
+/* Goodput an oracle with perfect knowledge of the channel would get */
+
+static double sim_oracle(const struct sim_channel *ch, unsigned int len)
+{
+  double end = ch->t[ch->npoints - 1];
+  double sum = 0;
+  double tp;
+  double bad;
+  double t;
+
+  for (t = 0; t < end; t += 1)
+    {
+      sim_bestrate(sim_snr(ch, t), len, &tp);
+      sum += tp;
+    }
+
+  bad = 0;
+  if (ch->burst_enter > 0)
+    {
+      bad = ch->burst_enter / (ch->burst_enter + ch->burst_leave);
+    }
+
+  return end > 0 ? sum / end * (1 - bad * ch->burst_loss) : 0;
+}
+
+static void sim_point(struct sim_channel *ch, double t, double snr)
+{
+  if (ch->npoints < SIM_MAXPOINTS)
+    {
+      ch->t[ch->npoints]   = t;
+      ch->snr[ch->npoints] = snr;
+      ch->npoints++;
+    }
+}
+
+static void sim_run(const struct sim_channel *ch, const struct sim_alg *alg,
+                    struct sim_result *res)
+{
+  struct ieee80211_s ic;
+  struct ieee80211_node ni;
+  struct ieee80211_ratechain chain;
+  struct ieee80211_txstatus txs;
+  double events[SIM_MAXEVENTS];
+  double end = ch->t[ch->npoints - 1] * 1000;
+  double bytes = 0;
+  double settle = 0;
+  double best;
+  double snr;
+  unsigned long frames = 0;
+  unsigned long delivered = 0;
+  unsigned long attempts = 0;
+  unsigned long good = 0;
+  unsigned int nevents;
+  unsigned int event = 0;
+  unsigned int streak = 0;
+  unsigned int nattempts;
+  unsigned int i;
+  unsigned int k;
+  bool converged = false;
+  bool burst = false;
+  bool acked;
+  int ridx;
+
+  memset(&ic, 0, sizeof(ic));
+  memset(&ni, 0, sizeof(ni));
+  memset(res, 0, sizeof(*res));
+  strcpy(ic.ic_ifname, "sim0");
+  ni.ni_macaddr[0] = 0x02;
+  ni.ni_macaddr[5] = 0x01;
+  ni.ni_rates.rs_nrates = SIM_NRATES;
+  memcpy(ni.ni_rates.rs_rates, g_rates, SIM_NRATES);
+
+  g_now  = 0;
+  g_rand = g_seed * 0x9e3779b97f4a7c15ull + 1;
+  nevents = sim_events(ch, events);
+  res->nevents = nevents;
+
+  ieee80211_ratectl_attach(&ic, alg->ops);
+  ieee80211_ratectl_node_init(&ic, &ni);
+
+  while (g_now < end)
+    {
+      /* Moving on to the next SNR change */
+
+      if (event + 1 < nevents && g_now >= events[event + 1] * 1000)
+        {
+          event++;
+          converged = false;
+          streak = 0;
+        }
+
+      snr = sim_snr(ch, g_now / 1000);
+      ni.ni_rssi = snr < 0 ? 0 : snr > 100 ? 100 : (uint8_t)snr;
+
+      ieee80211_ratectl_choose(&ic, &ni, g_len, &chain);
+
+      /* Is the rate the algorithm settled on a good one? */
+
+      sim_bestrate(snr, g_len, &best);
+      if (sim_goodput(ni.ni_txrate, snr, g_len) >= SIM_TARGET * best)
+        {
+          good++;
+          if (streak++ == 0)
+            {
+              settle = g_now / 1000;
+            }
+
+          if (streak >= SIM_SETTLE && !converged)
+            {
+              converged = true;
+              res->converge += settle - events[event];
+              res->nconverged++;
+            }
+        }
+      else
+        {
+          streak = 0;
+        }
+
+      /* Walk the retry chain */
+
+      acked = false;
+      nattempts = 0;
+      for (i = 0; ; i++)
+        {
+          ridx = chain.rc_ridx[i];
+          for (k = 0; k < chain.rc_tries[i] && !acked; k++)
+            {
+              g_now += sim_airtime(g_rates[ridx], g_len, nattempts++);
+
+              if (burst)
+                {
+                  burst = sim_random() >= ch->burst_leave;
+                }
+              else
+                {
+                  burst = sim_random() < ch->burst_enter;
+                }
+
+              acked = sim_random() < sim_psuccess(ridx, snr, g_len) &&
+                      !(burst && sim_random() < ch->burst_loss);
+            }
+
+          if (acked || i + 1 >= chain.rc_nrates)
+            {
+              break;
+            }
+        }
+
+      txs.txs_len   = g_len;
+      txs.txs_final = i;
+      txs.txs_tries = k;
+      txs.txs_acked = acked;
+      ieee80211_ratectl_tx_complete(&ic, &ni, &chain, &txs);
+
+      frames++;
+      attempts += nattempts;
+      if (acked)
+        {
+          delivered++;
+          bytes += g_len - SIM_HDRLEN;
+          ieee80211_ratectl_input(&ic, &ni, ni.ni_rssi);
+        }
+    }
+
+  res->goodput = bytes * 8 / end;
+  res->retries = delivered > 0 ? (double)(attempts - delivered) / delivered
+                               : 0;
+  res->loss    = frames > 0 ? 100.0 * (frames - delivered) / frames : 0;
+  res->target  = frames > 0 ? 100.0 * good / frames : 0;
+  if (res->nconverged > 0)
+    {
+      res->converge /= res->nconverged;
+    }
+}
+
+static void sim_report(const struct sim_channel *ch)
+{
+  struct sim_result res;
+  unsigned int i;
+
+  printf("\n%s: %.1f s, oracle %.2f Mb/s\n", ch->name,
+         ch->t[ch->npoints - 1] / 1000, sim_oracle(ch, g_len));
+  printf("%-10s %10s %9s %8s %9s %12s\n", "algorithm", "goodput",
+         "retries", "loss %", "target %", "converge ms");
+
+  for (i = 0; i < sizeof(g_algs) / sizeof(g_algs[0]); i++)
+    {
+      sim_run(ch, &g_algs[i], &res);
+      printf("%-10s %10.2f %9.2f %8.2f %9.1f ", g_algs[i].name,
+             res.goodput, res.retries, res.loss, res.target);
+
+      if (res.nconverged > 0)
+        {
+          printf("%7.0f %u/%u\n", res.converge, res.nconverged,
+                 res.nevents);
+        }
+      else
+        {
+          printf("%7s %u/%u\n", "-", 0, res.nevents);
+        }
+    }
+}
+
+/* Built-in scenarios */
+
+static void sim_reset(struct sim_channel *ch, const char *name)
+{
+  memset(ch, 0, sizeof(*ch));
+  snprintf(ch->name, sizeof(ch->name), "%s", name);
+}
+
+static void sim_builtin(void)
+{
+  struct sim_channel *ch = &g_channel;
+  double d;
+  double t;
+
+  /* Good, stable link */
+
+  sim_reset(ch, "static 25 dB");
+  sim_point(ch, 0, 25);
+  sim_point(ch, 20000, 25);
+  sim_report(ch);
+
+  /* Walking away from the AP and back (log-distance path loss) */
+
+  sim_reset(ch, "walk 1-30 m");
+  for (t = 0; t <= 30000; t += 250)
+    {
+      d = 1 + 29 * (t <= 15000 ? t / 15000 : (30000 - t) / 15000);
+      sim_point(ch, t, 40 - 30 * log10(d));
+    }
+
+  sim_report(ch);
+
+  /* Sudden changes; measures convergence */
+
+  sim_reset(ch, "step 30/12/30 dB");
+  sim_point(ch, 0, 30);
+  sim_point(ch, 5000, 30);
+  sim_point(ch, 5000.001, 12);
+  sim_point(ch, 10000, 12);
+  sim_point(ch, 10000.001, 30);
+  sim_point(ch, 15000, 30);
+  sim_report(ch);
+
+  /* Fading bursts on an otherwise fine link */
+
+  sim_reset(ch, "bursty 20 dB");
+  sim_point(ch, 0, 20);
+  sim_point(ch, 20000, 20);
+  ch->burst_enter = 0.002;
+  ch->burst_leave = 0.05;
+  ch->burst_loss  = 0.9;
+  sim_report(ch);
+
+  /* A 10 msec interferer every 50 msec */
+
+  sim_reset(ch, "interference 24 dB");
+  sim_point(ch, 0, 24);
+  sim_point(ch, 20000, 24);
+  ch->intf_period = 50;
+  ch->intf_on     = 10;
+  ch->intf_db     = 12;
+  sim_report(ch);
+}
+
+static int sim_trace(const char *path)
+{
+  struct sim_channel *ch = &g_channel;
+  char line[128];
+  double t;
+  double snr;
+  FILE *fp;
+
+  fp = fopen(path, "r");
+  if (fp == NULL)
+    {
+      perror(path);
+      return -1;
+    }
+
+  sim_reset(ch, path);
+  while (fgets(line, sizeof(line), fp) != NULL)
+    {
+      if (line[0] != '#' && sscanf(line, "%lf %lf", &t, &snr) == 2)
+        {
+          sim_point(ch, t, snr);
+        }
+    }
+
+  fclose(fp);
+
+  if (ch->npoints < 2)
+    {
+      fprintf(stderr, "%s: need at least two points\n", path);
+      return -1;
+    }
+
+  sim_report(ch);
+  return 0;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  int ret = EXIT_SUCCESS;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:l:")) != -1)
+    {
+      switch (opt)
+        {
+        case 's':
+          g_seed = strtoull(optarg, NULL, 0);
+          break;
+
+        case 'l':
+          g_len = strtoul(optarg, NULL, 0);
+          if (g_len <= SIM_HDRLEN || g_len > 2346)
+            {
+              fprintf(stderr, "bad length %s\n", optarg);
+              return EXIT_FAILURE;
+            }
+          break;
+
+        default:
+          fprintf(stderr, "usage: %s [-s seed] [-l length] [trace ...]\n",
+                  argv[0]);
+          return EXIT_FAILURE;
+        }
+    }
+
+  printf("seed %llu, %u byte MPDUs\n", (unsigned long long)g_seed, g_len);
+
+  if (optind >= argc)
+    {
+      sim_builtin();
+    }
+
+  for (; optind < argc; optind++)
+    {
+      if (sim_trace(argv[optind]) < 0)
+        {
+          ret = EXIT_FAILURE;
+        }
+    }
+
+  return ret;
+}
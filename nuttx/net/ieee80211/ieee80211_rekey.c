@@ -0,0 +1,323 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_rekey.c
+ * Paced group key (GTK/IGTK) rekeying
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/net/uip/uip.h>
+
+#include "ieee80211/ieee80211_debug.h"
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_crypto.h"
+
+#ifdef CONFIG_IEEE80211_AP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Each message 1 costs a key wrap and a MIC; send the batches from the low
+ * priority work queue.  Without a work queue all stations are sent their
+ * message 1 at once, as before.
+ */
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+#  define REKEY_WORK  LPWORK
+#  define REKEY_BATCH CONFIG_IEEE80211_REKEY_BATCH
+#else
+#  define REKEY_BATCH UINT16_MAX
+#endif
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+static void ieee80211_rekey_worker(FAR void *arg);
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_rekey_complete
+ *
+ * Description:
+ *   All stations have the new group keys: install them and account for
+ *   the duration of the rekey.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_rekey_complete(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+  FAR struct ieee80211_rekey_stats *st = &rk->rk_stats;
+  uint32_t ms;
+
+  ms = TICK2MSEC(clock_systimer() - rk->rk_start);
+  st->rk_completed++;
+  st->rk_lastms = ms;
+  if (ms > st->rk_maxms)
+    {
+      st->rk_maxms = ms;
+    }
+
+  nvdbg("%s: group key rekey with %lu stations done in %lu ms\n",
+        ic->ic_ifname, (unsigned long)st->rk_stations, (unsigned long)ms);
+
+  ieee80211_rekey_cancel(ic);
+  ieee80211_setkeysdone(ic);
+}
+
+/****************************************************************************
+ * Name: ieee80211_rekey_mark
+ *
+ * Description:
+ *   Node iterator: include a station in the rekey.
+ *
+ ****************************************************************************/
+
+static void ieee80211_rekey_mark(FAR void *arg, FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+
+  if (ni->ni_state != IEEE80211_STA_ASSOC || ni->ni_rsn == NULL)
+    {
+      return;
+    }
+
+  if (ni->ni_rsn->rn_gstate == RSNA_IDLE)
+    {
+      ni->ni_flags |= IEEE80211_NODE_REKEY;
+    }
+
+  /* Stations still busy with the previous rekey report here as well */
+
+  if (ni->ni_flags & IEEE80211_NODE_REKEY)
+    {
+      ic->ic_rekey.rk_outstanding++;
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_rekey_node
+ *
+ * Description:
+ *   Node iterator: send message 1 of the group key handshake to a station
+ *   that is part of the rekey and has not been sent one yet, as long as
+ *   the batch allows.
+ *
+ ****************************************************************************/
+
+static void ieee80211_rekey_node(FAR void *arg, FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+
+  if ((ni->ni_flags & IEEE80211_NODE_REKEY) == 0 || ni->ni_rsn == NULL ||
+      ni->ni_rsn->rn_gstate != RSNA_IDLE)
+    {
+      return;
+    }
+
+  if (rk->rk_budget == 0)
+    {
+      rk->rk_more = true;
+      return;
+    }
+
+  rk->rk_budget--;
+  if (ieee80211_send_group_msg1(ic, ni) != 0)
+    {
+      /* Leave this station out rather than stall the rekey */
+
+      ieee80211_rekey_done(ic, ni);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_rekey_batch
+ *
+ * Description:
+ *   Send the next batch of messages 1 and schedule the one after it.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+static void ieee80211_rekey_batch(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+
+  rk->rk_budget = REKEY_BATCH;
+  rk->rk_more   = false;
+  ieee80211_iterate_nodes(ic, ieee80211_rekey_node, ic);
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+  if (rk->rk_active && rk->rk_more)
+    {
+      (void)work_queue(REKEY_WORK, &rk->rk_work, ieee80211_rekey_worker,
+                       ic, MSEC2TICK(CONFIG_IEEE80211_REKEY_INTERVAL));
+    }
+#endif
+}
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+/****************************************************************************
+ * Name: ieee80211_rekey_worker
+ ****************************************************************************/
+
+static void ieee80211_rekey_worker(FAR void *arg)
+{
+  FAR struct ieee80211_s *ic = (FAR struct ieee80211_s *)arg;
+  uip_lock_t lock;
+
+  lock = uip_lock();
+  if (ic->ic_rekey.rk_active)
+    {
+      ieee80211_rekey_batch(ic);
+    }
+
+  uip_unlock(lock);
+}
+#endif
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_rekey_start
+ *
+ * Description:
+ *   Distribute the new group keys generated by ieee80211_setkeys() to all
+ *   associated stations, CONFIG_IEEE80211_REKEY_BATCH stations every
+ *   CONFIG_IEEE80211_REKEY_INTERVAL milliseconds.  The keys are installed
+ *   when the last station has acknowledged them.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_rekey_start(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+
+  ieee80211_rekey_cancel(ic);
+
+  rk->rk_start  = clock_systimer();
+  rk->rk_active = true;
+  rk->rk_stats.rk_started++;
+
+  ieee80211_iterate_nodes(ic, ieee80211_rekey_mark, ic);
+  rk->rk_stats.rk_stations = rk->rk_outstanding;
+
+  if (rk->rk_outstanding == 0)
+    {
+      ieee80211_rekey_complete(ic);
+      return;
+    }
+
+  ieee80211_rekey_batch(ic);
+}
+
+/****************************************************************************
+ * Name: ieee80211_rekey_done
+ *
+ * Description:
+ *   A station has completed the group key handshake of a rekey, or left.
+ *
+ * Assumptions:
+ *   The network is locked.
+ *
+ ****************************************************************************/
+
+void ieee80211_rekey_done(FAR struct ieee80211_s *ic,
+                          FAR struct ieee80211_node *ni)
+{
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+
+  if ((ni->ni_flags & IEEE80211_NODE_REKEY) == 0)
+    {
+      return;
+    }
+
+  ni->ni_flags &= ~IEEE80211_NODE_REKEY;
+  if (rk->rk_active && rk->rk_outstanding > 0 && --rk->rk_outstanding == 0)
+    {
+      ieee80211_rekey_complete(ic);
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_rekey_cancel
+ *
+ * Description:
+ *   Stop sending messages 1 and forget the shared Key Data.
+ *
+ ****************************************************************************/
+
+void ieee80211_rekey_cancel(FAR struct ieee80211_s *ic)
+{
+  FAR struct ieee80211_rekey_s *rk = &ic->ic_rekey;
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+  (void)work_cancel(REKEY_WORK, &rk->rk_work);
+#endif
+  rk->rk_active      = false;
+  rk->rk_outstanding = 0;
+  memset(rk->rk_kdelen, 0, sizeof(rk->rk_kdelen));
+  memset(rk->rk_kde, 0, sizeof(rk->rk_kde));
+}
+
+#endif /* CONFIG_IEEE80211_AP */
@@ -0,0 +1,541 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_reorder.c
+ * A-MPDU receive reordering (see 9.10.7.6)
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wdog.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/net/iob.h>
+
+#include "ieee80211/ieee80211_var.h"
+#include "ieee80211/ieee80211_priv.h"
+
+#ifdef CONFIG_IEEE80211_HT
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+/* Total number of reordering slots shared by all Block Ack agreements.
+ * Each agreement takes exactly ba_winsize contiguous slots.
+ */
+
+#ifndef CONFIG_IEEE80211_BA_NSLOTS
+#  define CONFIG_IEEE80211_BA_NSLOTS 256
+#endif
+
+#define BA_POOL_WORDS ((CONFIG_IEEE80211_BA_NSLOTS + 31) / 32)
+
+/* Count trailing zeros of a non-zero 32-bit word */
+
+#ifdef __GNUC__
+#  define ba_ctz(x) __builtin_ctz(x)
+#else
+#  define ba_ctz(x) ieee80211_ctz(x)
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* The reordering slot pool and its allocation bitmap (1 = in use) */
+
+static struct ieee80211_ba_slot g_ba_slots[CONFIG_IEEE80211_BA_NSLOTS];
+static uint32_t g_ba_slotmap[BA_POOL_WORDS];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifndef __GNUC__
+static int ieee80211_ctz(uint32_t x)
+{
+  int n = 0;
+
+  while ((x & 1) == 0)
+    {
+      x >>= 1;
+      n++;
+    }
+
+  return n;
+}
+#endif
+
+/****************************************************************************
+ * Name: ieee80211_ba_slotmap
+ *
+ * Description:
+ *   Mark slots [first, first + n) of the pool as used or free.
+ *
+ ****************************************************************************/
+
+static void ieee80211_ba_slotmap(unsigned int first, unsigned int n,
+                                 bool used)
+{
+  unsigned int i;
+
+  for (i = first; i < first + n; i++)
+    {
+      if (used)
+        {
+          g_ba_slotmap[i >> 5] |= (uint32_t)1 << (i & 31);
+        }
+      else
+        {
+          g_ba_slotmap[i >> 5] &= ~((uint32_t)1 << (i & 31));
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: ieee80211_ba_slot
+ *
+ * Description:
+ *   Return the slot holding the MPDU at offset 'off' from WinStartB.
+ *
+ ****************************************************************************/
+
+static inline FAR struct ieee80211_ba_slot *
+ieee80211_ba_slot(FAR struct ieee80211_rx_ba *ba, unsigned int head,
+                  unsigned int off)
+{
+  unsigned int idx = head + off;
+
+  if (idx >= ba->ba_winsize)
+    {
+      idx -= ba->ba_winsize;
+    }
+
+  return &ba->ba_buf[idx];
+}
+
+/****************************************************************************
+ * Name: ieee80211_ba_run
+ *
+ * Description:
+ *   Return the number of MPDUs buffered back to back from WinStartB, i.e.
+ *   the length of the in-order run that can be released.
+ *
+ ****************************************************************************/
+
+static unsigned int ieee80211_ba_run(FAR struct ieee80211_rx_ba *ba)
+{
+  unsigned int n = 0;
+  int i;
+
+  for (i = 0; i < IEEE80211_BA_BITMAP_WORDS; i++)
+    {
+      if (ba->ba_bitmap[i] != UINT32_MAX)
+        {
+          n += ba_ctz(~ba->ba_bitmap[i]);
+          break;
+        }
+
+      n += 32;
+    }
+
+  return n < ba->ba_winsize ? n : ba->ba_winsize;
+}
+
+/****************************************************************************
+ * Name: ieee80211_ba_advance
+ *
+ * Description:
+ *   Move WinStartB forward by 'n' (n <= ba_winsize) and pass the MPDUs
+ *   buffered in the 'n' released positions up to the next MAC process.
+ *   The window state is updated and the released MPDUs are taken out of
+ *   their slots, in sequence order, for the whole run first; buffered MPDUs
+ *   are located with count-trailing-zeros so that gaps cost nothing.  The
+ *   run is then handed up in one pass, with the network locked throughout.
+ *
+ * Returned Value:
+ *   true if the agreement is still in place; false if it was torn down
+ *   (and possibly set up again) by the upper layers.
+ *
+ ****************************************************************************/
+
+static bool ieee80211_ba_advance(FAR struct ieee80211_s *ic,
+                                 FAR struct ieee80211_node *ni,
+                                 FAR struct ieee80211_rx_ba *ba,
+                                 unsigned int n)
+{
+  uint32_t released[IEEE80211_BA_BITMAP_WORDS];
+  FAR struct ieee80211_ba_slot *buf = ba->ba_buf;
+  FAR struct ieee80211_ba_slot *slot;
+  FAR struct ieee80211_pkthdr *ph;
+  FAR struct ieee80211_pkthdr *tail = NULL;
+  struct ieee80211_rxinfo rxi;
+  FAR struct iob_s *run = NULL;
+  FAR struct iob_s *iob;
+  unsigned int head = ba->ba_head;
+  unsigned int words = n >> 5;
+  unsigned int bits = n & 31;
+  unsigned int off;
+  uint8_t gen = ba->ba_gen;
+  uint32_t lo;
+  uint32_t hi;
+  int i;
+
+  if (n == 0)
+    {
+      return true;
+    }
+
+  /* Split the occupancy bitmap into the released part and the remainder,
+   * which is shifted down so that bit 0 is the new WinStartB.
+   */
+
+  for (i = 0; i < IEEE80211_BA_BITMAP_WORDS; i++)
+    {
+      if (i < words)
+        {
+          released[i] = ba->ba_bitmap[i];
+        }
+      else if (i == words && bits != 0)
+        {
+          released[i] = ba->ba_bitmap[i] & (((uint32_t)1 << bits) - 1);
+        }
+      else
+        {
+          released[i] = 0;
+        }
+
+      lo = i + words < IEEE80211_BA_BITMAP_WORDS ?
+           ba->ba_bitmap[i + words] : 0;
+      hi = i + words + 1 < IEEE80211_BA_BITMAP_WORDS ?
+           ba->ba_bitmap[i + words + 1] : 0;
+      ba->ba_bitmap[i] = bits != 0 ? (lo >> bits) | (hi << (32 - bits)) : lo;
+    }
+
+  ba->ba_head = ieee80211_ba_slot(ba, head, n) - buf;
+  ba->ba_winstart = (ba->ba_winstart + n) & 0xfff;
+
+  /* Collect the released MPDUs in sequence order.  Only MPDUs with a
+   * packet header are ever buffered.
+   */
+
+  for (i = 0; i < IEEE80211_BA_BITMAP_WORDS; i++)
+    {
+      while (released[i] != 0)
+        {
+          off = (i << 5) + ba_ctz(released[i]);
+          released[i] &= released[i] - 1;
+
+          slot = ieee80211_ba_slot(ba, head, off);
+          iob  = slot->bs_iob;
+          slot->bs_iob = NULL;
+
+          ph = IEEE80211_PKTHDR(iob);
+          ph->ph_next = NULL;
+          if (tail == NULL)
+            {
+              run = iob;
+            }
+          else
+            {
+              tail->ph_next = iob;
+            }
+
+          tail = ph;
+        }
+    }
+
+  /* Then hand the run up */
+
+  while (run != NULL)
+    {
+      iob = run;
+      ph  = IEEE80211_PKTHDR(iob);
+      run = ph->ph_next;
+      rxi = ph->ph_rxi;
+
+      ieee80211_input(ic, iob, ni, &rxi);
+
+      /* Stop if the agreement was torn down by the upper layers, and drop
+       * the rest of the run with it.  The slots may have been handed out
+       * again at the same address, so the generation is checked too.
+       */
+
+      if (ba->ba_buf != buf || ba->ba_gen != gen)
+        {
+          while (run != NULL)
+            {
+              iob = run;
+              run = IEEE80211_PKTHDR(iob)->ph_next;
+              iob_free_chain(iob);
+            }
+
+          return false;
+        }
+    }
+
+  return true;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_reorder_alloc
+ *
+ * Description:
+ *   Allocate ba_winsize reordering slots for a new Block Ack agreement.
+ *   ba_winsize and ba_winstart must already be set.
+ *
+ * Returned Value:
+ *   OK on success; -ENOMEM if the slot pool cannot satisfy the request.
+ *
+ ****************************************************************************/
+
+int ieee80211_reorder_alloc(FAR struct ieee80211_rx_ba *ba)
+{
+  unsigned int first = 0;
+  unsigned int run = 0;
+  unsigned int i;
+
+  DEBUGASSERT(ba->ba_buf == NULL && ba->ba_winsize > 0 &&
+              ba->ba_winsize <= IEEE80211_BA_MAX_WINSZ);
+
+  /* First fit.  This only runs when an ADDBA Request is accepted. */
+
+  for (i = 0; i < CONFIG_IEEE80211_BA_NSLOTS && run < ba->ba_winsize; i++)
+    {
+      if ((g_ba_slotmap[i >> 5] & ((uint32_t)1 << (i & 31))) != 0)
+        {
+          run = 0;
+        }
+      else if (run++ == 0)
+        {
+          first = i;
+        }
+    }
+
+  if (run < ba->ba_winsize)
+    {
+      return -ENOMEM;
+    }
+
+  ieee80211_ba_slotmap(first, ba->ba_winsize, true);
+
+  ba->ba_buf  = &g_ba_slots[first];
+  ba->ba_head = 0;
+  memset(ba->ba_buf, 0, ba->ba_winsize * sizeof(struct ieee80211_ba_slot));
+  memset(ba->ba_bitmap, 0, sizeof(ba->ba_bitmap));
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ieee80211_reorder_free
+ *
+ * Description:
+ *   Discard the MPDUs buffered for a Block Ack agreement and return its
+ *   slots to the pool.  ieee80211_ba_advance() drops the MPDUs it has
+ *   released but not yet handed up when it notices.
+ *
+ ****************************************************************************/
+
+void ieee80211_reorder_free(FAR struct ieee80211_rx_ba *ba)
+{
+  FAR struct ieee80211_ba_slot *slot;
+  unsigned int i;
+
+  if (ba->ba_buf == NULL)
+    {
+      return;
+    }
+
+  for (i = 0; i < ba->ba_winsize; i++)
+    {
+      slot = &ba->ba_buf[i];
+      if (slot->bs_iob != NULL)
+        {
+          iob_free_chain(slot->bs_iob);
+          slot->bs_iob = NULL;
+        }
+    }
+
+  memset(ba->ba_bitmap, 0, sizeof(ba->ba_bitmap));
+  ieee80211_ba_slotmap(ba->ba_buf - g_ba_slots, ba->ba_winsize, false);
+  ba->ba_buf = NULL;
+  ba->ba_gen++;
+}
+
+/* Process a received data MPDU related to a specific HT-immediate Block Ack
+ * agreement (see 9.10.7.6).
+ */
+
+void ieee80211_input_ba(struct ieee80211_s *ic, struct iob_s *iob,
+                        struct ieee80211_node *ni, int tid,
+                        struct ieee80211_rxinfo *rxi)
+{
+  struct ieee80211_rx_ba *ba = &ni->ni_ba->nb_rx[tid];
+  struct ieee80211_frame *wh;
+  FAR struct ieee80211_ba_slot *slot;
+  FAR struct ieee80211_pkthdr *ph;
+  unsigned int count;
+  unsigned int off;
+  uint16_t sn;
+
+  wh = (FAR struct ieee80211_frame *)IOB_DATA(iob);
+  sn = letoh16(*(uint16_t *) wh->i_seq) >> IEEE80211_SEQ_SEQ_SHIFT;
+
+  /* reset Block Ack inactivity timer */
+
+  wd_start(ba->ba_to, USEC2TICK(ba->ba_timeout_val), ieee80211_rx_ba_timeout, 1,
+           ba);
+
+  if (SEQ_LT(sn, ba->ba_winstart))
+    {
+      /* SN < WinStartB, discard the MPDU */
+
+      ic->ic_reorder_stats.rs_stale++;
+      iob_free_chain(iob);
+      return;
+    }
+
+  if (SEQ_LT(ba->ba_winend, sn))
+    {
+      /* WinEndB < SN: flush everything that falls out of the window, gaps
+       * may exist.
+       */
+
+      count = (sn - ba->ba_winend) & 0xfff;
+      if (count > ba->ba_winsize)       /* no overlap */
+        {
+          count = ba->ba_winsize;
+        }
+
+      if (!ieee80211_ba_advance(ic, ni, ba, count))
+        {
+          iob_free_chain(iob);
+          return;
+        }
+
+      /* Move window forward */
+
+      ba->ba_winstart = (sn - ba->ba_winsize + 1) & 0xfff;
+    }
+
+  /* WinStartB <= SN <= WinEndB */
+
+  off = (sn - ba->ba_winstart) & 0xfff;
+  if ((ba->ba_bitmap[off >> 5] & ((uint32_t)1 << (off & 31))) != 0)
+    {
+      /* Duplicate */
+
+      ic->ic_reorder_stats.rs_dups++;
+      iob_free_chain(iob);
+      return;
+    }
+
+  /* Store the received MPDU in the buffer, its Rx meta-data goes along in
+   * the packet header.
+   */
+
+  ph = IEEE80211_PKTHDR_GET(iob);
+  if (ph == NULL)
+    {
+      iob_free_chain(iob);
+      return;
+    }
+
+  rxi->rxi_flags |= IEEE80211_RXI_AMPDU_DONE;
+  ph->ph_rxi = *rxi;
+
+  slot = ieee80211_ba_slot(ba, ba->ba_head, off);
+  slot->bs_iob = iob;
+  ba->ba_bitmap[off >> 5] |= (uint32_t)1 << (off & 31);
+
+  /* Pass the in-order run of reordered MPDUs up to the next MAC process */
+
+  if (ieee80211_ba_advance(ic, ni, ba, ieee80211_ba_run(ba)))
+    {
+      ba->ba_winend = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
+    }
+}
+
+/* Change the value of WinStartB (move window forward) upon reception of a
+ * BlockAckReq frame or an ADDBA Request (PBAC).
+ */
+
+void ieee80211_ba_move_window(struct ieee80211_s *ic,
+                              struct ieee80211_node *ni, uint8_t tid,
+                              uint16_t ssn)
+{
+  struct ieee80211_rx_ba *ba = &ni->ni_ba->nb_rx[tid];
+  unsigned int count;
+
+  /* assert(WinStartB <= SSN) */
+
+  count = (ssn - ba->ba_winstart) & 0xfff;
+  if (count > ba->ba_winsize)   /* no overlap */
+    {
+      count = ba->ba_winsize;
+    }
+
+  if (!ieee80211_ba_advance(ic, ni, ba, count))
+    {
+      return;
+    }
+
+  /* Move window forward */
+
+  ba->ba_winstart = ssn;
+
+  /* Pass reordered MPDUs up to the next MAC process */
+
+  if (ieee80211_ba_advance(ic, ni, ba, ieee80211_ba_run(ba)))
+    {
+      ba->ba_winend = (ba->ba_winstart + ba->ba_winsize - 1) & 0xfff;
+    }
+}
+
+#endif /* CONFIG_IEEE80211_HT */
@@ -0,0 +1,459 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_rijndael.c
+ * AES (Rijndael) block cipher, encryption direction only (FIPS-197).
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ieee80211_rijndael.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* A single 1KiB T-table is used.  The other three tables of the classic
+ * four-table implementation are byte rotations of the first; the rotate
+ * is free (or nearly so) on the targets we care about and saves 3KiB of
+ * FLASH and data cache.
+ */
+
+#define ROTR(x,n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define TE0(x)     (g_te0[(x)])
+#define TE1(x)     ROTR(g_te0[(x)], 8)
+#define TE2(x)     ROTR(g_te0[(x)], 16)
+#define TE3(x)     ROTR(g_te0[(x)], 24)
+
+/* The S-box value is embedded in each T-table entry */
+
+#define SBOX(x)    ((g_te0[(x)] >> 8) & 0xff)
+
+#define GETU32(p) \
+  (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+   ((uint32_t)(p)[2] <<  8) | ((uint32_t)(p)[3]))
+
+#define PUTU32(p,v) \
+  do \
+    { \
+      (p)[0] = (uint8_t)((v) >> 24); \
+      (p)[1] = (uint8_t)((v) >> 16); \
+      (p)[2] = (uint8_t)((v) >>  8); \
+      (p)[3] = (uint8_t)(v); \
+    } \
+  while (0)
+
+/* One full round (SubBytes, ShiftRows, MixColumns, AddRoundKey) from state
+ * s0-s3 into t0-t3 with round key rk[0-3].
+ */
+
+#define AES_ROUND(t0,t1,t2,t3,s0,s1,s2,s3,rk) \
+  do \
+    { \
+      (t0) = TE0((s0) >> 24) ^ TE1(((s1) >> 16) & 0xff) ^ \
+             TE2(((s2) >> 8) & 0xff) ^ TE3((s3) & 0xff) ^ (rk)[0]; \
+      (t1) = TE0((s1) >> 24) ^ TE1(((s2) >> 16) & 0xff) ^ \
+             TE2(((s3) >> 8) & 0xff) ^ TE3((s0) & 0xff) ^ (rk)[1]; \
+      (t2) = TE0((s2) >> 24) ^ TE1(((s3) >> 16) & 0xff) ^ \
+             TE2(((s0) >> 8) & 0xff) ^ TE3((s1) & 0xff) ^ (rk)[2]; \
+      (t3) = TE0((s3) >> 24) ^ TE1(((s0) >> 16) & 0xff) ^ \
+             TE2(((s1) >> 8) & 0xff) ^ TE3((s2) & 0xff) ^ (rk)[3]; \
+    } \
+  while (0)
+
+/* Final round (no MixColumns) from state s0-s3, stored to 'dst' */
+
+#define AES_FINAL(dst,s0,s1,s2,s3,rk) \
+  do \
+    { \
+      PUTU32((dst), \
+             (SBOX((s0) >> 24) << 24) ^ (SBOX(((s1) >> 16) & 0xff) << 16) ^ \
+             (SBOX(((s2) >> 8) & 0xff) << 8) ^ SBOX((s3) & 0xff) ^ (rk)[0]); \
+      PUTU32((dst) + 4, \
+             (SBOX((s1) >> 24) << 24) ^ (SBOX(((s2) >> 16) & 0xff) << 16) ^ \
+             (SBOX(((s3) >> 8) & 0xff) << 8) ^ SBOX((s0) & 0xff) ^ (rk)[1]); \
+      PUTU32((dst) + 8, \
+             (SBOX((s2) >> 24) << 24) ^ (SBOX(((s3) >> 16) & 0xff) << 16) ^ \
+             (SBOX(((s0) >> 8) & 0xff) << 8) ^ SBOX((s1) & 0xff) ^ (rk)[2]); \
+      PUTU32((dst) + 12, \
+             (SBOX((s3) >> 24) << 24) ^ (SBOX(((s0) >> 16) & 0xff) << 16) ^ \
+             (SBOX(((s1) >> 8) & 0xff) << 8) ^ SBOX((s2) & 0xff) ^ (rk)[3]); \
+    } \
+  while (0)
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Te0[x] = S[x].[02, 01, 01, 03] */
+
+static const uint32_t g_te0[256] =
+{
+  0xc66363a5U, 0xf87c7c84U, 0xee777799U, 0xf67b7b8dU,
+  0xfff2f20dU, 0xd66b6bbdU, 0xde6f6fb1U, 0x91c5c554U,
+  0x60303050U, 0x02010103U, 0xce6767a9U, 0x562b2b7dU,
+  0xe7fefe19U, 0xb5d7d762U, 0x4dababe6U, 0xec76769aU,
+  0x8fcaca45U, 0x1f82829dU, 0x89c9c940U, 0xfa7d7d87U,
+  0xeffafa15U, 0xb25959ebU, 0x8e4747c9U, 0xfbf0f00bU,
+  0x41adadecU, 0xb3d4d467U, 0x5fa2a2fdU, 0x45afafeaU,
+  0x239c9cbfU, 0x53a4a4f7U, 0xe4727296U, 0x9bc0c05bU,
+  0x75b7b7c2U, 0xe1fdfd1cU, 0x3d9393aeU, 0x4c26266aU,
+  0x6c36365aU, 0x7e3f3f41U, 0xf5f7f702U, 0x83cccc4fU,
+  0x6834345cU, 0x51a5a5f4U, 0xd1e5e534U, 0xf9f1f108U,
+  0xe2717193U, 0xabd8d873U, 0x62313153U, 0x2a15153fU,
+  0x0804040cU, 0x95c7c752U, 0x46232365U, 0x9dc3c35eU,
+  0x30181828U, 0x379696a1U, 0x0a05050fU, 0x2f9a9ab5U,
+  0x0e070709U, 0x24121236U, 0x1b80809bU, 0xdfe2e23dU,
+  0xcdebeb26U, 0x4e272769U, 0x7fb2b2cdU, 0xea75759fU,
+  0x1209091bU, 0x1d83839eU, 0x582c2c74U, 0x341a1a2eU,
+  0x361b1b2dU, 0xdc6e6eb2U, 0xb45a5aeeU, 0x5ba0a0fbU,
+  0xa45252f6U, 0x763b3b4dU, 0xb7d6d661U, 0x7db3b3ceU,
+  0x5229297bU, 0xdde3e33eU, 0x5e2f2f71U, 0x13848497U,
+  0xa65353f5U, 0xb9d1d168U, 0x00000000U, 0xc1eded2cU,
+  0x40202060U, 0xe3fcfc1fU, 0x79b1b1c8U, 0xb65b5bedU,
+  0xd46a6abeU, 0x8dcbcb46U, 0x67bebed9U, 0x7239394bU,
+  0x944a4adeU, 0x984c4cd4U, 0xb05858e8U, 0x85cfcf4aU,
+  0xbbd0d06bU, 0xc5efef2aU, 0x4faaaae5U, 0xedfbfb16U,
+  0x864343c5U, 0x9a4d4dd7U, 0x66333355U, 0x11858594U,
+  0x8a4545cfU, 0xe9f9f910U, 0x04020206U, 0xfe7f7f81U,
+  0xa05050f0U, 0x783c3c44U, 0x259f9fbaU, 0x4ba8a8e3U,
+  0xa25151f3U, 0x5da3a3feU, 0x804040c0U, 0x058f8f8aU,
+  0x3f9292adU, 0x219d9dbcU, 0x70383848U, 0xf1f5f504U,
+  0x63bcbcdfU, 0x77b6b6c1U, 0xafdada75U, 0x42212163U,
+  0x20101030U, 0xe5ffff1aU, 0xfdf3f30eU, 0xbfd2d26dU,
+  0x81cdcd4cU, 0x180c0c14U, 0x26131335U, 0xc3ecec2fU,
+  0xbe5f5fe1U, 0x359797a2U, 0x884444ccU, 0x2e171739U,
+  0x93c4c457U, 0x55a7a7f2U, 0xfc7e7e82U, 0x7a3d3d47U,
+  0xc86464acU, 0xba5d5de7U, 0x3219192bU, 0xe6737395U,
+  0xc06060a0U, 0x19818198U, 0x9e4f4fd1U, 0xa3dcdc7fU,
+  0x44222266U, 0x542a2a7eU, 0x3b9090abU, 0x0b888883U,
+  0x8c4646caU, 0xc7eeee29U, 0x6bb8b8d3U, 0x2814143cU,
+  0xa7dede79U, 0xbc5e5ee2U, 0x160b0b1dU, 0xaddbdb76U,
+  0xdbe0e03bU, 0x64323256U, 0x743a3a4eU, 0x140a0a1eU,
+  0x924949dbU, 0x0c06060aU, 0x4824246cU, 0xb85c5ce4U,
+  0x9fc2c25dU, 0xbdd3d36eU, 0x43acacefU, 0xc46262a6U,
+  0x399191a8U, 0x319595a4U, 0xd3e4e437U, 0xf279798bU,
+  0xd5e7e732U, 0x8bc8c843U, 0x6e373759U, 0xda6d6db7U,
+  0x018d8d8cU, 0xb1d5d564U, 0x9c4e4ed2U, 0x49a9a9e0U,
+  0xd86c6cb4U, 0xac5656faU, 0xf3f4f407U, 0xcfeaea25U,
+  0xca6565afU, 0xf47a7a8eU, 0x47aeaee9U, 0x10080818U,
+  0x6fbabad5U, 0xf0787888U, 0x4a25256fU, 0x5c2e2e72U,
+  0x381c1c24U, 0x57a6a6f1U, 0x73b4b4c7U, 0x97c6c651U,
+  0xcbe8e823U, 0xa1dddd7cU, 0xe874749cU, 0x3e1f1f21U,
+  0x964b4bddU, 0x61bdbddcU, 0x0d8b8b86U, 0x0f8a8a85U,
+  0xe0707090U, 0x7c3e3e42U, 0x71b5b5c4U, 0xcc6666aaU,
+  0x904848d8U, 0x06030305U, 0xf7f6f601U, 0x1c0e0e12U,
+  0xc26161a3U, 0x6a35355fU, 0xae5757f9U, 0x69b9b9d0U,
+  0x17868691U, 0x99c1c158U, 0x3a1d1d27U, 0x279e9eb9U,
+  0xd9e1e138U, 0xebf8f813U, 0x2b9898b3U, 0x22111133U,
+  0xd26969bbU, 0xa9d9d970U, 0x078e8e89U, 0x339494a7U,
+  0x2d9b9bb6U, 0x3c1e1e22U, 0x15878792U, 0xc9e9e920U,
+  0x87cece49U, 0xaa5555ffU, 0x50282878U, 0xa5dfdf7aU,
+  0x038c8c8fU, 0x59a1a1f8U, 0x09898980U, 0x1a0d0d17U,
+  0x65bfbfdaU, 0xd7e6e631U, 0x844242c6U, 0xd06868b8U,
+  0x824141c3U, 0x299999b0U, 0x5a2d2d77U, 0x1e0f0f11U,
+  0x7bb0b0cbU, 0xa85454fcU, 0x6dbbbbd6U, 0x2c16163aU
+};
+
+/* Round constants for the key expansion */
+
+static const uint32_t g_rcon[10] =
+{
+  0x01000000, 0x02000000, 0x04000000, 0x08000000, 0x10000000,
+  0x20000000, 0x40000000, 0x80000000, 0x1b000000, 0x36000000
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: rijndael_subword
+ *
+ * Description:
+ *   Apply the S-box to each byte of a key schedule word.
+ *
+ ****************************************************************************/
+
+static inline uint32_t rijndael_subword(uint32_t w)
+{
+  return (SBOX(w >> 24) << 24) ^ (SBOX((w >> 16) & 0xff) << 16) ^
+         (SBOX((w >> 8) & 0xff) << 8) ^ SBOX(w & 0xff);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: rijndael_set_key_enc_only
+ *
+ * Description:
+ *   Expand a 128, 192 or 256-bit key into an encryption key schedule.
+ *
+ * Returned Value:
+ *   Zero on success; -1 if the key size is not supported.
+ *
+ ****************************************************************************/
+
+int rijndael_set_key_enc_only(FAR rijndael_ctx *ctx, FAR const uint8_t *key,
+                              int bits)
+{
+  FAR uint32_t *rk = ctx->ek;
+  uint32_t temp;
+  int nk;
+  int nw;
+  int i;
+
+  switch (bits)
+    {
+    case 128:
+      nk = 4;
+      break;
+
+    case 192:
+      nk = 6;
+      break;
+
+    case 256:
+      nk = 8;
+      break;
+
+    default:
+      return -1;
+    }
+
+  ctx->nr = nk + 6;
+  nw      = 4 * (ctx->nr + 1);
+
+  for (i = 0; i < nk; i++)
+    {
+      rk[i] = GETU32(key + 4 * i);
+    }
+
+  for (i = nk; i < nw; i++)
+    {
+      temp = rk[i - 1];
+      if (i % nk == 0)
+        {
+          temp = rijndael_subword(ROTR(temp, 24)) ^ g_rcon[i / nk - 1];
+        }
+      else if (nk > 6 && i % nk == 4)
+        {
+          temp = rijndael_subword(temp);
+        }
+
+      rk[i] = rk[i - nk] ^ temp;
+    }
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: rijndael_encrypt
+ *
+ * Description:
+ *   Encrypt one 16-byte block.  'src' and 'dst' may be the same buffer.
+ *
+ ****************************************************************************/
+
+void rijndael_encrypt(FAR const rijndael_ctx *ctx, FAR const uint8_t *src,
+                      FAR uint8_t *dst)
+{
+  FAR const uint32_t *rk = ctx->ek;
+  uint32_t s0;
+  uint32_t s1;
+  uint32_t s2;
+  uint32_t s3;
+  uint32_t t0;
+  uint32_t t1;
+  uint32_t t2;
+  uint32_t t3;
+  int r;
+
+  s0 = GETU32(src)      ^ rk[0];
+  s1 = GETU32(src +  4) ^ rk[1];
+  s2 = GETU32(src +  8) ^ rk[2];
+  s3 = GETU32(src + 12) ^ rk[3];
+
+  /* nr - 1 full rounds */
+
+  for (r = ctx->nr - 1; r > 0; r--)
+    {
+      rk += 4;
+      AES_ROUND(t0, t1, t2, t3, s0, s1, s2, s3, rk);
+
+      s0 = t0;
+      s1 = t1;
+      s2 = t2;
+      s3 = t3;
+    }
+
+  /* Final round (no MixColumns) */
+
+  rk += 4;
+  AES_FINAL(dst, s0, s1, s2, s3, rk);
+}
+
+/****************************************************************************
+ * Name: rijndael_encrypt_ctr
+ *
+ * Description:
+ *   Produce 'nblocks' consecutive blocks of counter mode key stream into
+ *   'dst'.  After each block the big-endian 16-bit counter held in the last
+ *   two bytes of 'ctr' (the CCM counter with L = 2) is incremented, so on
+ *   return 'ctr' holds the next unused counter block.
+ *
+ *   Only the low 16 bits of the counter block change, so the first round
+ *   is computed once:  of its 16 table lookups only the two that depend on
+ *   the counter are done per block.  The remaining rounds of two blocks
+ *   are interleaved; the blocks are independent, so the table loads of one
+ *   overlap with the arithmetic of the other.
+ *
+ ****************************************************************************/
+
+void rijndael_encrypt_ctr(FAR const rijndael_ctx *ctx, FAR uint8_t *ctr,
+                          FAR uint8_t *dst, unsigned int nblocks)
+{
+  FAR const uint32_t *rk = ctx->ek;
+  FAR const uint32_t *rkr;
+  uint16_t count = ((uint16_t)ctr[14] << 8) | ctr[15];
+  uint32_t c0;
+  uint32_t c1;
+  uint32_t c2;
+  uint32_t c3;
+  uint32_t lo;
+  uint32_t x;
+  uint32_t s0;
+  uint32_t s1;
+  uint32_t s2;
+  uint32_t s3;
+  uint32_t t0;
+  uint32_t t1;
+  uint32_t t2;
+  uint32_t t3;
+  uint32_t u0;
+  uint32_t u1;
+  uint32_t u2;
+  uint32_t u3;
+  uint32_t v0;
+  uint32_t v1;
+  uint32_t v2;
+  uint32_t v3;
+  int r;
+
+  /* Initial AddRoundKey and the constant part of the first round.  The
+   * counter occupies the two low bytes of s3, which feed only TE3() of c0
+   * and TE2() of c1.
+   */
+
+  s0 = GETU32(ctr)      ^ rk[0];
+  s1 = GETU32(ctr +  4) ^ rk[1];
+  s2 = GETU32(ctr +  8) ^ rk[2];
+  s3 = GETU32(ctr + 12) ^ rk[3];
+  lo = rk[3] & 0xffff;
+
+  c0 = TE0(s0 >> 24) ^ TE1((s1 >> 16) & 0xff) ^
+       TE2((s2 >> 8) & 0xff) ^ rk[4];
+  c1 = TE0(s1 >> 24) ^ TE1((s2 >> 16) & 0xff) ^
+       TE3(s0 & 0xff) ^ rk[5];
+  c2 = TE0(s2 >> 24) ^ TE1((s3 >> 16) & 0xff) ^
+       TE2((s0 >> 8) & 0xff) ^ TE3(s1 & 0xff) ^ rk[6];
+  c3 = TE0(s3 >> 24) ^ TE1((s0 >> 16) & 0xff) ^
+       TE2((s1 >> 8) & 0xff) ^ TE3(s2 & 0xff) ^ rk[7];
+
+  while (nblocks > 0)
+    {
+      /* Finish the first round of blocks 'count' and 'count + 1' */
+
+      x  = count ^ lo;
+      s0 = c0 ^ TE3(x & 0xff);
+      s1 = c1 ^ TE2(x >> 8);
+      s2 = c2;
+      s3 = c3;
+
+      x  = (uint16_t)(count + 1) ^ lo;
+      t0 = c0 ^ TE3(x & 0xff);
+      t1 = c1 ^ TE2(x >> 8);
+      t2 = c2;
+      t3 = c3;
+
+      /* Rounds 2 to nr - 1 */
+
+      rkr = rk + 8;
+      for (r = ctx->nr - 2; r > 0; r--)
+        {
+          AES_ROUND(u0, u1, u2, u3, s0, s1, s2, s3, rkr);
+          AES_ROUND(v0, v1, v2, v3, t0, t1, t2, t3, rkr);
+
+          s0 = u0;
+          s1 = u1;
+          s2 = u2;
+          s3 = u3;
+          t0 = v0;
+          t1 = v1;
+          t2 = v2;
+          t3 = v3;
+          rkr += 4;
+        }
+
+      /* Final round.  The second state of an odd last block is dropped. */
+
+      if (nblocks >= 2)
+        {
+          AES_FINAL(dst, s0, s1, s2, s3, rkr);
+          AES_FINAL(dst + AES_BLOCK_SIZE, t0, t1, t2, t3, rkr);
+          dst     += 2 * AES_BLOCK_SIZE;
+          count   += 2;
+          nblocks -= 2;
+        }
+      else
+        {
+          AES_FINAL(dst, s0, s1, s2, s3, rkr);
+          count++;
+          nblocks = 0;
+        }
+    }
+
+  ctr[14] = (uint8_t)(count >> 8);
+  ctr[15] = (uint8_t)count;
+}
@@ -0,0 +1,116 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_rijndael.h
+ * AES (Rijndael) block cipher, encryption direction only.
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_RIJNDAEL_H
+#define __NET_IEEE80211_IEEE80211_RIJNDAEL_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#else
+#  define FAR
+#endif
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define AES_BLOCK_SIZE   16   /* Size of one cipher block in bytes */
+#define AES_MAXROUNDS    14   /* Rounds for a 256-bit key */
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Expanded encryption key schedule.  The schedule is computed once when
+ * the key is installed and then reused for every block.
+ */
+
+typedef struct
+{
+  int      nr;                               /* Number of rounds */
+  uint32_t ek[4 * (AES_MAXROUNDS + 1)];      /* Encryption round keys */
+} rijndael_ctx;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: rijndael_set_key_enc_only
+ *
+ * Description:
+ *   Expand a 128, 192 or 256-bit key into an encryption key schedule.
+ *
+ * Returned Value:
+ *   Zero on success; -1 if the key size is not supported.
+ *
+ ****************************************************************************/
+
+int rijndael_set_key_enc_only(FAR rijndael_ctx *ctx, FAR const uint8_t *key,
+                              int bits);
+
+/****************************************************************************
+ * Name: rijndael_encrypt
+ *
+ * Description:
+ *   Encrypt one 16-byte block.  'src' and 'dst' may be the same buffer.
+ *
+ ****************************************************************************/
+
+void rijndael_encrypt(FAR const rijndael_ctx *ctx, FAR const uint8_t *src,
+                      FAR uint8_t *dst);
+
+/****************************************************************************
+ * Name: rijndael_encrypt_ctr
+ *
+ * Description:
+ *   Produce 'nblocks' consecutive blocks of counter mode key stream into
+ *   'dst'.  After each block the big-endian 16-bit counter held in the last
+ *   two bytes of 'ctr' (the CCM counter with L = 2) is incremented, so on
+ *   return 'ctr' holds the next unused counter block.
+ *
+ ****************************************************************************/
+
+void rijndael_encrypt_ctr(FAR const rijndael_ctx *ctx, FAR uint8_t *ctr,
+                          FAR uint8_t *dst, unsigned int nblocks);
+
+#endif /* __NET_IEEE80211_IEEE80211_RIJNDAEL_H */
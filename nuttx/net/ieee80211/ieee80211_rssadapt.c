@@ -32,6 +32,7 @@
  * Included Files
  ****************************************************************************/
 
+#ifndef IEEE80211_HOSTBENCH
 #include <sys/socket.h>
 
 #include <net/if.h>
@@ -43,6 +44,8 @@
 
 #include "ieee80211/ieee80211_debug.h"
 #include "ieee80211/ieee80211_var.h"
+#endif
+
 #include "ieee80211/ieee80211_rssadapt.h"
 
 #ifdef interpolate
@@ -86,7 +89,7 @@ ieee80211_rssadapt_choose(struct ieee80211_rssadapt *ra,
                           const struct ieee80211_frame *wh, unsigned int len,
                           int fixed_rate, const char *dvname, int do_not_adapt)
 {
-  uint16_t(*thrs)[IEEE80211_RATE_SIZE];
+  uint16_t(*thrs)[IEEE80211_RATE_MAXSIZE];
   int flags = 0, i, rateidx = 0, thridx, top;
 
   if ((wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) == IEEE80211_FC0_TYPE_CTL)
@@ -227,7 +230,7 @@ ieee80211_rssadapt_raise_rate(struct ieee80211_s *ic,
                               struct ieee80211_rssadapt *ra,
                               const struct ieee80211_rssdesc *id)
 {
-  uint16_t(*thrs)[IEEE80211_RATE_SIZE], newthr, oldthr;
+  uint16_t(*thrs)[IEEE80211_RATE_MAXSIZE], newthr, oldthr;
   const struct ieee80211_node *ni = id->id_node;
   const struct ieee80211_rateset *rs = &ni->ni_rates;
   int i, rate, top;
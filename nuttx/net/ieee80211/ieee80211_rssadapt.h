@@ -84,7 +84,7 @@ struct ieee80211_rssadapt
 
     /* RSSI threshold for each Tx rate */
 
-    uint16_t ra_rate_thresh[IEEE80211_RSSADAPT_BKTS][IEEE80211_RATE_SIZE];
+    uint16_t ra_rate_thresh[IEEE80211_RSSADAPT_BKTS][IEEE80211_RATE_MAXSIZE];
     struct timeval ra_last_raise;
     struct timeval ra_raise_interval;
   };
@@ -0,0 +1,315 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_sha1.c
+ * SHA-1 and HMAC-SHA1 (RFC 2104)
+ *
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ieee80211_sha1.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define ROTL(x,n)  (((x) << (n)) | ((x) >> (32 - (n))))
+
+/* One SHA-1 round.  The message schedule is kept in a 16 word ring. */
+
+#define SHA1_W(t) \
+  (w[(t) & 15] = ROTL(w[((t) + 13) & 15] ^ w[((t) + 8) & 15] ^ \
+                      w[((t) + 2) & 15] ^ w[(t) & 15], 1))
+
+#define SHA1_ROUND(f, k, wt) \
+  do \
+    { \
+      tmp = ROTL(a, 5) + (f) + e + (k) + (wt); \
+      e = d; \
+      d = c; \
+      c = ROTL(b, 30); \
+      b = a; \
+      a = tmp; \
+    } \
+  while (0)
+
+#define SHA1_F0(b,c,d)  ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F1(b,c,d)  ((b) ^ (c) ^ (d))
+#define SHA1_F2(b,c,d)  (((b) & (c)) | ((d) & ((b) | (c))))
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sha1_block
+ *
+ * Description:
+ *   Fold one 64-byte block into 'h'.
+ *
+ ****************************************************************************/
+
+static void sha1_block(FAR uint32_t *h, FAR const uint8_t *p)
+{
+  uint32_t w[16];
+  int i;
+
+  for (i = 0; i < 16; i++, p += 4)
+    {
+      w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+             (uint32_t)p[2] << 8 | p[3];
+    }
+
+  ieee80211_sha1_compress(h, w);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ieee80211_sha1_compress
+ ****************************************************************************/
+
+void ieee80211_sha1_compress(FAR uint32_t *h, FAR const uint32_t *msg)
+{
+  uint32_t w[16];
+  uint32_t a = h[0];
+  uint32_t b = h[1];
+  uint32_t c = h[2];
+  uint32_t d = h[3];
+  uint32_t e = h[4];
+  uint32_t tmp;
+  int t;
+
+  memcpy(w, msg, sizeof(w));
+
+  for (t = 0; t < 16; t++)
+    {
+      SHA1_ROUND(SHA1_F0(b, c, d), 0x5a827999, w[t]);
+    }
+
+  for (; t < 20; t++)
+    {
+      SHA1_ROUND(SHA1_F0(b, c, d), 0x5a827999, SHA1_W(t));
+    }
+
+  for (; t < 40; t++)
+    {
+      SHA1_ROUND(SHA1_F1(b, c, d), 0x6ed9eba1, SHA1_W(t));
+    }
+
+  for (; t < 60; t++)
+    {
+      SHA1_ROUND(SHA1_F2(b, c, d), 0x8f1bbcdc, SHA1_W(t));
+    }
+
+  for (; t < 80; t++)
+    {
+      SHA1_ROUND(SHA1_F1(b, c, d), 0xca62c1d6, SHA1_W(t));
+    }
+
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+/****************************************************************************
+ * Name: SHA1Init
+ ****************************************************************************/
+
+void SHA1Init(FAR SHA1_CTX *ctx)
+{
+  ctx->state[0] = 0x67452301;
+  ctx->state[1] = 0xefcdab89;
+  ctx->state[2] = 0x98badcfe;
+  ctx->state[3] = 0x10325476;
+  ctx->state[4] = 0xc3d2e1f0;
+  ctx->count    = 0;
+}
+
+/****************************************************************************
+ * Name: SHA1Update
+ ****************************************************************************/
+
+void SHA1Update(FAR SHA1_CTX *ctx, FAR const void *data, size_t len)
+{
+  FAR const uint8_t *p = data;
+  size_t used = ctx->count % SHA1_BLOCK_LENGTH;
+  size_t ncopy;
+
+  ctx->count += len;
+
+  while (len > 0)
+    {
+      if (used == 0 && len >= SHA1_BLOCK_LENGTH)
+        {
+          sha1_block(ctx->state, p);
+          p   += SHA1_BLOCK_LENGTH;
+          len -= SHA1_BLOCK_LENGTH;
+          continue;
+        }
+
+      ncopy = SHA1_BLOCK_LENGTH - used;
+      if (ncopy > len)
+        {
+          ncopy = len;
+        }
+
+      memcpy(&ctx->buffer[used], p, ncopy);
+      p    += ncopy;
+      len  -= ncopy;
+      used += ncopy;
+
+      if (used == SHA1_BLOCK_LENGTH)
+        {
+          sha1_block(ctx->state, ctx->buffer);
+          used = 0;
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: SHA1Final
+ ****************************************************************************/
+
+void SHA1Final(FAR uint8_t *digest, FAR SHA1_CTX *ctx)
+{
+  size_t used = ctx->count % SHA1_BLOCK_LENGTH;
+  uint64_t bits = ctx->count * 8;
+  int i;
+
+  ctx->buffer[used++] = 0x80;
+  if (used > SHA1_BLOCK_LENGTH - 8)
+    {
+      memset(&ctx->buffer[used], 0, SHA1_BLOCK_LENGTH - used);
+      sha1_block(ctx->state, ctx->buffer);
+      used = 0;
+    }
+
+  memset(&ctx->buffer[used], 0, SHA1_BLOCK_LENGTH - 8 - used);
+  for (i = 0; i < 8; i++)
+    {
+      ctx->buffer[SHA1_BLOCK_LENGTH - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+
+  sha1_block(ctx->state, ctx->buffer);
+
+  for (i = 0; i < 5; i++, digest += 4)
+    {
+      digest[0] = ctx->state[i] >> 24;
+      digest[1] = ctx->state[i] >> 16;
+      digest[2] = ctx->state[i] >> 8;
+      digest[3] = ctx->state[i];
+    }
+}
+
+/****************************************************************************
+ * Name: HMAC_SHA1_Init
+ ****************************************************************************/
+
+void HMAC_SHA1_Init(FAR HMAC_SHA1_CTX *ctx, FAR const uint8_t *key,
+                    size_t key_len)
+{
+  uint8_t pad[SHA1_BLOCK_LENGTH];
+  uint8_t digest[SHA1_DIGEST_LENGTH];
+  size_t i;
+
+  if (key_len > SHA1_BLOCK_LENGTH)
+    {
+      SHA1Init(&ctx->ictx);
+      SHA1Update(&ctx->ictx, key, key_len);
+      SHA1Final(digest, &ctx->ictx);
+      key     = digest;
+      key_len = SHA1_DIGEST_LENGTH;
+    }
+
+  memset(pad, 0x36, sizeof(pad));
+  for (i = 0; i < key_len; i++)
+    {
+      pad[i] ^= key[i];
+    }
+
+  SHA1Init(&ctx->ictx);
+  SHA1Update(&ctx->ictx, pad, sizeof(pad));
+
+  for (i = 0; i < sizeof(pad); i++)
+    {
+      pad[i] ^= 0x36 ^ 0x5c;
+    }
+
+  SHA1Init(&ctx->octx);
+  SHA1Update(&ctx->octx, pad, sizeof(pad));
+
+  /* Do not leave key material on the stack */
+
+  memset(pad, 0, sizeof(pad));
+  memset(digest, 0, sizeof(digest));
+}
+
+/****************************************************************************
+ * Name: HMAC_SHA1_Update
+ ****************************************************************************/
+
+void HMAC_SHA1_Update(FAR HMAC_SHA1_CTX *ctx, FAR const void *data,
+                      size_t len)
+{
+  SHA1Update(&ctx->ictx, data, len);
+}
+
+/****************************************************************************
+ * Name: HMAC_SHA1_Final
+ ****************************************************************************/
+
+void HMAC_SHA1_Final(FAR uint8_t *digest, FAR HMAC_SHA1_CTX *ctx)
+{
+  uint8_t inner[SHA1_DIGEST_LENGTH];
+
+  SHA1Final(inner, &ctx->ictx);
+  SHA1Update(&ctx->octx, inner, sizeof(inner));
+  SHA1Final(digest, &ctx->octx);
+
+  memset(inner, 0, sizeof(inner));
+  memset(ctx, 0, sizeof(HMAC_SHA1_CTX));
+}
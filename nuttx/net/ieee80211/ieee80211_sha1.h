@@ -0,0 +1,117 @@
+/****************************************************************************
+ * net/ieee80211/ieee80211_sha1.h
+ * SHA-1 and HMAC-SHA1 (RFC 2104)
+ *
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __NET_IEEE80211_IEEE80211_SHA1_H
+#define __NET_IEEE80211_IEEE80211_SHA1_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#ifndef IEEE80211_HOSTBENCH
+#  include <nuttx/config.h>
+#else
+#  define FAR
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define SHA1_BLOCK_LENGTH    64    /* Bytes per compression */
+#define SHA1_DIGEST_LENGTH   20
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef struct
+{
+  uint32_t state[5];                /* Chaining state */
+  uint64_t count;                   /* Bytes hashed so far */
+  uint8_t buffer[SHA1_BLOCK_LENGTH]; /* Partial block */
+} SHA1_CTX;
+
+/* The inner and outer contexts are left just past the key pads by
+ * HMAC_SHA1_Init(), so an initialized context may be copied to compute
+ * several MACs with the same key.
+ */
+
+typedef struct
+{
+  SHA1_CTX ictx;                    /* H(K ^ ipad || ... */
+  SHA1_CTX octx;                    /* H(K ^ opad || ... */
+} HMAC_SHA1_CTX;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+void SHA1Init(FAR SHA1_CTX *ctx);
+void SHA1Update(FAR SHA1_CTX *ctx, FAR const void *data, size_t len);
+void SHA1Final(FAR uint8_t *digest, FAR SHA1_CTX *ctx);
+
+/****************************************************************************
+ * Name: ieee80211_sha1_compress
+ *
+ * Description:
+ *   Fold one message block, given as 16 host order words, into 'state'.
+ *   For callers such as PBKDF2 that build whole blocks themselves.
+ *
+ ****************************************************************************/
+
+void ieee80211_sha1_compress(FAR uint32_t *state, FAR const uint32_t *w);
+
+/****************************************************************************
+ * Name: HMAC_SHA1_Init/Update/Final
+ *
+ * Description:
+ *   HMAC-SHA1 of a message given in any number of pieces.  Keys longer
+ *   than one block are hashed first.  Final wipes the context.
+ *
+ ****************************************************************************/
+
+void HMAC_SHA1_Init(FAR HMAC_SHA1_CTX *ctx, FAR const uint8_t *key,
+                    size_t key_len);
+void HMAC_SHA1_Update(FAR HMAC_SHA1_CTX *ctx, FAR const void *data,
+                      size_t len);
+void HMAC_SHA1_Final(FAR uint8_t *digest, FAR HMAC_SHA1_CTX *ctx);
+
+#endif /* __NET_IEEE80211_IEEE80211_SHA1_H */
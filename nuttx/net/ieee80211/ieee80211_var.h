@@ -44,10 +44,12 @@
 
 #include <net/if.h>
 
+#include <nuttx/wqueue.h>
 #include <nuttx/net/iob.h>
 #include "ieee80211/ieee80211.h"
 #include "ieee80211/ieee80211_crypto.h"
 #include "ieee80211/ieee80211_node.h"
+#include "ieee80211/ieee80211_nodetab.h"
 #include "ieee80211/ieee80211_proto.h"
 
 /****************************************************************************
@@ -202,17 +204,239 @@ struct ieee80211_edca_ac_params
     uint8_t ac_acm;
   };
 
-#define IEEE80211_DEFRAG_SIZE    3    /* must be >= 3 according to spec */
+/* Transmit queue of one access category, or of the management or power
+ * save frames.  The counters are maintained under the network lock by
+ * ieee80211_ifsend() and ieee80211_ifpoll().
+ */
+
+struct ieee80211_txq_s
+  {
+    struct iob_queue_s txq_queue;   /* Queued I/O buffer chains */
+    uint16_t txq_len;               /* Current number of queued frames */
+    uint16_t txq_hiwat;             /* Largest value of txq_len seen */
+    uint32_t txq_enqueued;          /* Frames accepted into the queue */
+    uint32_t txq_dequeued;          /* Frames handed to the driver */
+    uint32_t txq_drops;             /* Frames dropped (queue full/flushed) */
+  };
+
+/* A-MPDU transmit statistics, maintained under the network lock by the
+ * aggregation stage.  am_subframes / am_aggregates is the mean aggregate
+ * size.
+ */
+
+struct ieee80211_ampdu_stats
+  {
+    uint32_t am_aggregates;         /* A-MPDUs handed to the driver */
+    uint32_t am_subframes;          /* MPDUs carried in them */
+    uint32_t am_acked;              /* MPDUs acknowledged by BlockAck */
+    uint32_t am_retries;            /* MPDUs queued for retransmission */
+    uint32_t am_drops;              /* MPDUs dropped (backlog/retry limit) */
+    uint32_t am_bars;               /* BlockAckReq frames sent */
+  };
+
+/* An A-MSDU under construction for one access category.  The first MSDU
+ * stays an Ethernet frame until a second one joins it.
+ */
 
-/* Entry in the fragment cache */
+struct ieee80211_amsdu_s
+  {
+    FAR struct iob_s *as_head;      /* First MSDU; NULL if idle */
+    FAR struct iob_s *as_tail;      /* Last I/O buffer of the chain */
+    uint16_t as_len;                /* A-MSDU length so far */
+    uint16_t as_lastlen;            /* Length of the last subframe */
+    uint8_t as_nmsdus;              /* Number of MSDUs held */
+    uint8_t as_tid;                 /* TID shared by all MSDUs */
+    uint8_t as_da[IEEE80211_ADDR_LEN];  /* DA shared by all MSDUs */
+  };
+
+/* A-MSDU transmit statistics.  as_msdus / as_amsdus is the aggregation
+ * ratio.
+ */
+
+struct ieee80211_amsdu_stats
+  {
+    uint32_t as_amsdus;             /* A-MSDUs queued for transmission */
+    uint32_t as_msdus;              /* MSDUs carried in them */
+    uint32_t as_single;             /* Held MSDUs that were sent alone */
+    uint32_t as_timeouts;           /* Flushes by the hold timer */
+    uint32_t as_nobufs;             /* MSDUs lost for lack of I/O buffers */
+  };
+
+/* Fragment reassembly table (see ieee80211_defrag.c) */
+
+#ifndef CONFIG_IEEE80211_DEFRAG_NENTRIES
+#  define CONFIG_IEEE80211_DEFRAG_NENTRIES 16
+#endif
+
+#ifndef CONFIG_IEEE80211_DEFRAG_PERNODE
+#  define CONFIG_IEEE80211_DEFRAG_PERNODE 3   /* must be >= 3 according to spec */
+#endif
+
+#define IEEE80211_DEFRAG_HASHSIZE 16           /* power of 2 */
+
+/* An MSDU being reassembled, keyed by (TA, sequence number, TID) */
 
 struct ieee80211_defrag
   {
-    WDOG_ID df_to;
-    struct iob_s *df_m;
+    dq_entry_t df_age;              /* Age list, oldest first */
+    FAR struct ieee80211_defrag *df_hnext;  /* Hash chain or free list */
+    FAR struct ieee80211_node *df_ni;       /* Transmitter (no reference) */
+    FAR struct iob_s *df_m;         /* Fragments received so far */
+    uint32_t df_expire;             /* Expiry time (system ticks) */
+    uint8_t df_ta[IEEE80211_ADDR_LEN];
     uint16_t df_seq;
-    uint8_t df_frag;
+    uint8_t df_tid;
+    uint8_t df_frag;                /* Last fragment number received */
+    uint8_t df_hash;                /* Hash bucket */
+  };
+
+struct ieee80211_defrag_stats
+  {
+    uint32_t ds_msdus;              /* MSDUs reassembled */
+    uint32_t ds_evictions;          /* MSDUs dropped to make room */
+    uint32_t ds_timeouts;           /* MSDUs dropped after their lifetime */
+    uint32_t ds_dropped;            /* Fragments without a matching MSDU */
+  };
+
+/* Receive reordering statistics (see ieee80211_reorder.c) */
+
+struct ieee80211_reorder_stats
+  {
+    uint32_t rs_stale;              /* MPDUs behind the window, dropped */
+    uint32_t rs_dups;               /* MPDUs already held, dropped */
+  };
+
+/* Scan statistics.  A pass is one sweep over the channel list, from
+ * ieee80211_begin_scan() or the previous pass to ieee80211_end_scan().
+ * Durations are in milliseconds.
+ */
+
+struct ieee80211_scan_stats
+  {
+    uint32_t ss_scans;              /* Scans started */
+    uint32_t ss_passes;             /* Passes completed */
+    uint32_t ss_start;              /* Start of the current pass (ticks) */
+    uint32_t ss_last;               /* Duration of the last pass */
+    uint32_t ss_max;                /* Longest pass */
+    uint32_t ss_total;              /* Time spent scanning */
+    uint32_t ss_bgscans;            /* Background scans completed */
+    uint32_t ss_slices;             /* Off-channel slices of those scans */
+    uint32_t ss_roams;              /* Roams decided on their results */
+  };
+
+#ifdef CONFIG_IEEE80211_BGSCAN
+/* Background scan state (see ieee80211_bgscan.c).  While a station is
+ * associated, the channels of the scan list are visited one at a time for
+ * a short dwell, returning to the home channel (that of ic_bss) in between.
+ */
+
+struct ieee80211_bgscan_s
+  {
+    struct work_s bs_work;          /* Slice timer and periodic trigger */
+    FAR struct ieee80211_channel *bs_chan; /* Off-channel tuned, NULL: home */
+    uint32_t bs_start;              /* Start of the current scan (ticks) */
+    uint32_t bs_last;               /* End of the previous scan (ticks) */
+    uint16_t bs_next;               /* Next entry of ic_scan_chans[] */
+    uint8_t bs_state;               /* See ieee80211_bgscan.c */
+    uint8_t bs_defer;               /* Slices postponed for pending traffic */
+  };
+
+/* The channel the radio is tuned to, and whether beacons and probe
+ * responses are being collected as scan results.  A background scan
+ * collects them for its whole duration, on the home channel too.
+ */
+
+#  define IEEE80211_CURCHAN(ic) \
+     ((ic)->ic_bgscan.bs_chan != NULL ? (ic)->ic_bgscan.bs_chan : \
+      (ic)->ic_bss->ni_chan)
+#  define IEEE80211_SCANNING(ic) \
+     ((ic)->ic_state == IEEE80211_S_SCAN || (ic)->ic_bgscan.bs_state != 0)
+#else
+#  define IEEE80211_CURCHAN(ic)  ((ic)->ic_bss->ni_chan)
+#  define IEEE80211_SCANNING(ic) ((ic)->ic_state == IEEE80211_S_SCAN)
+#endif
+
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+/* Authenticator 4-way handshake scheduler (see ieee80211_authsched.c) */
+
+#  ifndef CONFIG_IEEE80211_AUTHSCHED_MAXACTIVE
+#    define CONFIG_IEEE80211_AUTHSCHED_MAXACTIVE 4
+#  endif
+#  ifndef CONFIG_IEEE80211_AUTHSCHED_BATCH
+#    define CONFIG_IEEE80211_AUTHSCHED_BATCH 2
+#  endif
+
+struct ieee80211_hs_stats
+  {
+    uint32_t hs_started;            /* Handshakes given a slot */
+    uint32_t hs_completed;          /* Reached PTKINITDONE */
+    uint32_t hs_failed;             /* Slot released without completing */
+    uint32_t hs_deferred;           /* Had to wait for a slot */
+    uint32_t hs_micfail;            /* Message 2 with a bad MIC */
+    uint32_t hs_peak;               /* Most handshakes in progress at once */
+    uint32_t hs_lastms;             /* Latency of the last handshake */
+    uint32_t hs_maxms;              /* Worst latency */
+    uint32_t hs_totalms;            /* Sum of the latencies */
+  };
+
+struct ieee80211_authsched_s
+  {
+    dq_queue_t as_waiting;          /* Stations waiting for a slot */
+    dq_queue_t as_ready;            /* Messages 2 waiting for the worker */
+    dq_queue_t as_timers;           /* EAPOL retry timers, soonest first */
+    struct work_s as_work;          /* Message 2 worker (low priority) */
+    struct work_s as_timer;         /* Shared retry timer */
+    uint16_t as_active;             /* Handshakes holding a slot */
+    uint16_t as_seq;                /* Last message 2 sequence number */
+    bool as_queued;                 /* as_work is queued or running */
+    struct ieee80211_hs_stats as_stats;
   };
+#endif
+
+#ifdef CONFIG_IEEE80211_AP
+/* Group key rekeying (see ieee80211_rekey.c) */
+
+#  ifndef CONFIG_IEEE80211_REKEY_BATCH
+#    define CONFIG_IEEE80211_REKEY_BATCH 4
+#  endif
+#  ifndef CONFIG_IEEE80211_REKEY_INTERVAL
+#    define CONFIG_IEEE80211_REKEY_INTERVAL 10
+#  endif
+
+/* Largest Key Data of a group message 1: GTK KDE (TKIP) and IGTK KDE */
+
+#define IEEE80211_REKEY_KDELEN  (2 + 6 + 32 + 2 + 28)
+
+struct ieee80211_rekey_stats
+  {
+    uint32_t rk_started;            /* Rekeys started */
+    uint32_t rk_completed;          /* Rekeys acknowledged by all stations */
+    uint32_t rk_stations;           /* Stations in the last rekey */
+    uint32_t rk_lastms;             /* Duration of the last rekey */
+    uint32_t rk_maxms;              /* Longest rekey */
+  };
+
+struct ieee80211_rekey_s
+  {
+#ifdef CONFIG_SCHED_WORKQUEUE
+    struct work_s rk_work;          /* Sends the next batch of messages 1 */
+#endif
+    uint32_t rk_start;              /* Rekey started (system ticks) */
+    uint16_t rk_outstanding;        /* Stations yet to install the keys */
+    uint16_t rk_budget;             /* Messages 1 left in this batch */
+    bool rk_active;                 /* A rekey is in progress */
+    bool rk_more;                   /* Stations left for the next batch */
+
+    /* Key Data shared by all stations with the same TxRx flag and MFP
+     * setting, built on first use.  Only the per-station replay counter,
+     * key wrap and MIC differ.
+     */
+
+    uint8_t rk_kdelen[4];
+    uint8_t rk_kde[4][IEEE80211_REKEY_KDELEN];
+    struct ieee80211_rekey_stats rk_stats;
+  };
+#endif
 
 #define IEEE80211_PROTO_NONE     0
 #define IEEE80211_PROTO_RSN     (1 << 0)
@@ -227,12 +451,20 @@ struct ieee80211_defrag
 
 struct ieee80211_s
   {
+    dq_entry_t ic_list;         /* Link in ieee80211_s_head (must be first) */
     void (*ic_recv_mgmt) (struct ieee80211_s *,
                           struct iob_s *, struct ieee80211_node *,
                           struct ieee80211_rxinfo *, int);
     int (*ic_send_mgmt) (struct ieee80211_s *,
                          struct ieee80211_node *, int, int, int);
     int (*ic_newstate) (struct ieee80211_s *, enum ieee80211_state, int);
+
+    /* Optional: retune the radio without a state change (background
+     * scanning).  Frames the driver already took must go out first.
+     */
+
+    int (*ic_set_channel) (struct ieee80211_s *,
+                           struct ieee80211_channel *);
     void (*ic_newassoc) (struct ieee80211_s *, struct ieee80211_node *, int);
     void (*ic_node_leave) (struct ieee80211_s *, struct ieee80211_node *);
     void (*ic_updateslot) (struct ieee80211_s *);
@@ -242,6 +474,10 @@ struct ieee80211_s
                        struct ieee80211_node *, struct ieee80211_key *);
     void (*ic_delete_key) (struct ieee80211_s *,
                            struct ieee80211_node *, struct ieee80211_key *);
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+    int (*ic_crypto_offload) (struct ieee80211_s *,
+                              struct ieee80211_crypto_req *);
+#endif
     int (*ic_ampdu_tx_start) (struct ieee80211_s *,
                               struct ieee80211_node *, uint8_t);
     void (*ic_ampdu_tx_stop) (struct ieee80211_s *,
@@ -258,11 +494,28 @@ struct ieee80211_s
     struct ieee80211_channel ic_channels[IEEE80211_CHAN_MAX + 1];
     uint8_t ic_chan_avail[howmany(IEEE80211_CHAN_MAX, 8)];
     uint8_t ic_chan_active[howmany(IEEE80211_CHAN_MAX, 8)];
-    uint8_t ic_chan_scan[howmany(IEEE80211_CHAN_MAX, 8)];
-    struct iob_queue_s ic_mgtq;
-    struct iob_queue_s ic_pwrsaveq;
+    uint8_t ic_scan_chans[IEEE80211_CHAN_MAX + 1]; /* Channels to scan */
+    uint16_t ic_scan_nchans;    /* Entries in ic_scan_chans[] */
+    uint16_t ic_scan_next;      /* Next entry to scan */
+    struct ieee80211_txq_s ic_mgtq;     /* Management frames */
+    struct ieee80211_txq_s ic_pwrsaveq; /* Frames released by PS stations */
+    struct ieee80211_txq_s ic_txq[EDCA_NUM_AC]; /* EDCA data queues */
+    uint32_t ic_txclassified;   /* Data frames given an access category */
+    bool ic_txpolling;          /* Driver has been asked to poll */
+#ifdef CONFIG_IEEE80211_AMSDU_TX
+    struct ieee80211_amsdu_s ic_amsdu[EDCA_NUM_AC];
+    struct ieee80211_amsdu_stats ic_amsdu_stats;
+    struct work_s ic_amsdu_work;    /* A-MSDU hold timer */
+#endif
+#ifdef CONFIG_IEEE80211_HT
+    struct ieee80211_ampdu_stats ic_ampdu_stats;
+#endif
     unsigned int ic_scan_lock;  /* user-initiated scan */
     uint8_t ic_scan_count;      /* count scans */
+    struct ieee80211_scan_stats ic_scan_stats;
+#ifdef CONFIG_IEEE80211_BGSCAN
+    struct ieee80211_bgscan_s ic_bgscan;
+#endif
     uint32_t ic_flags;          /* state flags */
     uint32_t ic_caps;           /* capabilities */
     uint16_t ic_modecaps;       /* set of mode capabilities */
@@ -277,6 +530,7 @@ struct ieee80211_s
     struct ieee80211_node *ic_bss;      /* information for this node */
     struct ieee80211_channel *ic_ibss_chan;
     int ic_fixed_rate;          /* index to ic_sup_rates[] */
+    FAR const struct ieee80211_ratectl_ops *ic_ratectl; /* NULL: driver */
     uint16_t ic_rtsthreshold;
     uint16_t ic_fragthreshold;
     unsigned int ic_scangen;    /* gen# for timeout scan */
@@ -289,6 +543,7 @@ struct ieee80211_s
                                 const struct ieee80211_node *);
     uint8_t ic_max_rssi;
     struct ieee80211_tree ic_tree;
+    struct ieee80211_nodetab_s ic_nodetab;  /* MAC index over ic_tree */
     int ic_nnodes;              /* length of ic_nnodes */
     int ic_max_nnodes;          /* max length of ic_nnodes */
     uint16_t ic_lintval;        /* listen interval */
@@ -312,6 +567,10 @@ struct ieee80211_s
 #define ic_wep_txkey    ic_def_txkey
     int ic_igtk_kid;            /* IGTK key index */
     uint32_t ic_iv;             /* initial vector for wep */
+    struct ieee80211_crypto_stats ic_crypto_stats;
+#ifdef CONFIG_IEEE80211_CRYPTO_ASYNC
+    struct ieee80211_cryptoq_s ic_cryptoq;      /* async crypto engine */
+#endif
     struct timeval ic_last_merge_print; /* for rate-limiting * IBSS merge
                                          * print-outs */
     struct ieee80211_edca_ac_params ic_edca_ac[EDCA_NUM_AC];
@@ -320,23 +579,44 @@ struct ieee80211_s
     uint8_t ic_globalcnt[EAPOL_KEY_NONCE_LEN];
     uint8_t ic_nonce[EAPOL_KEY_NONCE_LEN];
     uint8_t ic_psk[IEEE80211_PMK_LEN];
+#ifdef CONFIG_IEEE80211_PBKDF2
+    struct ieee80211_pskreq_s ic_pskreq;        /* passphrase to PSK */
+#endif
+#ifdef CONFIG_IEEE80211_AUTHSCHED
+    struct ieee80211_authsched_s ic_authsched;  /* 4-way handshakes */
+#endif
     WDOG_ID ic_rsn_timeout;
-    uint16_t ic_rsn_keydonesta;
+#ifdef CONFIG_IEEE80211_AP
+    struct ieee80211_rekey_s ic_rekey;          /* group key rekeying */
+#endif
     int ic_tkip_micfail;
     uint64_t ic_tkip_micfail_last_tsc;
 
-    sq_queue_t ic_pmksa;        /* PMKSA cache */
+    struct ieee80211_pmk ic_pmksa[CONFIG_IEEE80211_PMKSA_NENTRIES];
+    FAR struct ieee80211_pmk *ic_pmksa_hash[IEEE80211_PMKSA_HASHSIZE];
+    FAR struct ieee80211_pmk *ic_pmksa_free;
+    dq_queue_t ic_pmksa_lru;    /* PMKSA cache, least recently used first */
+    struct ieee80211_pmksa_stats ic_pmksa_stats;
     unsigned int ic_rsnprotos;
     unsigned int ic_rsnakms;
     unsigned int ic_rsnciphers;
     enum ieee80211_cipher ic_rsngroupcipher;
     enum ieee80211_cipher ic_rsngroupmgmtcipher;
 
-    struct ieee80211_defrag ic_defrag[IEEE80211_DEFRAG_SIZE];
-    int ic_defrag_cur;
+    struct ieee80211_defrag ic_defrag[CONFIG_IEEE80211_DEFRAG_NENTRIES];
+    FAR struct ieee80211_defrag *ic_defrag_hash[IEEE80211_DEFRAG_HASHSIZE];
+    FAR struct ieee80211_defrag *ic_defrag_free;
+    dq_queue_t ic_defrag_age;
+    struct work_s ic_defrag_work;   /* Receive lifetime timer */
+    struct ieee80211_defrag_stats ic_defrag_stats;
+#ifdef CONFIG_IEEE80211_HT
+    struct ieee80211_reorder_stats ic_reorder_stats;
+#endif
 
     uint8_t *ic_tim_bitmap;
     unsigned int ic_tim_len;
+    unsigned int ic_tim_lo;     /* first non-zero octet of ic_tim_bitmap */
+    unsigned int ic_tim_hi;     /* last one (< ic_tim_lo if none) */
     unsigned int ic_tim_mcast_pending;
     unsigned int ic_dtim_period;
     unsigned int ic_dtim_count;
@@ -346,15 +626,36 @@ struct ieee80211_s
     uint8_t ic_aselcaps;
     uint8_t ic_sup_mcs[16];
     uint8_t ic_dialog_token;
+    uint32_t ic_mgmt_gen;       /* see IEEE80211_MGMT_CHANGED() */
+#ifdef CONFIG_IEEE80211_AP
+    FAR uint8_t *ic_prresp;     /* probe response body template */
+    uint16_t ic_prresp_len;
+    uint32_t ic_prresp_gen;     /* ic_mgmt_gen when it was built */
+    uint32_t ic_prresp_flags;   /* ic_flags when it was built */
+    FAR uint8_t *ic_bcn;        /* beacon template */
+    uint16_t ic_bcn_size;       /* allocated size of ic_bcn */
+    uint16_t ic_bcn_len;        /* length of the beacon frame */
+    uint16_t ic_bcn_timoff;     /* offset of the TIM element */
+    uint32_t ic_bcn_gen;        /* ic_mgmt_gen when it was built */
+    uint32_t ic_bcn_flags;      /* ic_flags when it was built */
+#endif
 
     dq_queue_t c_vaps;
   };
 
 extern dq_queue_t ieee80211_s_head;
 
+FAR struct ieee80211_s *ieee80211_find_ifname(FAR const char *ifname);
+
 #define IEEE80211_ADDR_EQ(a1,a2)    (memcmp(a1,a2,IEEE80211_ADDR_LEN) == 0)
 #define IEEE80211_ADDR_COPY(dst,src)    memcpy(dst,src,IEEE80211_ADDR_LEN)
 
+/* Note a change of the BSS state advertised in management frames, making
+ * the templates built from it stale.
+ */
+
+#define IEEE80211_MGMT_CHANGED(ic)      ((ic)->ic_mgmt_gen++)
+
 /* ic_flags */
 
 #define IEEE80211_F_ASCAN       0x00000001    /* STATUS: active scan */
@@ -397,6 +698,8 @@ extern dq_queue_t ieee80211_s_head;
 #define IEEE80211_C_RSN         0x00001000    /* CAPABILITY: RSN avail */
 #define IEEE80211_C_MFP         0x00002000    /* CAPABILITY: MFP avail */
 #define IEEE80211_C_RAWCTL      0x00004000    /* CAPABILITY: raw ctl */
+#define IEEE80211_C_RXALIGN     0x00008000    /* CAPABILITY: aligned rx */
+#define IEEE80211_C_TXCRYPTO    0x00010000    /* CAPABILITY: hw Tx crypto */
 
 /* flags for ieee80211_fix_rate() */
 
@@ -68,6 +68,12 @@ extern FAR struct iob_s *g_iob_freelist;
 extern FAR struct iob_qentry_s *g_iob_freeqlist;
 #endif
 
+/* A list of all free, unallocated packet metadata descriptors */
+
+#ifdef CONFIG_IOB_PKTHDR
+extern FAR struct iob_pkthdr_s *g_iob_freephlist;
+#endif
+
 /* Counting semaphores that tracks the number of free IOBs/qentries */
 
 extern sem_t g_iob_sem;       /* Counts free I/O buffers */
@@ -78,6 +84,12 @@ extern sem_t g_throttle_sem;  /* Counts available I/O buffers when throttled */
 extern sem_t g_qentry_sem;    /* Counts free I/O buffer queue containers */
 #endif
 
+/* Largest number of I/O buffers that were in use at the same time */
+
+#ifdef CONFIG_IOB_STATS
+extern uint16_t g_iob_hiwat;
+#endif
+
 /****************************************************************************
  * Public Data
  ****************************************************************************/
@@ -109,4 +121,16 @@ FAR struct iob_qentry_s *iob_alloc_qentry(void);
 
 FAR struct iob_qentry_s *iob_free_qentry(FAR struct iob_qentry_s *iobq);
 
+/****************************************************************************
+ * Name: iob_free_pkthdr
+ *
+ * Description:
+ *   Return a packet metadata descriptor to the free list.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_IOB_PKTHDR
+void iob_free_pkthdr(FAR struct iob_pkthdr_s *ph);
+#endif
+
 #endif /* __NET_IOB_IOB_H */
@@ -131,6 +131,13 @@ static FAR struct iob_s *iob_tryalloc(bool throttled)
           g_iob_sem.semcount--;
           DEBUGASSERT(g_iob_sem.semcount >= 0);
 
+#ifdef CONFIG_IOB_STATS
+          if (CONFIG_IOB_NBUFFERS - g_iob_sem.semcount > g_iob_hiwat)
+            {
+              g_iob_hiwat = CONFIG_IOB_NBUFFERS - g_iob_sem.semcount;
+            }
+#endif
+
 #if CONFIG_IOB_THROTTLE > 0
           /* The throttle semaphore is a little more complicated because
            * it can be negative!  Decrementing is still safe, however.
@@ -147,6 +154,9 @@ static FAR struct iob_s *iob_tryalloc(bool throttled)
           iob->io_len    = 0;    /* Length of the data in the entry */
           iob->io_offset = 0;    /* Offset to the beginning of data */
           iob->io_pktlen = 0;    /* Total length of the packet */
+#ifdef CONFIG_IOB_PKTHDR
+          iob->io_pkthdr = NULL; /* No packet metadata */
+#endif
           return iob;
         }
     }
@@ -104,6 +104,16 @@ int iob_clone(FAR struct iob_s *iob1, FAR struct iob_s *iob2, bool throttled)
 
   iob2->io_pktlen = iob1->io_pktlen;
 
+#ifdef CONFIG_IOB_PKTHDR
+  /* And the packet metadata, if there is any and a descriptor is free */
+
+  if (iob1->io_pkthdr != NULL && iob_pkthdr_attach(iob2) != NULL)
+    {
+      memcpy(iob2->io_pkthdr->ph_data, iob1->io_pkthdr->ph_data,
+             sizeof(iob1->io_pkthdr->ph_data));
+    }
+#endif
+
   /* Handle special case where there are empty buffers at the head
    * the the list.
    */
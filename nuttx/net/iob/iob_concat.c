@@ -82,16 +82,24 @@
 
 void iob_concat(FAR struct iob_s *iob1, FAR struct iob_s *iob2)
 {
+  FAR struct iob_s *tail = iob1;
+
   /* Find the last buffer in the iob1 buffer chain */
- 
-  while (iob1->io_flink)
+
+  while (tail->io_flink)
     {
-      iob1 = iob1->io_flink;
+      tail = tail->io_flink;
     }
 
   /* Then connect iob2 buffer chain to the end of the iob1 chain */
 
-  iob1->io_flink = iob2;
+  tail->io_flink = iob2;
+
+#ifdef CONFIG_IOB_PKTHDR
+  /* iob2 is no longer the head of a chain */
+
+  iob_pkthdr_detach(iob2);
+#endif
 
   /* Combine the total packet size */
 
@@ -121,7 +121,21 @@ FAR struct iob_s *iob_free(FAR struct iob_s *iob)
 
       nllvdbg("next=%p io_pktlen=%u io_len=%u\n",
                next, next->io_pktlen, next->io_len);
+
+#ifdef CONFIG_IOB_PKTHDR
+      /* The packet metadata follows the head of the chain */
+
+      next->io_pkthdr = iob->io_pkthdr;
+#endif
     }
+#ifdef CONFIG_IOB_PKTHDR
+  else if (iob->io_pkthdr != NULL)
+    {
+      /* Last buffer of the packet, release its metadata */
+
+      iob_free_pkthdr(iob->io_pkthdr);
+    }
+#endif
 
   /* Free the I/O buffer by adding it to the head of the free list. We don't
    * know what context we are called from so we use extreme measures to
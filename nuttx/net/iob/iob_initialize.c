@@ -71,6 +71,9 @@ static struct iob_s        g_iob_pool[CONFIG_IOB_NBUFFERS];
 #if CONFIG_IOB_NCHAINS > 0
 static struct iob_qentry_s g_iob_qpool[CONFIG_IOB_NCHAINS];
 #endif
+#ifdef CONFIG_IOB_PKTHDR
+static struct iob_pkthdr_s g_iob_phpool[CONFIG_IOB_NPKTHDRS];
+#endif
 
 /****************************************************************************
  * Public Data
@@ -86,6 +89,12 @@ FAR struct iob_s *g_iob_freelist;
 FAR struct iob_qentry_s *g_iob_freeqlist;
 #endif
 
+/* A list of all free, unallocated packet metadata descriptors */
+
+#ifdef CONFIG_IOB_PKTHDR
+FAR struct iob_pkthdr_s *g_iob_freephlist;
+#endif
+
 /* Counting semaphores that tracks the number of free IOBs/qentries */
 
 sem_t g_iob_sem;            /* Counts free I/O buffers */
@@ -150,6 +159,18 @@ void iob_initialize(void)
 
       sem_init(&g_qentry_sem, 0, CONFIG_IOB_NCHAINS);
 #endif
+
+#ifdef CONFIG_IOB_PKTHDR
+      /* Add each packet metadata descriptor to the free list */
+
+      for (i = 0; i < CONFIG_IOB_NPKTHDRS; i++)
+        {
+          FAR struct iob_pkthdr_s *ph = &g_iob_phpool[i];
+
+          ph->ph_flink     = g_iob_freephlist;
+          g_iob_freephlist = ph;
+        }
+#endif
       initialized = true;
     }
 }
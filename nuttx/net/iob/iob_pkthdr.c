@@ -0,0 +1,146 @@
+/****************************************************************************
+ * net/iob/iob_pkthdr.c
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#if defined(CONFIG_DEBUG) && defined(CONFIG_IOB_DEBUG)
+/* Force debug output (from this file only) */
+
+#  undef  CONFIG_DEBUG_NET
+#  define CONFIG_DEBUG_NET 1
+#endif
+
+#include <string.h>
+#include <assert.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/net/iob.h>
+
+#include "iob.h"
+
+#ifdef CONFIG_IOB_PKTHDR
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: iob_free_pkthdr
+ *
+ * Description:
+ *   Return a packet metadata descriptor to the free list.
+ *
+ ****************************************************************************/
+
+void iob_free_pkthdr(FAR struct iob_pkthdr_s *ph)
+{
+  irqstate_t flags;
+
+  /* We don't know what context we are called from so we use extreme
+   * measures to protect the free list:  We disable interrupts very briefly.
+   */
+
+  flags = irqsave();
+  ph->ph_flink = g_iob_freephlist;
+  g_iob_freephlist = ph;
+  irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: iob_pkthdr_attach
+ *
+ * Description:
+ *   Return the packet metadata of the I/O buffer chain headed by iob,
+ *   taking a zeroed metadata descriptor from the free list if the chain
+ *   does not have one yet.  NULL is returned if no descriptor is available.
+ *   This function never waits and may be called from interrupt handlers.
+ *
+ ****************************************************************************/
+
+FAR void *iob_pkthdr_attach(FAR struct iob_s *iob)
+{
+  FAR struct iob_pkthdr_s *ph;
+  irqstate_t flags;
+
+  DEBUGASSERT(iob != NULL);
+
+  ph = iob->io_pkthdr;
+  if (ph == NULL)
+    {
+      flags = irqsave();
+      ph = g_iob_freephlist;
+      if (ph != NULL)
+        {
+          g_iob_freephlist = ph->ph_flink;
+        }
+
+      irqrestore(flags);
+
+      if (ph == NULL)
+        {
+          return NULL;
+        }
+
+      ph->ph_flink = NULL;
+      memset(ph->ph_data, 0, sizeof(ph->ph_data));
+      iob->io_pkthdr = ph;
+    }
+
+  return ph->ph_data;
+}
+
+/****************************************************************************
+ * Name: iob_pkthdr_detach
+ *
+ * Description:
+ *   Release the packet metadata of the I/O buffer chain headed by iob, if
+ *   any.
+ *
+ ****************************************************************************/
+
+void iob_pkthdr_detach(FAR struct iob_s *iob)
+{
+  if (iob->io_pkthdr != NULL)
+    {
+      iob_free_pkthdr(iob->io_pkthdr);
+      iob->io_pkthdr = NULL;
+    }
+}
+
+#endif /* CONFIG_IOB_PKTHDR */
@@ -0,0 +1,90 @@
+/****************************************************************************
+ * net/iob/iob_stats.c
+ *
+ *   Copyright (C) 2014 Gregory Nutt. All rights reserved.
+ *   Author: Gregory Nutt <gnutt@nuttx.org>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <semaphore.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/net/iob.h>
+
+#include "iob.h"
+
+#ifdef CONFIG_IOB_STATS
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Largest number of I/O buffers that were in use at the same time */
+
+uint16_t g_iob_hiwat;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: iob_getstats
+ *
+ * Description:
+ *   Return the current I/O buffer pool usage.  If 'reset' is true, the
+ *   high-water mark is restarted from the number of buffers in use now.
+ *
+ ****************************************************************************/
+
+void iob_getstats(FAR struct iob_stats_s *stats, bool reset)
+{
+  irqstate_t flags;
+
+  flags = irqsave();
+  stats->is_nbuffers = CONFIG_IOB_NBUFFERS;
+  stats->is_nfree    = g_iob_sem.semcount;
+  stats->is_hiwat    = g_iob_hiwat;
+
+  if (reset)
+    {
+      g_iob_hiwat = CONFIG_IOB_NBUFFERS - g_iob_sem.semcount;
+    }
+
+  irqrestore(flags);
+}
+
+#endif /* CONFIG_IOB_STATS */